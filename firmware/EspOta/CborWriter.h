@@ -0,0 +1,97 @@
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Escritor CBOR (RFC 8949) mínimo sobre un buffer fijo, sin memoria dinámica.
+// Solo cubre lo que usan las tramas de telemetría: enteros, bytes, texto,
+// float32, mapas y arrays de largo conocido.
+//
+//   CborMessage<32> frame;
+//   frame.map(2).uint(0).bytes(mac, 6).uint(1).float32(25.3f);
+//   mqttClient.publish(TOPIC_SENSOR_CBOR, frame.data(), frame.length(), false);
+class CborWriter {
+public:
+  CborWriter(uint8_t* buf, size_t cap) : _buf(buf), _cap(cap), _len(0), _ok(true) {}
+
+  CborWriter& uint(uint64_t v) { head(0, v); return *this; }
+  CborWriter& integer(int64_t v) {
+    if (v < 0) head(1, (uint64_t)(-(v + 1)));
+    else head(0, (uint64_t)v);
+    return *this;
+  }
+  CborWriter& bytes(const uint8_t* p, size_t n) { head(2, n); put(p, n); return *this; }
+  CborWriter& text(const char* s) {
+    size_t n = s ? strlen(s) : 0;
+    head(3, n);
+    put((const uint8_t*)s, n);
+    return *this;
+  }
+  CborWriter& array(size_t n) { head(4, n); return *this; }
+  CborWriter& map(size_t n) { head(5, n); return *this; }
+  CborWriter& boolean(bool v) { byte(v ? 0xF5 : 0xF4); return *this; }
+  CborWriter& null() { byte(0xF6); return *this; }
+
+  CborWriter& float32(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    byte(0xFA);
+    for (int shift = 24; shift >= 0; shift -= 8) byte((bits >> shift) & 0xFF);
+    return *this;
+  }
+
+  bool ok() const { return _ok; }
+  const uint8_t* data() const { return _buf; }
+  size_t length() const { return _len; }
+  void clear() { _len = 0; _ok = true; }
+
+private:
+  void byte(uint8_t b) {
+    if (_len < _cap) _buf[_len++] = b;
+    else _ok = false;
+  }
+
+  void put(const uint8_t* p, size_t n) {
+    for (size_t i = 0; i < n; i++) byte(p[i]);
+  }
+
+  // Cabecera: 3 bits de tipo mayor + argumento en la forma más corta
+  void head(uint8_t major, uint64_t v) {
+    major <<= 5;
+    if (v < 24) {
+      byte(major | v);
+    } else if (v <= 0xFF) {
+      byte(major | 24);
+      byte(v);
+    } else if (v <= 0xFFFF) {
+      byte(major | 25);
+      byte(v >> 8);
+      byte(v);
+    } else if (v <= 0xFFFFFFFFULL) {
+      byte(major | 26);
+      for (int shift = 24; shift >= 0; shift -= 8) byte((v >> shift) & 0xFF);
+    } else {
+      byte(major | 27);
+      for (int shift = 56; shift >= 0; shift -= 8) byte((v >> shift) & 0xFF);
+    }
+  }
+
+  uint8_t* _buf;
+  size_t _cap;
+  size_t _len;
+  bool _ok;
+};
+
+// CborWriter con su propio buffer de N bytes
+template <size_t N>
+class CborMessage : public CborWriter {
+public:
+  CborMessage() : CborWriter(_storage, N) {}
+
+private:
+  uint8_t _storage[N];
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef CONNECTIVITY_FSM_H
+#define CONNECTIVITY_FSM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Eventos pendientes entre el callback de WiFi y loop() (potencia de 2)
+#ifndef CONN_EVENT_QUEUE
+#define CONN_EVENT_QUEUE 16
+#endif
+
+// Estados de la conectividad
+enum ConnState {
+  CONN_DISCONNECTED,     // sin WiFi; se espera el próximo intento
+  CONN_ASSOCIATING,      // escaneando o asociándose a una red
+  CONN_IP,               // WiFi con IP, sin MQTT
+  CONN_MQTT_CONNECTING,  // intento de conexión al broker en curso
+  CONN_ONLINE            // WiFi y MQTT conectados
+};
+
+// Eventos que mueven la máquina de estados
+enum ConnEvent {
+  CONN_EV_JOIN_STARTED,    // se lanzó un escaneo o WiFi.begin()
+  CONN_EV_GOT_IP,          // ARDUINO_EVENT_WIFI_STA_GOT_IP
+  CONN_EV_LOST_IP,         // ARDUINO_EVENT_WIFI_STA_LOST_IP
+  CONN_EV_DISCONNECTED,    // ARDUINO_EVENT_WIFI_STA_DISCONNECTED
+  CONN_EV_JOIN_FAILED,     // se agotaron las redes candidatas
+  CONN_EV_MQTT_STARTED,    // se inicia la conexión al broker
+  CONN_EV_MQTT_CONNECTED,
+  CONN_EV_MQTT_FAILED,
+  CONN_EV_MQTT_LOST        // el broker cerró la sesión
+};
+
+// Máquina de estados de la conectividad. No depende de Arduino: en el host se
+// prueba alimentando post()/apply() con una secuencia de eventos guionada.
+//
+// Los eventos de WiFi llegan desde la tarea de eventos del sistema: el callback
+// solo hace post() y loop() los consume con poll(), así las transiciones y los
+// callbacks del usuario corren siempre en el contexto de loop().
+//
+// Mientras se asocia, CONN_EV_DISCONNECTED no cambia el estado: cambiar de red
+// con WiFi.begin() genera desconexiones propias y el fallo de un intento lo
+// decide el plazo del intento, no el evento.
+class ConnectivityFsm {
+public:
+  typedef void (*Listener)(ConnState from, ConnState to, void* ctx);
+
+  ConnectivityFsm()
+    : _state(CONN_DISCONNECTED), _since(0), _listener(nullptr), _ctx(nullptr),
+      _head(0), _tail(0), _dropped(0) {}
+
+  void setListener(Listener listener, void* ctx) { _listener = listener; _ctx = ctx; }
+
+  ConnState state() const { return _state; }
+  unsigned long since() const { return _since; }  // instante de entrada al estado actual
+
+  // Encola un evento (un solo productor: el callback de WiFi). Nunca bloquea.
+  bool post(ConnEvent ev) {
+    uint8_t head = _head.load(std::memory_order_relaxed);
+    uint8_t next = (head + 1) & (CONN_EVENT_QUEUE - 1);
+    if (next == _tail.load(std::memory_order_acquire)) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    _events[head] = (uint8_t)ev;
+    _head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Saca el próximo evento encolado (un solo consumidor: loop())
+  bool poll(ConnEvent& ev) {
+    uint8_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) return false;
+    ev = (ConnEvent)_events[tail];
+    _tail.store((tail + 1) & (CONN_EVENT_QUEUE - 1), std::memory_order_release);
+    return true;
+  }
+
+  uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+  // Aplica un evento; avisa al listener si el estado cambió. Devuelve el estado nuevo.
+  ConnState apply(ConnEvent ev, unsigned long now) {
+    ConnState next = transition(_state, ev);
+    if (next != _state) {
+      ConnState from = _state;
+      _state = next;
+      _since = now;
+      if (_listener) _listener(from, next, _ctx);
+    }
+    return _state;
+  }
+
+  // Tabla de transiciones; los eventos que no aplican dejan el estado igual
+  static ConnState transition(ConnState s, ConnEvent ev) {
+    switch (ev) {
+      case CONN_EV_JOIN_STARTED:
+        return s == CONN_DISCONNECTED ? CONN_ASSOCIATING : s;
+      case CONN_EV_GOT_IP:
+        return (s == CONN_DISCONNECTED || s == CONN_ASSOCIATING) ? CONN_IP : s;
+      case CONN_EV_LOST_IP:
+        return s == CONN_DISCONNECTED ? s : CONN_DISCONNECTED;
+      case CONN_EV_DISCONNECTED:
+        return (s == CONN_DISCONNECTED || s == CONN_ASSOCIATING) ? s : CONN_DISCONNECTED;
+      case CONN_EV_JOIN_FAILED:
+        return s == CONN_ASSOCIATING ? CONN_DISCONNECTED : s;
+      case CONN_EV_MQTT_STARTED:
+        return s == CONN_IP ? CONN_MQTT_CONNECTING : s;
+      case CONN_EV_MQTT_CONNECTED:
+        return s == CONN_MQTT_CONNECTING ? CONN_ONLINE : s;
+      case CONN_EV_MQTT_FAILED:
+        return s == CONN_MQTT_CONNECTING ? CONN_IP : s;
+      case CONN_EV_MQTT_LOST:
+        return s == CONN_ONLINE ? CONN_IP : s;
+    }
+    return s;
+  }
+
+  static const char* name(ConnState s) {
+    switch (s) {
+      case CONN_DISCONNECTED:    return "DISCONNECTED";
+      case CONN_ASSOCIATING:     return "ASSOCIATING";
+      case CONN_IP:              return "IP";
+      case CONN_MQTT_CONNECTING: return "MQTT_CONNECTING";
+      case CONN_ONLINE:          return "ONLINE";
+    }
+    return "?";
+  }
+
+private:
+  ConnState _state;
+  unsigned long _since;
+  Listener _listener;
+  void* _ctx;
+
+  uint8_t _events[CONN_EVENT_QUEUE];
+  std::atomic<uint8_t> _head;
+  std::atomic<uint8_t> _tail;
+  std::atomic<uint32_t> _dropped;
+};
+
+#endif
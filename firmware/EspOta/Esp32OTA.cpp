@@ -1,4 +1,6 @@
 #include "Esp32OTA.h"
+#include <esp_ota_ops.h>
+
 void Esp32OTA::setLocation(float lat, float lon) {
   _latitude = lat;
   _longitude = lon;
@@ -6,200 +8,1795 @@ void Esp32OTA::setLocation(float lat, float lon) {
 
 Esp32OTA::Esp32OTA(const char* mqttHost, int mqttPort,
                    const char* mqttUser, const char* mqttPass,
-                   const char* deviceName, const char* firmwareVersion)
+                   const char* deviceName, const char* firmwareVersion,
+                   TelemetryEncoding encoding)
   : _mqttHost(mqttHost), _mqttPort(mqttPort),
     _mqttUser(mqttUser), _mqttPass(mqttPass),
     _deviceName(deviceName), _firmwareVersion(firmwareVersion),
+    _encoding(encoding),
     mqttClient(wifiClient)
 {
-  lastHeartbeat = 0;
+  memset(_macBytes, 0, sizeof(_macBytes));
+  _updateGroupCount = 0;
+  _legacyUpdateTopic = true;
   otaUpdateCallback = nullptr;
   _ssids = nullptr;
   _passwords = nullptr;
   _wifiCount = 0;
+  memset(&_wifiStats, 0, sizeof(_wifiStats));
+  _wifiSelection = WIFI_SELECT_RANKED;
+  memset(_wifiHistory, 0, sizeof(_wifiHistory));
+  _connCallback = nullptr;
+  _joinPhase = JOIN_FAST;
+  _joinCount = 0;
+  _joinNext = 0;
+  _joinIndex = -1;
+  _joinFast = false;
+  _joinStart = 0;
+  _joinDeadline = 0;
+  _wifiRetryAt = 0;
+  _mqttRetryAt = 0;
+  _conn.setListener(connStateThunk, this);
+  _netThreaded = false;
+  _netTask = nullptr;
+  _netQueueMem = nullptr;
+  _netOnline = false;
+  _netEnqueued = 0;
+  _netSent = 0;
+  _netFailed = 0;
+  _netOffline = 0;
+  _netWeatherPendingCount = 0;
+  _netWeatherUrl[0] = '\0';
+  _netWeatherDeferred = 0;
+  _netWeatherDropped = 0;
+  _otaState = OTA_IDLE;
+  _otaScheduled = false;
+  _otaScheduledKind = OTA_CMD_FULL;
+  _otaHasManifest = false;
+  _otaManifest.size = 0;
+  _runningShaState = 0;
+  _otaStream = nullptr;
+  _otaIsDelta = false;
+  _otaResumable = false;
+  _otaResumeFrom = 0;
+  _otaRetries = 0;
+  _otaRetryAt = 0;
+  _otaReceived = 0;
+  _otaWritten = 0;
+  _otaTotal = 0;
+  _otaStartMs = 0;
+  _otaLastDataMs = 0;
+  _otaBudgetMs = 20;
+  _otaBudgetBytes = 16 * 1024;
+  _otaPipeBufSize = OTA_CHUNK_SIZE;
+  _otaPipeDepth = OTA_PIPELINE_DEPTH;
+  _otaPipeMem = nullptr;
+  _otaFreeQ = nullptr;
+  _otaFullQ = nullptr;
+  _otaPipeDone = nullptr;
+  _otaPipeTask = false;
+  _otaPipeError = nullptr;
+  _otaPipeStalls = 0;
+  _otaFlashMicros = 0;
+  _otaVerifyMicros = 0;
+  _otaSignatureLen = 0;
+  _batchSamples = TELEMETRY_BATCH_SAMPLES;
+  _batchMaxAge = TELEMETRY_BATCH_MAX_AGE;
+  _logForward = false;
+  _logPendingCount = 0;
+  _logForwardDropped = 0;
+  _metricsTopic = TOPIC_METRICS;
+  _metricsInterval = METRICS_INTERVAL;
+  _metricsLast = 0;
+  // Tareas internas: se registran detenidas y se programan cuando corresponde
+  _heartbeatJob = _netJobs.add(heartbeatJob, this);
+  _metricsJob = _netJobs.add(metricsJob, this);
+  _otaScheduledJob = _netJobs.add(otaScheduledJob, this);
+  _httpIdleJob = _netJobs.add(httpIdleJob, this);
+  _offlineJob = _netJobs.add(offlineJob, this);
+  _weatherUrl[0] = '\0';
+  _bootId = 0;
+  _httpOrigin[0] = '\0';
+  memset(&_httpStats, 0, sizeof(_httpStats));
+  _httpNewTotalMs = 0;
+  _httpReusedTotalMs = 0;
 }
 
 void Esp32OTA::setWiFiNetworks(const char* ssids[], const char* passwords[], int count) {
   _ssids = ssids;
   _passwords = passwords;
   _wifiCount = count;
+  memset(_wifiHistory, 0, sizeof(_wifiHistory));
 }
 
 void Esp32OTA::begin() {
   Serial.begin(115200);
-  delay(1000);
-  connectWiFi();
+
+  // Cola offline: se abre antes de la red para no perder lecturas si el WiFi no levanta
+  _bootId = esp_random();
+  if (LittleFS.begin(true) && _offline.begin(LittleFS, OFFLINE_QUEUE_PATH)) {
+    LOGI("📂 Cola offline: %u lecturas pendientes", (unsigned)_offline.size());
+    if (!_offline.empty()) _netJobs.start(_offlineJob, millis(), 0);
+  } else {
+    LOGE("❌ No se pudo abrir la cola offline en LittleFS");
+  }
+
+  // La conexión la lleva connectivityStep() desde loop(): aquí no se espera a nada.
+  // Los reintentos los decide la máquina de estados, no el driver de WiFi.
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
+  WiFi.onEvent([this](arduino_event_id_t event, arduino_event_info_t) {
+    this->onWiFiEvent(event);
+  });
+  // Hora UNIX para fechar lecturas encoladas (SNTP sincroniza en segundo plano al tener IP)
+  configTime(0, 0, NTP_SERVER);
   deviceMac = WiFi.macAddress();
-  Serial.println("MAC: " + deviceMac);
+  WiFi.macAddress(_macBytes);
+  LOGI("MAC: %s", deviceMac.c_str());
 
-  // Configurar cliente MQTT
-  wifiClient.setInsecure();
+  // Configurar cliente MQTT (TlsSessionClient no valida el certificado, como setInsecure())
+  _httpTls.setInsecure();
+  // Cada intento de conexión al broker queda acotado a MQTT_CONNECT_TIMEOUT
+  wifiClient.setHandshakeTimeout(MQTT_CONNECT_TIMEOUT);
+  mqttClient.setSocketTimeout((MQTT_CONNECT_TIMEOUT + 999) / 1000);
   mqttClient.setServer(_mqttHost, _mqttPort);
+  // Los lotes de telemetría superan el buffer por defecto (256 bytes)
+  mqttClient.setBufferSize(TELEMETRY_BATCH_BYTES + 128);
   mqttClient.setCallback([this](char* topic, byte* payload, unsigned int length) {
     this->mqttCallback(topic, payload, length);
   });
-  connectMQTT();
+
+  // Primer intento de conexión (solo lo lanza, sin esperar)
+  if (_wifiCount == 0) LOGW("⚠️ No hay redes WiFi configuradas.");
+  _wifiRetryAt = millis();
+  connectivityStep();
+
+  // Si una descarga quedó a medias antes del reinicio, se retoma desde NVS
+  otaResumePending();
+
+  if (_netThreaded) startNetworkTask();
 }
 
-void Esp32OTA::connectWiFi() {
-  if (_wifiCount == 0) {
-    Serial.println("⚠️ No hay redes WiFi configuradas.");
-    return;
+void Esp32OTA::setConnectivityCallback(void (*callback)(ConnState from, ConnState to)) {
+  _connCallback = callback;
+}
+
+// Corre en la tarea de eventos de WiFi: solo encola, la transición la hace loop()
+void Esp32OTA::onWiFiEvent(arduino_event_id_t event) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:       _conn.post(CONN_EV_GOT_IP); break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:      _conn.post(CONN_EV_LOST_IP); break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED: _conn.post(CONN_EV_DISCONNECTED); break;
+    default: break;
+  }
+}
+
+void Esp32OTA::connStateThunk(ConnState from, ConnState to, void* ctx) {
+  static_cast<Esp32OTA*>(ctx)->connStateChanged(from, to);
+}
+
+// Acciones al entrar en cada estado; después se avisa al usuario
+void Esp32OTA::connStateChanged(ConnState from, ConnState to) {
+  unsigned long now = millis();
+  LOGI("🔌 Conectividad: %s -> %s", ConnectivityFsm::name(from), ConnectivityFsm::name(to));
+
+  if (to == CONN_IP && (from == CONN_ASSOCIATING || from == CONN_DISCONNECTED)) {
+    if (_joinIndex >= 0) WiFiRanker::record(_wifiHistory[_joinIndex], true);
+    wifiConnected(_joinStart, _joinFast);
+    _mqttRetryAt = now;
+  } else if (to == CONN_IP && from == CONN_ONLINE) {
+    LOGW("⚠️ Se perdió la conexión MQTT");
+    _metrics.count(METRIC_MQTT_LOST);
+    _mqttRetryAt = now;  // un reintento inmediato, después cada MQTT_RETRY_DELAY
+  } else if (to == CONN_DISCONNECTED && from != CONN_ASSOCIATING) {
+    LOGW("⚠️ Se perdió el WiFi");
+    _metrics.count(METRIC_WIFI_LOST);
+    wifiClient.stop();   // el socket ya no sirve; la sesión TLS se conserva
+    _wifiFast.useDhcp(); // una IP reutilizada no sigue en la próxima unión
+    _wifiRetryAt = now;  // se reintenta ya, empezando por la unión directa
   }
 
-  Serial.println("Conectando a WiFi...");
+  _netOnline = to == CONN_ONLINE;
+  if (to == CONN_ONLINE) netJobsOnline();
+  if (_connCallback) _connCallback(from, to);
+}
+
+// Avanza la conectividad un paso. Nunca espera: cada estado revisa sus plazos y sigue.
+void Esp32OTA::connectivityStep() {
+  ConnEvent ev;
+  while (_conn.poll(ev)) _conn.apply(ev, millis());
+
+  unsigned long now = millis();
+  switch (_conn.state()) {
+    case CONN_DISCONNECTED:
+      if (_wifiCount > 0 && (long)(now - _wifiRetryAt) >= 0) joinStart();
+      break;
+
+    case CONN_ASSOCIATING:
+      joinStep(now);
+      break;
+
+    case CONN_IP:
+      if (WiFi.status() != WL_CONNECTED) {
+        _conn.apply(CONN_EV_DISCONNECTED, now);
+      } else if ((long)(now - _mqttRetryAt) >= 0) {
+        // PubSubClient conecta en forma síncrona: un solo intento acotado por MQTT_CONNECT_TIMEOUT
+        _conn.apply(CONN_EV_MQTT_STARTED, now);
+        bool ok = connectMQTT();
+        if (ok) {
+          _metrics.count(METRIC_MQTT_CONNECTS);
+          _metrics.observe(METRIC_MQTT_CONNECT_MS, millis() - now);
+        } else {
+          _metrics.count(METRIC_MQTT_FAILED);
+        }
+        _mqttRetryAt = millis() + MQTT_RETRY_DELAY;
+        _conn.apply(ok ? CONN_EV_MQTT_CONNECTED : CONN_EV_MQTT_FAILED, millis());
+      }
+      break;
 
-  for (int i = 0; i < _wifiCount; i++) {
-    Serial.printf("Intentando conectar a %s...\n", _ssids[i]);
-    WiFi.begin(_ssids[i], _passwords[i]);
-    int retries = 0;
-    while (WiFi.status() != WL_CONNECTED && retries < 20) {
-      delay(500);
-      Serial.print(".");
-      retries++;
+    case CONN_MQTT_CONNECTING:
+      break;  // transitorio: se resuelve dentro del mismo paso
+
+    case CONN_ONLINE:
+      if (WiFi.status() != WL_CONNECTED) _conn.apply(CONN_EV_DISCONNECTED, now);
+      else if (!mqttClient.connected()) _conn.apply(CONN_EV_MQTT_LOST, now);
+      break;
+  }
+}
+
+// Lanza un intento de conexión: unión directa a la última red, si hay registro
+void Esp32OTA::joinStart() {
+  _joinStart = millis();
+  _joinCount = 0;
+  _joinNext = 0;
+  _joinIndex = -1;
+  _joinFast = false;
+  _conn.apply(CONN_EV_JOIN_STARTED, _joinStart);
+
+  if (_wifiFast.load()) {
+    const char* password = nullptr;
+    for (int i = 0; i < _wifiCount; i++) {
+      if (strcmp(_ssids[i], _wifiFast.record().ssid) == 0) password = _passwords[i];
     }
-    if (WiFi.status() == WL_CONNECTED) {
-      Serial.printf("\n✅ Conectado a %s, IP: %s\n", _ssids[i], WiFi.localIP().toString().c_str());
+    if (!password) {
+      _wifiFast.forget();  // la red ya no está configurada
+    } else if (_wifiFast.start(password)) {
+      _joinFast = true;
+      _joinPhase = JOIN_FAST;
+      _joinDeadline = _joinStart + WIFI_FAST_JOIN_TIMEOUT;
       return;
     }
-    WiFi.disconnect(true);
   }
-
-  Serial.println("\n❌ No se pudo conectar a ninguna red. Reiniciando...");
-  ESP.restart();
+  joinScan();
 }
 
-void Esp32OTA::connectMQTT() {
-  String clientId = "ESP32_" + deviceMac;
-  String willMessage = "{\"mac\":\"" + deviceMac + "\",\"name\":\"" + _deviceName + "\",\"status\":\"offline\"}";
-
-  // Solo UN intento, no bucle infinito
-  if (!mqttClient.connected()) {
-    Serial.println("🔄 Intento de conexión MQTT...");
-    if (mqttClient.connect(clientId.c_str(), _mqttUser, _mqttPass,
-                           TOPIC_STATUS, 0, false, willMessage.c_str())) {
-      Serial.println("✅ MQTT conectado para OTA.");
-      String onlineMsg = "{\"mac\":\"" + deviceMac + "\",\"name\":\"" + _deviceName +
-                         "\",\"status\":\"ONLINE\",\"version\":\"" + _firmwareVersion + "\"}";
-      mqttClient.publish(TOPIC_STATUS, onlineMsg.c_str(), false);
-      mqttClient.subscribe(TOPIC_UPDATE);
-    } else {
-      Serial.printf("⚠️ Fallo MQTT (estado: %d) - Continuando solo con HTTP\n", mqttClient.state());
-      // NO hacer delay ni reintentar automáticamente
+// Escaneo asíncrono en el modo por ranking; en modo ordenado se pasa directo a la lista
+void Esp32OTA::joinScan() {
+  if (_wifiSelection == WIFI_SELECT_RANKED) {
+    if (WiFi.scanNetworks(true, false, false, WIFI_SCAN_MS_PER_CHAN) == WIFI_SCAN_RUNNING) {
+      _joinPhase = JOIN_SCAN;
+      _joinDeadline = millis() + WIFI_SCAN_TIMEOUT;
+      return;
     }
+    LOGW("⚠️ Falló el escaneo WiFi, se prueban las redes en orden");
   }
+  joinOrdered();
 }
 
-void Esp32OTA::mqttCallback(char* topic, byte* payload, unsigned int length) {
-  String msg;
-  for (unsigned int i = 0; i < length; i++) msg += (char)payload[i];
-  Serial.println("Mensaje en " + String(topic) + ": " + msg);
-
-  int sepIndex = msg.indexOf('|');
-  if (sepIndex < 0) return;
-
-  String targetId = msg.substring(0, sepIndex);
-  String firmwareUrl = msg.substring(sepIndex + 1);
-
-  if ((targetId == deviceMac || targetId == "all") && firmwareUrl.startsWith("http")) {
-    Serial.println("Iniciando OTA con URL: " + firmwareUrl);
-    doOTA(firmwareUrl);
-    if (otaUpdateCallback) otaUpdateCallback(firmwareUrl);
-  }
-}
-
-void Esp32OTA::doOTA(const String &url) {
-  Serial.println("[OTA] Descargando firmware desde: " + url);
-  HTTPClient http;
-  http.begin(url);
-  int httpCode = http.GET();
-  if (httpCode == 200) {
-    int contentLength = http.getSize();
-    WiFiClient *stream = http.getStreamPtr();
-    if (contentLength > 0 && Update.begin(contentLength)) {
-      size_t written = Update.writeStream(*stream);
-      if (written == contentLength && Update.end(true)) {
-        Serial.println("[OTA] ✅ Actualización exitosa. Reiniciando...");
-        ESP.restart();
+// Todas las redes configuradas, en orden y sin BSSID/canal (sirve para SSID ocultos)
+void Esp32OTA::joinOrdered() {
+  _joinCount = 0;
+  for (int i = 0; i < _wifiCount && i < WIFI_MAX_NETWORKS; i++) {
+    WiFiCandidate& c = _joinList[_joinCount++];
+    memset(&c, 0, sizeof(c));
+    c.index = i;
+  }
+  _joinNext = 0;
+  joinNext();
+}
+
+// Un solo escaneo: se cruza con las redes configuradas y quedan solo las visibles,
+// de mejor a peor, con el BSSID/canal del escaneo para unirse sin volver a escanear
+void Esp32OTA::joinRanked(int16_t found) {
+  WiFiRanker ranker;
+  for (int i = 0; i < _wifiCount && i < WIFI_MAX_NETWORKS; i++) {
+    ranker.addNetwork(_ssids[i], _wifiHistory[i]);
+  }
+  for (int16_t j = 0; j < found; j++) {
+    ranker.addScanResult(WiFi.SSID(j).c_str(), WiFi.RSSI(j), WiFi.BSSID(j), WiFi.channel(j));
+  }
+  WiFi.scanDelete();
+
+  _joinCount = ranker.rank(_joinList, WIFI_MAX_NETWORKS);
+  _joinNext = 0;
+  LOGI("📶 Escaneo en %lu ms: %u de %d redes configuradas al alcance",
+       millis() - _joinStart, (unsigned)_joinCount, _wifiCount);
+  joinNext();
+}
+
+// Lanza la próxima candidata; sin candidatas, el intento terminó
+void Esp32OTA::joinNext() {
+  if (_joinNext >= _joinCount) {
+    LOGE("❌ No se pudo conectar a ninguna red. Nuevo intento en %lu s",
+         (unsigned long)(WIFI_RETRY_DELAY / 1000));
+    _joinIndex = -1;
+    _wifiRetryAt = millis() + WIFI_RETRY_DELAY;
+    _conn.apply(CONN_EV_JOIN_FAILED, millis());
+    return;
+  }
+
+  const WiFiCandidate& c = _joinList[_joinNext++];
+  _joinIndex = (int)c.index;
+  _wifiFast.useDhcp();  // la IP de la unión directa es de otra red o ya no vale
+  if (c.channel > 0) {
+    LOGI("Intentando conectar a %s (%ld dBm, canal %ld)...",
+         _ssids[c.index], (long)c.rssi, (long)c.channel);
+    WiFi.begin(_ssids[c.index], _passwords[c.index], c.channel, c.bssid, true);
+  } else {
+    LOGI("Intentando conectar a %s...", _ssids[c.index]);
+    WiFi.begin(_ssids[c.index], _passwords[c.index]);
+  }
+  _joinPhase = JOIN_CANDIDATE;
+  _joinDeadline = millis() + WIFI_JOIN_TIMEOUT;
+}
+
+// Vigila el intento en curso; la llegada de la IP la informa el evento GOT_IP
+void Esp32OTA::joinStep(unsigned long now) {
+  switch (_joinPhase) {
+    case JOIN_FAST:
+      if ((long)(now - _joinDeadline) < 0) return;
+      _wifiFast.failed();
+      _wifiStats.fastFailures++;
+      _joinFast = false;
+      joinScan();
+      break;
+
+    case JOIN_SCAN: {
+      int16_t found = WiFi.scanComplete();
+      if (found == WIFI_SCAN_RUNNING && (long)(now - _joinDeadline) < 0) return;
+      if (found < 0) {
+        LOGW("⚠️ Falló el escaneo WiFi, se prueban las redes en orden");
+        WiFi.scanDelete();
+        joinOrdered();
       } else {
-        Serial.println("[OTA] ❌ Error al escribir firmware.");
+        joinRanked(found);
       }
+      break;
+    }
+
+    case JOIN_CANDIDATE:
+      if ((long)(now - _joinDeadline) < 0) return;
+      WiFiRanker::record(_wifiHistory[_joinIndex], false);
+      WiFi.disconnect();
+      joinNext();
+      break;
+  }
+}
+
+// Registra el tiempo de conexión y guarda el enlace para la próxima unión directa
+void Esp32OTA::wifiConnected(unsigned long startMs, bool fast) {
+  _wifiStats.lastConnectMs = millis() - startMs;
+  _wifiStats.lastWasFast = fast;
+  if (fast) _wifiStats.fastJoins++;
+  else _wifiStats.fullJoins++;
+  _metrics.count(METRIC_WIFI_CONNECTS);
+  _metrics.observe(METRIC_WIFI_CONNECT_MS, _wifiStats.lastConnectMs);
+  _wifiFast.save();
+  LOGI("✅ Conectado a %s en %lu ms%s, IP: %s", WiFi.SSID().c_str(), _wifiStats.lastConnectMs,
+       fast ? " (directo)" : "", WiFi.localIP().toString().c_str());
+}
+
+bool Esp32OTA::connectMQTT() {
+  char clientId[32];
+  snprintf(clientId, sizeof(clientId), "ESP32_%s", deviceMac.c_str());
+  JsonMessage<160> willMessage;
+  willMessage.beginObject()
+             .field("mac", deviceMac.c_str())
+             .field("name", _deviceName)
+             .field("status", "offline")
+             .endObject();
+
+  // Solo UN intento, no bucle infinito (el próximo lo programa connectivityStep())
+  if (mqttClient.connected()) return true;
+  LOGI("🔄 Intento de conexión MQTT...");
+  if (!mqttClient.connect(clientId, _mqttUser, _mqttPass,
+                          TOPIC_STATUS, 0, false, willMessage.c_str())) {
+    LOGW("⚠️ Fallo MQTT (estado: %d) - Continuando solo con HTTP", mqttClient.state());
+    return false;
+  }
+  LOGI("✅ MQTT conectado para OTA.");
+  JsonMessage<192> onlineMsg;
+  onlineMsg.beginObject()
+           .field("mac", deviceMac.c_str())
+           .field("name", _deviceName)
+           .field("status", "ONLINE")
+           .field("version", _firmwareVersion)
+           .endObject();
+  mqttClient.publish(TOPIC_STATUS, onlineMsg.c_str(), false);
+  // Resultado de la actualización que provocó el último reinicio
+  otaReportPending();
+  subscribeUpdates();
+  return true;
+}
+
+// Tópicos de comandos OTA: el propio, los de grupo, el de toda la flota y el compartido
+void Esp32OTA::subscribeUpdates() {
+  char topic[96];
+  snprintf(topic, sizeof(topic), "%s%s", TOPIC_UPDATE_PREFIX, deviceMac.c_str());
+  mqttClient.subscribe(topic);
+  for (size_t i = 0; i < _updateGroupCount; i++) {
+    snprintf(topic, sizeof(topic), "%s%s", TOPIC_UPDATE_GROUP, _updateGroups[i]);
+    mqttClient.subscribe(topic);
+  }
+  mqttClient.subscribe(TOPIC_UPDATE_ALL);
+  if (_legacyUpdateTopic) mqttClient.subscribe(TOPIC_UPDATE);
+}
+
+bool Esp32OTA::addUpdateGroup(const char* group) {
+  if (!group || !*group || _updateGroupCount >= MQTT_MAX_UPDATE_GROUPS) return false;
+  _updateGroups[_updateGroupCount++] = group;
+  return true;
+}
+
+void Esp32OTA::mqttCallback(char* topic, byte* payload, unsigned int length) {
+  // Se interpreta sobre el buffer de PubSubClient; lo dirigido a otra MAC se descarta sin copiar
+  OtaCommand cmd;
+  OtaParseResult result = parseOtaCommand(payload, length, deviceMac.c_str(), cmd);
+  if (result == OTA_PARSE_OTHER_TARGET) return;
+  (void)topic;  // solo lo usa LOGD, que no se compila por debajo de LOG_LVL_DEBUG
+  LOGD("Mensaje en %s: %.*s", topic, (int)length, (const char*)payload);
+  if (result != OTA_PARSE_OK) return;
+
+  // Manifiesto: si la imagen anunciada ya es la que corre no hay nada que descargar
+  OtaManifest manifest;
+  manifest.size = 0;
+  manifest.signatureLen = cmd.signatureLen;
+  memcpy(manifest.signature, cmd.signature, cmd.signatureLen);
+  if (_otaVerify.hasPublicKey() && cmd.signatureLen == 0) {
+    LOGE("[OTA] ❌ Comando sin firma y hay clave configurada, se ignora");
+    otaReport("failed", nullptr, "imagen sin firma");
+    return;
+  }
+  if (cmd.kind == OTA_CMD_MANIFEST) {
+    manifest.version.concat(cmd.version.data, cmd.version.len);
+    manifest.size = cmd.imageSize;
+    memcpy(manifest.sha256, cmd.sha256, sizeof(manifest.sha256));
+    if (otaIsRunningImage(manifest)) {
+      LOGI("[OTA] Ya corre la versión %s con el mismo hash, no se descarga",
+           manifest.version.c_str());
+      otaReport("skipped", manifest.version.c_str(), "misma imagen");
+      return;
+    }
+  }
+
+  // Comandos para toda la flota: cohorte por MAC y espera al azar dentro de la ventana
+  uint32_t delayMs = 0;
+  if (cmd.target.equals("all") && (cmd.percent < 100 || cmd.windowSec > 0)) {
+    RolloutPlan plan = planRollout(_macBytes, cmd.percent, cmd.windowSec, esp_random());
+    if (!plan.apply) {
+      LOGI("[OTA] Cohorte %u fuera del %u%% del despliegue, se omite",
+           (unsigned)plan.cohort, (unsigned)cmd.percent);
+      return;
+    }
+    delayMs = plan.delayMs;
+    LOGI("[OTA] Cohorte %u dentro del %u%%, inicio en %lu s",
+         (unsigned)plan.cohort, (unsigned)cmd.percent, (unsigned long)(delayMs / 1000));
+  }
+
+  // Única copia: la URL (y la versión base), que la OTA guarda hasta terminar
+  String url;
+  url.concat(cmd.url.data, cmd.url.len);
+  String baseVersion;
+  baseVersion.concat(cmd.baseVersion.data, cmd.baseVersion.len);
+
+  if (delayMs > 0) {
+    // Un comando nuevo reemplaza al que esperaba
+    _otaScheduled = true;
+    _otaScheduledKind = cmd.kind;
+    _netJobs.start(_otaScheduledJob, millis(), delayMs);
+    _otaScheduledUrl = url;
+    _otaScheduledBase = baseVersion;
+    _otaScheduledManifest = manifest;
+    return;
+  }
+  _otaScheduled = false;
+  _netJobs.stop(_otaScheduledJob);
+  otaDispatch(cmd.kind, baseVersion, url, manifest);
+}
+
+// Solo se encola: la descarga avanza por bloques desde loop()
+void Esp32OTA::otaDispatch(OtaCommandKind kind, const String &baseVersion, const String &url,
+                           const OtaManifest &manifest) {
+  bool queued;
+  if (kind == OTA_CMD_DELTA) queued = requestDeltaOTA(baseVersion, url);
+  else if (kind == OTA_CMD_MANIFEST) queued = requestManifestOTA(manifest, url);
+  else queued = requestOTA(url);
+  if (!queued) return;
+  // La firma viaja en el comando; se comprueba al terminar la descarga
+  memcpy(_otaSignature, manifest.signature, manifest.signatureLen);
+  _otaSignatureLen = manifest.signatureLen;
+  if (otaUpdateCallback) otaUpdateCallback(url);
+}
+
+bool Esp32OTA::requestOTA(const String &url) {
+  if (isOTAInProgress()) {
+    LOGW("[OTA] ⚠️ Ya hay una actualización en curso, se ignora: %s", url.c_str());
+    return false;
+  }
+  LOGI("[OTA] Actualización encolada: %s", url.c_str());
+  _otaUrl = url;
+  _otaIsDelta = false;
+  _otaHasManifest = false;
+  _otaSignatureLen = 0;
+  _otaRetries = 0;
+  _otaRetryAt = 0;
+  _otaState = OTA_PENDING;
+  return true;
+}
+
+bool Esp32OTA::requestDeltaOTA(const String &baseVersion, const String &patchUrl) {
+  if (baseVersion != _firmwareVersion) {
+    LOGW("[OTA] ⚠️ Parche para %s ignorado: este firmware es %s",
+         baseVersion.c_str(), _firmwareVersion);
+    return false;
+  }
+  if (!requestOTA(patchUrl)) return false;
+  _otaIsDelta = true;
+  LOGI("[OTA] Modo delta sobre la versión %s", baseVersion.c_str());
+  return true;
+}
+
+bool Esp32OTA::requestManifestOTA(const OtaManifest &manifest, const String &url) {
+  if (otaIsRunningImage(manifest)) {
+    otaReport("skipped", manifest.version.c_str(), "misma imagen");
+    return false;
+  }
+  // Se descarta antes de bajar nada si la imagen no entra en la partición de destino
+  const esp_partition_t* target = esp_ota_get_next_update_partition(nullptr);
+  if (!target || manifest.size > target->size) {
+    LOGE("[OTA] ❌ La imagen %s (%u bytes) no entra en la partición OTA",
+         manifest.version.c_str(), (unsigned)manifest.size);
+    otaReport("failed", manifest.version.c_str(), "imagen demasiado grande");
+    return false;
+  }
+  if (!requestOTA(url)) return false;
+  _otaHasManifest = true;
+  _otaManifest = manifest;
+  LOGI("[OTA] Manifiesto: %s -> %s (%u bytes)",
+       _firmwareVersion, manifest.version.c_str(), (unsigned)manifest.size);
+  return true;
+}
+
+// La imagen en ejecución es la del manifiesto si coinciden la versión y el hash de la
+// partición. Si el hash no se puede leer decide solo la versión.
+bool Esp32OTA::otaIsRunningImage(const OtaManifest &manifest) {
+  if (manifest.version != _firmwareVersion) return false;
+  if (_runningShaState == 0) {
+    // Recorre la imagen completa en flash: se hace una sola vez por arranque
+    _runningShaState = esp_partition_get_sha256(esp_ota_get_running_partition(), _runningSha) == ESP_OK ? 1 : -1;
+    if (_runningShaState < 0) LOGW("[OTA] ⚠️ No se pudo calcular el hash de la imagen en ejecución");
+  }
+  return _runningShaState < 0 || memcmp(_runningSha, manifest.sha256, sizeof(_runningSha)) == 0;
+}
+
+// Resultado de una actualización en TOPIC_STATUS: "skipped", "updated" o "failed"
+void Esp32OTA::otaReport(const char* result, const char* version, const char* reason) {
+  JsonMessage<256> msg;
+  msg.beginObject()
+     .field("mac", deviceMac.c_str())
+     .field("status", "ota")
+     .field("result", result)
+     .field("version", _firmwareVersion);
+  if (version && *version) msg.field("target", version);
+  if (reason) msg.field("reason", reason);
+  msg.endObject();
+  publish(TOPIC_STATUS, (const uint8_t*)msg.c_str(), msg.length());
+}
+
+// Antes de reiniciar con la imagen nueva: tras el arranque se sabrá si quedó en uso
+void Esp32OTA::otaSavePendingReport(const esp_partition_t* target) {
+  Preferences prefs;
+  if (!target || !prefs.begin(OTA_REPORT_NAMESPACE, false)) return;
+  prefs.putString("part", target->label);
+  prefs.putString("target", _otaHasManifest ? _otaManifest.version : String());
+  prefs.end();
+}
+
+// Si el arranque vino de una actualización, informa si corre la partición escrita
+// ("updated") o si el bootloader volvió a la anterior ("failed")
+void Esp32OTA::otaReportPending() {
+  Preferences prefs;
+  if (!prefs.begin(OTA_REPORT_NAMESPACE, false)) return;
+  String part = prefs.getString("part", "");
+  String target = prefs.getString("target", "");
+  prefs.clear();
+  prefs.end();
+  if (part.length() == 0) return;
+  if (part == esp_ota_get_running_partition()->label) {
+    otaReport("updated", target.c_str());
+  } else {
+    otaReport("failed", target.c_str(), "la imagen nueva no arrancó");
+  }
+}
+
+void Esp32OTA::setOTABudget(unsigned long maxMillis, size_t maxBytes) {
+  _otaBudgetMs = maxMillis;
+  _otaBudgetBytes = maxBytes;
+}
+
+void Esp32OTA::setOTAPipeline(size_t bufferSize, uint8_t depth) {
+  _otaPipeBufSize = max(bufferSize, (size_t)256);
+  _otaPipeDepth = constrain(depth, 1, OTA_PIPELINE_MAX_DEPTH);
+}
+
+OTAStatus Esp32OTA::getOTAStatus() const {
+  OTAStatus st;
+  st.state = _otaState;
+  st.encoding = _otaInflate.encoding();
+  st.delta = _otaIsDelta;
+  st.received = _otaReceived;
+  st.total = _otaTotal;
+  st.written = _otaWritten;
+  st.resumedFrom = _otaResumeFrom;
+  st.retries = _otaRetries;
+  st.elapsedMs = (_otaState == OTA_DOWNLOADING) ? millis() - _otaStartMs : _otaLastDataMs - _otaStartMs;
+  st.throughput = st.elapsedMs > 0 ? ((_otaReceived - _otaResumeFrom) * 1000.0f) / st.elapsedMs : 0.0f;
+  st.flashThroughput = _otaFlashMicros > 0 ? ((_otaWritten - _otaResumeFrom) * 1000000.0f) / _otaFlashMicros : 0.0f;
+  st.pipelineStalls = _otaPipeStalls;
+  size_t verified = _otaWritten - _otaResumeFrom;
+  st.verifyMsPerMB = verified > 0 ? (_otaVerifyMicros / 1000.0f) * (1048576.0f / verified) : 0.0f;
+  return st;
+}
+
+// ---------------------------------------------------------------------------
+// Progreso persistido en NVS para reanudar descargas planas con HTTP Range
+// ---------------------------------------------------------------------------
+void Esp32OTA::otaSaveProgress(size_t committed) {
+  Preferences prefs;
+  if (!prefs.begin(OTA_PREFS_NAMESPACE, false)) return;
+  if (committed == 0) {
+    prefs.putString("url", _otaUrl);
+    prefs.putUInt("size", _otaTotal);
+    prefs.putString("etag", _otaEtag);
+    // Lo esperado de la imagen: sin esto, la descarga retomada tras un reinicio no se verifica
+    if (_otaHasManifest) {
+      prefs.putString("ver", _otaManifest.version);
+      prefs.putUInt("msize", _otaManifest.size);
+      prefs.putBytes("sha", _otaManifest.sha256, sizeof(_otaManifest.sha256));
     } else {
-      Serial.println("[OTA] ❌ Tamaño inválido.");
+      prefs.remove("ver");
+      prefs.remove("msize");
+      prefs.remove("sha");
+    }
+    if (_otaSignatureLen > 0) prefs.putBytes("sig", _otaSignature, _otaSignatureLen);
+    else prefs.remove("sig");
+  }
+  prefs.putUInt("done", committed);
+  prefs.end();
+}
+
+bool Esp32OTA::otaLoadProgress(String &url, size_t &size, String &etag, size_t &committed) {
+  Preferences prefs;
+  if (!prefs.begin(OTA_PREFS_NAMESPACE, true)) return false;
+  url = prefs.getString("url", "");
+  size = prefs.getUInt("size", 0);
+  etag = prefs.getString("etag", "");
+  committed = prefs.getUInt("done", 0);
+  prefs.end();
+  return url.length() > 0 && size > 0 && committed > 0 && committed < size;
+}
+
+void Esp32OTA::otaClearProgress() {
+  Preferences prefs;
+  if (!prefs.begin(OTA_PREFS_NAMESPACE, false)) return;
+  prefs.clear();
+  prefs.end();
+}
+
+void Esp32OTA::otaResumePending() {
+  String url, etag;
+  size_t size, committed;
+  if (!otaLoadProgress(url, size, etag, committed)) return;
+  LOGI("[OTA] Descarga pendiente (%u/%u bytes), se reanudará: %s",
+       (unsigned)committed, (unsigned)size, url.c_str());
+  if (!requestOTA(url)) return;
+  otaRestoreExpected();
+}
+
+// Manifiesto y firma del comando original, guardados con el progreso por otaSaveProgress(0)
+void Esp32OTA::otaRestoreExpected() {
+  Preferences prefs;
+  if (!prefs.begin(OTA_PREFS_NAMESPACE, true)) return;
+  if (prefs.getBytesLength("sha") == sizeof(_otaManifest.sha256)) {
+    _otaManifest.version = prefs.getString("ver", "");
+    _otaManifest.size = prefs.getUInt("msize", 0);
+    prefs.getBytes("sha", _otaManifest.sha256, sizeof(_otaManifest.sha256));
+    _otaManifest.signatureLen = 0;
+    _otaHasManifest = true;
+  }
+  size_t sigLen = prefs.getBytesLength("sig");
+  if (sigLen > 0 && sigLen <= sizeof(_otaSignature)) {
+    _otaSignatureLen = prefs.getBytes("sig", _otaSignature, sizeof(_otaSignature));
+  }
+  prefs.end();
+}
+
+// ---------------------------------------------------------------------------
+// Pipeline de buffers: loop() llena bloques desde la red y la tarea
+// otaPipelineTask los descomprime/aplica y escribe en flash en paralelo.
+// ---------------------------------------------------------------------------
+bool Esp32OTA::otaPipelineStart() {
+  _otaPipeError = nullptr;
+  _otaPipeStalls = 0;
+  _otaFlashMicros = 0;
+  _otaPipeMem = (uint8_t*)malloc(_otaPipeBufSize * _otaPipeDepth);
+  if (!_otaPipeMem) return false;
+  for (uint8_t i = 0; i < _otaPipeDepth; i++) {
+    _otaBlocks[i].data = _otaPipeMem + i * _otaPipeBufSize;
+    _otaBlocks[i].len = 0;
+  }
+  if (_otaPipeDepth == 1) return true;
+
+  _otaFreeQ = xQueueCreate(_otaPipeDepth, sizeof(OtaBlock*));
+  _otaFullQ = xQueueCreate(_otaPipeDepth + 1, sizeof(OtaBlock*));  // +1 para el fin
+  _otaPipeDone = xSemaphoreCreateBinary();
+  if (!_otaFreeQ || !_otaFullQ || !_otaPipeDone) {
+    otaPipelineStop();
+    return false;
+  }
+  for (uint8_t i = 0; i < _otaPipeDepth; i++) {
+    OtaBlock* blk = &_otaBlocks[i];
+    xQueueSend(_otaFreeQ, &blk, 0);
+  }
+  _otaPipeTask = xTaskCreatePinnedToCore(otaPipelineTask, "ota_flash", OTA_PIPELINE_STACK, this,
+                                         OTA_PIPELINE_PRIORITY, nullptr, OTA_PIPELINE_CORE) == pdPASS;
+  if (!_otaPipeTask) {
+    otaPipelineStop();
+    return false;
+  }
+  return true;
+}
+
+void Esp32OTA::otaPipelineStop() {
+  if (_otaPipeTask) {
+    // La tarea termina los bloques encolados y sale al recibir el marcador nulo
+    OtaBlock* stop = nullptr;
+    xQueueSend(_otaFullQ, &stop, portMAX_DELAY);
+    xSemaphoreTake(_otaPipeDone, portMAX_DELAY);
+    _otaPipeTask = false;
+  }
+  if (_otaFreeQ) vQueueDelete(_otaFreeQ);
+  if (_otaFullQ) vQueueDelete(_otaFullQ);
+  if (_otaPipeDone) vSemaphoreDelete(_otaPipeDone);
+  _otaFreeQ = nullptr;
+  _otaFullQ = nullptr;
+  _otaPipeDone = nullptr;
+  free(_otaPipeMem);
+  _otaPipeMem = nullptr;
+}
+
+bool Esp32OTA::otaPipelineIdle() {
+  return !_otaPipeTask || uxQueueMessagesWaiting(_otaFreeQ) == _otaPipeDepth;
+}
+
+Esp32OTA::OtaBlock* Esp32OTA::otaAcquireBlock() {
+  if (!_otaPipeTask) return &_otaBlocks[0];
+  OtaBlock* blk = nullptr;
+  if (xQueueReceive(_otaFreeQ, &blk, 0) != pdTRUE) return nullptr;
+  return blk;
+}
+
+void Esp32OTA::otaReleaseBlock(OtaBlock* blk) {
+  if (_otaPipeTask) xQueueSend(_otaFreeQ, &blk, 0);
+}
+
+bool Esp32OTA::otaSubmitBlock(OtaBlock* blk) {
+  if (_otaPipeTask) return xQueueSend(_otaFullQ, &blk, 0) == pdTRUE;
+  return otaProcessBlock(blk);
+}
+
+bool Esp32OTA::otaProcessBlock(OtaBlock* blk) {
+  unsigned long t0 = micros();
+  bool ok = _otaInflate.write(blk->data, blk->len);
+  _otaFlashMicros += micros() - t0;
+  if (!ok) _otaPipeError = otaStageError();
+  return ok;
+}
+
+const char* Esp32OTA::otaStageError() {
+  if (_otaFlash.error()) return _otaFlash.error();
+  if (_otaIsDelta && _otaDelta.error()) return _otaDelta.error();
+  return _otaInflate.error();
+}
+
+void Esp32OTA::otaPipelineTask(void* arg) {
+  Esp32OTA* self = static_cast<Esp32OTA*>(arg);
+  OtaBlock* blk = nullptr;
+  while (xQueueReceive(self->_otaFullQ, &blk, portMAX_DELAY) == pdTRUE && blk != nullptr) {
+    // Tras un error se siguen devolviendo los bloques sin procesarlos
+    if (!self->_otaPipeError) self->otaProcessBlock(blk);
+    xQueueSend(self->_otaFreeQ, &blk, portMAX_DELAY);
+  }
+  xSemaphoreGive(self->_otaPipeDone);
+  vTaskDelete(nullptr);
+}
+
+void Esp32OTA::otaStart() {
+  if (WiFi.status() != WL_CONNECTED) return;  // se reintenta en el próximo loop()
+  if (_otaRetryAt != 0 && (long)(millis() - _otaRetryAt) < 0) return;  // backoff entre reintentos
+
+  _otaReceived = 0;
+  _otaWritten = 0;
+  _otaTotal = 0;
+  _otaResumeFrom = 0;
+  _otaResumable = false;
+  _otaEtag = "";
+  _otaStartMs = millis();
+  _otaLastDataMs = _otaStartMs;
+
+  // Solo las imágenes planas se reanudan: gzip/heatshrink/delta necesitan el estado del decodificador
+  String savedUrl, savedEtag;
+  size_t savedSize = 0, savedDone = 0;
+  bool canResume = !_otaIsDelta && otaLoadProgress(savedUrl, savedSize, savedEtag, savedDone) &&
+                   savedUrl == _otaUrl;
+
+  // Content-Encoding permite servir imágenes comprimidas sin cambiar la URL
+  const char* headerKeys[] = {"Content-Encoding", "Content-Range", "ETag"};
+  _otaHttp.begin(_otaUrl);
+  _otaHttp.collectHeaders(headerKeys, 3);
+  if (canResume) {
+    LOGI("[OTA] Reanudando desde el byte %u: %s", (unsigned)savedDone, _otaUrl.c_str());
+    _otaHttp.addHeader("Range", "bytes=" + String((unsigned long)savedDone) + "-");
+    // Si el archivo cambió en el servidor, If-Range hace que responda 200 con la imagen completa
+    if (savedEtag.length() > 0) _otaHttp.addHeader("If-Range", savedEtag);
+  } else {
+    LOGI("[OTA] Descargando firmware desde: %s", _otaUrl.c_str());
+  }
+
+  int httpCode = _otaHttp.GET();
+  if (httpCode == 206 && canResume) {
+    // Content-Range: bytes <inicio>-<fin>/<total>
+    String range = _otaHttp.header("Content-Range");
+    int slash = range.indexOf('/');
+    size_t rangeStart = range.startsWith("bytes ") ? range.substring(6).toInt() : 0;
+    size_t rangeTotal = slash > 0 ? range.substring(slash + 1).toInt() : 0;
+    if (rangeStart != savedDone || rangeTotal != savedSize) {
+      otaClearProgress();
+      otaRetry("Content-Range no coincide con el progreso guardado");
+      return;
+    }
+    if (!_otaFlash.begin(savedSize, savedDone)) {
+      otaFail(_otaFlash.error());
+      return;
+    }
+    if (!otaVerifyResume(savedDone)) {
+      otaFail("no se pudo releer lo ya escrito para el hash");
+      return;
     }
+    _otaInflate.begin(OTA_ENC_NONE, otaWriteFlashThunk, this);
+    _otaReceived = _otaWritten = _otaResumeFrom = savedDone;
+    _otaTotal = savedSize;
+    _otaEtag = savedEtag;
+    _otaResumable = true;
+  } else if (httpCode == 200) {
+    // Descarga completa: el servidor ignoró el Range o la imagen cambió
+    if (canResume) LOGI("[OTA] El servidor no aceptó el rango, descarga completa.");
+    int contentLength = _otaHttp.getSize();
+    if (contentLength <= 0) {
+      otaFail("tamaño inválido");
+      return;
+    }
+    _otaTotal = contentLength;
+    _otaEtag = _otaHttp.header("ETag");
   } else {
-    Serial.printf("[OTA] HTTP error: %d\n", httpCode);
+    LOGE("[OTA] HTTP error: %d", httpCode);
+    if (httpCode == 416) otaClearProgress();
+    // Errores de red y del servidor son transitorios; los 4xx no
+    if (httpCode < 0 || httpCode >= 500 || httpCode == 416) otaRetry("respuesta HTTP inválida");
+    else otaFail("respuesta HTTP inválida");
+    return;
   }
-  http.end();
+
+  if (!otaPipelineStart()) {
+    otaFail("sin memoria para los buffers de la OTA");
+    return;
+  }
+
+  // En descargas nuevas el flash se inicia con el primer bloque, al conocer el formato
+  _otaContentEncoding = _otaHttp.header("Content-Encoding");
+  _otaStream = _otaHttp.getStreamPtr();
+  _otaState = OTA_DOWNLOADING;
+}
+
+void Esp32OTA::otaStep() {
+  // Error reportado por la tarea de escritura
+  if (_otaPipeError) {
+    otaFail(_otaPipeError);
+    return;
+  }
+
+  unsigned long stepStart = millis();
+  size_t moved = 0;
+  size_t writtenAtStart = _otaWritten;
+  // Sin tarea, en delta pocos bytes de red pueden generar mucha escritura: se acota con bloques chicos
+  size_t chunk = (_otaIsDelta && !_otaPipeTask) ? OTA_DELTA_READ_CHUNK : _otaPipeBufSize;
+
+  // Mover bloques hasta agotar el presupuesto o los datos disponibles, sin esperar.
+  // Sin tarea, la escritura en flash también cuenta para el presupuesto.
+  while (max(moved, _otaPipeTask ? 0 : _otaWritten - writtenAtStart) < _otaBudgetBytes &&
+         millis() - stepStart < _otaBudgetMs && _otaReceived < _otaTotal) {
+    size_t avail = _otaStream->available();
+    if (avail == 0) {
+      if (!_otaStream->connected()) {
+        otaRetry("conexión cerrada");
+        return;
+      }
+      break;
+    }
+
+    OtaBlock* blk = otaAcquireBlock();
+    if (!blk) {
+      // Todos los buffers esperan a la flash: la red espera al próximo loop()
+      _otaPipeStalls++;
+      break;
+    }
+
+    size_t toRead = min(avail, chunk);
+    toRead = min(toRead, _otaTotal - _otaReceived);
+    toRead = min(toRead, _otaBudgetBytes - moved);
+    int n = _otaStream->read(blk->data, toRead);
+    if (n <= 0) {
+      otaReleaseBlock(blk);
+      break;
+    }
+    blk->len = n;
+
+    // El primer bloque decide el formato (plano, gzip o heatshrink)
+    if (_otaReceived == 0) {
+      OTAEncoding enc = OtaInflate::detect(_otaContentEncoding, blk->data[0]);
+      LOGI("[OTA] Formato de imagen: %s", OtaInflate::encodingName(enc));
+      if (!_otaInflate.begin(enc, _otaIsDelta ? otaDeltaThunk : otaWriteFlashThunk, this)) {
+        otaReleaseBlock(blk);
+        otaFail(_otaInflate.error());
+        return;
+      }
+      if (_otaIsDelta) {
+        _otaDelta.begin(_firmwareVersion, esp_ota_get_running_partition()->size,
+                        otaReadBaseThunk, otaWriteFlashThunk, this);
+      }
+      // Una descarga plana nueva deja registro en NVS para poder reanudarse
+      _otaResumable = (enc == OTA_ENC_NONE && !_otaIsDelta);
+      if (_otaResumable) otaSaveProgress(0);
+      else otaClearProgress();
+    }
+
+    if (!otaSubmitBlock(blk) || _otaPipeError) {
+      otaFail(_otaPipeError ? _otaPipeError : "no se pudo encolar el bloque");
+      return;
+    }
+    _otaReceived += n;
+    moved += n;
+    _metrics.count(METRIC_OTA_BYTES, n);
+    _otaLastDataMs = millis();
+  }
+
+  if (_otaReceived >= _otaTotal) {
+    // Esperar (sin bloquear) a que la tarea escriba los bloques pendientes
+    if (otaPipelineIdle()) otaFinish();
+  } else if (millis() - _otaLastDataMs > OTA_STALL_TIMEOUT) {
+    otaRetry("timeout sin datos");
+  }
+}
+
+bool Esp32OTA::otaWriteFlashThunk(void* ctx, const uint8_t* data, size_t len) {
+  return static_cast<Esp32OTA*>(ctx)->otaWriteFlash(data, len);
+}
+
+bool Esp32OTA::otaDeltaThunk(void* ctx, const uint8_t* data, size_t len) {
+  return static_cast<Esp32OTA*>(ctx)->_otaDelta.write(data, len);
+}
+
+bool Esp32OTA::otaReadBaseThunk(void* ctx, uint32_t offset, uint8_t* buf, size_t len) {
+  (void)ctx;
+  return esp_partition_read(esp_ota_get_running_partition(), offset, buf, len) == ESP_OK;
+}
+
+bool Esp32OTA::otaWriteFlash(const uint8_t* data, size_t len) {
+  if (!_otaFlash.isRunning()) {
+    // Plano: el tamaño es el de la descarga. Heatshrink y delta lo traen en su cabecera; gzip no se conoce.
+    size_t imageSize = OTA_IMAGE_SIZE_UNKNOWN;
+    if (_otaIsDelta) imageSize = _otaDelta.expectedSize();
+    else if (_otaInflate.encoding() == OTA_ENC_NONE) imageSize = _otaTotal;
+    else if (_otaInflate.expectedSize() > 0) imageSize = _otaInflate.expectedSize();
+    else if (_otaHasManifest) imageSize = _otaManifest.size;
+    if (!_otaFlash.begin(imageSize)) {
+      LOGE("[OTA] ❌ No se pudo iniciar la escritura: %s", _otaFlash.error());
+      return false;
+    }
+    _otaVerify.begin(_otaHasManifest ? _otaManifest.sha256 : nullptr, _otaSignature, _otaSignatureLen);
+  }
+  if (!_otaFlash.write(data, len)) return false;
+  // Mismos bytes que van a flash: no hace falta releer la partición para verificarla
+  unsigned long t0 = micros();
+  _otaVerify.update(data, len);
+  _otaVerifyMicros += micros() - t0;
+
+  // Checkpoint cada OTA_RESUME_CHECKPOINT bytes, alineado a sector
+  size_t before = _otaWritten;
+  _otaWritten += len;
+  if (_otaResumable && _otaWritten / OTA_RESUME_CHECKPOINT != before / OTA_RESUME_CHECKPOINT) {
+    otaSaveProgress(_otaWritten / OTA_RESUME_CHECKPOINT * OTA_RESUME_CHECKPOINT);
+  }
+  return true;
+}
+
+// Al reanudar, el estado del hash no sobrevive al corte: se rehace con lo que ya está en flash
+bool Esp32OTA::otaVerifyResume(size_t committed) {
+  _otaVerify.begin(_otaHasManifest ? _otaManifest.sha256 : nullptr, _otaSignature, _otaSignatureLen);
+  uint8_t buf[512];
+  for (size_t off = 0; off < committed; off += sizeof(buf)) {
+    size_t n = min(sizeof(buf), committed - off);
+    if (esp_partition_read(_otaFlash.partition(), off, buf, n) != ESP_OK) return false;
+    _otaVerify.update(buf, n);
+  }
+  return true;
+}
+
+void Esp32OTA::otaFinish() {
+  otaPipelineStop();
+  if (_otaPipeError) {
+    otaFail(_otaPipeError);
+    return;
+  }
+  _otaHttp.end();
+  _otaStream = nullptr;
+  bool streamOk = _otaInflate.finish();
+  _otaInflate.end();
+  if (!streamOk) {
+    otaFail(_otaInflate.error());
+    return;
+  }
+  if (_otaIsDelta && !_otaDelta.finish()) {
+    otaFail(_otaDelta.error());
+    return;
+  }
+  if (_otaHasManifest && _otaWritten != _otaManifest.size) {
+    otaFail("el tamaño no coincide con el manifiesto");
+    return;
+  }
+  // Imagen truncada, alterada o sin firma válida: no se marca como partición de arranque
+  if (!_otaVerify.finish()) {
+    otaFail(_otaVerify.error());
+    return;
+  }
+  // end() suelta la partición: se toma antes para el informe posterior al reinicio
+  const esp_partition_t* target = _otaFlash.partition();
+  if (!_otaFlash.end()) {
+    otaFail(_otaFlash.error());
+    return;
+  }
+  otaClearProgress();
+  otaSavePendingReport(target);
+  _otaState = OTA_SUCCESS;
+  OTAStatus st = getOTAStatus();
+  LOGI("[OTA] ✅ Actualización exitosa (%u bytes recibidos, %u escritos, red %.0f B/s, flash %.0f B/s, %u esperas, hash %.1f ms/MB). Reiniciando...",
+       (unsigned)st.received, (unsigned)st.written, st.throughput, st.flashThroughput,
+       (unsigned)st.pipelineStalls, st.verifyMsPerMB);
+  // Última instantánea antes del reinicio, con el rendimiento de esta OTA (mejor esfuerzo)
+  otaRecordMetrics();
+  publishMetrics();
+  logRing.flush(Serial);
+  ESP.restart();
+}
+
+void Esp32OTA::otaRetry(const char* reason) {
+  otaPipelineStop();
+  _otaHttp.end();
+  _otaInflate.end();
+  _otaFlash.abort();
+  _otaStream = nullptr;
+  if (_otaRetries >= OTA_MAX_RETRIES) {
+    // Se conserva el progreso: un próximo comando (o reinicio) con la misma URL reanuda
+    otaFail(reason, true);
+    return;
+  }
+  _otaRetries++;
+  _otaRetryAt = millis() + OTA_RETRY_DELAY * _otaRetries;
+  _otaState = OTA_PENDING;
+  LOGW("[OTA] ⚠️ %s tras %u/%u bytes; reintento %u/%u en %lu ms",
+       reason, (unsigned)_otaReceived, (unsigned)_otaTotal,
+       (unsigned)_otaRetries, (unsigned)OTA_MAX_RETRIES,
+       (unsigned long)OTA_RETRY_DELAY * _otaRetries);
+}
+
+// Rendimiento de la última OTA (terminada o fallida) para la próxima instantánea
+void Esp32OTA::otaRecordMetrics() {
+  OTAStatus st = getOTAStatus();
+  _metrics.set(METRIC_OTA_BPS, (int32_t)st.throughput);
+  _metrics.set(METRIC_OTA_FLASH_BPS, (int32_t)st.flashThroughput);
+}
+
+void Esp32OTA::otaFail(const char* reason, bool keepProgress) {
+  otaPipelineStop();
+  _otaFlash.abort();
+  _otaHttp.end();
+  _otaInflate.end();
+  _otaStream = nullptr;
+  _otaState = OTA_FAILED;
+  if (!keepProgress) otaClearProgress();
+  otaRecordMetrics();
+  LOGE("[OTA] ❌ Falló la actualización (%s) tras %u/%u bytes",
+       reason ? reason : "desconocido", (unsigned)_otaReceived, (unsigned)_otaTotal);
+  otaReport("failed", _otaHasManifest ? _otaManifest.version.c_str() : nullptr,
+            reason ? reason : "desconocido");
 }
 
 void Esp32OTA::sendSensorData(float temperature, float humidity) {
-  String sensorMsg = "{\"mac\":\"" + deviceMac + "\",\"name\":\"" + _deviceName +
-                     "\",\"temperature\":" + String(temperature, 1) +
-                     ",\"humidity\":" + String(humidity, 1) + "}";
-  mqttClient.publish(TOPIC_SENSOR, sensorMsg.c_str(), false);
-  Serial.println("Sensor data enviado: " + sensorMsg);
+  if (_encoding == TELEMETRY_CBOR) {
+    // Sin nombre ni claves de texto: la MAC va en binario y el servidor ya conoce el dispositivo
+    CborMessage<32> frame;
+    frame.map(3).uint(CBOR_KEY_MAC).bytes(_macBytes, sizeof(_macBytes));
+    frame.uint(CBOR_KEY_TEMPERATURE);
+    if (isnan(temperature)) frame.null(); else frame.float32(temperature);
+    frame.uint(CBOR_KEY_HUMIDITY);
+    if (isnan(humidity)) frame.null(); else frame.float32(humidity);
+    publish(TOPIC_SENSOR_CBOR, frame.data(), frame.length());
+    LOGD("Sensor data enviado (CBOR, %u bytes)", (unsigned)frame.length());
+    return;
+  }
+
+  JsonMessage<192> sensorMsg;
+  sensorMsg.beginObject()
+           .field("mac", deviceMac.c_str())
+           .field("name", _deviceName)
+           .field("temperature", temperature, 1)
+           .field("humidity", humidity, 1)
+           .endObject();
+  publish(TOPIC_SENSOR, (const uint8_t*)sensorMsg.c_str(), sensorMsg.length());
+  LOGD("Sensor data enviado: %s", sensorMsg.c_str());
+}
+
+void Esp32OTA::record(const char* type, float value, const char* unit) {
+  if (isnan(value)) return;  // lectura fallida: no se guarda
+  if (!_samples.push(type, value, unit, millis())) {
+    LOGW("⚠️ Buffer de muestras lleno: se descartó la más vieja (%u perdidas)",
+         (unsigned)_samples.dropped());
+  }
 }
 
+void Esp32OTA::setTelemetryBatch(size_t maxSamples, unsigned long maxAgeMs) {
+  _batchSamples = constrain(maxSamples, (size_t)1, SampleRing::capacity());
+  _batchMaxAge = maxAgeMs;
+}
+
+bool Esp32OTA::flushTelemetry() {
+  while (!_samples.empty()) {
+    if (!publishBatch()) return false;
+  }
+  return true;
+}
+
+// Disparadores automáticos del lote: cantidad de muestras o antigüedad de la más vieja.
+// Devuelve los ms hasta que vence la antigüedad del lote.
+unsigned long Esp32OTA::telemetryStep() {
+  if (_samples.empty() || !mqttReady()) return LOOP_MAX_WAIT;
+  unsigned long age = millis() - _samples.at(0).at;
+  if (_samples.size() >= _batchSamples || age >= _batchMaxAge) {
+    // Lo que no entró en el mensaje (o no se pudo publicar) sale en la próxima vuelta
+    return publishBatch() && _samples.empty() ? LOOP_MAX_WAIT : LOOP_RETRY_MS;
+  }
+  return _batchMaxAge - age;
+}
+
+// Cota de una entrada sin contar type/unit: claves, comillas, número y separadores
+#define TELEMETRY_ENTRY_OVERHEAD 72
+
+// Publica en un solo mensaje todas las muestras más viejas que entren en el buffer.
+// Solo se liberan del buffer después de publicarlas.
+bool Esp32OTA::publishBatch() {
+  if (_samples.empty() || !mqttReady()) return false;
+
+  uint32_t now = millis();
+  JsonWriter msg(_batchBuf, sizeof(_batchBuf));
+  msg.beginObject()
+     .field("mac", deviceMac.c_str())
+     .beginArray("measurements");
+
+  size_t count = 0;
+  while (count < _samples.size()) {
+    const Sample& s = _samples.at(count);
+    size_t need = strlen(s.type) + (s.unit ? strlen(s.unit) : 0) + TELEMETRY_ENTRY_OVERHEAD;
+    if (count > 0 && msg.length() + need + 2 >= sizeof(_batchBuf)) break;  // 2 = "]}"
+    msg.beginObject()
+       .field("type", s.type)
+       .field("value", s.value, TELEMETRY_DECIMALS);
+    if (s.unit) msg.field("unit", s.unit);
+    msg.field("age", (unsigned long)(now - s.at)).endObject();
+    count++;
+  }
+  msg.endArray().endObject();
+
+  if (!msg.ok()) {
+    // Una sola muestra no entra en el buffer: se descarta para no trabar la cola
+    LOGE("❌ Muestra demasiado grande para TELEMETRY_BATCH_BYTES, descartada");
+    _samples.drop(1);
+    return false;
+  }
+  if (!publish(TOPIC_MEASUREMENTS, (const uint8_t*)msg.c_str(), msg.length())) {
+    LOGE("❌ No se pudo publicar el lote de muestras");
+    return false;
+  }
+  _samples.drop(count);
+  LOGI("📦 Lote enviado: %u muestras, %u bytes", (unsigned)count, (unsigned)msg.length());
+  return true;
+}
+
+// Fecha mínima creíble: antes de esto el reloj todavía no se sincronizó
+#define OFFLINE_MIN_EPOCH 1600000000
+
 void Esp32OTA::sendWeatherData(float temperature, float humidity, const char* endpointUrl) {
-  if (WiFi.status() != WL_CONNECTED) {
-    Serial.println("No hay WiFi para enviar POST");
+  QueuedReading reading;
+  reading.temperature = temperature;
+  reading.humidity = humidity;
+  time_t now = time(nullptr);
+  reading.epoch = now > OFFLINE_MIN_EPOCH ? (uint32_t)now : 0;
+  reading.capturedMs = millis();
+  reading.bootId = _bootId;
+
+  if (_netTask) {
+    // La tarea de red es dueña de la sesión HTTP, de la URL y de la cola offline: se le
+    // pasa la lectura con una copia de la URL
+    netFlushWeather();
+    if (_netWeatherPendingCount == 0 && netPushWeather(reading, endpointUrl)) return;
+
+    // Cola llena: la lectura espera aquí, detrás de las anteriores, y loop() la reintenta
+    size_t urlLen = endpointUrl ? strlen(endpointUrl) : 0;
+    if (urlLen > 0 && urlLen <= WEATHER_URL_MAX) memcpy(_netWeatherUrl, endpointUrl, urlLen + 1);
+    if (_netWeatherPendingCount == NET_WEATHER_PENDING) {
+      LOGW("⚠️ Cola de la tarea de red llena: se pierde la lectura en espera más vieja");
+      memmove(&_netWeatherPending[0], &_netWeatherPending[1],
+              sizeof(QueuedReading) * (NET_WEATHER_PENDING - 1));
+      _netWeatherPendingCount--;
+      _netWeatherDropped++;
+    }
+    _netWeatherPending[_netWeatherPendingCount++] = reading;
+    _netWeatherDeferred++;
     return;
   }
+  storeWeatherUrl(endpointUrl);
+  deliverWeather(reading);
+}
 
-  HTTPClient http;
-  http.begin(endpointUrl);
-  http.addHeader("Content-Type", "application/json");
+// Copia la lectura y la URL a la cola de la tarea de red. Con la cola llena devuelve false
+// sin contarlo como descarte: quien llama la guarda y reintenta.
+bool Esp32OTA::netPushWeather(const QueuedReading& reading, const char* url) {
+  size_t urlLen = url ? strlen(url) : 0;
+  if (urlLen > WEATHER_URL_MAX) urlLen = 0;  // la tarea la descarta y conserva la anterior
+  uint8_t* p = _netQueue.tryReserve(NET_RECORD_HEADER + sizeof(reading) + urlLen);
+  if (!p) return false;
+  p[0] = NET_WEATHER;
+  p[1] = (uint8_t)urlLen;
+  memcpy(p + NET_RECORD_HEADER, &reading, sizeof(reading));
+  memcpy(p + NET_RECORD_HEADER + sizeof(reading), url, urlLen);
+  _netQueue.commit(NET_RECORD_HEADER + sizeof(reading) + urlLen);
+  _netEnqueued++;
+  xTaskNotifyGive(_netTask);
+  return true;
+}
 
-  // String payload = "{\"mac\":\"" + deviceMac + "\",\"name\":\"" + _deviceName +
-  //                  "\",\"version\":\"" + _firmwareVersion +
-  //                  "\",\"temperature\":" + String(temperature, 1) +
-  //                  ",\"humidity\":" + String(humidity, 1) + "}";
-String payload = "{\"mac\":\"" + deviceMac + "\",\"name\":\"" + _deviceName +
-                 "\",\"version\":\"" + _firmwareVersion +
-                 "\",\"temperature\":" + String(temperature, 1) +
-                 ",\"humidity\":" + String(humidity, 1) +
-                 ",\"lat\":" + String(_latitude, 6) +
-                 ",\"lon\":" + String(_longitude, 6) + "}";
+// Pasa a la cola las lecturas en espera, en orden, mientras haya lugar
+void Esp32OTA::netFlushWeather() {
+  size_t sent = 0;
+  while (sent < _netWeatherPendingCount && netPushWeather(_netWeatherPending[sent], _netWeatherUrl)) sent++;
+  if (sent == 0) return;
+  _netWeatherPendingCount -= sent;
+  memmove(&_netWeatherPending[0], &_netWeatherPending[sent], sizeof(QueuedReading) * _netWeatherPendingCount);
+  if (_netWeatherPendingCount == 0) _netWeatherUrl[0] = '\0';
+}
 
-  int httpCode = http.POST(payload);
+// Copia propia del endpoint: el puntero del llamador puede no durar hasta el reenvío.
+// Una URL vacía o demasiado larga no reemplaza a la anterior.
+bool Esp32OTA::storeWeatherUrl(const char* url) {
+  size_t len = url ? strlen(url) : 0;
+  if (len == 0 || len > WEATHER_URL_MAX) {
+    LOGE("❌ URL de sendWeatherData vacía o de más de %u bytes", (unsigned)WEATHER_URL_MAX);
+    return false;
+  }
+  memcpy(_weatherUrl, url, len + 1);
+  return true;
+}
+
+void Esp32OTA::deliverWeather(const QueuedReading& reading) {
+  // Con lecturas pendientes, la nueva va a la cola para respetar el orden
+  if (WiFi.status() != WL_CONNECTED || !_offline.empty() || !_weatherUrl[0]) {
+    if (WiFi.status() != WL_CONNECTED) LOGI("No hay WiFi para enviar POST");
+    enqueueWeather(reading);
+    return;
+  }
+
+  int httpCode = postWeather(&reading, 1);
+  if (httpCode <= 0 || httpCode >= 500) {
+    enqueueWeather(reading);
+  }
+}
+
+// Antigüedad de una lectura en ms: por hora UNIX si se conoce, o por millis()
+// si se tomó en este mismo arranque. Sin ninguna de las dos, no se informa.
+bool Esp32OTA::readingAge(const QueuedReading& reading, unsigned long& ageMs) {
+  time_t now = time(nullptr);
+  if (reading.epoch != 0 && now > OFFLINE_MIN_EPOCH && (uint32_t)now >= reading.epoch) {
+    ageMs = ((uint32_t)now - reading.epoch) * 1000UL;
+    return true;
+  }
+  if (reading.bootId == _bootId) {
+    ageMs = millis() - reading.capturedMs;
+    return true;
+  }
+  return false;
+}
+
+// Un POST con una lectura (formato original) o varias en "readings".
+// Devuelve el código HTTP, o un valor <= 0 si no hubo respuesta.
+int Esp32OTA::postWeather(const QueuedReading* readings, size_t count) {
+  JsonMessage<256 + OFFLINE_DRAIN_BATCH * 80> payload;
+  payload.beginObject()
+         .field("mac", deviceMac.c_str())
+         .field("name", _deviceName)
+         .field("version", _firmwareVersion)
+         .field("lat", _latitude, 6)
+         .field("lon", _longitude, 6);
+
+  unsigned long ageMs;
+  if (count == 1) {
+    payload.field("temperature", readings[0].temperature, 1)
+           .field("humidity", readings[0].humidity, 1);
+    if (readingAge(readings[0], ageMs) && ageMs > 0) payload.field("age", ageMs);
+  } else {
+    payload.beginArray("readings");
+    for (size_t i = 0; i < count; i++) {
+      payload.beginObject()
+             .field("temperature", readings[i].temperature, 1)
+             .field("humidity", readings[i].humidity, 1);
+      if (readingAge(readings[i], ageMs)) payload.field("age", ageMs);
+      payload.endObject();
+    }
+    payload.endArray();
+  }
+  payload.endObject();
+
+  int httpCode = httpPost(_weatherUrl, (const uint8_t*)payload.c_str(), payload.length());
   if (httpCode > 0) {
-    Serial.printf("POST enviado (%d): %s\n", httpCode, payload.c_str());
+    LOGD("POST enviado (%d, %lu ms): %s", httpCode, _httpStats.lastMs, payload.c_str());
   } else {
-    Serial.printf("Error POST: %s\n", http.errorToString(httpCode).c_str());
+    LOGW("Error POST: %s", HTTPClient::errorToString(httpCode).c_str());
   }
-  http.end();
+  return httpCode;
+}
+
+// POST sobre la sesión persistente. Si la conexión reutilizada resulta estar
+// muerta (el servidor cierra las inactivas), se reintenta una vez con una nueva.
+int Esp32OTA::httpPost(const char* url, const uint8_t* body, size_t len) {
+  bool tls = strncmp(url, "https://", 8) == 0;
+  WiFiClient& client = tls ? (WiFiClient&)_httpTls : _httpPlain;
+
+  // Origen = esquema + host + puerto: si cambia, la conexión abierta no sirve
+  const char* hostStart = strstr(url, "://");
+  hostStart = hostStart ? hostStart + 3 : url;
+  const char* pathStart = strchr(hostStart, '/');
+  size_t originLen = pathStart ? (size_t)(pathStart - url) : strlen(url);
+  if (originLen >= sizeof(_httpOrigin)) originLen = sizeof(_httpOrigin) - 1;
+  if (strncmp(_httpOrigin, url, originLen) != 0 || _httpOrigin[originLen] != '\0') {
+    _httpTls.stop();
+    _httpPlain.stop();
+    memcpy(_httpOrigin, url, originLen);
+    _httpOrigin[originLen] = '\0';
+  }
+
+  int httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    bool reused = client.connected();
+    if (!reused) _httpStats.handshakes++;
+
+    unsigned long start = millis();
+    _http.begin(client, url);
+    _http.setReuse(true);
+    _http.addHeader("Content-Type", "application/json");
+    httpCode = _http.POST((uint8_t*)body, len);
+    unsigned long elapsed = millis() - start;
+    _http.end();  // con setReuse(true) el socket queda abierto
+    _netJobs.start(_httpIdleJob, millis(), HTTP_KEEPALIVE_IDLE);
+
+    if (httpCode > 0) {
+      _httpStats.requests++;
+      _httpStats.lastMs = elapsed;
+      if (elapsed > _httpStats.maxMs) _httpStats.maxMs = elapsed;
+      if (reused) {
+        _httpStats.reused++;
+        _httpReusedTotalMs += elapsed;
+      } else {
+        _httpNewTotalMs += elapsed;
+      }
+      return httpCode;
+    }
+
+    client.stop();
+    if (!reused) break;  // ya era una conexión nueva: no tiene sentido reintentar
+    LOGI("🔁 Conexión HTTP reutilizada caída, reconectando...");
+  }
+  _httpStats.failures++;
+  return httpCode;
+}
+
+// Cierra la sesión tras HTTP_KEEPALIVE_IDLE sin uso (cada POST reprograma el plazo)
+void Esp32OTA::httpIdleClose() {
+  if (_httpTls.connected() || _httpPlain.connected()) {
+    LOGI("💤 Cerrando sesión HTTP inactiva");
+  }
+  _httpTls.stop();
+  _httpPlain.stop();
+}
+
+HttpStats Esp32OTA::getHttpStats() const {
+  HttpStats stats = _httpStats;
+  uint32_t fresh = _httpStats.requests - _httpStats.reused;
+  stats.avgNewMs = fresh ? _httpNewTotalMs / fresh : 0;
+  stats.avgReusedMs = _httpStats.reused ? _httpReusedTotalMs / _httpStats.reused : 0;
+  return stats;
+}
+
+void Esp32OTA::enqueueWeather(const QueuedReading& reading) {
+  uint32_t evicted = _offline.evicted();
+  if (!_offline.push(reading)) {
+    LOGE("❌ No se pudo guardar la lectura en la cola offline");
+    return;
+  }
+  if (_offline.evicted() != evicted) {
+    LOGW("⚠️ Cola offline llena: se descartó la lectura más vieja");
+  }
+  LOGI("💾 Lectura guardada en cola offline (%u pendientes)", (unsigned)_offline.size());
+  // Si no hay un lote programado, se intenta ya (el POST que falló reprograma la espera)
+  if (!_netJobs.pending(_offlineJob)) _netJobs.start(_offlineJob, millis(), 0);
+}
+
+// Vacía la cola de a un lote por vez, espaciando los lotes para no frenar loop(). Cada
+// lote programa el siguiente; con la cola vacía la tarea queda detenida.
+void Esp32OTA::offlineDrain() {
+  if (_offline.empty()) return;
+  if (!_weatherUrl[0] || WiFi.status() != WL_CONNECTED || isOTAInProgress()) {
+    _netJobs.start(_offlineJob, millis(), OFFLINE_DRAIN_INTERVAL);
+    return;
+  }
+
+  QueuedReading batch[OFFLINE_DRAIN_BATCH];
+  size_t count = 0;
+  while (count < OFFLINE_DRAIN_BATCH && count < _offline.size() && _offline.peek(count, batch[count])) {
+    count++;
+  }
+  if (count == 0) return;
+
+  unsigned long next = OFFLINE_DRAIN_INTERVAL;
+  int httpCode = postWeather(batch, count);
+  if (httpCode >= 200 && httpCode < 300) {
+    _offline.pop(count);
+    LOGI("📤 Cola offline: %u lecturas reenviadas, quedan %u",
+         (unsigned)count, (unsigned)_offline.size());
+  } else if (httpCode >= 400 && httpCode < 500) {
+    // El servidor las rechaza: reintentarlas no va a cambiar el resultado
+    _offline.pop(count);
+    LOGE("❌ Cola offline: %u lecturas rechazadas (%d), descartadas", (unsigned)count, httpCode);
+  } else {
+    next = OFFLINE_RETRY_DELAY;
+  }
+  if (!_offline.empty()) _netJobs.start(_offlineJob, millis(), next);
 }
 
 void Esp32OTA::sendHeartbeat() {
-  String hbMsg = "{\"mac\":\"" + deviceMac + "\",\"name\":\"" + _deviceName +
-                 "\",\"uptime\":" + String(millis()) + "}";
-  mqttClient.publish(TOPIC_HEARTBEAT, hbMsg.c_str(), false);
-  Serial.println("Heartbeat enviado: " + hbMsg);
+  JsonMessage<160> hbMsg;
+  hbMsg.beginObject()
+       .field("mac", deviceMac.c_str())
+       .field("name", _deviceName)
+       .field("uptime", millis())
+       .endObject();
+  publish(TOPIC_HEARTBEAT, (const uint8_t*)hbMsg.c_str(), hbMsg.length());
+  LOGD("Heartbeat enviado: %s", hbMsg.c_str());
 }
 
-void Esp32OTA::loop() {
-  // Solo intentar conectar si no está conectado (sin bloquear)
-  static unsigned long lastConnectAttempt = 0;
-  
-  if (!mqttClient.connected()) {
-    // Solo intentar reconectar cada 30 segundos
-    if (millis() - lastConnectAttempt > 30000) {
-      connectMQTT();
-      lastConnectAttempt = millis();
+unsigned long Esp32OTA::loop() {
+  unsigned long start = micros();
+  // En el modo con tarea de red, la red la atiende la tarea: aquí solo se arman los lotes
+  // y se reintentan las lecturas que no entraron en la cola
+  unsigned long wait = LOOP_MAX_WAIT;
+  if (!_netTask) {
+    wait = networkStep();
+  } else if (_netWeatherPendingCount > 0) {
+    netFlushWeather();
+    if (_netWeatherPendingCount > 0) wait = LOOP_RETRY_MS;
+  }
+  wait = min(wait, (unsigned long)_jobs.run(millis()));
+  wait = min(wait, telemetryStep());
+  wait = min(wait, logStep());
+  _metrics.observe(METRIC_LOOP_US, micros() - start);
+  return wait;
+}
+
+int8_t Esp32OTA::every(unsigned long periodMs, SchedulerFn fn, void* ctx) {
+  return _jobs.every(millis(), periodMs, fn, ctx);
+}
+
+int8_t Esp32OTA::after(unsigned long delayMs, SchedulerFn fn, void* ctx) {
+  return _jobs.after(millis(), delayMs, fn, ctx);
+}
+
+// Pasa al Serial lo que entra en su buffer sin esperar y publica el lote de log si corresponde.
+// Devuelve los ms hasta que haga falta volver: poco si el Serial no aceptó todo.
+unsigned long Esp32OTA::logStep() {
+  logRing.drain(Serial, _logForward ? logForwardThunk : nullptr, this);
+  unsigned long wait = logRing.pending() ? LOOP_RETRY_MS : LOOP_MAX_WAIT;
+  if (_logPendingCount == 0 || !mqttReady()) return wait;
+  unsigned long age = millis() - _logPending[0].at;
+  if (_logPendingCount >= LOG_FORWARD_BATCH || age >= LOG_FORWARD_MAX_AGE) {
+    publishLogs();
+    return wait;
+  }
+  return min(wait, LOG_FORWARD_MAX_AGE - age);
+}
+
+void Esp32OTA::logForwardThunk(const LogEntry& entry, void* ctx) {
+  static_cast<Esp32OTA*>(ctx)->logForward(entry);
+}
+
+// Guarda una línea para el próximo lote. Con el lote lleno se publica; sin MQTT se
+// descarta la más vieja.
+void Esp32OTA::logForward(const LogEntry& entry) {
+  if (entry.level < LOG_LVL_WARN) return;
+  if (_logPendingCount == LOG_FORWARD_BATCH && mqttReady()) publishLogs();
+  if (_logPendingCount == LOG_FORWARD_BATCH) {
+    memmove(&_logPending[0], &_logPending[1], sizeof(LogEntry) * (LOG_FORWARD_BATCH - 1));
+    _logPendingCount--;
+    _logForwardDropped++;
+  }
+  _logPending[_logPendingCount++] = entry;
+}
+
+// Un mensaje con todas las líneas pendientes: {"mac", "entries": [{level, message, age}]}.
+// Los fallos de aquí no se registran con LOG*: volverían a entrar al lote.
+bool Esp32OTA::publishLogs() {
+  uint32_t now = millis();
+  JsonWriter msg(_batchBuf, sizeof(_batchBuf));
+  msg.beginObject()
+     .field("mac", deviceMac.c_str())
+     .beginArray("entries");
+  for (size_t i = 0; i < _logPendingCount; i++) {
+    const LogEntry& e = _logPending[i];
+    msg.beginObject()
+       .field("level", LogRing::levelName(e.level))
+       .field("message", e.text)
+       .field("age", (unsigned long)(now - e.at))
+       .endObject();
+  }
+  msg.endArray().endObject();
+  if (msg.ok() && !publish(TOPIC_DEBUG, (const uint8_t*)msg.c_str(), msg.length())) return false;
+  if (!msg.ok()) _logForwardDropped += _logPendingCount;
+  _logPendingCount = 0;
+  return msg.ok();
+}
+
+// Todo lo que usa WiFi, MQTT o HTTP. Corre en loop() o en la tarea de red, nunca en ambos.
+// Devuelve cuánto se puede esperar antes del próximo paso: 0 durante una OTA y como mucho
+// NET_TASK_IDLE_MS, que es lo que puede tardar en leerse un comando llegado por MQTT.
+unsigned long Esp32OTA::networkStep() {
+  // Heartbeat, métricas, turno del despliegue escalonado, cola offline, sesión HTTP
+  unsigned long wait = _netJobs.run(millis());
+
+  // OTA incremental: un bloque acotado por llamada
+  if (_otaState == OTA_PENDING) {
+    otaStart();
+  } else if (_otaState == OTA_DOWNLOADING) {
+    otaStep();
+  }
+
+  // WiFi y MQTT: la máquina de estados avanza un paso sin bloquear
+  connectivityStep();
+
+  // Solo procesar MQTT si está conectado
+  if (_conn.state() == CONN_ONLINE) mqttClient.loop();
+
+  // Mensajes encolados por la aplicación (solo en el modo con tarea de red)
+  if (_netTask) netDrain();
+
+  if (isOTAInProgress()) return 0;
+  return min(wait, (unsigned long)NET_TASK_IDLE_MS);
+}
+
+// Al quedar en línea se retoman el heartbeat (enseguida) y las métricas (en su plazo)
+void Esp32OTA::netJobsOnline() {
+  unsigned long now = millis();
+  if (!_netJobs.pending(_heartbeatJob)) _netJobs.start(_heartbeatJob, now, 0);
+  if (_metricsInterval > 0 && !_netJobs.pending(_metricsJob)) {
+    unsigned long elapsed = now - _metricsLast;
+    _netJobs.start(_metricsJob, now, elapsed < _metricsInterval ? _metricsInterval - elapsed : 0);
+  }
+}
+
+// Sin MQTT las dos tareas quedan detenidas hasta netJobsOnline()
+void Esp32OTA::heartbeatJob(void* ctx) {
+  Esp32OTA* self = static_cast<Esp32OTA*>(ctx);
+  if (self->_conn.state() != CONN_ONLINE) return;
+  self->sendHeartbeat();
+  self->_netJobs.start(self->_heartbeatJob, millis(), HEARTBEAT_INTERVAL);
+}
+
+void Esp32OTA::metricsJob(void* ctx) {
+  Esp32OTA* self = static_cast<Esp32OTA*>(ctx);
+  if (self->_conn.state() != CONN_ONLINE || self->_metricsInterval == 0) return;
+  self->publishMetrics();
+  self->_netJobs.start(self->_metricsJob, millis(), self->_metricsInterval);
+}
+
+// Actualización del despliegue escalonado cuyo turno llegó
+void Esp32OTA::otaScheduledJob(void* ctx) {
+  Esp32OTA* self = static_cast<Esp32OTA*>(ctx);
+  if (!self->_otaScheduled) return;
+  self->_otaScheduled = false;
+  self->otaDispatch(self->_otaScheduledKind, self->_otaScheduledBase, self->_otaScheduledUrl,
+                    self->_otaScheduledManifest);
+  self->_otaScheduledUrl = String();
+  self->_otaScheduledBase = String();
+  self->_otaScheduledManifest.version = String();
+}
+
+void Esp32OTA::httpIdleJob(void* ctx) {
+  static_cast<Esp32OTA*>(ctx)->httpIdleClose();
+}
+
+// Lecturas meteorológicas guardadas sin red (solo necesita WiFi, no MQTT)
+void Esp32OTA::offlineJob(void* ctx) {
+  static_cast<Esp32OTA*>(ctx)->offlineDrain();
+}
+
+void Esp32OTA::setMetrics(unsigned long intervalMs, const char* topic) {
+  _metricsInterval = intervalMs;
+  _metricsTopic = topic;
+}
+
+// Instantánea compacta: los indicadores de memoria y RSSI se leen aquí, una vez por envío.
+// Siempre se arma en el contexto de la red (loop() o la tarea), que es quien usa _metricsBuf.
+bool Esp32OTA::publishMetrics() {
+  if (!mqttReady()) return false;
+  unsigned long now = millis();
+  _metrics.set(METRIC_FREE_HEAP, ESP.getFreeHeap());
+  _metrics.set(METRIC_MIN_FREE_HEAP, ESP.getMinFreeHeap());
+  _metrics.set(METRIC_MAX_ALLOC_HEAP, ESP.getMaxAllocHeap());
+  _metrics.set(METRIC_RSSI, WiFi.RSSI());
+
+  JsonWriter msg(_metricsBuf, sizeof(_metricsBuf));
+  msg.beginObject()
+     .field("mac", deviceMac.c_str())
+     .field("uptime", now)
+     .field("windowMs", now - _metricsLast);
+  _metrics.write(msg);
+  msg.endObject();
+  _metricsLast = now;
+
+  if (!msg.ok()) {
+    LOGE("❌ La instantánea de métricas no entra en METRICS_BYTES");
+    return false;
+  }
+  return publish(_metricsTopic, (const uint8_t*)msg.c_str(), msg.length());
+}
+
+bool Esp32OTA::mqttReady() {
+  return _netTask ? _netOnline.load() : mqttClient.connected();
+}
+
+// Publica directo o, si hay tarea de red y se llama desde la aplicación, copia el
+// mensaje a la cola. Nunca espera a la red en el segundo caso.
+bool Esp32OTA::publish(const char* topic, const uint8_t* payload, size_t len) {
+  if (!_netTask || xTaskGetCurrentTaskHandle() == _netTask) {
+    return mqttPublish(topic, payload, len);
+  }
+
+  size_t topicLen = strlen(topic);
+  if (topicLen > NET_TOPIC_MAX) return false;
+  uint8_t* p = _netQueue.reserve(NET_RECORD_HEADER + topicLen + len);
+  if (!p) return false;  // cola llena: lo cuenta el ring como descartado
+  p[0] = NET_PUBLISH;
+  p[1] = (uint8_t)topicLen;
+  memcpy(p + NET_RECORD_HEADER, topic, topicLen);
+  memcpy(p + NET_RECORD_HEADER + topicLen, payload, len);
+  _netQueue.commit(NET_RECORD_HEADER + topicLen + len);
+  _netEnqueued++;
+  xTaskNotifyGive(_netTask);
+  return true;
+}
+
+// mqttClient.publish() con su latencia (escribe en el socket, así que mide la red y TLS)
+bool Esp32OTA::mqttPublish(const char* topic, const uint8_t* payload, size_t len) {
+  unsigned long start = micros();
+  bool ok = mqttClient.publish(topic, payload, len, false);
+  _metrics.observe(METRIC_PUBLISH_US, micros() - start);
+  if (!ok) _metrics.count(METRIC_PUBLISH_FAILED);
+  return ok;
+}
+
+bool Esp32OTA::startNetworkTask() {
+  _netQueueMem = (uint8_t*)malloc(NET_QUEUE_BYTES);
+  if (!_netQueueMem || !_netQueue.begin(_netQueueMem, NET_QUEUE_BYTES)) {
+    LOGE("❌ Sin memoria para la cola de la tarea de red, se sigue desde loop()");
+    free(_netQueueMem);
+    _netQueueMem = nullptr;
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(netTaskThunk, "esp32ota_net", NET_TASK_STACK, this,
+                              NET_TASK_PRIORITY, &_netTask, NET_TASK_CORE) != pdPASS) {
+    LOGE("❌ No se pudo crear la tarea de red, se sigue desde loop()");
+    _netTask = nullptr;
+    free(_netQueueMem);
+    _netQueueMem = nullptr;
+    return false;
+  }
+  LOGI("🧵 Tarea de red iniciada (cola de %u bytes)", (unsigned)NET_QUEUE_BYTES);
+  return true;
+}
+
+void Esp32OTA::netTaskThunk(void* arg) {
+  Esp32OTA* self = static_cast<Esp32OTA*>(arg);
+  for (;;) {
+    unsigned long wait = self->networkStep();
+    // Se despierta con cada mensaje encolado; durante una OTA solo cede un tick
+    ulTaskNotifyTake(pdTRUE, wait == 0 ? 1 : pdMS_TO_TICKS(wait));
+  }
+}
+
+// Saca todo lo que encoló la aplicación. Sin MQTT, las publicaciones se descartan
+// (como al publicar directo desconectado); las lecturas meteorológicas siguen su camino.
+void Esp32OTA::netDrain() {
+  size_t len;
+  const uint8_t* rec;
+  while ((rec = _netQueue.peek(len)) != nullptr) {
+    if (rec[0] == NET_WEATHER) {
+      char url[WEATHER_URL_MAX + 1];
+      QueuedReading reading;
+      size_t urlLen = rec[1];
+      memcpy(&reading, rec + NET_RECORD_HEADER, sizeof(reading));
+      memcpy(url, rec + NET_RECORD_HEADER + sizeof(reading), urlLen);
+      url[urlLen] = '\0';
+      _netQueue.release();
+      storeWeatherUrl(url);
+      deliverWeather(reading);
+      continue;
     }
-  } else {
-    // Solo procesar MQTT si está conectado
-    mqttClient.loop();
-    
-    // Enviar heartbeat solo si está conectado
-    if (millis() - lastHeartbeat > 60000) {
-      sendHeartbeat();
-      lastHeartbeat = millis();
+
+    if (!mqttClient.connected()) {
+      _netOffline++;
+    } else {
+      char topic[NET_TOPIC_MAX + 1];
+      size_t topicLen = rec[1];
+      memcpy(topic, rec + NET_RECORD_HEADER, topicLen);
+      topic[topicLen] = '\0';
+      const uint8_t* payload = rec + NET_RECORD_HEADER + topicLen;
+      if (mqttPublish(topic, payload, len - NET_RECORD_HEADER - topicLen)) _netSent++;
+      else _netFailed++;
     }
+    _netQueue.release();
   }
 }
 
+NetQueueStats Esp32OTA::getNetQueueStats() const {
+  NetQueueStats s;
+  s.enqueued = _netEnqueued;
+  s.dropped = _netQueue.dropped();
+  s.sent = _netSent;
+  s.failed = _netFailed;
+  s.offline = _netOffline;
+  s.weatherDeferred = _netWeatherDeferred;
+  s.weatherDropped = _netWeatherDropped;
+  s.used = _netQueue.used();
+  s.highWater = _netQueue.highWater();
+  s.capacity = _netQueue.capacity();
+  return s;
+}
+
 void Esp32OTA::setOTAUpdateCallback(void (*callback)(const String&)) {
   otaUpdateCallback = callback;
 }
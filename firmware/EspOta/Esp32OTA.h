@@ -6,26 +6,331 @@
 #include <PubSubClient.h>
 #include <HTTPClient.h>
 #include <Update.h>
+#include "JsonWriter.h"
+#include "SampleRing.h"
+#include "OfflineQueue.h"
+#include "TlsSessionClient.h"
+#include "WiFiFastConnect.h"
+#include "WiFiRanking.h"
+#include "ConnectivityFsm.h"
+#include "SpscRing.h"
+#include "OtaCommand.h"
+#include "Rollout.h"
+#include <LittleFS.h>
+#include "CborWriter.h"
+#include "OtaInflate.h"
+#include "OtaDelta.h"
+#include "OtaFlashWriter.h"
+#include "OtaVerify.h"
+#include "Metrics.h"
+#include "Log.h"
+#include "Scheduler.h"
+#include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
 
 // Definiciones para tópicos MQTT
 #define TOPIC_STATUS    "esp32/status"
-#define TOPIC_UPDATE    "esp32/update"
+#define TOPIC_UPDATE    "esp32/update"  // tópico compartido (servidores anteriores)
+// Comandos OTA dirigidos: así cada comando llega solo a quien corresponde
+#define TOPIC_UPDATE_PREFIX "esp32/update/"        // + MAC: solo este dispositivo
+#define TOPIC_UPDATE_GROUP  "esp32/update/group/"  // + grupo (sitio, revisión de hardware...)
+#define TOPIC_UPDATE_ALL    "esp32/update/all"     // toda la flota
+#ifndef MQTT_MAX_UPDATE_GROUPS
+#define MQTT_MAX_UPDATE_GROUPS 4
+#endif
 #define TOPIC_HEARTBEAT "esp32/heartbeat"
 #define TOPIC_SENSOR    "esp32/sensor"
+#define TOPIC_MEASUREMENTS "esp32/measurements"
+#define TOPIC_METRICS   "esp32/metrics"
+#define TOPIC_DEBUG     "esp32/debug"
+
+// Reenvío de líneas WARNING/ERROR por TOPIC_DEBUG: se publica al juntar LOG_FORWARD_BATCH
+// o cuando la más vieja supera LOG_FORWARD_MAX_AGE ms. Sin MQTT se conservan las últimas.
+#ifndef LOG_FORWARD_BATCH
+#define LOG_FORWARD_BATCH 8
+#endif
+#ifndef LOG_FORWARD_MAX_AGE
+#define LOG_FORWARD_MAX_AGE 10000
+#endif
+
+// Heartbeat por TOPIC_HEARTBEAT mientras haya MQTT (ms)
+#ifndef HEARTBEAT_INTERVAL
+#define HEARTBEAT_INTERVAL 60000
+#endif
+
+// Lo que devuelve loop(): como mucho LOOP_MAX_WAIT, y LOOP_RETRY_MS mientras quede salida
+// pendiente (Serial lleno, un lote que no entró en un mensaje) (ms)
+#ifndef LOOP_MAX_WAIT
+#define LOOP_MAX_WAIT 1000
+#endif
+#ifndef LOOP_RETRY_MS
+#define LOOP_RETRY_MS 10
+#endif
+
+// Instantánea de métricas internas (ver Metrics.h): cada cuánto se publica (ms, 0 = nunca)
+// y tamaño máximo del mensaje
+#ifndef METRICS_INTERVAL
+#define METRICS_INTERVAL 60000
+#endif
+#ifndef METRICS_BYTES
+#define METRICS_BYTES 1280
+#endif
+
+// Lotes de telemetría: se publica al juntar TELEMETRY_BATCH_SAMPLES muestras o cuando
+// la más vieja supera TELEMETRY_BATCH_MAX_AGE ms (lo que ocurra primero)
+#ifndef TELEMETRY_BATCH_SAMPLES
+#define TELEMETRY_BATCH_SAMPLES 24
+#endif
+#ifndef TELEMETRY_BATCH_MAX_AGE
+#define TELEMETRY_BATCH_MAX_AGE 300000
+#endif
+// Tamaño máximo de un mensaje de lote (también fija el buffer de PubSubClient)
+#ifndef TELEMETRY_BATCH_BYTES
+#define TELEMETRY_BATCH_BYTES 2048
+#endif
+#ifndef TELEMETRY_DECIMALS
+#define TELEMETRY_DECIMALS 2
+#endif
+
+// Cola offline de sendWeatherData en LittleFS
+#define OFFLINE_QUEUE_PATH "/weather.q"
+// Lecturas por POST al vaciar la cola
+#ifndef OFFLINE_DRAIN_BATCH
+#define OFFLINE_DRAIN_BATCH 8
+#endif
+// Pausa entre lotes (para no acaparar loop()) y espera tras un POST fallido (ms)
+#ifndef OFFLINE_DRAIN_INTERVAL
+#define OFFLINE_DRAIN_INTERVAL 1000
+#endif
+#ifndef OFFLINE_RETRY_DELAY
+#define OFFLINE_RETRY_DELAY 30000
+#endif
+// Largo máximo de la URL de sendWeatherData (se guarda una copia; entra en un byte)
+#ifndef WEATHER_URL_MAX
+#define WEATHER_URL_MAX 127
+#endif
+
+// Sesión HTTP(S) persistente: se cierra tras este tiempo sin uso para liberar
+// los buffers TLS (~40 KB de heap) entre lecturas espaciadas (ms)
+#ifndef HTTP_KEEPALIVE_IDLE
+#define HTTP_KEEPALIVE_IDLE 60000
+#endif
+
+// Modo con tarea de red: tamaño de la cola de publicaciones (potencia de 2; un
+// mensaje puede ocupar hasta la mitad), pila, prioridad y núcleo de la tarea
+#ifndef NET_QUEUE_BYTES
+#define NET_QUEUE_BYTES 8192
+#endif
+#ifndef NET_TASK_STACK
+#define NET_TASK_STACK 8192
+#endif
+#ifndef NET_TASK_PRIORITY
+#define NET_TASK_PRIORITY 1
+#endif
+#ifndef NET_TASK_CORE
+#define NET_TASK_CORE 0
+#endif
+// Espera máxima de la tarea de red sin avisos de la aplicación (ms)
+#ifndef NET_TASK_IDLE_MS
+#define NET_TASK_IDLE_MS 10
+#endif
+// Lecturas de sendWeatherData que esperan en loop() a que se libere lugar en la cola
+#ifndef NET_WEATHER_PENDING
+#define NET_WEATHER_PENDING 4
+#endif
+#define NET_TOPIC_MAX 63
+// Registros de la cola: [tipo][largo del tópico][2 reservados][tópico][datos]; las lecturas
+// meteorológicas llevan el largo de la URL en lugar del tópico: [lectura][URL]
+#define NET_RECORD_HEADER 4
+#define NET_PUBLISH 1
+#define NET_WEATHER 2
+
+// Servidor SNTP para fechar las lecturas que quedan en cola
+#ifndef NTP_SERVER
+#define NTP_SERVER "pool.ntp.org"
+#endif
+#define TOPIC_SENSOR_CBOR "esp32/sensor/cbor"
+
+// Claves enteras de la trama CBOR de sensor (servernode/lib/cbor.js usa las mismas)
+#define CBOR_KEY_MAC         0  // bytes(6)
+#define CBOR_KEY_TEMPERATURE 1  // float32 (null si la lectura falló)
+#define CBOR_KEY_HUMIDITY    2  // float32 (null si la lectura falló)
+
+// Tamaño por defecto de cada buffer intermedio HTTP -> flash
+#ifndef OTA_CHUNK_SIZE
+#define OTA_CHUNK_SIZE 4096
+#endif
+
+// Cantidad de buffers por defecto: con 2 o más, una tarea escribe la flash
+// mientras loop() sigue leyendo la red. Con 1 todo se hace en loop().
+#ifndef OTA_PIPELINE_DEPTH
+#define OTA_PIPELINE_DEPTH 2
+#endif
+#define OTA_PIPELINE_MAX_DEPTH 8
+
+// Tarea consumidora del pipeline (pila, prioridad y núcleo)
+#ifndef OTA_PIPELINE_STACK
+#define OTA_PIPELINE_STACK 6144
+#endif
+#ifndef OTA_PIPELINE_PRIORITY
+#define OTA_PIPELINE_PRIORITY 2
+#endif
+#ifndef OTA_PIPELINE_CORE
+#define OTA_PIPELINE_CORE 0
+#endif
+
+// En modo delta se leen bloques chicos: cada operación COPY genera hasta 4 KB de escritura
+#ifndef OTA_DELTA_READ_CHUNK
+#define OTA_DELTA_READ_CHUNK 64
+#endif
+
+// Tiempo máximo sin recibir datos antes de cortar la descarga (ms)
+#ifndef OTA_STALL_TIMEOUT
+#define OTA_STALL_TIMEOUT 20000
+#endif
+
+// Reintentos automáticos ante cortes de red; la espera crece con cada intento (ms)
+#ifndef OTA_MAX_RETRIES
+#define OTA_MAX_RETRIES 5
+#endif
+#ifndef OTA_RETRY_DELAY
+#define OTA_RETRY_DELAY 5000
+#endif
+
+// Cada cuántos bytes escritos se guarda el progreso en NVS (múltiplo de 4 KB)
+#ifndef OTA_RESUME_CHECKPOINT
+#define OTA_RESUME_CHECKPOINT (64 * 1024)
+#endif
+
+#define OTA_PREFS_NAMESPACE "ota"
+// Resultado pendiente de informar tras el reinicio de una actualización
+#define OTA_REPORT_NAMESPACE "ota_report"
+
+// Tiempo de escucha por canal en el escaneo de redes (ms)
+#ifndef WIFI_SCAN_MS_PER_CHAN
+#define WIFI_SCAN_MS_PER_CHAN 120
+#endif
+// Tiempo máximo para asociarse a cada red candidata (ms)
+#ifndef WIFI_JOIN_TIMEOUT
+#define WIFI_JOIN_TIMEOUT 10000
+#endif
+// Tiempo máximo del escaneo asíncrono antes de probar las redes en orden (ms)
+#ifndef WIFI_SCAN_TIMEOUT
+#define WIFI_SCAN_TIMEOUT 15000
+#endif
+// Espera tras un intento sin ninguna red disponible (ms)
+#ifndef WIFI_RETRY_DELAY
+#define WIFI_RETRY_DELAY 15000
+#endif
+// Plazo de cada intento de conexión al broker y espera entre intentos (ms)
+#ifndef MQTT_CONNECT_TIMEOUT
+#define MQTT_CONNECT_TIMEOUT 5000
+#endif
+#ifndef MQTT_RETRY_DELAY
+#define MQTT_RETRY_DELAY 30000
+#endif
+
+// Cómo se elige la red cuando falla la unión directa
+enum WiFiSelection {
+  WIFI_SELECT_RANKED,  // un escaneo; solo se prueban las redes visibles, por RSSI e historial
+  WIFI_SELECT_ORDERED  // se prueban todas en el orden configurado (necesario para SSID ocultos)
+};
+
+// Codificación de la telemetría de sensores
+enum TelemetryEncoding {
+  TELEMETRY_JSON,  // texto en TOPIC_SENSOR (compatible con versiones anteriores)
+  TELEMETRY_CBOR   // trama binaria compacta en TOPIC_SENSOR_CBOR (~21 bytes)
+};
+
+// Estados del motor OTA incremental
+enum OTAState {
+  OTA_IDLE,         // sin actualización en curso
+  OTA_PENDING,      // comando recibido, se inicia en el próximo loop()
+  OTA_DOWNLOADING,  // transfiriendo bloques HTTP -> flash
+  OTA_SUCCESS,      // imagen escrita y validada, reinicio inminente
+  OTA_FAILED        // la última actualización falló
+};
+
+// Instantánea del progreso de la OTA en curso (o de la última)
+struct OTAStatus {
+  OTAState state;
+  OTAEncoding encoding;    // formato detectado de la imagen
+  bool delta;              // true si se está aplicando un parche delta
+  size_t received;         // bytes recibidos por la red
+  size_t total;            // tamaño anunciado por el servidor (bytes por la red)
+  size_t written;          // bytes (ya descomprimidos) escritos en flash
+  size_t resumedFrom;      // offset desde el que se reanudó (0 si fue completa)
+  uint8_t retries;         // reintentos hechos tras cortes de red
+  unsigned long elapsedMs; // tiempo desde que empezó la descarga
+  float throughput;        // bytes/s promedio recibidos por la red
+  float flashThroughput;   // bytes/s escritos mientras la etapa de flash estuvo ocupada
+  uint32_t pipelineStalls; // veces que la red esperó por no haber buffer libre
+  float verifyMsPerMB;     // costo del SHA-256 en streaming por MB escrito
+};
+
+// Imagen que anuncia un comando "manifest" (o requestManifestOTA)
+struct OtaManifest {
+  String version;
+  size_t size;         // bytes de la imagen sin comprimir
+  uint8_t sha256[32];  // hash de la imagen, el que calcula esp_partition_get_sha256()
+  uint8_t signature[OTA_SIGNATURE_MAX];  // firma DER de sha256 (opción sig= del comando)
+  size_t signatureLen;
+};
+
+// Estadísticas de la sesión HTTP(S) de sendWeatherData
+struct HttpStats {
+  uint32_t requests;         // POST con respuesta del servidor
+  uint32_t failures;         // POST sin respuesta (tras reintentar con conexión nueva)
+  uint32_t handshakes;       // conexiones nuevas (DNS + TCP + TLS)
+  uint32_t reused;           // POST enviados sobre una conexión ya abierta
+  unsigned long lastMs;      // latencia del último POST
+  unsigned long maxMs;       // latencia máxima
+  unsigned long avgNewMs;    // latencia promedio con handshake
+  unsigned long avgReusedMs; // latencia promedio reutilizando la conexión
+};
+
+// Contadores de la cola de publicaciones del modo con tarea de red
+struct NetQueueStats {
+  uint32_t enqueued;  // mensajes encolados por la aplicación
+  uint32_t dropped;   // descartados al encolar: cola llena o mensaje demasiado grande
+  uint32_t sent;      // publicados por la tarea de red
+  uint32_t failed;    // publish() falló en la tarea de red
+  uint32_t offline;   // descartados por no haber MQTT al sacarlos de la cola
+  uint32_t weatherDeferred;  // lecturas que esperaron en loop() por la cola llena
+  uint32_t weatherDropped;   // lecturas perdidas: cola llena y sin lugar para esperar
+  size_t used;        // bytes ocupados ahora
+  size_t highWater;   // máximo de bytes ocupados
+  size_t capacity;
+};
 
 class Esp32OTA {
 public:
-  // Constructor: recibe credenciales WiFi, datos del broker MQTT, nombre del dispositivo y versión del firmware.
+  // Constructor: recibe datos del broker MQTT, nombre del dispositivo, versión del firmware
+  // y la codificación de la telemetría (JSON por defecto).
   Esp32OTA(const char* mqttHost, int mqttPort,
            const char* mqttUser, const char* mqttPass,
-           const char* deviceName, const char* firmwareVersion);
+           const char* deviceName, const char* firmwareVersion,
+           TelemetryEncoding encoding = TELEMETRY_JSON);
   // Permite configurar la ubicación geográfica
   void setLocation(float lat, float lon);
   // Inicializa la conexión WiFi y MQTT, y obtiene la MAC.
   void begin();
 
-  // Llamar en el loop() principal para gestionar MQTT y enviar heartbeats.
-  void loop();
+  // Llamar en el loop() principal: gestiona MQTT y la OTA y ejecuta las tareas vencidas.
+  // Devuelve los ms que se puede dormir hasta que vuelva a haber trabajo (0 durante una
+  // OTA; sin tarea de red, como mucho NET_TASK_IDLE_MS para no demorar los comandos).
+  //   void loop() { delay(esp.loop()); }
+  unsigned long loop();
+
+  // Tareas de la aplicación (ver Scheduler.h): cada periodMs o una sola vez tras delayMs.
+  // Corren dentro de loop(), nunca en la tarea de red. Devuelven el identificador para
+  // scheduler().stop()/start()/remove(), o -1 si ya hay SCHEDULER_JOBS registradas.
+  int8_t every(unsigned long periodMs, SchedulerFn fn, void* ctx = nullptr);
+  int8_t after(unsigned long delayMs, SchedulerFn fn, void* ctx = nullptr);
+  Scheduler& scheduler() { return _jobs; }
 
   // Permite establecer un callback para notificar cuando se inicia una actualización OTA.
   void setOTAUpdateCallback(void (*callback)(const String&));
@@ -33,20 +338,215 @@ public:
   // Envía manualmente un heartbeat.
   void sendHeartbeat();
 
-  // Envía datos de temperatura y humedad por MQTT
+  // Envía datos de temperatura y humedad por MQTT (JSON o CBOR según el constructor)
   void sendSensorData(float temperature, float humidity);
 
-  // Envía datos meteorológicos por POST
+  // Guarda una muestra en el buffer; se envía en lote por TOPIC_MEASUREMENTS.
+  // type y unit deben ser cadenas permanentes (literales o constantes globales).
+  void record(const char* type, float value, const char* unit = nullptr);
+
+  // Umbrales de envío del lote: cantidad de muestras y antigüedad máxima (ms)
+  void setTelemetryBatch(size_t maxSamples, unsigned long maxAgeMs);
+
+  // Envía ya todas las muestras pendientes. Devuelve false si quedaron muestras sin enviar.
+  bool flushTelemetry();
+
+  // Muestras pendientes y muestras perdidas por buffer lleno
+  size_t pendingSamples() const { return _samples.size(); }
+  uint32_t droppedSamples() const { return _samples.dropped(); }
+
+  // Envía datos meteorológicos por POST. Sin red (o si el POST falla) la lectura se guarda
+  // en flash y se reenvía en lotes desde loop() cuando vuelve la conexión. La URL se copia
+  // (hasta WEATHER_URL_MAX bytes): no hace falta que endpointUrl siga vivo después.
   void sendWeatherData(float temperature, float humidity, const char* endpointUrl);
 
+  // Endpoint al que se reenvía la cola offline (para vaciarla tras un reinicio
+  // sin esperar al próximo sendWeatherData). Se copia; con la tarea de red, llamarlo
+  // antes de begin().
+  void setWeatherEndpoint(const char* endpointUrl) { storeWeatherUrl(endpointUrl); }
+
+  // Lecturas meteorológicas guardadas esperando red
+  size_t pendingWeatherData() const { return _offline.size(); }
+
+  // Handshakes y latencias de los POST de sendWeatherData
+  HttpStats getHttpStats() const;
+
+  // Handshakes TLS completos vs reanudados de la conexión MQTT
+  const TlsSessionStats& getMqttTlsStats() const { return wifiClient.stats(); }
+
+  // Tiempo hasta conectado y uso de la unión directa a la última red
+  const WiFiConnectStats& getWiFiStats() const { return _wifiStats; }
+
+  // Métricas internas (duración de loop(), latencia de publicación, reconexiones, heap,
+  // OTA). Se publican en topic cada intervalMs mientras haya MQTT; 0 desactiva el envío
+  // pero se siguen registrando. Llamar antes de begin(); topic debe ser una cadena permanente.
+  void setMetrics(unsigned long intervalMs, const char* topic = TOPIC_METRICS);
+  Metrics& metrics() { return _metrics; }
+
+  // Los mensajes de la biblioteca (LOGI/LOGW/LOGE, ver Log.h) se guardan en un ring y loop()
+  // los pasa al Serial sin bloquear. Con enabled, las líneas WARNING y ERROR también se
+  // publican en lotes por TOPIC_DEBUG (servernode las guarda en debug_logs).
+  void setLogForwarding(bool enabled) { _logForward = enabled; }
+  uint32_t droppedLogForwards() const { return _logForwardDropped; }
+
+  // Grupo de actualización (por ejemplo "catamarca" o "hw-rev2"): también se reciben los
+  // comandos de TOPIC_UPDATE_GROUP<grupo>. Llamar antes de begin(); group debe ser una
+  // cadena permanente. Devuelve false si ya hay MQTT_MAX_UPDATE_GROUPS.
+  bool addUpdateGroup(const char* group);
+
+  // Seguir escuchando el tópico compartido TOPIC_UPDATE (por defecto sí, por compatibilidad)
+  void setLegacyUpdateTopic(bool enabled) { _legacyUpdateTopic = enabled; }
+
+  // Modo con tarea de red (llamar antes de begin()): una tarea de FreeRTOS se queda con
+  // WiFi, MQTT, HTTP y la OTA. sendSensorData(), sendHeartbeat(), los lotes de muestras y
+  // sendWeatherData() solo copian el mensaje a una cola sin locks y vuelven enseguida.
+  // En este modo los callbacks de OTA y de conectividad corren en la tarea de red.
+  // Con la cola llena, las lecturas de sendWeatherData esperan (hasta NET_WEATHER_PENDING)
+  // y loop() las reintenta.
+  void setNetworkTask(bool enabled) { _netThreaded = enabled; }
+  bool isNetworkTaskRunning() const { return _netTask != nullptr; }
+  NetQueueStats getNetQueueStats() const;
+
   // Permite configurar múltiples redes WiFi
   void setWiFiNetworks(const char* ssids[], const char* passwords[], int count);
 
+  // Modo de selección de red (por defecto WIFI_SELECT_RANKED)
+  void setWiFiSelection(WiFiSelection mode) { _wifiSelection = mode; }
+
+  // Estado de la conectividad (DISCONNECTED -> ASSOCIATING -> IP -> MQTT_CONNECTING -> ONLINE).
+  // El callback se llama desde loop() en cada cambio de estado.
+  ConnState getConnState() const { return _conn.state(); }
+  void setConnectivityCallback(void (*callback)(ConnState from, ConnState to));
+
+  // Encola una actualización OTA; se procesa por bloques en cada loop().
+  // Devuelve false si ya hay una actualización en curso.
+  bool requestOTA(const String &url);
+
+  // Encola una actualización delta: el parche se aplica sobre la partición en ejecución.
+  // Se rechaza si baseVersion no coincide con la versión de este firmware.
+  bool requestDeltaOTA(const String &baseVersion, const String &patchUrl);
+
+  // Encola la imagen del manifiesto solo si difiere de la que corre (versión o hash).
+  // Si es la misma se informa "skipped" en TOPIC_STATUS y devuelve false.
+  bool requestManifestOTA(const OtaManifest &manifest, const String &url);
+
+  // Presupuesto por llamada a loop() para la OTA: tiempo máximo (ms) y bytes máximos.
+  void setOTABudget(unsigned long maxMillis, size_t maxBytes);
+
+  // Buffers del pipeline red -> flash: tamaño de cada uno y cantidad (1 = sin tarea).
+  // Solo se aplica a la próxima actualización.
+  void setOTAPipeline(size_t bufferSize, uint8_t depth);
+
+  // Clave pública (PEM, cadena permanente) para verificar la firma de cada imagen. Con
+  // clave, los comandos sin sig= se rechazan sin descargar y una imagen cuya firma no
+  // verifica no llega a marcarse como partición de arranque.
+  bool setOTASigningKey(const char* publicKeyPem) { return _otaVerify.setPublicKey(publicKeyPem); }
+
+  // Consulta del estado de la OTA
+  OTAState getOTAState() const { return _otaState; }
+  bool isOTAInProgress() const { return _otaState == OTA_PENDING || _otaState == OTA_DOWNLOADING; }
+  OTAStatus getOTAStatus() const;
+
+  // Actualización aceptada por el despliegue escalonado que espera su turno en la ventana
+  bool isOTAScheduled() const { return _otaScheduled; }
+
 private:
-  void connectWiFi();
-  void connectMQTT();
+  // Conectividad por eventos
+  void onWiFiEvent(arduino_event_id_t event);
+  static void connStateThunk(ConnState from, ConnState to, void* ctx);
+  void connStateChanged(ConnState from, ConnState to);
+  void connectivityStep();
+  void joinStart();
+  void joinScan();
+  void joinOrdered();
+  void joinRanked(int16_t found);
+  void joinNext();
+  void joinStep(unsigned long now);
+  void wifiConnected(unsigned long startMs, bool fast);
+  bool connectMQTT();
+  void subscribeUpdates();
   void mqttCallback(char* topic, byte* payload, unsigned int length);
-  void doOTA(const String &url);
+  void otaDispatch(OtaCommandKind kind, const String &baseVersion, const String &url,
+                   const OtaManifest &manifest);
+
+  // Telemetría en lotes
+  unsigned long telemetryStep();
+  bool publishBatch();
+  bool mqttReady();
+  bool publishMetrics();
+
+  // Tareas internas de _netJobs
+  static void heartbeatJob(void* ctx);
+  static void metricsJob(void* ctx);
+  static void otaScheduledJob(void* ctx);
+  static void httpIdleJob(void* ctx);
+  static void offlineJob(void* ctx);
+  void netJobsOnline();
+
+  // Log: salida al Serial y reenvío por MQTT
+  unsigned long logStep();
+  static void logForwardThunk(const LogEntry& entry, void* ctx);
+  void logForward(const LogEntry& entry);
+  bool publishLogs();
+
+  // Red: directo desde loop() o desde la tarea de red, según el modo
+  unsigned long networkStep();
+  bool publish(const char* topic, const uint8_t* payload, size_t len);
+  bool mqttPublish(const char* topic, const uint8_t* payload, size_t len);
+  bool startNetworkTask();
+  void netDrain();
+  bool netPushWeather(const QueuedReading& reading, const char* url);
+  void netFlushWeather();
+  static void netTaskThunk(void* arg);
+
+  // Cola offline de sendWeatherData
+  int postWeather(const QueuedReading* readings, size_t count);
+  bool readingAge(const QueuedReading& reading, unsigned long& ageMs);
+  void enqueueWeather(const QueuedReading& reading);
+  void deliverWeather(const QueuedReading& reading);
+  bool storeWeatherUrl(const char* url);
+  void offlineDrain();
+
+  // Sesión HTTP(S) persistente
+  int httpPost(const char* url, const uint8_t* body, size_t len);
+  void httpIdleClose();
+
+  // Motor OTA incremental
+  void otaStart();
+  void otaStep();
+  void otaFinish();
+  // Pipeline de buffers entre loop() (red) y la tarea de escritura (flash)
+  struct OtaBlock {
+    uint8_t* data;
+    size_t len;
+  };
+  bool otaPipelineStart();
+  void otaPipelineStop();
+  bool otaPipelineIdle();
+  OtaBlock* otaAcquireBlock();
+  void otaReleaseBlock(OtaBlock* blk);
+  bool otaSubmitBlock(OtaBlock* blk);
+  bool otaProcessBlock(OtaBlock* blk);
+  const char* otaStageError();
+  static void otaPipelineTask(void* arg);
+
+  void otaRetry(const char* reason);
+  void otaFail(const char* reason, bool keepProgress = false);
+  void otaRecordMetrics();
+  void otaResumePending();
+  void otaRestoreExpected();
+  void otaSaveProgress(size_t committed);
+  bool otaLoadProgress(String &url, size_t &size, String &etag, size_t &committed);
+  void otaClearProgress();
+  bool otaIsRunningImage(const OtaManifest &manifest);
+  void otaReport(const char* result, const char* version, const char* reason = nullptr);
+  void otaSavePendingReport(const esp_partition_t* target);
+  void otaReportPending();
+  bool otaWriteFlash(const uint8_t* data, size_t len);
+  bool otaVerifyResume(size_t committed);
+  static bool otaWriteFlashThunk(void* ctx, const uint8_t* data, size_t len);
+  static bool otaDeltaThunk(void* ctx, const uint8_t* data, size_t len);
+  static bool otaReadBaseThunk(void* ctx, uint32_t offset, uint8_t* buf, size_t len);
   float _latitude = 0.0;
   float _longitude = 0.0;
   const char* _mqttHost;
@@ -55,18 +555,153 @@ private:
   const char* _mqttPass;
   const char* _deviceName;
   const char* _firmwareVersion;
+  TelemetryEncoding _encoding;
 
   String deviceMac;
-  WiFiClientSecure wifiClient;
+  uint8_t _macBytes[6];
+  const char* _updateGroups[MQTT_MAX_UPDATE_GROUPS];
+  size_t _updateGroupCount;
+  bool _legacyUpdateTopic;
+  TlsSessionClient wifiClient;  // TLS del broker MQTT con reanudación de sesión
   PubSubClient mqttClient;
 
-  unsigned long lastHeartbeat;
   void (*otaUpdateCallback)(const String&);  // Callback opcional para notificar actualizaciones OTA
 
   // Redes WiFi
   const char** _ssids;
   const char** _passwords;
   int _wifiCount;
+  WiFiFastConnect _wifiFast;
+  WiFiConnectStats _wifiStats;
+  WiFiSelection _wifiSelection;
+  WiFiNetStats _wifiHistory[WIFI_MAX_NETWORKS];  // intentos/éxitos por red (en RAM)
+
+  // Máquina de estados de la conectividad e intento de conexión en curso
+  enum JoinPhase { JOIN_FAST, JOIN_SCAN, JOIN_CANDIDATE };
+  ConnectivityFsm _conn;
+  void (*_connCallback)(ConnState, ConnState);
+  JoinPhase _joinPhase;
+  WiFiCandidate _joinList[WIFI_MAX_NETWORKS];
+  size_t _joinCount;
+  size_t _joinNext;
+  int _joinIndex;               // red del intento actual (-1 = ninguna)
+  bool _joinFast;               // el intento actual es la unión directa
+  unsigned long _joinStart;     // inicio del intento completo (para las estadísticas)
+  unsigned long _joinDeadline;  // plazo de la fase actual
+  unsigned long _wifiRetryAt;
+  unsigned long _mqttRetryAt;
+
+  // Estado de la OTA en curso
+  OTAState _otaState;
+  String _otaUrl;
+  // Despliegue escalonado: comando aceptado esperando su momento dentro de la ventana
+  bool _otaScheduled;
+  OtaCommandKind _otaScheduledKind;
+  String _otaScheduledUrl;
+  String _otaScheduledBase;
+  OtaManifest _otaScheduledManifest;
+  // Manifiesto de la actualización en curso y hash de la imagen que corre (se calcula una vez)
+  bool _otaHasManifest;
+  OtaManifest _otaManifest;
+  uint8_t _runningSha[32];
+  int8_t _runningShaState;  // 0 sin calcular, 1 válido, -1 no se pudo leer
+  HTTPClient _otaHttp;
+  WiFiClient* _otaStream;
+  OtaInflate _otaInflate;
+  OtaDelta _otaDelta;
+  OtaFlashWriter _otaFlash;
+  OtaVerify _otaVerify;         // SHA-256 (y firma) de los bytes que se escriben en flash
+  uint8_t _otaSignature[OTA_SIGNATURE_MAX];
+  size_t _otaSignatureLen;
+  unsigned long _otaVerifyMicros;
+  bool _otaIsDelta;
+  bool _otaResumable;
+  size_t _otaResumeFrom;
+  String _otaEtag;
+  uint8_t _otaRetries;
+  unsigned long _otaRetryAt;
+  String _otaContentEncoding;
+  size_t _otaReceived;
+  size_t _otaWritten;
+  size_t _otaTotal;
+  unsigned long _otaStartMs;
+  unsigned long _otaLastDataMs;
+  unsigned long _otaBudgetMs;
+  size_t _otaBudgetBytes;
+
+  // Pipeline
+  size_t _otaPipeBufSize;
+  uint8_t _otaPipeDepth;
+  OtaBlock _otaBlocks[OTA_PIPELINE_MAX_DEPTH];
+  uint8_t* _otaPipeMem;
+  QueueHandle_t _otaFreeQ;
+  QueueHandle_t _otaFullQ;
+  SemaphoreHandle_t _otaPipeDone;
+  bool _otaPipeTask;
+  const char* volatile _otaPipeError;
+  uint32_t _otaPipeStalls;
+  unsigned long _otaFlashMicros;
+
+  // Lote de telemetría (el buffer también arma los lotes de log: los dos, desde loop())
+  SampleRing _samples;
+  size_t _batchSamples;
+  unsigned long _batchMaxAge;
+  char _batchBuf[TELEMETRY_BATCH_BYTES];
+
+  // Líneas WARNING/ERROR esperando su envío por TOPIC_DEBUG (la más vieja primero)
+  bool _logForward;
+  LogEntry _logPending[LOG_FORWARD_BATCH];
+  size_t _logPendingCount;
+  uint32_t _logForwardDropped;
+
+  // Tareas temporizadas: las de la aplicación corren en loop() y las internas en el contexto
+  // de la red (loop() o la tarea de red). Cada planificador lo usa un solo contexto.
+  Scheduler _jobs;
+  Scheduler _netJobs;
+  int8_t _heartbeatJob;
+  int8_t _metricsJob;
+  int8_t _otaScheduledJob;  // turno del despliegue escalonado
+  int8_t _httpIdleJob;      // cierre de la sesión HTTP inactiva
+  int8_t _offlineJob;       // próximo lote de la cola offline
+
+  // Métricas internas (las instantáneas se arman en el contexto de la red)
+  Metrics _metrics;
+  const char* _metricsTopic;
+  unsigned long _metricsInterval;
+  unsigned long _metricsLast;
+  char _metricsBuf[METRICS_BYTES];
+
+  // Cola offline
+  OfflineQueue _offline;
+  char _weatherUrl[WEATHER_URL_MAX + 1];  // de la tarea de red, si la hay
+  uint32_t _bootId;
+
+  // Sesión HTTP(S) persistente (una conexión abierta por vez, al último host usado)
+  HTTPClient _http;
+  WiFiClientSecure _httpTls;
+  WiFiClient _httpPlain;
+  char _httpOrigin[96];
+  HttpStats _httpStats;
+  unsigned long _httpNewTotalMs;
+  unsigned long _httpReusedTotalMs;
+
+  // Tarea de red y cola de publicaciones (productor: aplicación, consumidor: tarea)
+  bool _netThreaded;
+  TaskHandle_t _netTask;
+  SpscRing _netQueue;
+  uint8_t* _netQueueMem;
+  std::atomic<bool> _netOnline;  // CONN_ONLINE, legible desde la aplicación
+  uint32_t _netEnqueued;         // solo lo escribe la aplicación
+  uint32_t _netSent;             // estos tres, solo la tarea de red
+  uint32_t _netFailed;
+  uint32_t _netOffline;
+
+  // Lecturas que no entraron en la cola, en orden (solo la aplicación); se reintenta en loop()
+  QueuedReading _netWeatherPending[NET_WEATHER_PENDING];
+  size_t _netWeatherPendingCount;
+  char _netWeatherUrl[WEATHER_URL_MAX + 1];  // la última URL recibida para esas lecturas
+  uint32_t _netWeatherDeferred;
+  uint32_t _netWeatherDropped;
 };
 
 #endif
@@ -9,54 +9,83 @@ DHT dht(DHTPIN, DHTTYPE);
 const char* ssids[] = {"Auditorio Nodo", "PB02", "PB202"};
 const char* passwords[] = {"auditorio.nodo", "12345678", "12345678"};
 
+// Con TELEMETRY_CBOR como último argumento la telemetría viaja en binario por esp32/sensor/cbor
 Esp32OTA esp(
   "ad11f935a9c74146a4d2e647921bf024.s1.eu.hivemq.cloud", 1883,
   "Augustodelcampo97", "Augustodelcampo97",
   "Esp32_2", "v1.0.1"
 );
 
-// Variables para controlar el envío de datos
-unsigned long lastHttpSent = 0;
+// Endpoint de la web de estaciones
+const char* WEATHER_URL = "https://miniestaciones.vercel.app/api/esp32";
+
+// Intervalos de las tareas (las ejecuta esp.loop(), ver Scheduler.h)
+const unsigned long SENSOR_INTERVAL = 10000;        // 10 segundos
 const unsigned long HTTP_INTERVAL = 40 * 60 * 1000; // 40 minutos en milisegundos (solo HTTP)
 
+// Última lectura válida del sensor (la que se envía por HTTP)
+float lastTemp = NAN;
+float lastHum = NAN;
+
+// Se llama desde esp.loop() en cada cambio de la conectividad
+void onConnectivity(ConnState from, ConnState to) {
+  if (to == CONN_ONLINE) LOGI("🌐 En línea (WiFi + MQTT)");
+  else if (to == CONN_DISCONNECTED) LOGW("📴 Sin WiFi, las lecturas HTTP quedan en cola");
+}
+
+// Todas las lecturas se guardan y viajan en lote por MQTT (esp32/measurements)
+void readSensors(void*) {
+  float temp = dht.readTemperature();
+  float hum  = dht.readHumidity();
+  if (isnan(temp) || isnan(hum)) {
+    LOGE("❌ Error sensor DHT22");
+    return;
+  }
+  lastTemp = temp;
+  lastHum = hum;
+  esp.record("temperature", temp, "C");
+  esp.record("humidity", hum, "%");
+}
+
+// Envío por HTTP (funciona independientemente de MQTT)
+void sendWeather(void*) {
+  if (isnan(lastTemp) || isnan(lastHum)) return;
+  LOGI("📊 T: %.1f°C, H: %.1f%% - Enviando HTTP...", lastTemp, lastHum);
+  esp.sendWeatherData(lastTemp, lastHum, WEATHER_URL);
+  HttpStats http = esp.getHttpStats();
+  LOGI("✅ HTTP enviado! (%u handshakes, %u reutilizadas, último %lu ms)",
+       (unsigned)http.handshakes, (unsigned)http.reused, http.lastMs);
+}
+
 void setup() {
   Serial.begin(115200);
-  Serial.println("🚀 Iniciando ESP32 Meteo Station...");
+  LOGI("🚀 Iniciando ESP32 Meteo Station...");
   
   dht.begin();
   esp.setWiFiNetworks(ssids, passwords, 3);
-  esp.begin();
+  // Para reenviar lecturas que quedaron en flash antes del reinicio
+  esp.setWeatherEndpoint(WEATHER_URL);
+  esp.setConnectivityCallback(onConnectivity);
+  // Comandos OTA por grupo (esp32/update/group/<grupo>), además de los propios y los de toda la flota
+  esp.addUpdateGroup("catamarca");
+  // Métricas internas (loop, publicaciones, reconexiones, heap) en esp32/metrics cada 5 minutos
+  esp.setMetrics(5 * 60 * 1000);
+  // Los avisos y errores (LOGW/LOGE) también llegan al servidor por esp32/debug
+  esp.setLogForwarding(true);
+  // Opcional: WiFi/MQTT/OTA en su propia tarea para que un envío lento no frene la lectura
+  // de sensores (los callbacks pasan a correr en esa tarea)
+  // esp.setNetworkTask(true);
+  esp.begin();  // no espera la conexión: avanza desde esp.loop()
     // 👉 Establecer ubicación geográfica
   esp.setLocation(-28.4762, -65.7863); // Catamarca, Argentina
-  lastHttpSent = millis(); // Inicializar el timestamp
+  esp.every(SENSOR_INTERVAL, readSensors);
+  esp.every(HTTP_INTERVAL, sendWeather);
   
-  Serial.println("✅ Setup completado - HTTP cada minuto, MQTT solo para OTA");
+  LOGI("✅ Setup completado - HTTP cada minuto, MQTT solo para OTA");
 }
 
 void loop() {
-  // 1. Leer sensores (prioridad máxima)
-  float temp = dht.readTemperature();
-  float hum  = dht.readHumidity();
-
-  if (!isnan(temp) && !isnan(hum)) {
-    // 2. Envío por HTTP (funciona independientemente de MQTT)
-    if (millis() - lastHttpSent >= HTTP_INTERVAL) {
-      Serial.printf("📊 T: %.1f°C, H: %.1f%% - Enviando HTTP...\n", temp, hum);
-      esp.sendWeatherData(temp, hum, "https://miniestaciones.vercel.app/api/esp32");
-      lastHttpSent = millis();
-      Serial.println("✅ HTTP enviado!");
-    }
-  } else {
-    Serial.println("❌ Error sensor DHT22");
-  }
-
-  // 3. MQTT solo para OTA (ahora no-bloqueante)
-  static unsigned long lastMqttCheck = 0;
-  if (millis() - lastMqttCheck > 60000) { // Cada minuto
-    Serial.println("🔍 Verificando MQTT para OTA...");
-    esp.loop(); // Ahora es no-bloqueante gracias a los cambios en Esp32OTA.cpp
-    lastMqttCheck = millis();
-  }
-  
-  delay(10000); // 10 segundos entre loops
-}
\ No newline at end of file
+  // MQTT/OTA y tareas: esp.loop() no bloquea y devuelve cuánto se puede dormir hasta que
+  // haya trabajo (0 durante una OTA, para no frenar la descarga)
+  delay(esp.loop());
+}
@@ -0,0 +1,3 @@
+#include "Log.h"
+
+LogRing logRing;
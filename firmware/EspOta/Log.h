@@ -0,0 +1,207 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+// Niveles de log. Los mensajes por debajo de LOG_COMPILE_LEVEL no se compilan: ni el
+// formato ni los argumentos llegan al binario.
+#define LOG_LVL_DEBUG 0
+#define LOG_LVL_INFO  1
+#define LOG_LVL_WARN  2
+#define LOG_LVL_ERROR 3
+#define LOG_LVL_NONE  4
+
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LVL_INFO
+#endif
+// Entradas del ring (potencia de 2) y largo máximo de cada línea (se trunca)
+#ifndef LOG_RING_ENTRIES
+#define LOG_RING_ENTRIES 32
+#endif
+#ifndef LOG_LINE_MAX
+#define LOG_LINE_MAX 120
+#endif
+
+struct LogEntry {
+  uint32_t at;  // millis() al registrarla
+  uint8_t level;
+  char text[LOG_LINE_MAX];
+};
+
+// Ring de líneas de log sin locks para varios productores (loop(), la tarea de red...) y un
+// consumidor que las pasa al UART sin bloquear. Registrar una línea es formatearla en una
+// celda libre: nunca se espera al UART. Con el ring lleno la línea se descarta y se cuenta.
+//
+// Cada celda tiene un número de secuencia (cola acotada de Vyukov): el productor reserva la
+// posición con un CAS, escribe la celda y la publica; el consumidor la libera al terminar.
+//
+//   LOGW("Cola llena (%u)", n);          // productores, desde cualquier tarea
+//   logRing.drain(Serial, onEntry, ctx);  // consumidor, desde loop()
+class LogRing {
+public:
+  LogRing() : _enqueue(0), _dequeue(0), _sent(0), _dropped(0), _reportedDrops(0), _draining(false) {
+    static_assert((LOG_RING_ENTRIES & (LOG_RING_ENTRIES - 1)) == 0, "LOG_RING_ENTRIES debe ser potencia de 2");
+    for (uint32_t i = 0; i < LOG_RING_ENTRIES; i++) _cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  // Formatea y encola una línea (sin '\n'). Devuelve false si el ring estaba lleno.
+  bool write(uint8_t level, uint32_t now, const char* fmt, ...) __attribute__((format(printf, 4, 5))) {
+    va_list args;
+    va_start(args, fmt);
+    bool ok = vwrite(level, now, fmt, args);
+    va_end(args);
+    return ok;
+  }
+
+  bool vwrite(uint8_t level, uint32_t now, const char* fmt, va_list args) {
+    uint32_t pos = _enqueue.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+      cell = &_cells[pos & (LOG_RING_ENTRIES - 1)];
+      uint32_t seq = cell->seq.load(std::memory_order_acquire);
+      int32_t diff = (int32_t)(seq - pos);
+      if (diff == 0) {
+        if (_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      } else {
+        pos = _enqueue.load(std::memory_order_relaxed);
+      }
+    }
+    cell->entry.at = now;
+    cell->entry.level = level;
+    vsnprintf(cell->entry.text, sizeof(cell->entry.text), fmt, args);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumidor: escribe en out solo lo que acepta sin bloquear (availableForWrite()); una
+  // línea puede quedar a medias y se sigue en la próxima llamada. Cada línea completa se
+  // pasa a onEntry. Si ya hay otro consumidor en curso, no hace nada. Devuelve los bytes escritos.
+  template <typename Out>
+  size_t drain(Out& out, void (*onEntry)(const LogEntry&, void*) = nullptr, void* ctx = nullptr) {
+    if (_draining.exchange(true, std::memory_order_acquire)) return 0;
+    size_t total = 0;
+    int room = out.availableForWrite();
+    while (room > 0) {
+      if (reportDrops(out, room, total)) continue;
+      Cell* cell = &_cells[_dequeue & (LOG_RING_ENTRIES - 1)];
+      if (cell->seq.load(std::memory_order_acquire) != _dequeue + 1) break;
+      size_t len = strlen(cell->entry.text);
+      if (_sent < len) {
+        size_t n = len - _sent < (size_t)room ? len - _sent : (size_t)room;
+        out.write((const uint8_t*)cell->entry.text + _sent, n);
+        _sent += n;
+        room -= (int)n;
+        total += n;
+        if (room == 0) break;
+      }
+      out.write((uint8_t)'\n');
+      room--;
+      total++;
+      if (onEntry) onEntry(cell->entry, ctx);
+      release(cell);
+    }
+    _draining.store(false, std::memory_order_release);
+    return total;
+  }
+
+  // Escribe todo lo pendiente aunque tenga que esperar al UART (antes de reiniciar)
+  template <typename Out>
+  void flush(Out& out, void (*onEntry)(const LogEntry&, void*) = nullptr, void* ctx = nullptr) {
+    if (_draining.exchange(true, std::memory_order_acquire)) return;
+    int room = 1 << 30;
+    size_t total = 0;
+    reportDrops(out, room, total);
+    Cell* cell;
+    while ((cell = &_cells[_dequeue & (LOG_RING_ENTRIES - 1)])->seq.load(std::memory_order_acquire) == _dequeue + 1) {
+      out.write((const uint8_t*)cell->entry.text + _sent, strlen(cell->entry.text) - _sent);
+      out.write((uint8_t)'\n');
+      if (onEntry) onEntry(cell->entry, ctx);
+      release(cell);
+    }
+    out.flush();
+    _draining.store(false, std::memory_order_release);
+  }
+
+  uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+  // Quedan líneas (o avisos de pérdida) sin escribir. Solo desde el consumidor.
+  bool pending() const {
+    return _enqueue.load(std::memory_order_acquire) != _dequeue || dropped() != _reportedDrops;
+  }
+  static size_t capacity() { return LOG_RING_ENTRIES; }
+
+  // Los mismos nombres que el enum LogLevel de servernode
+  static const char* levelName(uint8_t level) {
+    static const char* const names[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+    return level < LOG_LVL_NONE ? names[level] : "?";
+  }
+
+private:
+  struct Cell {
+    std::atomic<uint32_t> seq;
+    LogEntry entry;
+  };
+
+  void release(Cell* cell) {
+    _sent = 0;
+    cell->seq.store(_dequeue + LOG_RING_ENTRIES, std::memory_order_release);
+    _dequeue++;
+  }
+
+  // Línea con las entradas perdidas desde el último aviso (solo al empezar una línea)
+  template <typename Out>
+  bool reportDrops(Out& out, int& room, size_t& total) {
+    if (_sent != 0) return false;
+    uint32_t drops = dropped() - _reportedDrops;
+    if (drops == 0) return false;
+    char line[48];
+    int n = snprintf(line, sizeof(line), "⚠️ %u líneas de log perdidas\n", (unsigned)drops);
+    if (n < 0 || n > room) return false;
+    out.write((const uint8_t*)line, n);
+    room -= n;
+    total += n;
+    _reportedDrops += drops;
+    return true;
+  }
+
+  Cell _cells[LOG_RING_ENTRIES];
+  std::atomic<uint32_t> _enqueue;
+  uint32_t _dequeue;  // estos tres, solo el consumidor
+  size_t _sent;       // bytes ya escritos de la línea actual
+  std::atomic<uint32_t> _dropped;
+  uint32_t _reportedDrops;
+  std::atomic<bool> _draining;
+};
+
+// Ring único: las líneas de todos los módulos comparten el mismo orden (ver Log.cpp)
+extern LogRing logRing;
+
+#if LOG_COMPILE_LEVEL <= LOG_LVL_DEBUG
+#define LOGD(...) logRing.write(LOG_LVL_DEBUG, millis(), __VA_ARGS__)
+#else
+#define LOGD(...) do {} while (0)
+#endif
+#if LOG_COMPILE_LEVEL <= LOG_LVL_INFO
+#define LOGI(...) logRing.write(LOG_LVL_INFO, millis(), __VA_ARGS__)
+#else
+#define LOGI(...) do {} while (0)
+#endif
+#if LOG_COMPILE_LEVEL <= LOG_LVL_WARN
+#define LOGW(...) logRing.write(LOG_LVL_WARN, millis(), __VA_ARGS__)
+#else
+#define LOGW(...) do {} while (0)
+#endif
+#if LOG_COMPILE_LEVEL <= LOG_LVL_ERROR
+#define LOGE(...) logRing.write(LOG_LVL_ERROR, millis(), __VA_ARGS__)
+#else
+#define LOGE(...) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include "JsonWriter.h"
+
+// Cubetas por histograma: la 0 cuenta los ceros y la i, los valores en [2^(i-1), 2^i).
+// La última junta todo lo que no entra en las anteriores (con 20, desde 262144).
+#ifndef METRICS_HIST_BUCKETS
+#define METRICS_HIST_BUCKETS 20
+#endif
+
+// Las métricas son fijas y se indexan por enum: registrar una es sumar a un arreglo,
+// sin nombres, búsquedas ni memoria dinámica en el camino caliente.
+enum MetricCounter {
+  METRIC_WIFI_CONNECTS,  // uniones a una red
+  METRIC_WIFI_LOST,      // caídas del WiFi
+  METRIC_MQTT_CONNECTS,  // conexiones al broker
+  METRIC_MQTT_FAILED,    // intentos de conexión al broker fallidos
+  METRIC_MQTT_LOST,      // caídas de MQTT con el WiFi arriba
+  METRIC_PUBLISH_FAILED, // mqttClient.publish() rechazados
+  METRIC_OTA_BYTES,      // bytes de OTA recibidos por la red
+  METRIC_COUNTERS
+};
+
+enum MetricGauge {
+  METRIC_FREE_HEAP,      // ESP.getFreeHeap() al armar la instantánea
+  METRIC_MIN_FREE_HEAP,  // mínimo histórico del heap libre
+  METRIC_MAX_ALLOC_HEAP, // bloque libre más grande (ESP.getMaxAllocHeap())
+  METRIC_RSSI,
+  METRIC_OTA_BPS,        // red y flash de la última OTA (bytes/s)
+  METRIC_OTA_FLASH_BPS,
+  METRIC_GAUGES
+};
+
+enum MetricHistogram {
+  METRIC_LOOP_US,        // duración de Esp32OTA::loop()
+  METRIC_PUBLISH_US,     // duración de mqttClient.publish()
+  METRIC_WIFI_CONNECT_MS,
+  METRIC_MQTT_CONNECT_MS,
+  METRIC_HISTOGRAMS
+};
+
+// Histograma de cubetas fijas. Un solo hilo escribe y otro puede leerlo y reiniciarlo:
+// los campos son atómicos (relaxed), así que una muestra concurrente con take() puede
+// quedar contada en una ventana y su máximo en la siguiente, sin perderse.
+class Histogram {
+public:
+  Histogram() { reset(); }
+
+  void add(uint32_t v) {
+    _buckets[bucket(v)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    if (v > _max.load(std::memory_order_relaxed)) _max.store(v, std::memory_order_relaxed);
+  }
+
+  // Copia la ventana actual en buckets/count/max y la reinicia
+  void take(uint32_t* buckets, uint32_t& count, uint32_t& max) {
+    count = _count.exchange(0, std::memory_order_relaxed);
+    max = _max.exchange(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < METRICS_HIST_BUCKETS; i++) {
+      buckets[i] = _buckets[i].exchange(0, std::memory_order_relaxed);
+    }
+  }
+
+  void reset() {
+    uint32_t scratch[METRICS_HIST_BUCKETS], count, max;
+    take(scratch, count, max);
+  }
+
+  static uint8_t bucket(uint32_t v) {
+    uint8_t b = v ? 32 - __builtin_clz(v) : 0;
+    return b < METRICS_HIST_BUCKETS ? b : METRICS_HIST_BUCKETS - 1;
+  }
+
+  // Cota superior de la cubeta b (la última no tiene: se usa el máximo observado)
+  static uint32_t bucketLimit(uint8_t b) { return b == 0 ? 0 : (1UL << b) - 1; }
+
+  // Percentil aproximado (cota superior de la cubeta que lo contiene, acotada por max)
+  static uint32_t percentile(const uint32_t* buckets, uint32_t count, uint32_t max, float p) {
+    if (count == 0) return 0;
+    uint32_t rank = (uint32_t)(p * (count - 1)) + 1;
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < METRICS_HIST_BUCKETS; b++) {
+      seen += buckets[b];
+      if (seen >= rank) {
+        if (b == METRICS_HIST_BUCKETS - 1) return max;
+        uint32_t limit = bucketLimit(b);
+        return limit < max ? limit : max;
+      }
+    }
+    return max;
+  }
+
+private:
+  std::atomic<uint32_t> _buckets[METRICS_HIST_BUCKETS];
+  std::atomic<uint32_t> _count;
+  std::atomic<uint32_t> _max;
+};
+
+// Registro de contadores (acumulados desde el arranque), indicadores (último valor) e
+// histogramas (por ventana: cada instantánea los reinicia). Cuesta unos pocos enteros
+// atómicos por evento; el trabajo de serializar se hace solo al publicar.
+class Metrics {
+public:
+  Metrics() {
+    for (size_t i = 0; i < METRIC_COUNTERS; i++) _counters[i].store(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < METRIC_GAUGES; i++) _gauges[i].store(0, std::memory_order_relaxed);
+  }
+
+  void count(MetricCounter c, uint32_t n = 1) { _counters[c].fetch_add(n, std::memory_order_relaxed); }
+  void set(MetricGauge g, int32_t v) { _gauges[g].store(v, std::memory_order_relaxed); }
+  void observe(MetricHistogram h, uint32_t v) { _histograms[h].add(v); }
+
+  uint32_t counter(MetricCounter c) const { return _counters[c].load(std::memory_order_relaxed); }
+  int32_t gauge(MetricGauge g) const { return _gauges[g].load(std::memory_order_relaxed); }
+
+  // Escribe "counters", "gauges" y "histograms" dentro de un objeto ya abierto y
+  // reinicia los histogramas. Cada histograma lleva n, max, p50, p99 y las cubetas
+  // (sin los ceros del final).
+  void write(JsonWriter& msg) {
+    msg.beginObject("counters");
+    for (size_t i = 0; i < METRIC_COUNTERS; i++) {
+      msg.field(counterName((MetricCounter)i), (unsigned long)counter((MetricCounter)i));
+    }
+    msg.endObject().beginObject("gauges");
+    for (size_t i = 0; i < METRIC_GAUGES; i++) {
+      msg.field(gaugeName((MetricGauge)i), (long)gauge((MetricGauge)i));
+    }
+    msg.endObject().beginObject("histograms");
+    for (size_t i = 0; i < METRIC_HISTOGRAMS; i++) {
+      uint32_t buckets[METRICS_HIST_BUCKETS], n, max;
+      _histograms[i].take(buckets, n, max);
+      size_t used = METRICS_HIST_BUCKETS;
+      while (used > 0 && buckets[used - 1] == 0) used--;
+      msg.beginObject(histogramName((MetricHistogram)i))
+         .field("n", (unsigned long)n)
+         .field("max", (unsigned long)max)
+         .field("p50", (unsigned long)Histogram::percentile(buckets, n, max, 0.5f))
+         .field("p99", (unsigned long)Histogram::percentile(buckets, n, max, 0.99f))
+         .beginArray("b");
+      for (size_t b = 0; b < used; b++) msg.value((unsigned long)buckets[b]);
+      msg.endArray().endObject();
+    }
+    msg.endObject();
+  }
+
+  // Claves de la instantánea (servernode las guarda con los mismos nombres)
+  static const char* counterName(MetricCounter c) {
+    static const char* const names[METRIC_COUNTERS] = {
+      "wifiConnects", "wifiLost", "mqttConnects", "mqttFailed", "mqttLost", "publishFailed", "otaBytes"
+    };
+    return names[c];
+  }
+  static const char* gaugeName(MetricGauge g) {
+    static const char* const names[METRIC_GAUGES] = {
+      "freeHeap", "minFreeHeap", "maxAllocHeap", "rssi", "otaBps", "otaFlashBps"
+    };
+    return names[g];
+  }
+  static const char* histogramName(MetricHistogram h) {
+    static const char* const names[METRIC_HISTOGRAMS] = {
+      "loopUs", "publishUs", "wifiConnectMs", "mqttConnectMs"
+    };
+    return names[h];
+  }
+
+private:
+  std::atomic<uint32_t> _counters[METRIC_COUNTERS];
+  std::atomic<int32_t> _gauges[METRIC_GAUGES];
+  Histogram _histograms[METRIC_HISTOGRAMS];
+};
+
+#endif
@@ -0,0 +1,102 @@
+#include "OfflineQueue.h"
+#include "Log.h"
+
+#define OFFLINE_QUEUE_MAGIC 0x3151464FUL  // "OFQ1"
+
+OfflineQueue::OfflineQueue()
+  : _fs(nullptr), _path(nullptr), _capacity(0), _head(0), _count(0), _evicted(0), _ready(false)
+{
+}
+
+bool OfflineQueue::begin(fs::FS& fs, const char* path, uint32_t capacity) {
+  end();
+  _fs = &fs;
+  _path = path;
+  _capacity = capacity > 0 ? capacity : 1;
+  _evicted = 0;
+
+  if (_fs->exists(_path)) {
+    _file = _fs->open(_path, "r+");
+    Header h;
+    if (_file && _file.read((uint8_t*)&h, sizeof(h)) == sizeof(h) &&
+        h.magic == OFFLINE_QUEUE_MAGIC && h.recordSize == sizeof(QueuedReading) &&
+        h.capacity == _capacity && h.head < _capacity && h.count <= _capacity &&
+        _file.size() >= slotOffset(_capacity)) {
+      _head = h.head;
+      _count = h.count;
+      _ready = true;
+      return true;
+    }
+    if (_file) _file.close();
+    LOGW("⚠️ Cola offline con formato distinto, se crea de nuevo");
+  }
+  _ready = create();
+  return _ready;
+}
+
+void OfflineQueue::end() {
+  if (_file) _file.close();
+  _ready = false;
+}
+
+// Crea el archivo con todas las ranuras reservadas: después solo se sobrescribe
+bool OfflineQueue::create() {
+  _head = 0;
+  _count = 0;
+  _file = _fs->open(_path, FILE_WRITE);
+  if (!_file) return false;
+
+  Header h = {OFFLINE_QUEUE_MAGIC, sizeof(QueuedReading), _capacity, 0, 0};
+  if (_file.write((const uint8_t*)&h, sizeof(h)) != sizeof(h)) return false;
+  QueuedReading empty = {};
+  for (uint32_t i = 0; i < _capacity; i++) {
+    if (_file.write((const uint8_t*)&empty, sizeof(empty)) != sizeof(empty)) return false;
+  }
+  _file.close();
+
+  // Reabrir en lectura/escritura para poder sobrescribir ranuras
+  _file = _fs->open(_path, "r+");
+  return (bool)_file;
+}
+
+bool OfflineQueue::writeHeader() {
+  Header h = {OFFLINE_QUEUE_MAGIC, sizeof(QueuedReading), _capacity, _head, _count};
+  if (!_file.seek(0, fs::SeekSet)) return false;
+  if (_file.write((const uint8_t*)&h, sizeof(h)) != sizeof(h)) return false;
+  _file.flush();
+  return true;
+}
+
+bool OfflineQueue::push(const QueuedReading& reading) {
+  if (!_ready) return false;
+
+  if (_count == _capacity) {
+    // Llena: se descarta la más vieja
+    _head = (_head + 1) % _capacity;
+    _count--;
+    _evicted++;
+  }
+  uint32_t slot = (_head + _count) % _capacity;
+  if (!_file.seek(slotOffset(slot), fs::SeekSet) ||
+      _file.write((const uint8_t*)&reading, sizeof(reading)) != sizeof(reading)) {
+    return false;
+  }
+  _count++;
+  return writeHeader();
+}
+
+bool OfflineQueue::peek(uint32_t i, QueuedReading& out) {
+  if (!_ready || i >= _count) return false;
+  uint32_t slot = (_head + i) % _capacity;
+  return _file.seek(slotOffset(slot), fs::SeekSet) &&
+         _file.read((uint8_t*)&out, sizeof(out)) == sizeof(out);
+}
+
+bool OfflineQueue::pop(uint32_t n) {
+  if (!_ready) return false;
+  if (n > _count) n = _count;
+  _head = (_head + n) % _capacity;
+  _count -= n;
+  if (_count == 0) _head = 0;
+  return writeHeader();
+}
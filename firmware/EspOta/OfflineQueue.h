@@ -0,0 +1,74 @@
+#ifndef OFFLINE_QUEUE_H
+#define OFFLINE_QUEUE_H
+
+#include <FS.h>
+
+// Cantidad máxima de lecturas guardadas (512 lecturas cada 40 min = ~14 días)
+#ifndef OFFLINE_QUEUE_CAPACITY
+#define OFFLINE_QUEUE_CAPACITY 512
+#endif
+
+// Lectura meteorológica guardada mientras no hay red
+struct QueuedReading {
+  float temperature;
+  float humidity;
+  uint32_t epoch;       // hora UNIX de la lectura (0 si todavía no había hora por SNTP)
+  uint32_t capturedMs;  // millis() al tomar la lectura
+  uint32_t bootId;      // arranque en que se tomó: capturedMs solo vale en ese mismo arranque
+};
+
+// Cola persistente en flash (LittleFS) de capacidad fija.
+//
+// El archivo tiene una cabecera y `capacity` ranuras de tamaño fijo usadas como
+// buffer circular: agregar escribe una ranura y la cabecera, sin reescribir el
+// resto ni compactar. Si se llena, la lectura nueva reemplaza a la más vieja.
+// Si se corta la energía entre las dos escrituras se pierde como mucho la última
+// lectura, nunca las anteriores.
+class OfflineQueue {
+public:
+  OfflineQueue();
+
+  // Abre (o crea) la cola en `path`. Si el archivo no coincide con el formato o
+  // la capacidad, se vuelve a crear vacío.
+  bool begin(fs::FS& fs, const char* path, uint32_t capacity = OFFLINE_QUEUE_CAPACITY);
+  void end();
+
+  // Agrega al final; devuelve false solo si falló la escritura
+  bool push(const QueuedReading& reading);
+
+  // Lee la lectura i (0 = la más vieja) sin sacarla
+  bool peek(uint32_t i, QueuedReading& out);
+
+  // Saca las n lecturas más viejas (ya enviadas)
+  bool pop(uint32_t n);
+
+  bool ready() const { return _ready; }
+  uint32_t size() const { return _count; }
+  bool empty() const { return _count == 0; }
+  uint32_t capacity() const { return _capacity; }
+  uint32_t evicted() const { return _evicted; }  // descartadas por cola llena desde begin()
+
+private:
+  struct Header {
+    uint32_t magic;
+    uint32_t recordSize;
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t count;
+  };
+
+  bool create();
+  bool writeHeader();
+  size_t slotOffset(uint32_t slot) const { return sizeof(Header) + (size_t)slot * sizeof(QueuedReading); }
+
+  fs::FS* _fs;
+  const char* _path;
+  fs::File _file;
+  uint32_t _capacity;
+  uint32_t _head;
+  uint32_t _count;
+  uint32_t _evicted;
+  bool _ready;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef OTA_COMMAND_H
+#define OTA_COMMAND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Firma DER más larga aceptada en la opción sig= (la misma cota que OtaVerify)
+#ifndef OTA_SIGNATURE_MAX
+#define OTA_SIGNATURE_MAX 104
+#endif
+
+// Vista no propietaria de un tramo del payload MQTT (no termina en '\0')
+struct CmdView {
+  const char* data;
+  size_t len;
+
+  bool equals(const char* s) const {
+    size_t n = strlen(s);
+    return n == len && memcmp(data, s, n) == 0;
+  }
+  bool startsWith(const char* s) const {
+    size_t n = strlen(s);
+    return n <= len && memcmp(data, s, n) == 0;
+  }
+  // Posición del primer c a partir de from, o len si no está
+  size_t find(char c, size_t from = 0) const {
+    if (from >= len) return len;
+    const void* p = memchr(data + from, c, len - from);
+    return p ? (size_t)((const char*)p - data) : len;
+  }
+  CmdView sub(size_t from, size_t to) const {
+    if (from > len) from = len;
+    if (to > len) to = len;
+    CmdView v = { data + from, to > from ? to - from : 0 };
+    return v;
+  }
+};
+
+// Después de la URL pueden venir opciones "|clave=valor" (las desconocidas se ignoran):
+//   pct=<0-100>  porcentaje de la flota que aplica la actualización (despliegue por cohortes)
+//   win=<seg>    ventana en la que cada dispositivo elige al azar cuándo empezar
+//   sig=<hex>    firma DER del SHA-256 de la imagen (se verifica con la clave configurada)
+enum OtaCommandKind {
+  OTA_CMD_FULL,     // "<MAC|all>|<URL>[|opciones]"
+  OTA_CMD_DELTA,    // "<MAC|all>|delta|<versión base>|<URL del parche>[|opciones]"
+  OTA_CMD_MANIFEST  // "<MAC|all>|manifest|<versión>|<tamaño>|<sha256 hex>|<URL>[|opciones]"
+};
+
+enum OtaParseResult {
+  OTA_PARSE_OK,
+  OTA_PARSE_OTHER_TARGET,  // bien formado o no, es para otro dispositivo
+  OTA_PARSE_INVALID        // para este dispositivo pero con formato desconocido
+};
+
+struct OtaCommand {
+  OtaCommandKind kind;
+  CmdView target;
+  CmdView url;
+  CmdView baseVersion;  // solo en OTA_CMD_DELTA
+  CmdView version;      // solo en OTA_CMD_MANIFEST: versión de la imagen anunciada
+  uint32_t imageSize;   // solo en OTA_CMD_MANIFEST: bytes de la imagen (sin comprimir)
+  uint8_t sha256[32];   // solo en OTA_CMD_MANIFEST: hash de la imagen
+  uint8_t percent;      // 100 si no vino pct=
+  uint32_t windowSec;   // 0 si no vino win=
+  uint8_t signature[OTA_SIGNATURE_MAX];
+  size_t signatureLen;  // 0 si no vino sig=
+};
+
+// Entero decimal sin signo de hasta 9 dígitos
+inline bool cmdParseUint(const CmdView& v, uint32_t& out) {
+  if (v.len == 0 || v.len > 9) return false;
+  uint32_t n = 0;
+  for (size_t i = 0; i < v.len; i++) {
+    if (v.data[i] < '0' || v.data[i] > '9') return false;
+    n = n * 10 + (uint32_t)(v.data[i] - '0');
+  }
+  out = n;
+  return true;
+}
+
+// Exactamente 2*n dígitos hexadecimales (mayúsculas o minúsculas)
+inline bool cmdParseHex(const CmdView& v, uint8_t* out, size_t n) {
+  if (v.len != 2 * n) return false;
+  for (size_t i = 0; i < v.len; i++) {
+    char c = v.data[i];
+    uint8_t d;
+    if (c >= '0' && c <= '9') d = (uint8_t)(c - '0');
+    else if (c >= 'a' && c <= 'f') d = (uint8_t)(c - 'a' + 10);
+    else if (c >= 'A' && c <= 'F') d = (uint8_t)(c - 'A' + 10);
+    else return false;
+    out[i / 2] = (i & 1) ? (uint8_t)(out[i / 2] | d) : (uint8_t)(d << 4);
+  }
+  return true;
+}
+
+// Opciones "clave=valor" separadas por '|'. Un valor mal formado invalida el comando.
+inline bool cmdParseOptions(CmdView opts, OtaCommand& out) {
+  size_t pos = 0;
+  while (pos < opts.len) {
+    size_t end = opts.find('|', pos);
+    CmdView opt = opts.sub(pos, end);
+    size_t eq = opt.find('=');
+    CmdView key = opt.sub(0, eq);
+    CmdView value = opt.sub(eq + 1, opt.len);
+    uint32_t n;
+    if (key.equals("pct")) {
+      if (eq == opt.len || !cmdParseUint(value, n)) return false;
+      out.percent = n > 100 ? 100 : (uint8_t)n;
+    } else if (key.equals("win")) {
+      if (eq == opt.len || !cmdParseUint(value, n)) return false;
+      out.windowSec = n;
+    } else if (key.equals("sig")) {
+      if (eq == opt.len || value.len == 0 || value.len % 2 != 0 || value.len > 2 * OTA_SIGNATURE_MAX ||
+          !cmdParseHex(value, out.signature, value.len / 2)) {
+        return false;
+      }
+      out.signatureLen = value.len / 2;
+    }
+    pos = end + 1;
+  }
+  return true;
+}
+
+// Interpreta un comando de TOPIC_UPDATE directamente sobre el buffer de PubSubClient,
+// sin copias ni memoria dinámica: las vistas de out apuntan dentro de payload.
+// El destino se compara antes que nada, así los mensajes para otras MAC se descartan
+// tras un memchr y un memcmp. No depende de Arduino (se prueba y mide en el host).
+inline OtaParseResult parseOtaCommand(const uint8_t* payload, size_t len, const char* mac,
+                                      OtaCommand& out) {
+  CmdView msg = { (const char*)payload, payload ? len : 0 };
+  size_t sep = msg.find('|');
+  if (sep == msg.len) return OTA_PARSE_INVALID;
+
+  out.target = msg.sub(0, sep);
+  if (!out.target.equals(mac) && !out.target.equals("all")) return OTA_PARSE_OTHER_TARGET;
+
+  CmdView rest = msg.sub(sep + 1, msg.len);
+  out.baseVersion = rest.sub(0, 0);
+  out.version = rest.sub(0, 0);
+  out.imageSize = 0;
+  out.percent = 100;
+  out.windowSec = 0;
+  out.signatureLen = 0;
+  size_t urlStart = 0;
+  if (rest.startsWith("delta|")) {
+    size_t baseSep = rest.find('|', 6);
+    if (baseSep == rest.len) return OTA_PARSE_INVALID;
+    out.kind = OTA_CMD_DELTA;
+    out.baseVersion = rest.sub(6, baseSep);
+    urlStart = baseSep + 1;
+  } else if (rest.startsWith("manifest|")) {
+    // versión|tamaño|sha256|URL: los tres campos son obligatorios
+    size_t verSep = rest.find('|', 9);
+    size_t sizeSep = rest.find('|', verSep + 1);
+    size_t shaSep = rest.find('|', sizeSep + 1);
+    if (shaSep == rest.len) return OTA_PARSE_INVALID;
+    out.kind = OTA_CMD_MANIFEST;
+    out.version = rest.sub(9, verSep);
+    if (out.version.len == 0 || !cmdParseUint(rest.sub(verSep + 1, sizeSep), out.imageSize) ||
+        out.imageSize == 0 || !cmdParseHex(rest.sub(sizeSep + 1, shaSep), out.sha256, 32)) {
+      return OTA_PARSE_INVALID;
+    }
+    urlStart = shaSep + 1;
+  } else {
+    out.kind = OTA_CMD_FULL;
+  }
+  // Una URL válida no lleva '|' sin codificar: lo que sigue son opciones
+  size_t urlEnd = rest.find('|', urlStart);
+  out.url = rest.sub(urlStart, urlEnd);
+  if (!out.url.startsWith("http")) return OTA_PARSE_INVALID;
+  if (urlEnd < rest.len && !cmdParseOptions(rest.sub(urlEnd + 1, rest.len), out)) return OTA_PARSE_INVALID;
+  return OTA_PARSE_OK;
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "OtaDelta.h"
+#include <string.h>
+
+// Bloque usado para copiar desde la imagen base
+#define OTA_DELTA_COPY_CHUNK 256
+
+static uint32_t readLE32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+OtaDelta::OtaDelta()
+  : _baseVersion(nullptr), _baseLimit(0), _readBase(nullptr), _out(nullptr), _ctx(nullptr),
+    _error(nullptr), _state(HEADER), _bufLen(0), _need(6),
+    _baseSize(0), _newSize(0), _insertLeft(0), _produced(0)
+{
+}
+
+bool OtaDelta::begin(const char* baseVersion, uint32_t baseLimit,
+                     OtaBaseReadFn readBase, OtaOutputFn out, void* ctx) {
+  _baseVersion = baseVersion;
+  _baseLimit = baseLimit;
+  _readBase = readBase;
+  _out = out;
+  _ctx = ctx;
+  _error = nullptr;
+  _state = HEADER;
+  _bufLen = 0;
+  _need = 6;  // magia + formato + largo de la versión
+  _baseSize = 0;
+  _newSize = 0;
+  _insertLeft = 0;
+  _produced = 0;
+  return true;
+}
+
+bool OtaDelta::fail(const char* reason) {
+  if (!_error) _error = reason;
+  return false;
+}
+
+bool OtaDelta::emit(const uint8_t* data, size_t len) {
+  if (_produced + len > _newSize) return fail("el parche excede el tamaño declarado");
+  _produced += len;
+  if (!_out(_ctx, data, len)) return fail("error al escribir en flash");
+  return true;
+}
+
+bool OtaDelta::parseHeader() {
+  if (_bufLen == 6) {
+    if (memcmp(_buf, "EDLT", 4) != 0) return fail("no es un parche delta");
+    if (_buf[4] != OTA_DELTA_FORMAT) return fail("formato de parche no soportado");
+    if (_buf[5] > OTA_DELTA_MAX_VERSION) return fail("versión base demasiado larga");
+    _need = 6 + _buf[5] + 8;
+    return true;
+  }
+
+  size_t verLen = _buf[5];
+  if (!_baseVersion || strlen(_baseVersion) != verLen ||
+      memcmp(_buf + 6, _baseVersion, verLen) != 0) {
+    return fail("el parche fue generado para otra versión base");
+  }
+  _baseSize = readLE32(_buf + 6 + verLen);
+  _newSize = readLE32(_buf + 6 + verLen + 4);
+  if (_baseSize > _baseLimit) return fail("imagen base más grande que la partición");
+  if (_newSize == 0) return fail("imagen nueva vacía");
+  _state = OPCODE;
+  return true;
+}
+
+bool OtaDelta::copyFromBase(uint32_t offset, uint32_t len) {
+  if (len > OTA_DELTA_MAX_COPY) return fail("COPY más larga que el máximo del formato");
+  if (offset > _baseSize || len > _baseSize - offset) return fail("COPY fuera de la imagen base");
+  uint8_t chunk[OTA_DELTA_COPY_CHUNK];
+  while (len > 0) {
+    size_t n = len < sizeof(chunk) ? len : sizeof(chunk);
+    if (!_readBase(_ctx, offset, chunk, n)) return fail("error al leer la partición base");
+    if (!emit(chunk, n)) return false;
+    offset += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool OtaDelta::write(const uint8_t* data, size_t len) {
+  if (_error) return false;
+  size_t i = 0;
+
+  while (i < len) {
+    switch (_state) {
+      case HEADER:
+        while (_bufLen < _need && i < len) _buf[_bufLen++] = data[i++];
+        if (_bufLen == _need && !parseHeader()) return false;
+        break;
+
+      case OPCODE: {
+        uint8_t op = data[i++];
+        _bufLen = 0;
+        if (op == OTA_DELTA_OP_COPY) {
+          _state = COPY_ARGS;
+        } else if (op == OTA_DELTA_OP_INSERT) {
+          _state = INSERT_LEN;
+        } else if (op == OTA_DELTA_OP_END) {
+          _state = DONE;
+        } else {
+          return fail("operación de parche desconocida");
+        }
+        break;
+      }
+
+      case COPY_ARGS:
+        while (_bufLen < 8 && i < len) _buf[_bufLen++] = data[i++];
+        if (_bufLen == 8) {
+          if (!copyFromBase(readLE32(_buf), readLE32(_buf + 4))) return false;
+          _state = OPCODE;
+        }
+        break;
+
+      case INSERT_LEN:
+        while (_bufLen < 4 && i < len) _buf[_bufLen++] = data[i++];
+        if (_bufLen == 4) {
+          _insertLeft = readLE32(_buf);
+          _state = _insertLeft > 0 ? INSERT_DATA : OPCODE;
+        }
+        break;
+
+      case INSERT_DATA: {
+        size_t n = len - i < _insertLeft ? len - i : _insertLeft;
+        if (!emit(data + i, n)) return false;
+        i += n;
+        _insertLeft -= n;
+        if (_insertLeft == 0) _state = OPCODE;
+        break;
+      }
+
+      case DONE:
+        return fail("datos extra tras el fin del parche");
+    }
+  }
+  return true;
+}
+
+bool OtaDelta::finish() {
+  if (_error) return false;
+  if (_state != DONE) return fail("parche truncado");
+  if (_produced != _newSize) return fail("la imagen reconstruida no tiene el tamaño declarado");
+  return true;
+}
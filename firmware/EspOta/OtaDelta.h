@@ -0,0 +1,71 @@
+#ifndef OTA_DELTA_H
+#define OTA_DELTA_H
+
+#include "OtaStage.h"
+
+// Formato de parche delta (little endian), generado con firmware/tools/ota_delta.cpp:
+//
+//   "EDLT" <formato u8 = 1> <largo u8> <versión base> <tamaño base u32> <tamaño nuevo u32>
+//   operaciones:
+//     0x01 COPY   <origen u32> <largo u32>   copia bytes de la partición en ejecución
+//                                          (largo <= OTA_DELTA_MAX_COPY)
+//     0x02 INSERT <largo u32> <bytes...>     bytes nuevos literales
+//     0x00 END
+//
+// El parche puede viajar comprimido (gzip/heatshrink): OtaInflate lo
+// descomprime antes de esta etapa.
+#define OTA_DELTA_FORMAT       1
+#define OTA_DELTA_OP_END       0x00
+#define OTA_DELTA_OP_COPY      0x01
+#define OTA_DELTA_OP_INSERT    0x02
+#define OTA_DELTA_MAX_VERSION  31
+// Una COPY se aplica entera dentro de un write(): el tope acota lo que bloquea cada
+// llamada (lecturas de flash) y lo respetan tanto el generador como esta etapa
+#define OTA_DELTA_MAX_COPY     4096
+
+// Lectura de la imagen base (en el ESP32, la partición de la app en ejecución)
+typedef bool (*OtaBaseReadFn)(void* ctx, uint32_t offset, uint8_t* buf, size_t len);
+
+// Etapa que reconstruye la imagen nueva aplicando el parche sobre la imagen base.
+// No depende de Arduino para poder reutilizarse en la herramienta de host.
+class OtaDelta {
+public:
+  OtaDelta();
+
+  // baseVersion: versión que debe declarar el parche (la del firmware en ejecución).
+  bool begin(const char* baseVersion, uint32_t baseLimit,
+             OtaBaseReadFn readBase, OtaOutputFn out, void* ctx);
+  bool write(const uint8_t* data, size_t len);
+  bool finish();
+
+  // Tamaño de la imagen reconstruida, conocido tras la cabecera (0 antes).
+  size_t expectedSize() const { return _newSize; }
+  size_t outputSize() const { return _produced; }
+  const char* error() const { return _error; }
+
+private:
+  bool fail(const char* reason);
+  bool emit(const uint8_t* data, size_t len);
+  bool parseHeader();
+  bool copyFromBase(uint32_t offset, uint32_t len);
+
+  enum State { HEADER, OPCODE, COPY_ARGS, INSERT_LEN, INSERT_DATA, DONE };
+
+  const char* _baseVersion;
+  uint32_t _baseLimit;
+  OtaBaseReadFn _readBase;
+  OtaOutputFn _out;
+  void* _ctx;
+  const char* _error;
+
+  State _state;
+  uint8_t _buf[4 + 2 + OTA_DELTA_MAX_VERSION + 8];
+  size_t _bufLen;
+  size_t _need;
+  uint32_t _baseSize;
+  uint32_t _newSize;
+  uint32_t _insertLeft;
+  size_t _produced;
+};
+
+#endif
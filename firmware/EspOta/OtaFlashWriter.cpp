@@ -0,0 +1,65 @@
+#include "OtaFlashWriter.h"
+
+// Byte mágico de las imágenes de aplicación ESP32
+#define OTA_IMAGE_MAGIC 0xE9
+
+OtaFlashWriter::OtaFlashWriter()
+  : _partition(nullptr), _size(0), _offset(0), _erasedUpTo(0), _error(nullptr)
+{
+}
+
+bool OtaFlashWriter::fail(const char* reason) {
+  _error = reason;
+  _partition = nullptr;
+  return false;
+}
+
+bool OtaFlashWriter::begin(size_t imageSize, size_t resumeOffset) {
+  _error = nullptr;
+  _partition = esp_ota_get_next_update_partition(nullptr);
+  if (!_partition) return fail("no hay partición OTA disponible");
+  if (imageSize != OTA_IMAGE_SIZE_UNKNOWN && imageSize > _partition->size) {
+    return fail("la imagen no entra en la partición OTA");
+  }
+  if (resumeOffset % OTA_FLASH_SECTOR_SIZE != 0 || resumeOffset > _partition->size) {
+    return fail("offset de reanudación inválido");
+  }
+  _size = imageSize;
+  _offset = resumeOffset;
+  // Todo lo anterior a resumeOffset ya está escrito; lo siguiente se borra al avanzar
+  _erasedUpTo = resumeOffset;
+  return true;
+}
+
+bool OtaFlashWriter::write(const uint8_t* data, size_t len) {
+  if (!_partition) return false;
+  if (_offset == 0 && len > 0 && data[0] != OTA_IMAGE_MAGIC) return fail("no es una imagen ESP32");
+  if (_offset + len > _partition->size) return fail("la imagen excede la partición OTA");
+  if (_size != OTA_IMAGE_SIZE_UNKNOWN && _offset + len > _size) return fail("la imagen excede el tamaño anunciado");
+
+  size_t end = _offset + len;
+  if (end > _erasedUpTo) {
+    size_t eraseEnd = (end + OTA_FLASH_SECTOR_SIZE - 1) / OTA_FLASH_SECTOR_SIZE * OTA_FLASH_SECTOR_SIZE;
+    if (esp_partition_erase_range(_partition, _erasedUpTo, eraseEnd - _erasedUpTo) != ESP_OK) {
+      return fail("error al borrar la flash");
+    }
+    _erasedUpTo = eraseEnd;
+  }
+  if (esp_partition_write(_partition, _offset, data, len) != ESP_OK) return fail("error al escribir la flash");
+  _offset = end;
+  return true;
+}
+
+bool OtaFlashWriter::end() {
+  if (!_partition) return false;
+  if (_size != OTA_IMAGE_SIZE_UNKNOWN && _offset != _size) return fail("imagen incompleta");
+  // esp_ota_set_boot_partition verifica cabecera, checksum y hash de la imagen
+  esp_err_t err = esp_ota_set_boot_partition(_partition);
+  _partition = nullptr;
+  if (err != ESP_OK) return fail(err == ESP_ERR_OTA_VALIDATE_FAILED ? "imagen inválida" : "no se pudo activar la partición");
+  return true;
+}
+
+void OtaFlashWriter::abort() {
+  _partition = nullptr;
+}
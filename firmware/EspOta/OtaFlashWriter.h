@@ -0,0 +1,42 @@
+#ifndef OTA_FLASH_WRITER_H
+#define OTA_FLASH_WRITER_H
+
+#include <Arduino.h>
+#include <esp_ota_ops.h>
+
+#define OTA_FLASH_SECTOR_SIZE 4096
+#define OTA_IMAGE_SIZE_UNKNOWN 0xFFFFFFFF
+
+// Escritura de la imagen en la siguiente partición OTA.
+// A diferencia de Update, puede retomar desde un offset ya escrito (alineado a
+// sector) después de un corte o un reinicio. Los sectores se borran a medida
+// que se escriben y la partición solo se marca de arranque en end(), que
+// valida la imagen completa. No soporta flash cifrada.
+class OtaFlashWriter {
+public:
+  OtaFlashWriter();
+
+  // imageSize puede ser OTA_IMAGE_SIZE_UNKNOWN (gzip).
+  // resumeOffset debe ser múltiplo de OTA_FLASH_SECTOR_SIZE (0 para empezar de cero).
+  bool begin(size_t imageSize, size_t resumeOffset = 0);
+  bool write(const uint8_t* data, size_t len);
+  // Valida la imagen y la marca como partición de arranque.
+  bool end();
+  void abort();
+
+  bool isRunning() const { return _partition != nullptr; }
+  size_t offset() const { return _offset; }
+  const esp_partition_t* partition() const { return _partition; }
+  const char* error() const { return _error; }
+
+private:
+  bool fail(const char* reason);
+
+  const esp_partition_t* _partition;
+  size_t _size;
+  size_t _offset;
+  size_t _erasedUpTo;
+  const char* _error;
+};
+
+#endif
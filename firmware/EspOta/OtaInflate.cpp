@@ -0,0 +1,339 @@
+#include "OtaInflate.h"
+
+// gzip se apoya en el inflador tinfl de la ROM del ESP32 (si el core lo expone)
+#if __has_include(<esp32/rom/miniz.h>)
+#include <esp32/rom/miniz.h>
+#define OTA_HAVE_GZIP 1
+#elif __has_include(<rom/miniz.h>)
+#include <rom/miniz.h>
+#define OTA_HAVE_GZIP 1
+#else
+#define OTA_HAVE_GZIP 0
+#endif
+
+// Estados del parser de cabecera/trailer gzip (RFC 1952)
+enum {
+  GZ_FIXED,      // 10 bytes fijos
+  GZ_EXTRA_LEN,  // longitud de FEXTRA
+  GZ_EXTRA,      // contenido de FEXTRA
+  GZ_NAME,       // FNAME terminado en 0
+  GZ_COMMENT,    // FCOMMENT terminado en 0
+  GZ_HCRC,       // FHCRC
+  GZ_DATA,       // bloques deflate
+  GZ_TRAILER,    // CRC32 + ISIZE
+  GZ_END
+};
+
+#define GZ_FHCRC    0x02
+#define GZ_FEXTRA   0x04
+#define GZ_FNAME    0x08
+#define GZ_FCOMMENT 0x10
+
+#define OTA_GZ_DICT_SIZE (1u << OTA_GZ_WINDOW_BITS)
+
+// Bloque de salida usado para agrupar bytes antes de llamar al destino
+#define OTA_INFLATE_OUT_CHUNK 256
+
+#if OTA_HAVE_GZIP
+// CRC32 (polinomio de zlib) con tabla de 16 entradas para no gastar RAM
+static uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+  static const uint32_t table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+    crc = (crc >> 4) ^ table[crc & 0x0F];
+  }
+  return ~crc;
+}
+#endif
+
+static uint32_t readLE32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+OtaInflate::OtaInflate()
+  : _enc(OTA_ENC_NONE), _out(nullptr), _ctx(nullptr),
+    _expected(0), _produced(0), _error(nullptr), _hdrLen(0),
+    _window(nullptr), _windowSz2(0), _lookaheadSz2(0), _windowPos(0),
+    _bitBuf(0), _bitCount(0),
+    _inflator(nullptr), _dict(nullptr), _dictOfs(0),
+    _gzState(GZ_FIXED), _gzFlags(0), _gzSkip(0), _crc(0)
+{
+}
+
+OtaInflate::~OtaInflate() {
+  end();
+}
+
+OTAEncoding OtaInflate::detect(const String& contentEncoding, uint8_t firstByte) {
+  if (contentEncoding == "gzip" || contentEncoding == "x-gzip") return OTA_ENC_GZIP;
+  if (contentEncoding == "heatshrink") return OTA_ENC_HEATSHRINK;
+
+  // Una imagen de aplicación ESP32 siempre empieza con el byte mágico 0xE9
+  // y un parche delta con "EDLT"
+  if (firstByte == 0xE9 || firstByte == 'E') return OTA_ENC_NONE;
+  if (firstByte == 0x1F) return OTA_ENC_GZIP;
+  if (firstByte == 'H') return OTA_ENC_HEATSHRINK;
+  return OTA_ENC_UNKNOWN;
+}
+
+const char* OtaInflate::encodingName(OTAEncoding enc) {
+  switch (enc) {
+    case OTA_ENC_NONE:       return "plain";
+    case OTA_ENC_GZIP:       return "gzip";
+    case OTA_ENC_HEATSHRINK: return "heatshrink";
+    default:                 return "unknown";
+  }
+}
+
+bool OtaInflate::begin(OTAEncoding enc, OtaOutputFn out, void* ctx) {
+  end();
+  _enc = enc;
+  _out = out;
+  _ctx = ctx;
+  _expected = 0;
+  _produced = 0;
+  _error = nullptr;
+  _hdrLen = 0;
+
+  switch (enc) {
+    case OTA_ENC_NONE:
+    case OTA_ENC_HEATSHRINK:  // la ventana se reserva al leer la cabecera
+      return true;
+    case OTA_ENC_GZIP:
+#if OTA_HAVE_GZIP
+      _inflator = malloc(sizeof(tinfl_decompressor));
+      _dict = (uint8_t*)malloc(OTA_GZ_DICT_SIZE);
+      if (!_inflator || !_dict) return fail("sin memoria para gzip");
+      tinfl_init((tinfl_decompressor*)_inflator);
+      _dictOfs = 0;
+      _gzState = GZ_FIXED;
+      _gzFlags = 0;
+      _gzSkip = 0;
+      _crc = 0;
+      return true;
+#else
+      return fail("gzip no soportado por este core");
+#endif
+    default:
+      return fail("formato de imagen desconocido");
+  }
+}
+
+void OtaInflate::end() {
+  free(_window);
+  _window = nullptr;
+  free(_inflator);
+  _inflator = nullptr;
+  free(_dict);
+  _dict = nullptr;
+}
+
+bool OtaInflate::fail(const char* reason) {
+  if (!_error) _error = reason;
+  return false;
+}
+
+bool OtaInflate::emit(const uint8_t* data, size_t len) {
+  if (_expected > 0 && _produced + len > _expected) return fail("imagen más grande de lo anunciado");
+  _produced += len;
+  if (!_out(_ctx, data, len)) return fail("error al escribir en flash");
+  return true;
+}
+
+bool OtaInflate::write(const uint8_t* data, size_t len) {
+  if (_error) return false;
+  switch (_enc) {
+    case OTA_ENC_NONE:       return emit(data, len);
+    case OTA_ENC_HEATSHRINK: return writeHeatshrink(data, len);
+    case OTA_ENC_GZIP:       return writeGzip(data, len);
+    default:                 return fail("formato de imagen desconocido");
+  }
+}
+
+bool OtaInflate::finish() {
+  if (_error) return false;
+  switch (_enc) {
+    case OTA_ENC_HEATSHRINK:
+      // El relleno final son menos de 8 bits en cero; no debe quedar nada más
+      if (_hdrLen < OTA_HS_HEADER_SIZE) return fail("cabecera heatshrink incompleta");
+      if (_produced != _expected) return fail("imagen heatshrink truncada");
+      return true;
+    case OTA_ENC_GZIP:
+      if (_gzState != GZ_END) return fail("flujo gzip truncado");
+      return true;
+    default:
+      return true;
+  }
+}
+
+// ---------------------------------------------------------------------------
+// heatshrink: tokens de 1 bit de tag + literal (8 bits) o
+// referencia (window_sz2 bits de índice + lookahead_sz2 bits de longitud), MSB primero.
+// ---------------------------------------------------------------------------
+bool OtaInflate::writeHeatshrink(const uint8_t* data, size_t len) {
+  size_t i = 0;
+
+  // Cabecera propia con parámetros y tamaño original
+  while (_hdrLen < OTA_HS_HEADER_SIZE && i < len) _hdr[_hdrLen++] = data[i++];
+  if (_hdrLen < OTA_HS_HEADER_SIZE) return true;
+  if (!_window) {
+    if (_hdr[0] != 'H' || _hdr[1] != 'S') return fail("cabecera heatshrink inválida");
+    _windowSz2 = _hdr[2];
+    _lookaheadSz2 = _hdr[3];
+    if (_windowSz2 < 4 || _windowSz2 > OTA_HS_MAX_WINDOW_SZ2 ||
+        _lookaheadSz2 < 3 || _lookaheadSz2 >= _windowSz2) {
+      return fail("parámetros heatshrink no soportados");
+    }
+    _expected = readLE32(_hdr + 4);
+    if (_expected == 0) return fail("imagen heatshrink vacía");
+    _window = (uint8_t*)calloc(1, 1u << _windowSz2);
+    if (!_window) return fail("sin memoria para heatshrink");
+    _windowPos = 0;
+    _bitBuf = 0;
+    _bitCount = 0;
+  }
+
+  const uint16_t mask = (1u << _windowSz2) - 1;
+  const uint8_t refBits = 1 + _windowSz2 + _lookaheadSz2;
+  uint8_t out[OTA_INFLATE_OUT_CHUNK];
+  size_t outLen = 0;
+
+  // Los bits de relleno tras el último token se ignoran
+  for (; i < len && _produced + outLen < _expected; i++) {
+    _bitBuf = (_bitBuf << 8) | data[i];
+    _bitCount += 8;
+
+    while (_bitCount > 0 && _produced + outLen < _expected) {
+      bool literal = (_bitBuf >> (_bitCount - 1)) & 1;
+      if (literal) {
+        if (_bitCount < 9) break;
+        _bitCount -= 9;
+        uint8_t c = (_bitBuf >> _bitCount) & 0xFF;
+        _window[_windowPos++ & mask] = c;
+        out[outLen++] = c;
+        if (outLen == sizeof(out)) {
+          if (!emit(out, outLen)) return false;
+          outLen = 0;
+        }
+      } else {
+        if (_bitCount < refBits) break;
+        _bitCount -= refBits;
+        uint32_t token = _bitBuf >> _bitCount;
+        uint16_t count = (token & ((1u << _lookaheadSz2) - 1)) + 1;
+        uint16_t offset = ((token >> _lookaheadSz2) & mask) + 1;
+        for (uint16_t k = 0; k < count; k++) {
+          uint8_t c = _window[(_windowPos - offset) & mask];
+          _window[_windowPos++ & mask] = c;
+          out[outLen++] = c;
+          if (outLen == sizeof(out)) {
+            if (!emit(out, outLen)) return false;
+            outLen = 0;
+          }
+        }
+      }
+      _bitBuf &= (1u << _bitCount) - 1;
+    }
+  }
+
+  if (outLen > 0 && !emit(out, outLen)) return false;
+  // Completa la imagen, solo queda el relleno del último byte ya leído
+  if (i < len) return fail("datos extra tras la imagen heatshrink");
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// gzip: cabecera RFC 1952 + deflate crudo (tinfl) + CRC32/ISIZE.
+// ---------------------------------------------------------------------------
+bool OtaInflate::gzipHeaderByte(uint8_t b) {
+  switch (_gzState) {
+    case GZ_FIXED:
+      _hdr[_hdrLen++] = b;
+      if (_hdrLen < 10) return true;
+      if (_hdr[0] != 0x1F || _hdr[1] != 0x8B || _hdr[2] != 8) return fail("cabecera gzip inválida");
+      _gzFlags = _hdr[3];
+      _hdrLen = 0;
+      _gzState = GZ_EXTRA_LEN;
+      break;
+    case GZ_EXTRA_LEN:
+      _hdr[_hdrLen++] = b;
+      if (_hdrLen < 2) return true;
+      _gzSkip = _hdr[0] | (_hdr[1] << 8);
+      _hdrLen = 0;
+      _gzState = GZ_EXTRA;
+      break;
+    case GZ_EXTRA:
+      _gzSkip--;
+      break;
+    case GZ_NAME:
+    case GZ_COMMENT:
+      if (b != 0) return true;
+      _gzState++;
+      break;
+    case GZ_HCRC:
+      if (++_hdrLen < 2) return true;
+      _hdrLen = 0;
+      _gzState = GZ_DATA;
+      break;
+  }
+
+  // Saltar los campos opcionales ausentes o ya consumidos
+  if (_gzState == GZ_EXTRA_LEN && !(_gzFlags & GZ_FEXTRA)) _gzState = GZ_NAME;
+  if (_gzState == GZ_EXTRA && _gzSkip == 0) _gzState = GZ_NAME;
+  if (_gzState == GZ_NAME && !(_gzFlags & GZ_FNAME)) _gzState = GZ_COMMENT;
+  if (_gzState == GZ_COMMENT && !(_gzFlags & GZ_FCOMMENT)) _gzState = GZ_HCRC;
+  if (_gzState == GZ_HCRC && !(_gzFlags & GZ_FHCRC)) _gzState = GZ_DATA;
+  return true;
+}
+
+bool OtaInflate::writeGzip(const uint8_t* data, size_t len) {
+#if OTA_HAVE_GZIP
+  size_t i = 0;
+
+  while (i < len && _gzState < GZ_DATA) {
+    if (!gzipHeaderByte(data[i++])) return false;
+  }
+
+  while (_gzState == GZ_DATA) {
+    size_t inBytes = len - i;
+    size_t outBytes = OTA_GZ_DICT_SIZE - _dictOfs;
+    tinfl_status status = tinfl_decompress((tinfl_decompressor*)_inflator,
+                                           data + i, &inBytes,
+                                           _dict, _dict + _dictOfs, &outBytes,
+                                           TINFL_FLAG_HAS_MORE_INPUT);
+    i += inBytes;
+    if (outBytes > 0) {
+      _crc = crc32Update(_crc, _dict + _dictOfs, outBytes);
+      if (!emit(_dict + _dictOfs, outBytes)) return false;
+      _dictOfs = (_dictOfs + outBytes) & (OTA_GZ_DICT_SIZE - 1);
+    }
+    if (status < TINFL_STATUS_DONE) return fail("flujo deflate corrupto");
+    if (status == TINFL_STATUS_DONE) {
+      _gzState = GZ_TRAILER;
+      _hdrLen = 0;
+    } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+      break;
+    }
+  }
+
+  while (_gzState == GZ_TRAILER && i < len) {
+    _hdr[_hdrLen++] = data[i++];
+    if (_hdrLen == 8) {
+      if (readLE32(_hdr) != _crc) return fail("CRC32 de gzip no coincide");
+      if (readLE32(_hdr + 4) != (uint32_t)_produced) return fail("tamaño de gzip no coincide");
+      _gzState = GZ_END;
+    }
+  }
+
+  if (_gzState == GZ_END && i < len) return fail("datos extra tras el trailer gzip");
+  return true;
+#else
+  (void)data;
+  (void)len;
+  return fail("gzip no soportado por este core");
+#endif
+}
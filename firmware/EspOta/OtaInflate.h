@@ -0,0 +1,100 @@
+#ifndef OTA_INFLATE_H
+#define OTA_INFLATE_H
+
+#include <Arduino.h>
+#include "OtaStage.h"
+
+// Formatos de imagen OTA soportados
+enum OTAEncoding {
+  OTA_ENC_NONE,        // imagen .bin (0xE9) o parche delta ('E') sin comprimir
+  OTA_ENC_GZIP,        // gzip estándar (gzip -9 firmware.bin)
+  OTA_ENC_HEATSHRINK,  // heatshrink con cabecera propia (ver abajo)
+  OTA_ENC_UNKNOWN
+};
+
+// Cabecera de las imágenes heatshrink (8 bytes, little endian):
+//   'H' 'S' <window_sz2> <lookahead_sz2> <tamaño original uint32>
+// seguida del flujo heatshrink crudo generado con los mismos parámetros.
+#define OTA_HS_HEADER_SIZE 8
+
+// Ventana máxima aceptada para heatshrink (2^12 = 4 KB de RAM)
+#ifndef OTA_HS_MAX_WINDOW_SZ2
+#define OTA_HS_MAX_WINDOW_SZ2 12
+#endif
+
+// Ventana de deflate para gzip: 2^OTA_GZ_WINDOW_BITS bytes de heap mientras dura la OTA,
+// más el estado de tinfl (~11 KB). Con 15 (la de gzip y zlib) entra cualquier imagen gzip,
+// a costa de ~43 KB. Con menos bits baja la RAM (12: 4 KB + 11 KB), pero la imagen tiene que
+// comprimirse con esa misma ventana (tools/ota_pack --gzip --window=12): una comprimida con
+// una ventana mayor falla el CRC32 y la OTA se aborta sin marcar la partición.
+#ifndef OTA_GZ_WINDOW_BITS
+#define OTA_GZ_WINDOW_BITS 15
+#endif
+#if OTA_GZ_WINDOW_BITS < 9 || OTA_GZ_WINDOW_BITS > 15
+#error "OTA_GZ_WINDOW_BITS debe estar entre 9 y 15"
+#endif
+
+// Etapa de descompresión en streaming entre el stream HTTP y Update.write().
+// Trabaja con una ventana fija: heatshrink usa 2^window_sz2 bytes (según la cabecera, hasta
+// 2^OTA_HS_MAX_WINDOW_SZ2) y gzip 2^OTA_GZ_WINDOW_BITS más el estado de tinfl (ver arriba).
+// Las imágenes se generan con tools/ota_pack.
+class OtaInflate {
+public:
+  OtaInflate();
+  ~OtaInflate();
+
+  // Detecta el formato a partir del Content-Encoding (si lo hay) o del primer byte.
+  static OTAEncoding detect(const String& contentEncoding, uint8_t firstByte);
+  static const char* encodingName(OTAEncoding enc);
+
+  bool begin(OTAEncoding enc, OtaOutputFn out, void* ctx);
+  // Alimenta bytes tal como llegan de la red.
+  bool write(const uint8_t* data, size_t len);
+  // Verifica que el flujo terminó correctamente (fin de deflate, CRC, tamaño).
+  bool finish();
+  void end();
+
+  OTAEncoding encoding() const { return _enc; }
+  // Tamaño de la imagen descomprimida si se conoce de antemano (0 si no).
+  size_t expectedSize() const { return _expected; }
+  size_t outputSize() const { return _produced; }
+  const char* error() const { return _error; }
+
+private:
+  bool emit(const uint8_t* data, size_t len);
+  bool fail(const char* reason);
+
+  bool writeHeatshrink(const uint8_t* data, size_t len);
+  bool writeGzip(const uint8_t* data, size_t len);
+  bool gzipHeaderByte(uint8_t b);
+
+  OTAEncoding _enc;
+  OtaOutputFn _out;
+  void* _ctx;
+  size_t _expected;
+  size_t _produced;
+  const char* _error;
+
+  // Cabecera pendiente de completar (heatshrink, cabecera fija y trailer gzip)
+  uint8_t _hdr[10];
+  size_t _hdrLen;
+
+  // heatshrink
+  uint8_t* _window;
+  uint8_t _windowSz2;
+  uint8_t _lookaheadSz2;
+  uint16_t _windowPos;
+  uint32_t _bitBuf;
+  uint8_t _bitCount;
+
+  // gzip
+  void* _inflator;
+  uint8_t* _dict;
+  size_t _dictOfs;
+  uint8_t _gzState;
+  uint8_t _gzFlags;
+  uint16_t _gzSkip;
+  uint32_t _crc;
+};
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef OTA_STAGE_H
+#define OTA_STAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Destino de los bytes que produce una etapa del pipeline OTA
+// (red -> descompresión -> delta -> flash). Devuelve false para abortar.
+typedef bool (*OtaOutputFn)(void* ctx, const uint8_t* data, size_t len);
+
+#endif
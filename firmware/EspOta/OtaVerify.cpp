@@ -0,0 +1,119 @@
+#include "OtaVerify.h"
+#include <string.h>
+#include <mbedtls/version.h>
+
+// mbedtls 2.x (core de Arduino 2.x) usa las variantes _ret; en 3.x se renombraron
+#if MBEDTLS_VERSION_NUMBER < 0x03000000
+#define OTA_SHA256_STARTS mbedtls_sha256_starts_ret
+#define OTA_SHA256_UPDATE mbedtls_sha256_update_ret
+#define OTA_SHA256_FINISH mbedtls_sha256_finish_ret
+#else
+#define OTA_SHA256_STARTS mbedtls_sha256_starts
+#define OTA_SHA256_UPDATE mbedtls_sha256_update
+#define OTA_SHA256_FINISH mbedtls_sha256_finish
+#endif
+
+// Cabecera de la imagen de la app (esp_image_header_t)
+#define OTA_IMAGE_MAGIC          0xE9
+#define OTA_IMAGE_HASH_APPENDED  23
+
+OtaVerify::OtaVerify()
+  : _hasKey(false), _running(false), _error(nullptr), _tailLen(0), _total(0),
+    _magic(0), _hashAppended(0), _hasExpected(false), _signatureLen(0)
+{
+  mbedtls_sha256_init(&_sha);
+  mbedtls_pk_init(&_pk);
+  memset(_digest, 0, sizeof(_digest));
+}
+
+OtaVerify::~OtaVerify() {
+  mbedtls_sha256_free(&_sha);
+  mbedtls_pk_free(&_pk);
+}
+
+bool OtaVerify::setPublicKey(const char* pem) {
+  mbedtls_pk_free(&_pk);
+  mbedtls_pk_init(&_pk);
+  _hasKey = false;
+  if (!pem) return true;
+  if (mbedtls_pk_parse_public_key(&_pk, (const unsigned char*)pem, strlen(pem) + 1) != 0) {
+    return fail("clave pública inválida");
+  }
+  _hasKey = true;
+  return true;
+}
+
+void OtaVerify::begin(const uint8_t* expectedSha, const uint8_t* signature, size_t signatureLen) {
+  _error = nullptr;
+  _tailLen = 0;
+  _total = 0;
+  _magic = 0;
+  _hashAppended = 0;
+  _hasExpected = expectedSha != nullptr;
+  if (_hasExpected) memcpy(_expected, expectedSha, sizeof(_expected));
+  _signatureLen = (signature && signatureLen <= sizeof(_signature)) ? signatureLen : 0;
+  if (_signatureLen) memcpy(_signature, signature, _signatureLen);
+  mbedtls_sha256_free(&_sha);
+  mbedtls_sha256_init(&_sha);
+  OTA_SHA256_STARTS(&_sha, 0);
+  _running = true;
+}
+
+void OtaVerify::hash(const uint8_t* data, size_t len) {
+  if (len > 0) OTA_SHA256_UPDATE(&_sha, data, len);
+}
+
+void OtaVerify::update(const uint8_t* data, size_t len) {
+  if (!_running || len == 0) return;
+  if (_total == 0) _magic = data[0];
+  if (_total <= OTA_IMAGE_HASH_APPENDED && _total + len > OTA_IMAGE_HASH_APPENDED) {
+    _hashAppended = data[OTA_IMAGE_HASH_APPENDED - _total];
+  }
+  _total += len;
+
+  if (len >= sizeof(_tail)) {
+    // Lo retenido y todo salvo los últimos 32 bytes ya entran al hash
+    hash(_tail, _tailLen);
+    hash(data, len - sizeof(_tail));
+    memcpy(_tail, data + len - sizeof(_tail), sizeof(_tail));
+    _tailLen = sizeof(_tail);
+    return;
+  }
+  size_t overflow = _tailLen + len > sizeof(_tail) ? _tailLen + len - sizeof(_tail) : 0;
+  if (overflow > 0) {
+    hash(_tail, overflow);
+    memmove(_tail, _tail + overflow, _tailLen - overflow);
+    _tailLen -= overflow;
+  }
+  memcpy(_tail + _tailLen, data, len);
+  _tailLen += len;
+}
+
+bool OtaVerify::finish() {
+  if (!_running) return fail("verificación no iniciada");
+  _running = false;
+  bool appended = _magic == OTA_IMAGE_MAGIC && _hashAppended == 1 && _tailLen == sizeof(_tail);
+  if (!appended) hash(_tail, _tailLen);
+  OTA_SHA256_FINISH(&_sha, _digest);
+
+  if (appended && memcmp(_digest, _tail, sizeof(_digest)) != 0) {
+    return fail("el SHA-256 de la imagen no coincide (imagen truncada o alterada)");
+  }
+  if (_hasExpected && memcmp(_digest, _expected, sizeof(_digest)) != 0) {
+    return fail("el SHA-256 no coincide con el manifiesto");
+  }
+  if (_hasKey) {
+    if (_signatureLen == 0) return fail("imagen sin firma");
+    if (mbedtls_pk_verify(&_pk, MBEDTLS_MD_SHA256, _digest, sizeof(_digest),
+                          _signature, _signatureLen) != 0) {
+      return fail("firma inválida");
+    }
+  }
+  return true;
+}
+
+bool OtaVerify::fail(const char* reason) {
+  _error = reason;
+  _running = false;
+  return false;
+}
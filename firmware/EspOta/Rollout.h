@@ -0,0 +1,46 @@
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Despliegue escalonado de los comandos "all": cada dispositivo cae en una cohorte fija
+// (0-99) según su MAC y solo actualiza si su cohorte es menor que el porcentaje pedido.
+// Subir de pct=10 a pct=50 incluye a los mismos equipos de la primera etapa.
+// Dentro de la ventana, cada uno espera un tiempo al azar para no descargar todos juntos.
+// No depende de Arduino: la asignación de cohortes se prueba en el host.
+
+// Ventana máxima aceptada (s); una mayor se recorta
+#ifndef ROLLOUT_MAX_WINDOW
+#define ROLLOUT_MAX_WINDOW 86400
+#endif
+
+struct RolloutPlan {
+  bool apply;        // false: la cohorte queda fuera del porcentaje
+  uint8_t cohort;
+  uint32_t delayMs;  // espera antes de empezar (0 sin ventana)
+};
+
+// Cohorte determinística de una MAC: FNV-1a de los 6 bytes, reducida a 0-99
+inline uint8_t rolloutCohort(const uint8_t mac[6]) {
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < 6; i++) h = (h ^ mac[i]) * 16777619UL;
+  // Mezcla final: los bytes bajos de MACs consecutivas no deben caer en cohortes vecinas
+  h ^= h >> 15;
+  h *= 0x2C1B3C6DUL;
+  h ^= h >> 12;
+  return (uint8_t)(h % 100);
+}
+
+// random es una muestra uniforme de 32 bits (esp_random() en el dispositivo)
+inline RolloutPlan planRollout(const uint8_t mac[6], uint8_t percent, uint32_t windowSec, uint32_t random) {
+  RolloutPlan plan;
+  plan.cohort = rolloutCohort(mac);
+  plan.apply = plan.cohort < percent;
+  if (windowSec > ROLLOUT_MAX_WINDOW) windowSec = ROLLOUT_MAX_WINDOW;
+  uint64_t windowMs = (uint64_t)windowSec * 1000;
+  plan.delayMs = plan.apply && windowMs > 0 ? (uint32_t)(((uint64_t)random * windowMs) >> 32) : 0;
+  return plan;
+}
+
+#endif
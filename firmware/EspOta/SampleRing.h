@@ -0,0 +1,67 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Capacidad del buffer de muestras (en cantidad de muestras)
+#ifndef TELEMETRY_RING_CAPACITY
+#define TELEMETRY_RING_CAPACITY 64
+#endif
+
+// Una muestra: tipo y unidad son punteros a cadenas que deben vivir siempre
+// (literales o constantes globales); así cada muestra ocupa 16 bytes fijos.
+struct Sample {
+  const char* type;
+  const char* unit;
+  float value;
+  uint32_t at;  // millis() en el momento de la lectura
+};
+
+// Buffer circular de capacidad fija, sin memoria dinámica. Si se llena antes de
+// poder enviarse, la muestra nueva pisa a la más vieja y se cuenta como perdida.
+class SampleRing {
+public:
+  SampleRing() : _head(0), _count(0), _dropped(0) {}
+
+  // Devuelve false si tuvo que descartar la muestra más vieja
+  bool push(const char* type, float value, const char* unit, uint32_t now) {
+    bool overwrote = false;
+    if (_count == TELEMETRY_RING_CAPACITY) {
+      _head = (_head + 1) % TELEMETRY_RING_CAPACITY;
+      _count--;
+      _dropped++;
+      overwrote = true;
+    }
+    Sample& s = _samples[(_head + _count) % TELEMETRY_RING_CAPACITY];
+    s.type = type;
+    s.unit = unit;
+    s.value = value;
+    s.at = now;
+    _count++;
+    return !overwrote;
+  }
+
+  // i = 0 es la muestra más vieja
+  const Sample& at(size_t i) const { return _samples[(_head + i) % TELEMETRY_RING_CAPACITY]; }
+
+  // Libera las n muestras más viejas (ya enviadas)
+  void drop(size_t n) {
+    if (n > _count) n = _count;
+    _head = (_head + n) % TELEMETRY_RING_CAPACITY;
+    _count -= n;
+  }
+
+  size_t size() const { return _count; }
+  bool empty() const { return _count == 0; }
+  static size_t capacity() { return TELEMETRY_RING_CAPACITY; }
+  uint32_t dropped() const { return _dropped; }
+
+private:
+  Sample _samples[TELEMETRY_RING_CAPACITY];
+  size_t _head;
+  size_t _count;
+  uint32_t _dropped;
+};
+
+#endif
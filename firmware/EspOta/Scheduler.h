@@ -0,0 +1,220 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Tareas registrables, cubetas de la rueda (potencia de 2) y ms que cubre cada cubeta.
+// Con los valores por defecto una vuelta de la rueda son 640 ms.
+#ifndef SCHEDULER_JOBS
+#define SCHEDULER_JOBS 16
+#endif
+#ifndef SCHEDULER_SLOTS
+#define SCHEDULER_SLOTS 64
+#endif
+#ifndef SCHEDULER_TICK_MS
+#define SCHEDULER_TICK_MS 10
+#endif
+
+// run()/nextIn() sin ninguna tarea programada
+#define SCHEDULER_IDLE 0xFFFFFFFFUL
+
+typedef void (*SchedulerFn)(void* ctx);
+
+// Planificador cooperativo sobre una rueda de tiempos, sin memoria dinámica ni dependencia de
+// Arduino (el tiempo lo pasa quien llama). Cada tarea vive en la cubeta de su vencimiento:
+// run() solo recorre las cubetas de los ticks transcurridos desde la llamada anterior, así que
+// las tareas lejanas no cuestan nada hasta que les toca. Los vencimientos son exactos al ms;
+// el tick solo decide la cubeta. Los ticks se cuentan desde el primer uso, no desde 0 ms, para
+// que el desborde de millis() no mueva las tareas de cubeta.
+//
+// Una tarea registrada conserva su identificador hasta remove(): al vencer, una de una vez
+// queda detenida y start() la vuelve a programar. No es segura entre tareas de FreeRTOS:
+// cada planificador lo usa un solo contexto (loop() o la tarea de red).
+//
+//   int8_t id = jobs.every(now, 60000, heartbeat, this);
+//   unsigned long wait = jobs.run(millis());  // ms hasta el próximo vencimiento
+class Scheduler {
+public:
+  Scheduler() : _tick(0), _tickMs(0), _primed(false) {
+    static_assert((SCHEDULER_SLOTS & (SCHEDULER_SLOTS - 1)) == 0, "SCHEDULER_SLOTS debe ser potencia de 2");
+    for (size_t i = 0; i < SCHEDULER_SLOTS; i++) _slots[i] = -1;
+    for (size_t i = 0; i < SCHEDULER_JOBS; i++) {
+      _jobs[i].fn = nullptr;
+      _jobs[i].armed = false;
+      _jobs[i].firing = false;
+    }
+  }
+
+  // Registra una tarea detenida. Devuelve su identificador, o -1 si no hay lugar.
+  int8_t add(SchedulerFn fn, void* ctx) {
+    if (!fn) return -1;
+    for (int8_t id = 0; id < SCHEDULER_JOBS; id++) {
+      Job& j = _jobs[id];
+      if (j.fn) continue;
+      j.fn = fn;
+      j.ctx = ctx;
+      j.period = 0;
+      j.armed = false;
+      j.firing = false;
+      return id;
+    }
+    return -1;
+  }
+
+  // Programa la tarea para dentro de delayMs; con periodMs > 0 se repite con ese período.
+  // Si ya estaba programada, se reemplaza el vencimiento anterior.
+  bool start(int8_t id, uint32_t now, uint32_t delayMs, uint32_t periodMs = 0) {
+    if (!valid(id)) return false;
+    Job& j = _jobs[id];
+    unlink(id);
+    j.period = periodMs;
+    j.due = now + delayMs;
+    j.firing = false;
+    prime(now);
+    link(id);
+    return true;
+  }
+
+  void stop(int8_t id) {
+    if (!valid(id)) return;
+    unlink(id);
+    _jobs[id].firing = false;
+  }
+
+  void remove(int8_t id) {
+    if (!valid(id)) return;
+    stop(id);
+    _jobs[id].fn = nullptr;
+  }
+
+  bool pending(int8_t id) const { return valid(id) && _jobs[id].armed; }
+
+  // Atajos: add() + start()
+  int8_t every(uint32_t now, uint32_t periodMs, SchedulerFn fn, void* ctx) {
+    int8_t id = add(fn, ctx);
+    if (id >= 0) start(id, now, periodMs, periodMs);
+    return id;
+  }
+  int8_t after(uint32_t now, uint32_t delayMs, SchedulerFn fn, void* ctx) {
+    int8_t id = add(fn, ctx);
+    if (id >= 0) start(id, now, delayMs);
+    return id;
+  }
+
+  // Ejecuta las tareas vencidas y devuelve los ms hasta el próximo vencimiento
+  // (0 si alguna ya venció de nuevo, SCHEDULER_IDLE si no hay ninguna programada).
+  uint32_t run(uint32_t now) {
+    prime(now);
+    uint32_t steps = (now - _tickMs) / SCHEDULER_TICK_MS;
+    uint32_t target = _tick + steps;
+    // Atrasado más de una vuelta: alcanza con recorrer cada cubeta una vez
+    uint32_t from = steps >= SCHEDULER_SLOTS ? target - (SCHEDULER_SLOTS - 1) : _tick;
+
+    int8_t due[SCHEDULER_JOBS];
+    size_t count = 0;
+    for (uint32_t t = from; t != target + 1; t++) {
+      int8_t id = _slots[t & (SCHEDULER_SLOTS - 1)];
+      while (id >= 0) {
+        int8_t next = _jobs[id].next;
+        if ((int32_t)(_jobs[id].due - now) <= 0) {
+          unlink(id);
+          _jobs[id].firing = true;
+          due[count++] = id;
+        }
+        id = next;
+      }
+    }
+    _tick = target;
+    _tickMs += steps * SCHEDULER_TICK_MS;
+
+    // Los períodos se reprograman antes de llamar a la tarea, que puede detenerse o moverse.
+    // Una tarea atrasada más de un período no se pone al día con varias ejecuciones seguidas.
+    for (size_t i = 0; i < count; i++) {
+      Job& j = _jobs[due[i]];
+      if (!j.firing) continue;  // otra tarea de este mismo run() la detuvo o la movió
+      j.firing = false;
+      if (j.period > 0) {
+        j.due += j.period;
+        if ((int32_t)(j.due - now) <= 0) j.due = now + j.period;
+        link(due[i]);
+      }
+      j.fn(j.ctx);
+    }
+    return nextIn(now);
+  }
+
+  // ms hasta el próximo vencimiento sin ejecutar nada
+  uint32_t nextIn(uint32_t now) const {
+    // Primero la vuelta actual de la rueda, cubeta por cubeta: la primera no vacía tiene
+    // el vencimiento más cercano
+    for (uint32_t k = 0; k < SCHEDULER_SLOTS; k++) {
+      bool found = false;
+      uint32_t best = 0;
+      for (int8_t id = _slots[(_tick + k) & (SCHEDULER_SLOTS - 1)]; id >= 0; id = _jobs[id].next) {
+        if (_jobs[id].tick != _tick + k) continue;  // vueltas posteriores
+        uint32_t wait = (int32_t)(_jobs[id].due - now) <= 0 ? 0 : _jobs[id].due - now;
+        if (!found || wait < best) best = wait;
+        found = true;
+      }
+      if (found) return best;
+    }
+    // Nada en esta vuelta: el vencimiento más cercano entre las tareas lejanas
+    uint32_t best = SCHEDULER_IDLE;
+    for (size_t i = 0; i < SCHEDULER_JOBS; i++) {
+      if (!_jobs[i].armed) continue;
+      uint32_t wait = (int32_t)(_jobs[i].due - now) <= 0 ? 0 : _jobs[i].due - now;
+      if (wait < best) best = wait;
+    }
+    return best;
+  }
+
+private:
+  struct Job {
+    SchedulerFn fn;
+    void* ctx;
+    uint32_t due;     // vencimiento en ms (mismo reloj que now)
+    uint32_t period;  // 0 = una sola vez
+    uint32_t tick;    // tick de la cubeta en la que está
+    int8_t next;      // siguiente tarea de la misma cubeta
+    bool armed;       // está en la rueda
+    bool firing;      // vencida en el run() en curso, todavía sin ejecutar
+  };
+
+  bool valid(int8_t id) const { return id >= 0 && id < SCHEDULER_JOBS && _jobs[id].fn; }
+
+  // La primera vez que se conoce la hora, la rueda arranca en ese instante
+  void prime(uint32_t now) {
+    if (_primed) return;
+    _tickMs = now;
+    _primed = true;
+  }
+
+  // Un vencimiento ya pasado va a la cubeta actual, que run() siempre vuelve a revisar
+  void link(int8_t id) {
+    Job& j = _jobs[id];
+    int32_t ahead = (int32_t)(j.due - _tickMs);
+    j.tick = ahead > 0 ? _tick + (uint32_t)ahead / SCHEDULER_TICK_MS : _tick;
+    int8_t& head = _slots[j.tick & (SCHEDULER_SLOTS - 1)];
+    j.next = head;
+    head = id;
+    j.armed = true;
+  }
+
+  void unlink(int8_t id) {
+    Job& j = _jobs[id];
+    if (!j.armed) return;
+    int8_t* p = &_slots[j.tick & (SCHEDULER_SLOTS - 1)];
+    while (*p >= 0 && *p != id) p = &_jobs[*p].next;
+    if (*p == id) *p = j.next;
+    j.armed = false;
+  }
+
+  Job _jobs[SCHEDULER_JOBS];
+  int8_t _slots[SCHEDULER_SLOTS];
+  uint32_t _tick;    // último tick recorrido por run()
+  uint32_t _tickMs;  // ms en que empieza _tick
+  bool _primed;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Cola sin locks de mensajes de largo variable para un solo productor y un solo
+// consumidor (por ejemplo loop() y la tarea de red). No depende de Arduino ni de
+// FreeRTOS: el mismo código corre en Linux con std::thread.
+//
+// Cada mensaje ocupa una cabecera de 4 bytes con su largo más los datos, alineado a
+// 4 bytes y siempre contiguo: si no entra antes del final del buffer se deja una
+// marca de salto y se escribe desde el principio. Por eso un mensaje puede ocupar
+// como máximo la mitad de la capacidad.
+//
+//   Productor:  uint8_t* p = ring.reserve(n); ...llenar hasta n bytes...; ring.commit(usados);
+//   Consumidor: size_t len; const uint8_t* p = ring.peek(len); ...usar...; ring.release();
+class SpscRing {
+public:
+  SpscRing() : _buf(nullptr), _cap(0), _head(0), _tail(0), _resHead(0), _resLen(0),
+               _dropped(0), _highWater(0) {}
+
+  // capacity debe ser potencia de 2 (mínimo 16 bytes); el buffer debe estar alineado a 4
+  bool begin(uint8_t* buffer, size_t capacity) {
+    if (!buffer || capacity < 16 || (capacity & (capacity - 1)) != 0) return false;
+    _buf = buffer;
+    _cap = (uint32_t)capacity;
+    _head.store(0, std::memory_order_relaxed);
+    _tail.store(0, std::memory_order_relaxed);
+    return true;
+  }
+
+  bool ready() const { return _buf != nullptr; }
+  size_t capacity() const { return _cap; }
+  size_t maxMessage() const { return _cap / 2 - HEADER; }
+
+  // Lado productor: reserva espacio contiguo para hasta len bytes, o nullptr si no hay
+  // lugar (se cuenta como descartado). No publica nada hasta commit().
+  uint8_t* reserve(size_t len) {
+    uint8_t* p = tryReserve(len);
+    if (!p) _dropped.fetch_add(1, std::memory_order_relaxed);
+    return p;
+  }
+
+  // Como reserve(), pero sin contar el descarte: para el productor que guarda el
+  // mensaje y reintenta más tarde
+  uint8_t* tryReserve(size_t len) {
+    if (!_buf || len > maxMessage()) return nullptr;
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+    uint32_t need = HEADER + align(len);
+    uint32_t off = head & (_cap - 1);
+    uint32_t skip = _cap - off < need ? _cap - off : 0;  // salto al principio
+    if (_cap - (head - tail) < skip + need) return nullptr;
+    _resHead = head + skip;
+    _resLen = (uint32_t)len;
+    if (skip) writeWord(off, WRAP);
+    return _buf + (_resHead & (_cap - 1)) + HEADER;
+  }
+
+  // Publica el mensaje reservado con len <= lo pedido en reserve()
+  void commit(size_t len) {
+    if (len > _resLen) len = _resLen;
+    writeWord(_resHead & (_cap - 1), (uint32_t)len);
+    uint32_t head = _resHead + HEADER + align(len);
+    _head.store(head, std::memory_order_release);
+    uint32_t used = head - _tail.load(std::memory_order_relaxed);
+    if (used > _highWater.load(std::memory_order_relaxed)) _highWater.store(used, std::memory_order_relaxed);
+  }
+
+  // Reserva + copia + commit en un paso
+  bool push(const void* data, size_t len) {
+    uint8_t* p = reserve(len);
+    if (!p) return false;
+    memcpy(p, data, len);
+    commit(len);
+    return true;
+  }
+
+  // Lado consumidor: el mensaje más viejo sin sacarlo, o nullptr si la cola está vacía
+  const uint8_t* peek(size_t& len) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) return nullptr;
+    uint32_t off = tail & (_cap - 1);
+    uint32_t word = readWord(off);
+    if (word == WRAP) {
+      tail += _cap - off;
+      _tail.store(tail, std::memory_order_release);
+      off = 0;
+      word = readWord(0);
+    }
+    len = word;
+    return _buf + off + HEADER;
+  }
+
+  // Saca el mensaje devuelto por peek()
+  void release() {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    uint32_t len = readWord(tail & (_cap - 1));
+    _tail.store(tail + HEADER + align(len), std::memory_order_release);
+  }
+
+  bool empty() const {
+    return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+  }
+  // Bytes ocupados (aproximado si se consulta desde un tercer hilo)
+  size_t used() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+  }
+  uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+  uint32_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+
+private:
+  static const uint32_t HEADER = 4;
+  static const uint32_t WRAP = 0xFFFFFFFFUL;
+
+  static uint32_t align(size_t len) { return (uint32_t)((len + 3) & ~(size_t)3); }
+  void writeWord(uint32_t off, uint32_t v) { memcpy(_buf + off, &v, sizeof(v)); }
+  uint32_t readWord(uint32_t off) const { uint32_t v; memcpy(&v, _buf + off, sizeof(v)); return v; }
+
+  uint8_t* _buf;
+  uint32_t _cap;
+  std::atomic<uint32_t> _head;  // lo escribe solo el productor (contador libre, no índice)
+  std::atomic<uint32_t> _tail;  // lo escribe solo el consumidor
+  uint32_t _resHead;            // reserva en curso (solo productor)
+  uint32_t _resLen;
+  std::atomic<uint32_t> _dropped;
+  std::atomic<uint32_t> _highWater;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef WIFI_FAST_CONNECT_H
+#define WIFI_FAST_CONNECT_H
+
+#include <WiFi.h>
+#include <Preferences.h>
+
+// Tiempo máximo de la unión directa antes de volver al procedimiento normal (ms)
+#ifndef WIFI_FAST_JOIN_TIMEOUT
+#define WIFI_FAST_JOIN_TIMEOUT 3000
+#endif
+
+#define WIFI_PREFS_NAMESPACE "wifi"
+
+// Último enlace exitoso: red, punto de acceso y concesión DHCP
+struct WiFiLinkRecord {
+  char ssid[33];
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+};
+
+// Tiempos de conexión WiFi
+struct WiFiConnectStats {
+  unsigned long lastConnectMs;  // tiempo hasta conectado en la última conexión
+  bool lastWasFast;             // la última conexión usó la unión directa
+  uint32_t fastJoins;           // uniones directas exitosas
+  uint32_t fastFailures;        // uniones directas fallidas (se siguió con la lista)
+  uint32_t fullJoins;           // conexiones por el procedimiento normal
+};
+
+// Recuerda el BSSID, canal y concesión DHCP de la última red que funcionó, en RTC
+// (sobrevive a reinicios por software) y en NVS (sobrevive a cortes de energía).
+// Con eso, el primer intento es una unión directa sin escaneo.
+//
+// La IP anterior solo se reutiliza (sin DHCP) si el registro viene de RTC, en la
+// primera unión tras el reinicio y si esa IP la dio DHCP: tras un corte de energía la
+// concesión puede haber vencido, y una IP reutilizada no se vuelve a guardar como
+// concesión (el próximo arranque pide una nueva). NVS guarda solo red, AP y canal.
+class WiFiFastConnect {
+public:
+  WiFiFastConnect();
+
+  // Carga el registro (RTC primero, después NVS). Devuelve false si no hay.
+  bool load();
+  bool hasRecord() const { return _hasRecord; }
+  const WiFiLinkRecord& record() const { return _rec; }
+
+  // Lanza la unión directa al BSSID/canal guardado con la contraseña de esa red.
+  // No espera: el llamador vigila la conexión con un plazo de WIFI_FAST_JOIN_TIMEOUT.
+  bool start(const char* password);
+
+  // La unión directa no conectó a tiempo: vuelve a DHCP e invalida la copia en RTC
+  void failed();
+
+  // Vuelve a DHCP si quedó la IP fija de una unión directa. Llamar antes de cualquier
+  // WiFi.begin() que no sea start() y al perder el enlace.
+  void useDhcp();
+
+  // Versión bloqueante: start() y espera hasta timeoutMs (llama a failed() si no conecta)
+  bool join(const char* password, unsigned long timeoutMs = WIFI_FAST_JOIN_TIMEOUT);
+
+  // Guarda el enlace actual (llamar tras conectar). NVS solo se escribe si cambió.
+  void save();
+
+  // Borra el registro (por ejemplo si la red dejó de estar configurada)
+  void forget();
+
+private:
+  WiFiLinkRecord _rec;
+  WiFiLinkRecord _nvsRec;
+  bool _hasRecord;
+  bool _hasNvs;
+  bool _fromRtc;       // registro de RTC en la primera unión del arranque
+  bool _usedLease;     // la unión en curso usa la IP fija de RTC
+  bool _leaseOffered;  // la concesión de RTC ya se ofreció en este arranque
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef WIFI_RANKING_H
+#define WIFI_RANKING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Máximo de redes configuradas que entran en el ranking
+#ifndef WIFI_MAX_NETWORKS
+#define WIFI_MAX_NETWORKS 16
+#endif
+
+// Peso del historial frente al RSSI: una red que siempre conecta le gana a
+// una que nunca conecta aunque tenga hasta este valor de dBm más de señal
+#ifndef WIFI_RANK_HISTORY_WEIGHT
+#define WIFI_RANK_HISTORY_WEIGHT 20
+#endif
+
+// Historial de conexiones de una red configurada
+struct WiFiNetStats {
+  uint16_t attempts;
+  uint16_t successes;
+};
+
+// Red configurada que apareció en el escaneo, lista para intentar
+struct WiFiCandidate {
+  size_t index;       // posición en la lista configurada
+  int32_t rssi;       // mejor RSSI visto para ese SSID (dBm)
+  uint8_t bssid[6];   // AP con ese RSSI: se une directo sin volver a escanear
+  int32_t channel;
+  int32_t score;      // RSSI + bonificación por historial, en centésimas de dBm
+};
+
+// Cruza un escaneo con la lista de redes configuradas y ordena las alcanzables
+// por RSSI y tasa de éxito. No depende de Arduino: se puede probar en el host
+// con resultados de escaneo sintéticos.
+//
+//   WiFiRanker ranker;
+//   for (i...) ranker.addNetwork(ssids[i], history[i]);
+//   for (j...) ranker.addScanResult(WiFi.SSID(j).c_str(), WiFi.RSSI(j), WiFi.BSSID(j), WiFi.channel(j));
+//   size_t n = ranker.rank(candidates, WIFI_MAX_NETWORKS);
+class WiFiRanker {
+public:
+  WiFiRanker() : _count(0) {}
+
+  // Agrega una red configurada (en orden de prioridad, que desempata)
+  bool addNetwork(const char* ssid, const WiFiNetStats& stats) {
+    if (_count >= WIFI_MAX_NETWORKS || !ssid) return false;
+    Slot& s = _slots[_count++];
+    s.ssid = ssid;
+    s.stats = stats;
+    s.seen = false;
+    return true;
+  }
+
+  // Un resultado del escaneo; si el SSID aparece varias veces se queda el AP más fuerte
+  void addScanResult(const char* ssid, int32_t rssi, const uint8_t* bssid, int32_t channel) {
+    if (!ssid) return;
+    for (size_t i = 0; i < _count; i++) {
+      Slot& s = _slots[i];
+      if (strcmp(s.ssid, ssid) != 0) continue;
+      if (!s.seen || rssi > s.rssi) {
+        s.seen = true;
+        s.rssi = rssi;
+        s.channel = channel;
+        if (bssid) memcpy(s.bssid, bssid, sizeof(s.bssid));
+        else memset(s.bssid, 0, sizeof(s.bssid));
+      }
+    }
+  }
+
+  // Escribe en out las redes alcanzables, de mejor a peor. Devuelve cuántas.
+  size_t rank(WiFiCandidate* out, size_t max) const {
+    size_t n = 0;
+    for (size_t i = 0; i < _count && n < max; i++) {
+      const Slot& s = _slots[i];
+      if (!s.seen) continue;
+      WiFiCandidate c;
+      c.index = i;
+      c.rssi = s.rssi;
+      memcpy(c.bssid, s.bssid, sizeof(c.bssid));
+      c.channel = s.channel;
+      c.score = score(s.rssi, s.stats);
+
+      // Inserción estable: a igual puntaje queda primero la de mayor prioridad
+      size_t pos = n;
+      while (pos > 0 && out[pos - 1].score < c.score) {
+        out[pos] = out[pos - 1];
+        pos--;
+      }
+      out[pos] = c;
+      n++;
+    }
+    return n;
+  }
+
+  // Tasa de éxito con suavizado de Laplace: una red sin historial vale 0,5
+  static int32_t score(int32_t rssi, const WiFiNetStats& stats) {
+    int32_t rate = (int32_t)(((uint32_t)stats.successes + 1) * 100 / ((uint32_t)stats.attempts + 2));
+    return rssi * 100 + WIFI_RANK_HISTORY_WEIGHT * rate;
+  }
+
+  // Actualiza el historial tras un intento; a partir de 1000 se reduce a la mitad
+  // para que el comportamiento reciente pese más que el de hace semanas
+  static void record(WiFiNetStats& stats, bool success) {
+    if (stats.attempts >= 1000) {
+      stats.attempts /= 2;
+      stats.successes /= 2;
+    }
+    stats.attempts++;
+    if (success) stats.successes++;
+  }
+
+private:
+  struct Slot {
+    const char* ssid;
+    WiFiNetStats stats;
+    bool seen;
+    int32_t rssi;
+    uint8_t bssid[6];
+    int32_t channel;
+  };
+  Slot _slots[WIFI_MAX_NETWORKS];
+  size_t _count;
+};
+
+#endif
@@ -33,12 +33,14 @@ void Esp32OTA::begin() {
   Serial.begin(115200);
   delay(500);
   deviceMac = WiFi.macAddress();
+  WiFi.macAddress(macBytes);
   Serial.println("MAC: " + deviceMac);
 
-  // configurar MQTT client (SSL insecure para demo)
-  wifiClient.setInsecure();
+  // configurar MQTT client (TLS sin validar certificado, con reanudación de sesión)
   mqttClient.setClient(wifiClient);
   mqttClient.setServer(_mqttHost, _mqttPort);
+  // Los lotes de telemetría superan el buffer por defecto (256 bytes)
+  mqttClient.setBufferSize(TELEMETRY_BATCH_BYTES + 128);
   mqttClient.setCallback([this](char* topic, byte* payload, unsigned int length){
     this->mqttCallback(topic, payload, length);
   });
@@ -65,6 +67,34 @@ bool Esp32OTA::connectWiFi() {
   if (wifiCount == 0) return false;
 
   unsigned long startAll = millis();
+
+  // Primero, unión directa (sin escaneo) a la última red que funcionó
+  if (wifiFast.load()) {
+    const char* pass = nullptr;
+    for (size_t i = 0; i < wifiCount; ++i) {
+      if (strcmp(wifiList[i].ssid, wifiFast.record().ssid) == 0) pass = wifiList[i].pass;
+    }
+    if (!pass) {
+      wifiFast.forget();  // la red ya no está configurada
+    } else if (wifiFast.join(pass)) {
+      wifiConnected(startAll, true);
+      return true;
+    } else {
+      wifiStats.fastFailures++;
+    }
+  }
+
+  // Con un escaneo válido no se espera el timeout de redes que no aparecieron
+  if (wifiSelection == WIFI_SELECT_RANKED) {
+    bool scanOk = false;
+    if (connectRanked(startAll, scanOk)) return true;
+    if (scanOk) {
+      Serial.println("No se conectó a ninguna red visible.");
+      lastWiFiAttempt = millis();
+      return false;
+    }
+  }
+
   // Intentamos cada red una vez (con timeout por red), hasta que nos conectemos
   for (size_t i = 0; i < wifiCount; ++i) {
     size_t idx = (currentWifiIndex + i) % wifiCount;
@@ -73,6 +103,7 @@ bool Esp32OTA::connectWiFi() {
 
     Serial.printf("Intentando WiFi [%d/%d]: %s\n", (int)(i+1), (int)wifiCount, ssid);
     WiFi.disconnect(true); // limpiar
+    wifiFast.useDhcp();    // sin la IP fija de una unión directa a otra red
     delay(100);
     WiFi.begin(ssid, pass);
 
@@ -80,11 +111,13 @@ bool Esp32OTA::connectWiFi() {
     while (millis() - start < perNetworkTimeout) {
       if (WiFi.status() == WL_CONNECTED) {
         currentWifiIndex = idx; // guardar índice de la red que funcionó
-        Serial.println("Conectado a WiFi: " + WiFi.localIP().toString());
+        if (idx < WIFI_MAX_NETWORKS) WiFiRanker::record(wifiHistory[idx], true);
+        wifiConnected(startAll, false);
         return true;
       }
       delay(200);
     }
+    if (idx < WIFI_MAX_NETWORKS) WiFiRanker::record(wifiHistory[idx], false);
     Serial.println("Timeout para SSID: " + String(ssid));
   }
 
@@ -96,6 +129,69 @@ bool Esp32OTA::connectWiFi() {
   return false;
 }
 
+// Un solo escaneo: se cruza con wifiList y se prueban solo las redes visibles,
+// de mejor a peor, uniéndose directo al BSSID/canal visto en el escaneo.
+// scanOk queda en false si el escaneo falló (el llamador prueba en orden).
+bool Esp32OTA::connectRanked(unsigned long startMs, bool& scanOk) {
+  WiFi.mode(WIFI_STA);
+  int16_t found = WiFi.scanNetworks(false, false, false, WIFI_SCAN_MS_PER_CHAN);
+  scanOk = found >= 0;
+  if (!scanOk) {
+    Serial.println("Falló el escaneo WiFi, se prueban las redes en orden.");
+    return false;
+  }
+
+  WiFiRanker ranker;
+  for (size_t i = 0; i < wifiCount && i < WIFI_MAX_NETWORKS; ++i) {
+    ranker.addNetwork(wifiList[i].ssid, wifiHistory[i]);
+  }
+  for (int16_t j = 0; j < found; ++j) {
+    ranker.addScanResult(WiFi.SSID(j).c_str(), WiFi.RSSI(j), WiFi.BSSID(j), WiFi.channel(j));
+  }
+  WiFi.scanDelete();
+
+  WiFiCandidate candidates[WIFI_MAX_NETWORKS];
+  size_t n = ranker.rank(candidates, WIFI_MAX_NETWORKS);
+  Serial.printf("Escaneo en %lu ms: %d de %d redes configuradas al alcance\n",
+                millis() - startMs, (int)n, (int)wifiCount);
+
+  for (size_t k = 0; k < n; ++k) {
+    const WiFiCandidate& c = candidates[k];
+    const WiFiCred& cred = wifiList[c.index];
+    Serial.printf("Intentando WiFi [%d/%d]: %s (%ld dBm, canal %ld)\n",
+                  (int)(k+1), (int)n, cred.ssid, (long)c.rssi, (long)c.channel);
+    WiFi.disconnect(true);
+    wifiFast.useDhcp();
+    delay(100);
+    WiFi.begin(cred.ssid, cred.pass, c.channel, c.bssid, true);
+
+    unsigned long start = millis();
+    while (WiFi.status() != WL_CONNECTED && millis() - start < perNetworkTimeout) {
+      delay(100);
+    }
+    bool ok = WiFi.status() == WL_CONNECTED;
+    WiFiRanker::record(wifiHistory[c.index], ok);
+    if (ok) {
+      currentWifiIndex = c.index;
+      wifiConnected(startMs, false);
+      return true;
+    }
+    Serial.println("Timeout para SSID: " + String(cred.ssid));
+  }
+  return false;
+}
+
+// Registra el tiempo de conexión y guarda el enlace para la próxima unión directa
+void Esp32OTA::wifiConnected(unsigned long startMs, bool fast) {
+  wifiStats.lastConnectMs = millis() - startMs;
+  wifiStats.lastWasFast = fast;
+  if (fast) wifiStats.fastJoins++;
+  else wifiStats.fullJoins++;
+  wifiFast.save();
+  Serial.printf("Conectado a WiFi %s en %lu ms%s: %s\n", WiFi.SSID().c_str(), wifiStats.lastConnectMs,
+                fast ? " (directo)" : "", WiFi.localIP().toString().c_str());
+}
+
 void Esp32OTA::forceConnectWiFi() {
   // Forzamos intento inmediato (usa con moderación)
   connectWiFi();
@@ -107,22 +203,35 @@ void Esp32OTA::connectMQTT() {
     return;
   }
 
-  String clientId = "ESP32_" + deviceMac;
-  String willMessage = "{\"mac\":\"" + deviceMac + "\",\"name\":\"" + _deviceName + "\",\"status\":\"offline\"}";
+  char clientId[32];
+  snprintf(clientId, sizeof(clientId), "ESP32_%s", deviceMac.c_str());
+  JsonMessage<160> willMessage;
+  willMessage.beginObject()
+             .field("mac", deviceMac.c_str())
+             .field("name", _deviceName)
+             .field("status", "offline")
+             .endObject();
 
   // reconexión con backoff simple
   if (millis() - lastMqttAttempt < mqttReconnectInterval) return;
   lastMqttAttempt = millis();
 
   Serial.println("Conectando a MQTT...");
-  if(mqttClient.connect(clientId.c_str(), _mqttUser, _mqttPass,
+  if(mqttClient.connect(clientId, _mqttUser, _mqttPass,
                        TOPIC_STATUS, 0, false, willMessage.c_str())) {
     Serial.println("Conectado a MQTT.");
     // Publicar estado online junto con la versión del firmware
-    String onlineMsg = "{\"mac\":\"" + deviceMac + "\",\"name\":\"" + _deviceName +
-                       "\",\"status\":\"ONLINE\",\"version\":\"" + _firmwareVersion + "\"}";
+    JsonMessage<192> onlineMsg;
+    onlineMsg.beginObject()
+             .field("mac", deviceMac.c_str())
+             .field("name", _deviceName)
+             .field("status", "ONLINE")
+             .field("version", _firmwareVersion)
+             .endObject();
     mqttClient.publish(TOPIC_STATUS, onlineMsg.c_str(), false);
-    mqttClient.subscribe(TOPIC_UPDATE);
+    // Resultado de la OTA que provocó el último reinicio
+    otaReportPending();
+    subscribeUpdates();
     // resetear backoff a valor base
     mqttReconnectInterval = 2000;
   } else {
@@ -134,29 +243,88 @@ void Esp32OTA::connectMQTT() {
   }
 }
 
+// Tópicos de comandos OTA: el propio, los de grupo, el de toda la flota y el compartido
+void Esp32OTA::subscribeUpdates() {
+  char topic[96];
+  snprintf(topic, sizeof(topic), "%s%s", TOPIC_UPDATE_PREFIX, deviceMac.c_str());
+  mqttClient.subscribe(topic);
+  for (size_t i = 0; i < updateGroupCount; i++) {
+    snprintf(topic, sizeof(topic), "%s%s", TOPIC_UPDATE_GROUP, updateGroups[i]);
+    mqttClient.subscribe(topic);
+  }
+  mqttClient.subscribe(TOPIC_UPDATE_ALL);
+  if (legacyUpdateTopic) mqttClient.subscribe(TOPIC_UPDATE);
+}
+
+bool Esp32OTA::addUpdateGroup(const char* group) {
+  if (!group || !*group || updateGroupCount >= MQTT_MAX_UPDATE_GROUPS) return false;
+  updateGroups[updateGroupCount++] = group;
+  return true;
+}
+
 void Esp32OTA::mqttCallback(char* topic, byte* payload, unsigned int length) {
-  String msg;
-  for(unsigned int i = 0; i < length; i++) {
-    msg += (char)payload[i];
+  // "<MAC|all>|<URL>" o "<MAC|all>|manifest|<versión>|<tamaño>|<sha256>|<URL>" (sin copiar el payload)
+  OtaCommand cmd;
+  OtaParseResult result = parseOtaCommand(payload, length, deviceMac.c_str(), cmd);
+  if (result == OTA_PARSE_OTHER_TARGET) return;
+  Serial.printf("Mensaje en %s: %.*s\n", topic, (int)length, (const char*)payload);
+  if (result != OTA_PARSE_OK || cmd.kind == OTA_CMD_DELTA) return;
+
+  OtaManifest image;
+  image.size = 0;
+  image.signatureLen = cmd.signatureLen;
+  memcpy(image.signature, cmd.signature, cmd.signatureLen);
+  if (otaVerify.hasPublicKey() && cmd.signatureLen == 0) {
+    Serial.println("Comando OTA sin firma y hay clave configurada, se ignora");
+    otaReport("failed", nullptr, "imagen sin firma");
+    return;
   }
-  Serial.println("Mensaje en " + String(topic) + ": " + msg);
 
-  // Se espera el formato: "<MAC>|<URL>" o "all|<URL>"
-  int sepIndex = msg.indexOf('|');
-  if(sepIndex < 0) return;
-  String targetId = msg.substring(0, sepIndex);
-  String firmwareUrl = msg.substring(sepIndex + 1);
+  // Manifiesto: si la imagen anunciada ya es la que corre no se descarga nada
+  if (cmd.kind == OTA_CMD_MANIFEST) {
+    image.version.concat(cmd.version.data, cmd.version.len);
+    image.size = cmd.imageSize;
+    memcpy(image.sha256, cmd.sha256, sizeof(image.sha256));
+    if (isRunningImage(cmd.version, cmd.sha256)) {
+      Serial.println("Ya corre la versión " + image.version + " con el mismo hash, se omite la OTA");
+      otaReport("skipped", image.version.c_str(), "misma imagen");
+      return;
+    }
+  }
 
-  if((targetId == deviceMac || targetId == "all") && firmwareUrl.startsWith("http")) {
-    Serial.println("Iniciando OTA con URL: " + firmwareUrl);
-    doOTA(firmwareUrl);
-    if(otaUpdateCallback) {
-      otaUpdateCallback(firmwareUrl);
+  String firmwareUrl;
+  firmwareUrl.concat(cmd.url.data, cmd.url.len);
+
+  // Comandos para toda la flota: cohorte por MAC y espera al azar dentro de la ventana
+  if (cmd.target.equals("all") && (cmd.percent < 100 || cmd.windowSec > 0)) {
+    RolloutPlan plan = planRollout(macBytes, cmd.percent, cmd.windowSec, esp_random());
+    if (!plan.apply) {
+      Serial.printf("Cohorte %u fuera del %u%% del despliegue, se omite la OTA\n",
+                    (unsigned)plan.cohort, (unsigned)cmd.percent);
+      return;
     }
+    if (plan.delayMs > 0) {
+      Serial.printf("Cohorte %u: OTA programada en %lu s\n", (unsigned)plan.cohort,
+                    (unsigned long)(plan.delayMs / 1000));
+      otaScheduled = true;
+      otaScheduledAt = millis() + plan.delayMs;
+      otaScheduledUrl = firmwareUrl;
+      otaScheduledImage = image;
+      return;
+    }
+  }
+  otaScheduled = false;
+
+  Serial.println("Iniciando OTA con URL: " + firmwareUrl);
+  doOTA(firmwareUrl, image);
+  if(otaUpdateCallback) {
+    otaUpdateCallback(firmwareUrl);
   }
 }
 
-void Esp32OTA::doOTA(const String &url) {
+void Esp32OTA::doOTA(const String &url, const OtaManifest &image) {
+  const char* targetVersion = image.version.c_str();
+  size_t expectedSize = image.size;
   Serial.println("[OTA] Descargando firmware desde: " + url);
   HTTPClient http;
   http.begin(url);
@@ -164,35 +332,198 @@ void Esp32OTA::doOTA(const String &url) {
   if(httpCode == 200) {
     int contentLength = http.getSize();
     WiFiClient *stream = http.getStreamPtr();
-    if(contentLength > 0 && Update.begin(contentLength)) {
-      size_t written = Update.writeStream(*stream);
-      if(written == contentLength && Update.end(true)) {
+    const esp_partition_t* target = esp_ota_get_next_update_partition(nullptr);
+    if(expectedSize > 0 && (size_t)contentLength != expectedSize) {
+      Serial.println("[OTA] Error: el tamaño no coincide con el manifiesto.");
+      otaReport("failed", targetVersion, "el tamaño no coincide con el manifiesto");
+    } else if(contentLength > 0 && Update.begin(contentLength)) {
+      otaVerify.begin(expectedSize > 0 ? image.sha256 : nullptr, image.signature, image.signatureLen);
+      bool copied = otaCopyVerified(*stream, contentLength);
+      // Imagen truncada, alterada o sin firma válida: se descarta antes de cambiar de partición
+      if (copied && !otaVerify.finish()) {
+        Serial.printf("[OTA] Imagen rechazada: %s\n", otaVerify.error());
+        Update.abort();
+        otaReport("failed", targetVersion, otaVerify.error());
+      } else if(copied && Update.end(true)) {
+        // Tras el reinicio se informa si arrancó la partición escrita
+        Preferences prefs;
+        if (target && prefs.begin(OTA_REPORT_NAMESPACE, false)) {
+          prefs.putString("part", target->label);
+          prefs.putString("target", targetVersion);
+          prefs.end();
+        }
         Serial.println("[OTA] Actualización exitosa. Reiniciando...");
         ESP.restart();
       } else {
         Serial.println("[OTA] Error al escribir firmware.");
         Update.end();
+        otaReport("failed", targetVersion, "error al escribir");
       }
     } else {
       Serial.println("[OTA] Error: tamaño inválido o no se pudo iniciar Update.");
+      otaReport("failed", targetVersion, "tamaño inválido");
     }
   } else {
     Serial.printf("[OTA] HTTP error: %d\n", httpCode);
+    otaReport("failed", targetVersion, "respuesta HTTP inválida");
   }
   http.end();
 }
 
+// Copia size bytes del stream a Update pasando cada bloque también por otaVerify.
+// Reemplaza a Update.writeStream(), que no deja ver los datos.
+bool Esp32OTA::otaCopyVerified(WiFiClient &stream, size_t size) {
+  static uint8_t buf[OTA_CHUNK_SIZE];
+  size_t written = 0;
+  unsigned long lastData = millis();
+  unsigned long hashMicros = 0;
+  while (written < size) {
+    size_t avail = stream.available();
+    if (avail == 0) {
+      if (!stream.connected() || millis() - lastData > OTA_STALL_TIMEOUT) return false;
+      delay(1);
+      continue;
+    }
+    int n = stream.read(buf, min(min(avail, sizeof(buf)), size - written));
+    if (n <= 0) continue;
+    if (Update.write(buf, n) != (size_t)n) return false;
+    unsigned long t0 = micros();
+    otaVerify.update(buf, n);
+    hashMicros += micros() - t0;
+    written += n;
+    lastData = millis();
+  }
+  Serial.printf("[OTA] SHA-256 en streaming: %.1f ms/MB\n", hashMicros / 1000.0f * 1048576.0f / size);
+  return true;
+}
+
+// Misma versión y mismo hash de partición (si el hash no se puede leer, decide la versión)
+bool Esp32OTA::isRunningImage(const CmdView &version, const uint8_t sha256[32]) {
+  if (!version.equals(_firmwareVersion)) return false;
+  if (runningShaState == 0) {
+    runningShaState = esp_partition_get_sha256(esp_ota_get_running_partition(), runningSha) == ESP_OK ? 1 : -1;
+  }
+  return runningShaState < 0 || memcmp(runningSha, sha256, sizeof(runningSha)) == 0;
+}
+
+// Resultado de una OTA en TOPIC_STATUS: "skipped", "updated" o "failed"
+void Esp32OTA::otaReport(const char* result, const char* version, const char* reason) {
+  JsonMessage<256> msg;
+  msg.beginObject()
+     .field("mac", deviceMac.c_str())
+     .field("status", "ota")
+     .field("result", result)
+     .field("version", _firmwareVersion);
+  if (version && *version) msg.field("target", version);
+  if (reason) msg.field("reason", reason);
+  msg.endObject();
+  mqttClient.publish(TOPIC_STATUS, msg.c_str(), false);
+}
+
+void Esp32OTA::otaReportPending() {
+  Preferences prefs;
+  if (!prefs.begin(OTA_REPORT_NAMESPACE, false)) return;
+  String part = prefs.getString("part", "");
+  String target = prefs.getString("target", "");
+  prefs.clear();
+  prefs.end();
+  if (part.length() == 0) return;
+  if (part == esp_ota_get_running_partition()->label) otaReport("updated", target.c_str());
+  else otaReport("failed", target.c_str(), "la imagen nueva no arrancó");
+}
+
 void Esp32OTA::sendSensorData(float temperature, float humidity) {
-  String sensorMsg = "{\"mac\":\"" + deviceMac + "\",\"name\":\"" + _deviceName + "\",\"temperature\":" + String(temperature, 1) + ",\"humidity\":" + String(humidity, 1) + "}";
+  JsonMessage<192> sensorMsg;
+  sensorMsg.beginObject()
+           .field("mac", deviceMac.c_str())
+           .field("name", _deviceName)
+           .field("temperature", temperature, 1)
+           .field("humidity", humidity, 1)
+           .endObject();
   mqttClient.publish(TOPIC_SENSOR, sensorMsg.c_str(), false);
-  Serial.println("Sensor data enviado: " + sensorMsg);
+  Serial.printf("Sensor data enviado: %s\n", sensorMsg.c_str());
+}
+
+void Esp32OTA::record(const char* type, float value, const char* unit) {
+  if (isnan(value)) return;  // lectura fallida: no se guarda
+  if (!_samples.push(type, value, unit, millis())) {
+    Serial.printf("⚠️ Buffer de muestras lleno: se descartó la más vieja (%u perdidas)\n",
+                  (unsigned)_samples.dropped());
+  }
+}
+
+void Esp32OTA::setTelemetryBatch(size_t maxSamples, unsigned long maxAgeMs) {
+  _batchSamples = constrain(maxSamples, (size_t)1, SampleRing::capacity());
+  _batchMaxAge = maxAgeMs;
+}
+
+bool Esp32OTA::flushTelemetry() {
+  while (!_samples.empty()) {
+    if (!publishBatch()) return false;
+  }
+  return true;
+}
+
+// Disparadores automáticos del lote: cantidad de muestras o antigüedad de la más vieja
+void Esp32OTA::telemetryStep() {
+  if (_samples.empty() || !mqttClient.connected()) return;
+  if (_samples.size() >= _batchSamples || millis() - _samples.at(0).at >= _batchMaxAge) {
+    publishBatch();
+  }
+}
+
+// Cota de una entrada sin contar type/unit: claves, comillas, número y separadores
+#define TELEMETRY_ENTRY_OVERHEAD 72
+
+// Publica en un solo mensaje todas las muestras más viejas que entren en el buffer.
+// Solo se liberan del buffer después de publicarlas.
+bool Esp32OTA::publishBatch() {
+  if (_samples.empty() || !mqttClient.connected()) return false;
+
+  uint32_t now = millis();
+  JsonWriter msg(_batchBuf, sizeof(_batchBuf));
+  msg.beginObject()
+     .field("mac", deviceMac.c_str())
+     .beginArray("measurements");
+
+  size_t count = 0;
+  while (count < _samples.size()) {
+    const Sample& s = _samples.at(count);
+    size_t need = strlen(s.type) + (s.unit ? strlen(s.unit) : 0) + TELEMETRY_ENTRY_OVERHEAD;
+    if (count > 0 && msg.length() + need + 2 >= sizeof(_batchBuf)) break;  // 2 = "]}"
+    msg.beginObject()
+       .field("type", s.type)
+       .field("value", s.value, TELEMETRY_DECIMALS);
+    if (s.unit) msg.field("unit", s.unit);
+    msg.field("age", (unsigned long)(now - s.at)).endObject();
+    count++;
+  }
+  msg.endArray().endObject();
+
+  if (!msg.ok()) {
+    // Una sola muestra no entra en el buffer: se descarta para no trabar la cola
+    Serial.println("❌ Muestra demasiado grande para TELEMETRY_BATCH_BYTES, descartada");
+    _samples.drop(1);
+    return false;
+  }
+  if (!mqttClient.publish(TOPIC_MEASUREMENTS, msg.c_str(), false)) {
+    Serial.println("❌ No se pudo publicar el lote de muestras");
+    return false;
+  }
+  _samples.drop(count);
+  Serial.printf("📦 Lote enviado: %u muestras, %u bytes\n", (unsigned)count, (unsigned)msg.length());
+  return true;
 }
 
 void Esp32OTA::sendHeartbeat() {
-  String hbMsg = "{\"mac\":\"" + deviceMac + "\",\"name\":\"" + _deviceName +
-                 "\",\"uptime\":" + String(millis()) + "}";
+  JsonMessage<160> hbMsg;
+  hbMsg.beginObject()
+       .field("mac", deviceMac.c_str())
+       .field("name", _deviceName)
+       .field("uptime", millis())
+       .endObject();
   mqttClient.publish(TOPIC_HEARTBEAT, hbMsg.c_str(), false);
-  Serial.println("Heartbeat enviado: " + hbMsg);
+  Serial.printf("Heartbeat enviado: %s\n", hbMsg.c_str());
 }
 
 void Esp32OTA::loop() {
@@ -201,6 +532,7 @@ void Esp32OTA::loop() {
     if (millis() - lastWiFiAttempt > wifiAttemptInterval) {
       Serial.println("WiFi desconectado. Intentando reconectar...");
       lastWiFiAttempt = millis();
+      wifiFast.useDhcp();  // la IP reutilizada no sigue en las uniones siguientes
       connectWiFi();
     }
   }
@@ -219,6 +551,22 @@ void Esp32OTA::loop() {
     if (mqttClient.connected()) sendHeartbeat();
     lastHeartbeat = millis();
   }
+
+  // Lote de muestras si se cumplió algún umbral
+  telemetryStep();
+
+  // OTA del despliegue escalonado cuyo turno llegó
+  if (otaScheduled && WiFi.status() == WL_CONNECTED && (long)(millis() - otaScheduledAt) >= 0) {
+    otaScheduled = false;
+    String url = otaScheduledUrl;
+    otaScheduledUrl = String();
+    Serial.println("Iniciando OTA programada con URL: " + url);
+    doOTA(url, otaScheduledImage);
+    otaScheduledImage.version = String();
+    if(otaUpdateCallback) {
+      otaUpdateCallback(url);
+    }
+  }
 }
 
 void Esp32OTA::setOTAUpdateCallback(void (*callback)(const String&)) {
@@ -6,12 +6,76 @@
 #include <PubSubClient.h>
 #include <HTTPClient.h>
 #include <Update.h>
+#include "JsonWriter.h"
+#include "SampleRing.h"
+#include "TlsSessionClient.h"
+#include "WiFiFastConnect.h"
+#include "WiFiRanking.h"
+#include "OtaCommand.h"
+#include "Rollout.h"
+#include "OtaVerify.h"
+#include <Preferences.h>
+#include <esp_ota_ops.h>
 
 // Definiciones para tópicos MQTT
 #define TOPIC_STATUS    "esp32/status"
-#define TOPIC_UPDATE    "esp32/update"
+#define TOPIC_UPDATE    "esp32/update"  // tópico compartido (servidores anteriores)
+// Comandos OTA dirigidos: así cada comando llega solo a quien corresponde
+#define TOPIC_UPDATE_PREFIX "esp32/update/"        // + MAC: solo este dispositivo
+#define TOPIC_UPDATE_GROUP  "esp32/update/group/"  // + grupo (sitio, revisión de hardware...)
+#define TOPIC_UPDATE_ALL    "esp32/update/all"     // toda la flota
+#ifndef MQTT_MAX_UPDATE_GROUPS
+#define MQTT_MAX_UPDATE_GROUPS 4
+#endif
+// Resultado pendiente de informar tras el reinicio de una actualización
+#define OTA_REPORT_NAMESPACE "ota_report"
+// Bloque de lectura de doOTA: cada bloque va a Update.write() y al SHA-256
+#ifndef OTA_CHUNK_SIZE
+#define OTA_CHUNK_SIZE 4096
+#endif
+// Tiempo máximo sin recibir datos durante la descarga (ms)
+#ifndef OTA_STALL_TIMEOUT
+#define OTA_STALL_TIMEOUT 20000
+#endif
 #define TOPIC_HEARTBEAT "esp32/heartbeat"
 #define TOPIC_SENSOR    "esp32/sensor"
+#define TOPIC_MEASUREMENTS "esp32/measurements"
+
+// Lotes de telemetría: se publica al juntar TELEMETRY_BATCH_SAMPLES muestras o cuando
+// la más vieja supera TELEMETRY_BATCH_MAX_AGE ms (lo que ocurra primero)
+#ifndef TELEMETRY_BATCH_SAMPLES
+#define TELEMETRY_BATCH_SAMPLES 24
+#endif
+#ifndef TELEMETRY_BATCH_MAX_AGE
+#define TELEMETRY_BATCH_MAX_AGE 300000
+#endif
+// Tamaño máximo de un mensaje de lote (también fija el buffer de PubSubClient)
+#ifndef TELEMETRY_BATCH_BYTES
+#define TELEMETRY_BATCH_BYTES 2048
+#endif
+#ifndef TELEMETRY_DECIMALS
+#define TELEMETRY_DECIMALS 2
+#endif
+
+// Tiempo de escucha por canal en el escaneo de redes (ms)
+#ifndef WIFI_SCAN_MS_PER_CHAN
+#define WIFI_SCAN_MS_PER_CHAN 120
+#endif
+
+// Imagen que anuncia el comando: manifiesto (size > 0) y firma (signatureLen > 0)
+struct OtaManifest {
+  String version;
+  size_t size;
+  uint8_t sha256[32];
+  uint8_t signature[OTA_SIGNATURE_MAX];
+  size_t signatureLen;
+};
+
+// Cómo se elige la red cuando falla la unión directa
+enum WiFiSelection {
+  WIFI_SELECT_RANKED,  // un escaneo; solo se prueban las redes visibles, por RSSI e historial
+  WIFI_SELECT_ORDERED  // se prueban todas en orden rotativo (necesario para SSID ocultos)
+};
 
 class Esp32OTA {
 public:
@@ -29,6 +93,21 @@ public:
   // Agregar credenciales WiFi (puedes llamarlo varias veces)
   void addWiFi(const char* ssid, const char* password);
 
+  // Modo de selección de red (por defecto WIFI_SELECT_RANKED)
+  void setWiFiSelection(WiFiSelection mode) { wifiSelection = mode; }
+
+  // Grupo de actualización (por ejemplo "catamarca" o "hw-rev2"): también se reciben los
+  // comandos de TOPIC_UPDATE_GROUP<grupo>. Llamar antes de begin(); group debe ser una
+  // cadena permanente. Devuelve false si ya hay MQTT_MAX_UPDATE_GROUPS.
+  bool addUpdateGroup(const char* group);
+
+  // Seguir escuchando el tópico compartido TOPIC_UPDATE (por defecto sí, por compatibilidad)
+  void setLegacyUpdateTopic(bool enabled) { legacyUpdateTopic = enabled; }
+
+  // Clave pública (PEM, cadena permanente) para exigir imágenes firmadas: sin sig= el
+  // comando se ignora y una firma inválida se rechaza antes de Update.end(true)
+  bool setOTASigningKey(const char* publicKeyPem) { return otaVerify.setPublicKey(publicKeyPem); }
+
   // Callback para cuando se inicia una OTA
   void setOTAUpdateCallback(void (*callback)(const String&));
 
@@ -38,20 +117,51 @@ public:
   // Enviar sensor data
   void sendSensorData(float temperature, float humidity);
 
+  // Guarda una muestra en el buffer; se envía en lote por TOPIC_MEASUREMENTS.
+  // type y unit deben ser cadenas permanentes (literales o constantes globales).
+  void record(const char* type, float value, const char* unit = nullptr);
+
+  // Umbrales de envío del lote: cantidad de muestras y antigüedad máxima (ms)
+  void setTelemetryBatch(size_t maxSamples, unsigned long maxAgeMs);
+
+  // Envía ya todas las muestras pendientes. Devuelve false si quedaron muestras sin enviar.
+  bool flushTelemetry();
+
+  // Muestras pendientes y muestras perdidas por buffer lleno
+  size_t pendingSamples() const { return _samples.size(); }
+  uint32_t droppedSamples() const { return _samples.dropped(); }
+
+  // Handshakes TLS completos vs reanudados de la conexión MQTT
+  const TlsSessionStats& getMqttTlsStats() const { return wifiClient.stats(); }
+
+  // Tiempo hasta conectado y uso de la unión directa a la última red
+  const WiFiConnectStats& getWiFiStats() const { return wifiStats; }
+
 private:
   // Intentar conectar a una de las redes configuradas.
   // Non-blocking-ish: intentará redes con un timeout por red y regresa true si se conectó.
   bool connectWiFi();
+  void wifiConnected(unsigned long startMs, bool fast);
+  bool connectRanked(unsigned long startMs, bool& scanOk);
 
   // Forzar intento inmediato de conexión WiFi (usar con precaución)
   void forceConnectWiFi();
 
   // MQTT
   void connectMQTT();
+  void subscribeUpdates();
   void mqttCallback(char* topic, byte* payload, unsigned int length);
 
-  // OTA
-  void doOTA(const String &url);
+  // Telemetría en lotes
+  void telemetryStep();
+  bool publishBatch();
+
+  // OTA: image trae el manifiesto y la firma del comando (vacíos = sin comprobar)
+  void doOTA(const String &url, const OtaManifest &image);
+  bool otaCopyVerified(WiFiClient &stream, size_t size);
+  bool isRunningImage(const CmdView &version, const uint8_t sha256[32]);
+  void otaReport(const char* result, const char* version, const char* reason = nullptr);
+  void otaReportPending();
 
   // Datos MQTT/Device
   const char* _mqttHost;
@@ -70,6 +180,14 @@ private:
   size_t wifiCount = 0;
   size_t currentWifiIndex = 0;
 
+  // Unión directa a la última red que funcionó
+  WiFiFastConnect wifiFast;
+  WiFiConnectStats wifiStats = {};
+
+  // Selección por escaneo: historial de intentos/éxitos por red (en RAM)
+  WiFiSelection wifiSelection = WIFI_SELECT_RANKED;
+  WiFiNetStats wifiHistory[WIFI_MAX_NETWORKS] = {};
+
   // network attempt timing
   unsigned long lastWiFiAttempt = 0;
   unsigned long wifiAttemptInterval = 15000; // ms entre intentos de cambio/red
@@ -77,7 +195,11 @@ private:
 
   // MQTT & clients
   String deviceMac;
-  WiFiClientSecure wifiClient;
+  uint8_t macBytes[6] = {};
+  const char* updateGroups[MQTT_MAX_UPDATE_GROUPS] = {};
+  size_t updateGroupCount = 0;
+  bool legacyUpdateTopic = true;
+  TlsSessionClient wifiClient;  // TLS del broker MQTT con reanudación de sesión
   PubSubClient mqttClient;
 
   // heartbeat
@@ -87,6 +209,25 @@ private:
   // Backoff para MQTT reconexión
   unsigned long lastMqttAttempt = 0;
   unsigned long mqttReconnectInterval = 2000; // empieza en 2s, se puede aumentar
+
+  // Despliegue escalonado: OTA aceptada esperando su momento dentro de la ventana
+  bool otaScheduled = false;
+  unsigned long otaScheduledAt = 0;
+  String otaScheduledUrl;
+  OtaManifest otaScheduledImage;
+
+  // SHA-256 y firma de la imagen, calculados sobre los bloques que van a Update.write()
+  OtaVerify otaVerify;
+
+  // Hash de la imagen en ejecución, calculado la primera vez que llega un manifiesto
+  uint8_t runningSha[32] = {};
+  int8_t runningShaState = 0;  // 0 sin calcular, 1 válido, -1 no se pudo leer
+
+  // Lote de telemetría
+  SampleRing _samples;
+  size_t _batchSamples = TELEMETRY_BATCH_SAMPLES;
+  unsigned long _batchMaxAge = TELEMETRY_BATCH_MAX_AGE;
+  char _batchBuf[TELEMETRY_BATCH_BYTES];
 };
 
 #endif
@@ -26,10 +26,11 @@ void loop() {
   // Lógica principal de la app
   ota.loop();
 
-  // ejemplo: enviar datos de sensor cada 30s (simulado)
+  // ejemplo: leer el sensor cada 30s (simulado); las muestras se publican en lote
   static unsigned long last = 0;
   if (millis() - last > 30000) {
-    ota.sendSensorData(25.3, 48.1);
+    ota.record("temperature", 25.3, "C");
+    ota.record("humidity", 48.1, "%");
     last = millis();
   }
 
@@ -0,0 +1,180 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Escritor JSON sin memoria dinámica: serializa sobre un buffer fijo
+// (del llamador o de JsonMessage<N>). Si el buffer no alcanza, ok() devuelve
+// false y el contenido queda truncado pero terminado en '\0'.
+//
+//   JsonMessage<192> msg;
+//   msg.beginObject().field("mac", mac).field("temperature", 25.3f, 1).endObject();
+//   mqttClient.publish(TOPIC_SENSOR, msg.c_str(), false);
+class JsonWriter {
+public:
+  JsonWriter(char* buf, size_t cap) : _buf(buf), _cap(cap), _len(0), _ok(cap > 0), _first(true) {
+    if (cap > 0) _buf[0] = '\0';
+  }
+
+  JsonWriter& beginObject() { return open('{'); }
+  JsonWriter& endObject() { return close('}'); }
+  JsonWriter& beginArray() { return open('['); }
+  JsonWriter& endArray() { return close(']'); }
+
+  // Abre un objeto o array como valor de un campo
+  JsonWriter& beginObject(const char* k) { key(k); _first = true; return raw('{'); }
+  JsonWriter& beginArray(const char* k) { key(k); _first = true; return raw('['); }
+
+  JsonWriter& field(const char* k, const char* v) { key(k); return string(v); }
+  JsonWriter& field(const char* k, long v) { key(k); return number(v); }
+  JsonWriter& field(const char* k, unsigned long v) { key(k); return number(v); }
+  JsonWriter& field(const char* k, int v) { return field(k, (long)v); }
+  JsonWriter& field(const char* k, unsigned int v) { return field(k, (unsigned long)v); }
+  JsonWriter& field(const char* k, float v, uint8_t decimals) { key(k); return number(v, decimals); }
+  JsonWriter& field(const char* k, bool v) { key(k); return raw(v ? "true" : "false"); }
+
+  // Valores sueltos dentro de un array
+  JsonWriter& value(const char* v) { separator(); return string(v); }
+  JsonWriter& value(float v, uint8_t decimals) { separator(); return number(v, decimals); }
+  JsonWriter& value(unsigned long v) { separator(); return number(v); }
+
+  bool ok() const { return _ok; }
+  const char* c_str() const { return _buf; }
+  size_t length() const { return _len; }
+
+  void clear() {
+    _len = 0;
+    _ok = _cap > 0;
+    _first = true;
+    if (_cap > 0) _buf[0] = '\0';
+  }
+
+private:
+  JsonWriter& open(char c) {
+    separator();
+    _first = true;
+    return raw(c);
+  }
+
+  JsonWriter& close(char c) {
+    _first = false;
+    return raw(c);
+  }
+
+  void separator() {
+    if (!_first) raw(',');
+    _first = false;
+  }
+
+  void key(const char* k) {
+    separator();
+    string(k);
+    raw(':');
+  }
+
+  JsonWriter& raw(char c) {
+    if (_len + 1 < _cap) {
+      _buf[_len++] = c;
+      _buf[_len] = '\0';
+    } else {
+      _ok = false;
+    }
+    return *this;
+  }
+
+  JsonWriter& raw(const char* s) {
+    while (*s) raw(*s++);
+    return *this;
+  }
+
+  JsonWriter& string(const char* s) {
+    static const char hex[] = "0123456789abcdef";
+    raw('"');
+    for (; s && *s; s++) {
+      uint8_t c = (uint8_t)*s;
+      if (c == '"' || c == '\\') {
+        raw('\\');
+        raw((char)c);
+      } else if (c == '\n') {
+        raw("\\n");
+      } else if (c == '\r') {
+        raw("\\r");
+      } else if (c == '\t') {
+        raw("\\t");
+      } else if (c < 0x20) {
+        raw("\\u00");
+        raw(hex[c >> 4]);
+        raw(hex[c & 0x0F]);
+      } else {
+        raw((char)c);
+      }
+    }
+    return raw('"');
+  }
+
+  JsonWriter& number(unsigned long v) {
+    char tmp[12];
+    size_t n = 0;
+    do {
+      tmp[n++] = '0' + (v % 10);
+      v /= 10;
+    } while (v > 0);
+    while (n > 0) raw(tmp[--n]);
+    return *this;
+  }
+
+  JsonWriter& number(long v) {
+    if (v < 0) {
+      raw('-');
+      return number((unsigned long)(-(v + 1)) + 1);
+    }
+    return number((unsigned long)v);
+  }
+
+  // Punto fijo: evita printf("%f"), que en newlib puede reservar memoria
+  JsonWriter& number(float v, uint8_t decimals) {
+    if (v != v || v > 1e15f || v < -1e15f) return raw("null");  // NaN o fuera de rango
+    if (decimals > 6) decimals = 6;
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+    bool negative = v < 0;
+    uint64_t scaled = (uint64_t)((negative ? -(double)v : (double)v) * scale + 0.5);
+    uint64_t whole = scaled / scale;
+    uint32_t frac = scaled % scale;
+    if (negative && scaled > 0) raw('-');
+
+    char tmp[20];
+    size_t n = 0;
+    do {
+      tmp[n++] = '0' + (whole % 10);
+      whole /= 10;
+    } while (whole > 0);
+    while (n > 0) raw(tmp[--n]);
+
+    if (decimals > 0) {
+      raw('.');
+      for (uint32_t d = scale / 10; d > 0; d /= 10) raw('0' + (frac / d) % 10);
+    }
+    return *this;
+  }
+
+  char* _buf;
+  size_t _cap;
+  size_t _len;
+  bool _ok;
+  bool _first;
+};
+
+// JsonWriter con su propio buffer de N bytes (en la pila o estático)
+template <size_t N>
+class JsonMessage : public JsonWriter {
+public:
+  JsonMessage() : JsonWriter(_storage, N) {}
+
+private:
+  char _storage[N];
+};
+
+#endif
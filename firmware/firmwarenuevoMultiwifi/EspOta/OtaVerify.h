@@ -0,0 +1,70 @@
+#ifndef OTA_VERIFY_H
+#define OTA_VERIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <mbedtls/pk.h>
+#include <mbedtls/sha256.h>
+
+// Firma DER más larga aceptada (ECDSA P-256: hasta 72 bytes; alcanza también para P-384)
+#ifndef OTA_SIGNATURE_MAX
+#define OTA_SIGNATURE_MAX 104
+#endif
+
+// Verificación de la imagen en streaming: recibe los mismos bytes que se escriben en
+// flash, así no hace falta releer la partición al final. SHA-256 de mbedtls, que en el
+// ESP32 usa el acelerador por hardware (CONFIG_MBEDTLS_HARDWARE_SHA, activo por defecto).
+//
+// Si la imagen trae el SHA-256 que agrega esptool (cabecera 0xE9, byte 23 en 1), el hash
+// cubre todo menos esos 32 bytes finales y debe coincidir con ellos: es el mismo valor que
+// devuelve esp_partition_get_sha256(). Si no lo trae, el hash es el del archivo completo.
+// Sobre ese hash se comprueban el manifiesto y la firma (ECDSA o RSA, según la clave).
+//
+// No depende de Arduino: la herramienta de host mide el costo por MB con el mismo código.
+class OtaVerify {
+public:
+  OtaVerify();
+  ~OtaVerify();
+  OtaVerify(const OtaVerify&) = delete;
+  OtaVerify& operator=(const OtaVerify&) = delete;
+
+  // Clave pública en PEM (con su '\0'). Con clave, finish() exige una firma válida.
+  bool setPublicKey(const char* pem);
+  bool hasPublicKey() const { return _hasKey; }
+
+  // expectedSha (32 bytes) y signature son opcionales (nullptr)
+  void begin(const uint8_t* expectedSha, const uint8_t* signature, size_t signatureLen);
+  void update(const uint8_t* data, size_t len);
+  // Cierra el hash y lo compara con el SHA-256 de la imagen, el manifiesto y la firma
+  bool finish();
+
+  bool isRunning() const { return _running; }
+  size_t processed() const { return _total; }
+  const uint8_t* digest() const { return _digest; }
+  const char* error() const { return _error; }
+
+private:
+  bool fail(const char* reason);
+  void hash(const uint8_t* data, size_t len);
+
+  mbedtls_sha256_context _sha;
+  mbedtls_pk_context _pk;
+  bool _hasKey;
+  bool _running;
+  const char* _error;
+
+  // Los últimos 32 bytes se retienen hasta saber si son el hash agregado por esptool
+  uint8_t _tail[32];
+  size_t _tailLen;
+  size_t _total;
+  uint8_t _magic;
+  uint8_t _hashAppended;
+
+  bool _hasExpected;
+  uint8_t _expected[32];
+  uint8_t _signature[OTA_SIGNATURE_MAX];
+  size_t _signatureLen;
+  uint8_t _digest[32];
+};
+
+#endif
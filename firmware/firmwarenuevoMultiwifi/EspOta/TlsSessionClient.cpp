@@ -0,0 +1,312 @@
+#include "TlsSessionClient.h"
+#include <esp_attr.h>
+#include <mbedtls/version.h>
+
+// En mbedtls 3 los campos de la sesión son privados
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+#define TLS_SESSION_MASTER(s) ((s).MBEDTLS_PRIVATE(master))
+#else
+#define TLS_SESSION_MASTER(s) ((s).master)
+#endif
+
+// Error propio para la capa de transporte (mismo valor que MBEDTLS_ERR_NET_CONN_RESET)
+#define TLS_ERR_CONN_RESET (-0x0050)
+// Tiempo máximo para escribir un bloque antes de dar la conexión por perdida
+#define TLS_WRITE_TIMEOUT 5000
+
+#if TLS_SESSION_RTC
+// Sesión serializada en RTC: sobrevive a ESP.restart() y al watchdog, no a un corte de energía
+#define TLS_RTC_MAGIC 0x544C5331UL  // "TLS1"
+struct RtcTlsSession {
+  uint32_t magic;
+  uint32_t key;
+  uint32_t len;
+  uint32_t check;
+  uint8_t data[TLS_SESSION_RTC_SIZE];
+};
+RTC_NOINIT_ATTR static RtcTlsSession rtcSession;
+
+static uint32_t rtcChecksum(const RtcTlsSession& s) {
+  uint32_t h = 2166136261UL ^ s.key ^ s.len;
+  for (uint32_t i = 0; i < s.len && i < sizeof(s.data); i++) h = (h ^ s.data[i]) * 16777619UL;
+  return h;
+}
+#endif
+
+TlsSessionClient::TlsSessionClient()
+  : _ctxReady(false), _connected(false), _peeked(-1),
+    _hasSession(false), _sessionKey(0), _handshakeTimeout(TLS_HANDSHAKE_TIMEOUT)
+{
+  mbedtls_ssl_session_init(&_session);
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+TlsSessionClient::~TlsSessionClient() {
+  stop();
+  mbedtls_ssl_session_free(&_session);
+}
+
+uint32_t TlsSessionClient::sessionKey(const char* host, uint16_t port) {
+  uint32_t h = 2166136261UL;
+  for (; host && *host; host++) h = (h ^ (uint8_t)*host) * 16777619UL;
+  return (h ^ port) * 16777619UL;
+}
+
+void TlsSessionClient::clearSession() {
+  mbedtls_ssl_session_free(&_session);
+  mbedtls_ssl_session_init(&_session);
+  _hasSession = false;
+#if TLS_SESSION_RTC
+  rtcSession.magic = 0;
+#endif
+}
+
+void TlsSessionClient::saveRtcSession() {
+#if TLS_SESSION_RTC
+  size_t len = 0;
+  rtcSession.magic = 0;
+  if (mbedtls_ssl_session_save(&_session, rtcSession.data, sizeof(rtcSession.data), &len) != 0) {
+    Serial.println("⚠️ Sesión TLS demasiado grande para RTC, solo se conserva en RAM");
+    return;
+  }
+  rtcSession.key = _sessionKey;
+  rtcSession.len = len;
+  rtcSession.check = rtcChecksum(rtcSession);
+  rtcSession.magic = TLS_RTC_MAGIC;
+#endif
+}
+
+bool TlsSessionClient::loadRtcSession(uint32_t key) {
+#if TLS_SESSION_RTC
+  if (rtcSession.magic != TLS_RTC_MAGIC || rtcSession.key != key ||
+      rtcSession.len > sizeof(rtcSession.data) || rtcSession.check != rtcChecksum(rtcSession)) {
+    return false;
+  }
+  mbedtls_ssl_session_free(&_session);
+  mbedtls_ssl_session_init(&_session);
+  if (mbedtls_ssl_session_load(&_session, rtcSession.data, rtcSession.len) != 0) {
+    mbedtls_ssl_session_free(&_session);
+    mbedtls_ssl_session_init(&_session);
+    rtcSession.magic = 0;
+    return false;
+  }
+  _hasSession = true;
+  _sessionKey = key;
+  Serial.println("♻️ Sesión TLS recuperada de RTC");
+  return true;
+#else
+  return false;
+#endif
+}
+
+int TlsSessionClient::bioSend(void* ctx, const unsigned char* buf, size_t len) {
+  WiFiClient* tcp = static_cast<WiFiClient*>(ctx);
+  size_t n = tcp->write(buf, len);
+  if (n > 0) return n;
+  return tcp->connected() ? MBEDTLS_ERR_SSL_WANT_WRITE : TLS_ERR_CONN_RESET;
+}
+
+int TlsSessionClient::bioRecv(void* ctx, unsigned char* buf, size_t len) {
+  WiFiClient* tcp = static_cast<WiFiClient*>(ctx);
+  if (tcp->available() <= 0) return tcp->connected() ? MBEDTLS_ERR_SSL_WANT_READ : TLS_ERR_CONN_RESET;
+  int n = tcp->read(buf, len);
+  return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+}
+
+int TlsSessionClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip, port, (int32_t)_handshakeTimeout);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port) {
+  return connect(host, port, (int32_t)_handshakeTimeout);
+}
+
+int TlsSessionClient::connect(IPAddress ip, uint16_t port, int32_t timeout) {
+  stop();
+  if (!_tcp.connect(ip, port, timeout)) return 0;
+  return startTls(ip.toString().c_str(), port);
+}
+
+int TlsSessionClient::connect(const char* host, uint16_t port, int32_t timeout) {
+  stop();
+  if (!_tcp.connect(host, port, timeout)) return 0;
+  return startTls(host, port);
+}
+
+int TlsSessionClient::startTls(const char* host, uint16_t port) {
+  mbedtls_ssl_init(&_ssl);
+  mbedtls_ssl_config_init(&_conf);
+  mbedtls_ctr_drbg_init(&_drbg);
+  mbedtls_entropy_init(&_entropy);
+  _ctxReady = true;
+
+  static const char pers[] = "Esp32OTA";
+  if (mbedtls_ctr_drbg_seed(&_drbg, mbedtls_entropy_func, &_entropy,
+                            (const unsigned char*)pers, sizeof(pers) - 1) != 0 ||
+      mbedtls_ssl_config_defaults(&_conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                  MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+    _stats.failed++;
+    stop();
+    return 0;
+  }
+  mbedtls_ssl_conf_authmode(&_conf, MBEDTLS_SSL_VERIFY_NONE);
+  mbedtls_ssl_conf_rng(&_conf, mbedtls_ctr_drbg_random, &_drbg);
+  mbedtls_ssl_conf_session_tickets(&_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+  // La reanudación por ticket/ID es la de TLS 1.2 (en 1.3 funciona distinto)
+#if MBEDTLS_VERSION_NUMBER >= 0x03000000
+  mbedtls_ssl_conf_max_tls_version(&_conf, MBEDTLS_SSL_VERSION_TLS1_2);
+#else
+  mbedtls_ssl_conf_max_version(&_conf, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+#endif
+  if (mbedtls_ssl_setup(&_ssl, &_conf) != 0 || mbedtls_ssl_set_hostname(&_ssl, host) != 0) {
+    _stats.failed++;
+    stop();
+    return 0;
+  }
+  mbedtls_ssl_set_bio(&_ssl, &_tcp, bioSend, bioRecv, nullptr);
+
+  // Ofrecer la sesión anterior si es del mismo servidor
+  uint32_t key = sessionKey(host, port);
+  if (!_hasSession || _sessionKey != key) loadRtcSession(key);
+  bool offered = false;
+  uint8_t offeredMaster[sizeof(TLS_SESSION_MASTER(_session))];
+  if (_hasSession && _sessionKey == key && mbedtls_ssl_set_session(&_ssl, &_session) == 0) {
+    offered = true;
+    memcpy(offeredMaster, TLS_SESSION_MASTER(_session), sizeof(offeredMaster));
+  }
+
+  unsigned long start = millis();
+  int ret;
+  while ((ret = mbedtls_ssl_handshake(&_ssl)) != 0) {
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) break;
+    if (millis() - start > _handshakeTimeout) break;
+    delay(1);
+  }
+  _stats.lastHandshakeMs = millis() - start;
+
+  if (ret != 0) {
+    Serial.printf("❌ Handshake TLS fallido (-0x%04x)\n", (unsigned)-ret);
+    _stats.failed++;
+    // Si se ofreció una sesión, se descarta por si el servidor no la acepta
+    if (offered) clearSession();
+    stop();
+    return 0;
+  }
+
+  // Si el secreto maestro es el mismo que el ofrecido, el servidor reanudó la sesión
+  mbedtls_ssl_session fresh;
+  mbedtls_ssl_session_init(&fresh);
+  bool resumed = false;
+  if (mbedtls_ssl_get_session(&_ssl, &fresh) == 0) {
+    resumed = offered && memcmp(TLS_SESSION_MASTER(fresh), offeredMaster, sizeof(offeredMaster)) == 0;
+    mbedtls_ssl_session_free(&_session);
+    _session = fresh;  // _session pasa a ser dueña de los buffers de fresh
+    _hasSession = true;
+    _sessionKey = key;
+    saveRtcSession();
+  } else {
+    mbedtls_ssl_session_free(&fresh);
+  }
+
+  if (resumed) _stats.resumed++;
+  else _stats.full++;
+  Serial.printf("🔐 Handshake TLS %s en %lu ms (completos: %u, reanudados: %u)\n",
+                resumed ? "reanudado" : "completo", _stats.lastHandshakeMs,
+                (unsigned)_stats.full, (unsigned)_stats.resumed);
+
+  _connected = true;
+  return 1;
+}
+
+void TlsSessionClient::freeContext() {
+  if (!_ctxReady) return;
+  mbedtls_ssl_free(&_ssl);
+  mbedtls_ssl_config_free(&_conf);
+  mbedtls_ctr_drbg_free(&_drbg);
+  mbedtls_entropy_free(&_entropy);
+  _ctxReady = false;
+}
+
+size_t TlsSessionClient::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t TlsSessionClient::write(const uint8_t* buf, size_t size) {
+  if (!_connected) return 0;
+  size_t sent = 0;
+  unsigned long start = millis();
+  while (sent < size) {
+    int ret = mbedtls_ssl_write(&_ssl, buf + sent, size - sent);
+    if (ret > 0) {
+      sent += ret;
+      start = millis();
+    } else if ((ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) &&
+               millis() - start < TLS_WRITE_TIMEOUT) {
+      delay(1);
+    } else {
+      stop();
+      break;
+    }
+  }
+  return sent;
+}
+
+int TlsSessionClient::available() {
+  if (!_connected) return 0;
+  // Procesa un registro pendiente (si lo hay) para saber cuántos bytes descifrados quedan
+  int ret = mbedtls_ssl_read(&_ssl, nullptr, 0);
+  int pending = (_peeked >= 0 ? 1 : 0) + (int)mbedtls_ssl_get_bytes_avail(&_ssl);
+  // Error o cierre del servidor: se cierra cuando ya no quedan datos por leer
+  if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE && pending == 0) {
+    stop();
+  }
+  return pending;
+}
+
+int TlsSessionClient::read() {
+  uint8_t b;
+  return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsSessionClient::read(uint8_t* buf, size_t size) {
+  if (size == 0) return 0;
+  size_t got = 0;
+  if (_peeked >= 0) {
+    buf[got++] = (uint8_t)_peeked;
+    _peeked = -1;
+    if (got == size) return got;
+  }
+  if (!_connected) return got > 0 ? (int)got : -1;
+
+  int ret = mbedtls_ssl_read(&_ssl, buf + got, size - got);
+  if (ret > 0) return got + ret;
+  if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) stop();
+  return got > 0 ? (int)got : -1;
+}
+
+int TlsSessionClient::peek() {
+  if (_peeked < 0) {
+    uint8_t b;
+    if (read(&b, 1) == 1) _peeked = b;
+  }
+  return _peeked;
+}
+
+void TlsSessionClient::flush() {
+  // mbedtls_ssl_write ya envía cada registro completo
+}
+
+void TlsSessionClient::stop() {
+  if (_connected) mbedtls_ssl_close_notify(&_ssl);
+  _connected = false;
+  _peeked = -1;
+  _tcp.stop();
+  freeContext();
+}
+
+uint8_t TlsSessionClient::connected() {
+  if (_connected && !_tcp.connected() && mbedtls_ssl_get_bytes_avail(&_ssl) == 0) {
+    stop();
+  }
+  return _connected;
+}
@@ -0,0 +1,88 @@
+#ifndef TLS_SESSION_CLIENT_H
+#define TLS_SESSION_CLIENT_H
+
+#include <WiFi.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+
+// Guardar además la sesión en memoria RTC para reanudar tras un reinicio por software
+#ifndef TLS_SESSION_RTC
+#define TLS_SESSION_RTC 1
+#endif
+// Espacio en RTC para la sesión serializada (incluye el ticket y, según la
+// configuración de mbedtls, el certificado del servidor)
+#ifndef TLS_SESSION_RTC_SIZE
+#define TLS_SESSION_RTC_SIZE 2048
+#endif
+#ifndef TLS_HANDSHAKE_TIMEOUT
+#define TLS_HANDSHAKE_TIMEOUT 15000
+#endif
+
+// Contadores de handshakes
+struct TlsSessionStats {
+  uint32_t full;                 // handshakes completos
+  uint32_t resumed;              // handshakes abreviados (sesión reanudada)
+  uint32_t failed;               // handshakes fallidos
+  unsigned long lastHandshakeMs; // duración del último
+};
+
+// Cliente TLS 1.2 sobre WiFiClient que conserva la sesión entre conexiones
+// (session ticket o session ID) para hacer handshakes abreviados al reconectar.
+//
+// Como WiFiClientSecure con setInsecure(), no valida el certificado del servidor.
+// La sesión solo se ofrece al mismo host y puerto con el que se negoció.
+class TlsSessionClient : public Client {
+public:
+  TlsSessionClient();
+  ~TlsSessionClient();
+
+  void setHandshakeTimeout(unsigned long ms) { _handshakeTimeout = ms; }
+
+  // Olvida la sesión guardada (RAM y RTC): la próxima conexión hace handshake completo
+  void clearSession();
+
+  const TlsSessionStats& stats() const { return _stats; }
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(const char* host, uint16_t port);
+  int connect(IPAddress ip, uint16_t port, int32_t timeout);
+  int connect(const char* host, uint16_t port, int32_t timeout);
+  size_t write(uint8_t b);
+  size_t write(const uint8_t* buf, size_t size);
+  int available();
+  int read();
+  int read(uint8_t* buf, size_t size);
+  int peek();
+  void flush();
+  void stop();
+  uint8_t connected();
+  operator bool() { return connected(); }
+
+private:
+  int startTls(const char* host, uint16_t port);
+  void freeContext();
+  void saveRtcSession();
+  bool loadRtcSession(uint32_t key);
+  static uint32_t sessionKey(const char* host, uint16_t port);
+  static int bioSend(void* ctx, const unsigned char* buf, size_t len);
+  static int bioRecv(void* ctx, unsigned char* buf, size_t len);
+
+  WiFiClient _tcp;
+  mbedtls_ssl_context _ssl;
+  mbedtls_ssl_config _conf;
+  mbedtls_entropy_context _entropy;
+  mbedtls_ctr_drbg_context _drbg;
+  bool _ctxReady;
+  bool _connected;
+  int _peeked;
+
+  mbedtls_ssl_session _session;
+  bool _hasSession;
+  uint32_t _sessionKey;
+
+  unsigned long _handshakeTimeout;
+  TlsSessionStats _stats;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "WiFiFastConnect.h"
+#include <esp_attr.h>
+
+#define WIFI_RTC_MAGIC 0x57464331UL  // "WFC1"
+
+struct RtcWiFiLink {
+  uint32_t magic;
+  WiFiLinkRecord rec;
+  uint32_t check;
+};
+RTC_NOINIT_ATTR static RtcWiFiLink rtcLink;
+
+static uint32_t linkChecksum(const WiFiLinkRecord& rec) {
+  const uint8_t* p = (const uint8_t*)&rec;
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < sizeof(rec); i++) h = (h ^ p[i]) * 16777619UL;
+  return h;
+}
+
+WiFiFastConnect::WiFiFastConnect()
+  : _hasRecord(false), _hasNvs(false), _fromRtc(false), _usedLease(false), _leaseOffered(false)
+{
+  memset(&_rec, 0, sizeof(_rec));
+  memset(&_nvsRec, 0, sizeof(_nvsRec));
+}
+
+bool WiFiFastConnect::load() {
+  Preferences prefs;
+  _hasNvs = false;
+  if (prefs.begin(WIFI_PREFS_NAMESPACE, true)) {
+    _hasNvs = prefs.getBytesLength("link") == sizeof(_nvsRec) &&
+              prefs.getBytes("link", &_nvsRec, sizeof(_nvsRec)) == sizeof(_nvsRec);
+    prefs.end();
+  }
+
+  // La concesión de RTC solo vale para la primera unión del arranque
+  bool first = !_leaseOffered;
+  _leaseOffered = true;
+  if (rtcLink.magic == WIFI_RTC_MAGIC && rtcLink.check == linkChecksum(rtcLink.rec)) {
+    _rec = rtcLink.rec;
+    _fromRtc = first;
+  } else if (_hasNvs) {
+    _rec = _nvsRec;
+    _fromRtc = false;
+  } else {
+    return _hasRecord = false;
+  }
+  _rec.ssid[sizeof(_rec.ssid) - 1] = '\0';
+  return _hasRecord = _rec.ssid[0] != '\0' && _rec.channel != 0;
+}
+
+bool WiFiFastConnect::start(const char* password) {
+  if (!_hasRecord) return false;
+
+  bool reuse = _fromRtc && _rec.ip != 0;
+  _fromRtc = false;
+  if (reuse) {
+    WiFi.config(IPAddress(_rec.ip), IPAddress(_rec.gateway), IPAddress(_rec.subnet), IPAddress(_rec.dns));
+  } else {
+    useDhcp();
+  }
+  _usedLease = reuse;
+  Serial.printf("⚡ Unión directa a %s (canal %u)%s\n", _rec.ssid, _rec.channel,
+                _usedLease ? " con la IP anterior" : "");
+  WiFi.begin(_rec.ssid, password, _rec.channel, _rec.bssid, true);
+  return true;
+}
+
+void WiFiFastConnect::failed() {
+  // El AP cambió de canal, se apagó o la IP ya no vale: volver a DHCP y a la lista
+  WiFi.disconnect(true);
+  useDhcp();
+  _fromRtc = false;
+  rtcLink.magic = 0;
+}
+
+void WiFiFastConnect::useDhcp() {
+  WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+  _usedLease = false;
+}
+
+bool WiFiFastConnect::join(const char* password, unsigned long timeoutMs) {
+  if (!start(password)) return false;
+  unsigned long t0 = millis();
+  while (millis() - t0 < timeoutMs) {
+    if (WiFi.status() == WL_CONNECTED) return true;
+    delay(50);
+  }
+  failed();
+  return false;
+}
+
+void WiFiFastConnect::save() {
+  WiFiLinkRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  strncpy(rec.ssid, WiFi.SSID().c_str(), sizeof(rec.ssid) - 1);
+  const uint8_t* bssid = WiFi.BSSID();
+  if (bssid) memcpy(rec.bssid, bssid, sizeof(rec.bssid));
+  rec.channel = WiFi.channel();
+  WiFiLinkRecord link = rec;  // sin concesión: lo que va a NVS
+
+  // Solo una IP que dio DHCP vale como concesión; la reutilizada no se renueva así
+  if (!_usedLease) {
+    rec.ip = (uint32_t)WiFi.localIP();
+    rec.gateway = (uint32_t)WiFi.gatewayIP();
+    rec.subnet = (uint32_t)WiFi.subnetMask();
+    rec.dns = (uint32_t)WiFi.dnsIP();
+  }
+
+  _rec = rec;
+  _hasRecord = rec.ssid[0] != '\0' && rec.channel != 0;
+  rtcLink.rec = rec;
+  rtcLink.check = linkChecksum(rec);
+  rtcLink.magic = WIFI_RTC_MAGIC;
+
+  // La flash solo se escribe si cambió la red o el AP
+  if (_hasNvs && memcmp(&_nvsRec, &link, sizeof(link)) == 0) return;
+  Preferences prefs;
+  if (prefs.begin(WIFI_PREFS_NAMESPACE, false)) {
+    prefs.putBytes("link", &link, sizeof(link));
+    prefs.end();
+    _nvsRec = link;
+    _hasNvs = true;
+  }
+}
+
+void WiFiFastConnect::forget() {
+  _hasRecord = false;
+  rtcLink.magic = 0;
+  Preferences prefs;
+  if (prefs.begin(WIFI_PREFS_NAMESPACE, false)) {
+    prefs.remove("link");
+    prefs.end();
+  }
+  _hasNvs = false;
+}
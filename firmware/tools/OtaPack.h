@@ -0,0 +1,138 @@
+#ifndef OTA_PACK_H
+#define OTA_PACK_H
+
+// Compresores de imágenes OTA en los dos formatos que descomprime EspOta/OtaInflate:
+//   - gzip (RFC 1952) con la ventana de deflate elegida (ver OTA_GZ_WINDOW_BITS)
+//   - heatshrink con la cabecera de 8 bytes de OtaInflate.h
+// Los usan tools/ota_pack.cpp y las pruebas. Solo para el host (zlib).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <zlib.h>
+
+// gzip con ventana de 2^windowBits (9 a 15). Devuelve false si zlib falla.
+// name, si no es nullptr, va en el campo FNAME de la cabecera.
+inline bool otaPackGzip(const std::vector<uint8_t>& in, int windowBits, std::vector<uint8_t>& out,
+                        const char* name = nullptr) {
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + windowBits, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  gz_header header;
+  memset(&header, 0, sizeof(header));
+  header.os = 3;  // Unix, como gzip
+  header.name = (Bytef*)name;
+  if (name && deflateSetHeader(&zs, &header) != Z_OK) {
+    deflateEnd(&zs);
+    return false;
+  }
+  out.resize(deflateBound(&zs, in.size()) + 64 + (name ? strlen(name) + 1 : 0));
+  zs.next_in = (Bytef*)in.data();
+  zs.avail_in = (uInt)in.size();
+  zs.next_out = out.data();
+  zs.avail_out = (uInt)out.size();
+  int ret = deflate(&zs, Z_FINISH);
+  out.resize(zs.total_out);
+  deflateEnd(&zs);
+  return ret == Z_STREAM_END;
+}
+
+// Flujo de bits MSB primero, como lo lee OtaInflate; el último byte se completa con ceros
+class OtaBitWriter {
+public:
+  explicit OtaBitWriter(std::vector<uint8_t>& out) : _out(out), _acc(0), _count(0) {}
+  void put(uint32_t value, uint8_t bits) {
+    while (bits > 0) {
+      bits--;
+      _acc = (uint8_t)((_acc << 1) | ((value >> bits) & 1));
+      if (++_count == 8) {
+        _out.push_back(_acc);
+        _acc = 0;
+        _count = 0;
+      }
+    }
+  }
+  void flush() {
+    if (_count > 0) _out.push_back((uint8_t)(_acc << (8 - _count)));
+    _acc = 0;
+    _count = 0;
+  }
+
+private:
+  std::vector<uint8_t>& _out;
+  uint8_t _acc;
+  uint8_t _count;
+};
+
+// heatshrink: ventana de 2^windowSz2 y coincidencias de hasta 2^lookaheadSz2 bytes. Es el
+// mismo flujo que genera el codificador de heatshrink (heatshrink -e -w W -l L): 1 + 8 bits
+// por literal y 0 + (distancia - 1) + (largo - 1) por referencia. Busca con cadenas de hash
+// de 3 bytes; una referencia se usa solo si ocupa menos bits que sus literales.
+inline bool otaPackHeatshrink(const std::vector<uint8_t>& in, uint8_t windowSz2, uint8_t lookaheadSz2,
+                              std::vector<uint8_t>& out) {
+  if (windowSz2 < 4 || windowSz2 > 15 || lookaheadSz2 < 3 || lookaheadSz2 >= windowSz2) return false;
+  if (in.empty() || in.size() > 0xFFFFFFFFu) return false;
+  const size_t maxDistance = ((size_t)1 << windowSz2) - 1;
+  const size_t maxLength = (size_t)1 << lookaheadSz2;
+  const size_t refBits = 1 + windowSz2 + lookaheadSz2;
+  const size_t maxChain = 256;
+  const size_t hashSize = 1 << 15;
+
+  out.assign({ 'H', 'S', windowSz2, lookaheadSz2,
+               (uint8_t)in.size(), (uint8_t)(in.size() >> 8),
+               (uint8_t)(in.size() >> 16), (uint8_t)(in.size() >> 24) });
+  OtaBitWriter bits(out);
+
+  std::vector<int32_t> head(hashSize, -1);
+  std::vector<int32_t> prev(in.size(), -1);
+  auto hashAt = [&](size_t i) {
+    return ((in[i] << 10) ^ (in[i + 1] << 5) ^ in[i + 2]) & (hashSize - 1);
+  };
+  auto insert = [&](size_t i) {
+    if (i + 2 >= in.size()) return;
+    size_t h = hashAt(i);
+    prev[i] = head[h];
+    head[h] = (int32_t)i;
+  };
+
+  size_t i = 0;
+  while (i < in.size()) {
+    size_t bestLen = 0;
+    size_t bestDist = 0;
+    if (i + 2 < in.size()) {
+      size_t limit = std::min(maxLength, in.size() - i);
+      size_t chain = 0;
+      for (int32_t j = head[hashAt(i)]; j >= 0 && chain < maxChain; j = prev[j], chain++) {
+        size_t dist = i - (size_t)j;
+        if (dist > maxDistance) break;
+        size_t len = 0;
+        while (len < limit && in[j + len] == in[i + len]) len++;
+        if (len > bestLen) {
+          bestLen = len;
+          bestDist = dist;
+          if (len == limit) break;
+        }
+      }
+    }
+    if (bestLen * 9 > refBits) {
+      bits.put(0, 1);
+      bits.put((uint32_t)(bestDist - 1), windowSz2);
+      bits.put((uint32_t)(bestLen - 1), lookaheadSz2);
+      for (size_t k = 0; k < bestLen; k++) insert(i + k);
+      i += bestLen;
+    } else {
+      bits.put(1, 1);
+      bits.put(in[i], 8);
+      insert(i);
+      i++;
+    }
+  }
+  bits.flush();
+  return true;
+}
+
+#endif
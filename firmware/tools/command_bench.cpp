@@ -0,0 +1,110 @@
+// Compara el costo de interpretar comandos OTA en mqttCallback: el método anterior
+// (String armado de a un carácter + substring) contra parseOtaCommand() sobre el buffer.
+// Usa el mismo parser que el firmware (EspOta/OtaCommand.h).
+//
+// Compilar:
+//   g++ -O2 -std=c++17 -I../EspOta command_bench.cpp -o command_bench
+// o con CMake desde la raíz del repositorio: cmake --build build --target command_bench
+//
+// Uso:
+//   command_bench [iteraciones]
+//
+// LegacyString imita al String de Arduino: cada += pide exactamente un byte más con
+// realloc. Los tiempos son del host: sirven para comparar ambos métodos entre sí.
+
+#include "OtaCommand.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* DEVICE_MAC = "24:0A:C4:01:02:FF";
+
+// Lo mínimo del String de Arduino que usaba mqttCallback
+class LegacyString {
+public:
+  LegacyString() : _buf(nullptr), _len(0), _allocs(0) {}
+  LegacyString(const char* s, size_t n) : _buf(nullptr), _len(0), _allocs(0) {
+    for (size_t i = 0; i < n; i++) *this += s[i];
+  }
+  ~LegacyString() { free(_buf); }
+  LegacyString(const LegacyString&) = delete;
+  LegacyString& operator=(const LegacyString&) = delete;
+
+  LegacyString& operator+=(char c) {
+    _buf = (char*)realloc(_buf, _len + 2);
+    _allocs++;
+    _buf[_len++] = c;
+    _buf[_len] = '\0';
+    return *this;
+  }
+  int indexOf(char c, size_t from = 0) const {
+    for (size_t i = from; i < _len; i++) if (_buf[i] == c) return (int)i;
+    return -1;
+  }
+  bool equals(const char* s) const { return _len == strlen(s) && memcmp(_buf, s, _len) == 0; }
+  bool startsWith(const char* s) const { size_t n = strlen(s); return n <= _len && memcmp(_buf, s, n) == 0; }
+  const char* data() const { return _buf; }
+  size_t length() const { return _len; }
+  size_t allocs() const { return _allocs; }
+
+private:
+  char* _buf;
+  size_t _len;
+  size_t _allocs;
+};
+
+// Devuelve 1 si el comando es para este dispositivo y válido; suma a allocs las reservas hechas
+static int parseLegacy(const uint8_t* payload, size_t length, size_t& allocs) {
+  LegacyString msg;
+  for (size_t i = 0; i < length; i++) msg += (char)payload[i];
+  allocs += msg.allocs();
+  int sep = msg.indexOf('|');
+  if (sep < 0) return 0;
+  LegacyString target(msg.data(), sep);
+  LegacyString url(msg.data() + sep + 1, msg.length() - sep - 1);
+  allocs += target.allocs() + url.allocs();
+  return (target.equals(DEVICE_MAC) || target.equals("all")) && url.startsWith("http");
+}
+
+static int parseViews(const uint8_t* payload, size_t length, size_t& allocs) {
+  OtaCommand cmd;
+  (void)allocs;
+  return parseOtaCommand(payload, length, DEVICE_MAC, cmd) == OTA_PARSE_OK;
+}
+
+template <typename F>
+static double timeIt(long iterations, const char* msg, F parse, size_t& allocs, long& hits) {
+  const uint8_t* payload = (const uint8_t*)msg;
+  size_t len = strlen(msg);
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; i++) hits += parse(payload, len, allocs);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+  long iterations = argc > 1 ? atol(argv[1]) : 200000;
+  if (iterations <= 0) {
+    fprintf(stderr, "Uso: %s [iteraciones]\n", argv[0]);
+    return 2;
+  }
+
+  struct Case { const char* name; const char* msg; } cases[] = {
+    { "otra MAC", "24:0A:C4:99:88:77|https://ota.example.com/firmware/esp32-v1.0.2.bin" },
+    { "propio",   "24:0A:C4:01:02:FF|https://ota.example.com/firmware/esp32-v1.0.2.bin" },
+    { "delta",    "all|delta|v1.0.1|https://ota.example.com/firmware/esp32-v1.0.1-v1.0.2.patch" },
+  };
+
+  long hits = 0;
+  printf("%-9s %14s %12s %14s %12s\n", "", "String ns", "reservas", "vistas ns", "reservas");
+  for (const Case& c : cases) {
+    size_t legacyAllocs = 0, viewAllocs = 0;
+    double legacyNs = timeIt(iterations, c.msg, parseLegacy, legacyAllocs, hits);
+    double viewNs = timeIt(iterations, c.msg, parseViews, viewAllocs, hits);
+    printf("%-9s %14.1f %12.1f %14.1f %12.1f\n", c.name,
+           legacyNs, (double)legacyAllocs / iterations, viewNs, (double)viewAllocs / iterations);
+  }
+  return hits == 0;  // nunca 0: solo evita que se optimice el bucle
+}
@@ -0,0 +1,570 @@
+// Benchmarks de Esp32OTA en el host: armado de mensajes, interpretación de comandos en
+// mqttCallback y OTA completa de red a flash contra el servidor HTTP en memoria.
+// La biblioteca se compila sin cambios sobre el entorno simulado de host/ (ver HostSim.h);
+// el hash y la firma usan el mbedtls del sistema, como en el ESP32.
+//
+// Compilar (desde la raíz del repositorio; ver CMakeLists.txt):
+//   cmake -S . -B build && cmake --build build --target esp32ota_bench esp32ota_bench_multiwifi
+// esp32ota_bench usa EspOta y esp32ota_bench_multiwifi, firmwarenuevoMultiwifi (-DBENCH_MULTIWIFI).
+//
+// Uso:
+//   esp32ota_bench [--json] [--filter=<texto>] [--min-time=<s>] [--verbose]
+//
+// --json escribe el mismo formato que Google Benchmark (--benchmark_format=json), así los
+// resultados se comparan entre commits con sus herramientas (compare.py). Los tiempos del
+// host no son los del ESP32: sirven para ver tendencias y regresiones, no valores absolutos.
+// El tinfl de la ROM es en el host zlib (host/rom/miniz.h): una medición de gzip aquí no
+// dice nada del ESP32, por eso no hay casos gzip.
+//
+// BM_Build*/string es la línea de base: el mensaje armado concatenando String como antes de
+// JsonWriter. Los casos que arman mensajes informan allocs_per_iter, las reservas de memoria
+// del hilo por iteración (operator new de este programa). El String del host es std::string,
+// que crece en forma geométrica; el de Arduino reserva a la medida en cada concatenación,
+// así que en el ESP32 la cuenta de la línea de base es como mínimo la de aquí.
+
+#include "Esp32OTA.h"
+#include "HostSim.h"
+
+#include <chrono>
+#include <map>
+#include <mbedtls/sha256.h>
+#include <mbedtls/version.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+#if MBEDTLS_VERSION_NUMBER < 0x03000000
+#define SHA256_ONESHOT mbedtls_sha256_ret
+#else
+#define SHA256_ONESHOT mbedtls_sha256
+#endif
+
+#ifdef BENCH_MULTIWIFI
+#define BENCH_LIBRARY "firmwarenuevoMultiwifi/EspOta"
+#else
+#define BENCH_LIBRARY "EspOta"
+#endif
+
+#define BENCH_VERSION    "v-bench"
+#define BENCH_SSID       "bench-ap"
+#define BENCH_IMAGE_URL  "http://ota.local/firmware.bin"
+#define BENCH_IMAGE_SIZE (1024 * 1024)
+#define BENCH_CONNECT_MS 5000
+
+// ---------------------------------------------------------------------------
+// Reservas de memoria del hilo (lo que String pide al heap en el dispositivo)
+// ---------------------------------------------------------------------------
+static thread_local uint64_t t_allocs = 0;
+
+void* operator new(size_t size) {
+  t_allocs++;
+  void* p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// ---------------------------------------------------------------------------
+// Mínimo compatible con Google Benchmark: iteraciones crecientes hasta min_time
+// ---------------------------------------------------------------------------
+class State {
+public:
+  explicit State(uint64_t iterations) : _iterations(iterations), _bytes(0), _error(nullptr) {}
+
+  // for (auto _ : state) { ... } mide el cuerpo; Pause/ResumeTiming excluyen la preparación
+  struct __attribute__((unused)) Value {};
+  struct Iterator {
+    State* state;
+    uint64_t left;
+    bool operator!=(const Iterator&) const {
+      if (left > 0 && !state->_error) return true;
+      state->stop();
+      return false;
+    }
+    void operator++() { left--; }
+    Value operator*() const { return Value(); }
+  };
+  Iterator begin() {
+    start();
+    return Iterator{ this, _iterations };
+  }
+  Iterator end() { return Iterator{ this, 0 }; }
+
+  void PauseTiming() { stop(); }
+  void ResumeTiming() { start(); }
+  void SetBytesProcessed(uint64_t bytes) { _bytes = bytes; }
+  void SkipWithError(const char* error) { _error = error; }
+
+  // Contadores propios por iteración, como state.counters de Google Benchmark
+  std::map<std::string, double> counters;
+
+  uint64_t iterations() const { return _iterations; }
+  double realSeconds() const { return _real; }
+  double cpuSeconds() const { return _cpu; }
+  uint64_t bytes() const { return _bytes; }
+  const char* error() const { return _error; }
+
+private:
+  static double cpuNow() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  }
+  void start() {
+    _realStart = std::chrono::steady_clock::now();
+    _cpuStart = cpuNow();
+  }
+  void stop() {
+    _real += std::chrono::duration<double>(std::chrono::steady_clock::now() - _realStart).count();
+    _cpu += cpuNow() - _cpuStart;
+  }
+
+  uint64_t _iterations;
+  uint64_t _bytes;
+  const char* _error;
+  double _real = 0;
+  double _cpu = 0;
+  std::chrono::steady_clock::time_point _realStart;
+  double _cpuStart = 0;
+};
+
+struct Benchmark {
+  std::string name;
+  void (*fn)(State&, long);
+  long arg;
+  const char* unit;  // unidad de tiempo del informe: "ns" o "ms"
+};
+
+struct Result {
+  std::string name;
+  uint64_t iterations;
+  double realTime;
+  double cpuTime;
+  const char* unit;
+  double bytesPerSecond;
+  std::map<std::string, double> counters;
+  const char* error;
+};
+
+// ---------------------------------------------------------------------------
+// Dispositivo bajo prueba y datos compartidos
+// ---------------------------------------------------------------------------
+static const char* g_ssids[] = { BENCH_SSID };
+static const char* g_passwords[] = { "bench-pass" };
+
+#ifdef BENCH_MULTIWIFI
+static Esp32OTA g_device("broker.local", 8883, "user", "pass", "bench", BENCH_VERSION);
+#else
+static Esp32OTA g_device("broker.local", 8883, "user", "pass", "bench", BENCH_VERSION);
+static Esp32OTA g_cborDevice("broker.local", 8883, "user", "pass", "bench-cbor", BENCH_VERSION, TELEMETRY_CBOR);
+#endif
+
+static std::vector<uint8_t> g_image;
+static std::string g_mac;
+static std::string g_manifestCmd;
+
+// Imagen con la forma de las de esptool: cabecera 0xE9, hash_appended y el SHA-256 al final
+static std::vector<uint8_t> makeImage(size_t size) {
+  std::vector<uint8_t> image(size);
+  uint32_t x = 2463534242UL;
+  for (size_t i = 0; i < size; i++) {
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    image[i] = (uint8_t)x;
+  }
+  image[0] = 0xE9;
+  image[23] = 1;
+  SHA256_ONESHOT(image.data(), size - 32, image.data() + size - 32, 0);
+  return image;
+}
+
+static std::string toHex(const uint8_t* data, size_t len) {
+  static const char digits[] = "0123456789abcdef";
+  std::string out;
+  for (size_t i = 0; i < len; i++) {
+    out += digits[data[i] >> 4];
+    out += digits[data[i] & 0x0F];
+  }
+  return out;
+}
+
+// Arranca el dispositivo y espera a que esté conectado al broker simulado
+static bool bringUp(Esp32OTA& device) {
+#ifdef BENCH_MULTIWIFI
+  device.addWiFi(g_ssids[0], g_passwords[0]);
+#else
+  device.setWiFiNetworks(g_ssids, g_passwords, 1);
+#endif
+  device.begin();
+  unsigned long start = millis();
+  while (millis() - start < BENCH_CONNECT_MS) {
+    device.loop();
+#ifdef BENCH_MULTIWIFI
+    if (host::mqttConnected()) return true;
+#else
+    if (device.getConnState() == CONN_ONLINE) return true;
+#endif
+    delay(1);
+  }
+  return false;
+}
+
+static bool deliver(const std::string& payload) {
+  return host::mqttDeliver(TOPIC_UPDATE_ALL, payload.data(), payload.size());
+}
+
+// Reservas por iteración desde before (t_allocs al empezar)
+static void countAllocs(State& state, uint64_t before) {
+  state.counters["allocs_per_iter"] = (double)(t_allocs - before) / state.iterations();
+}
+
+// ---------------------------------------------------------------------------
+// Armado de mensajes
+// ---------------------------------------------------------------------------
+static void BM_SendHeartbeat(State& state, long) {
+  uint32_t before = host::mqttStats().publishes;
+  uint64_t allocs = t_allocs;
+  for (auto _ : state) g_device.sendHeartbeat();
+  countAllocs(state, allocs);
+  if (host::mqttStats().publishes - before != state.iterations()) state.SkipWithError("publicación rechazada");
+}
+
+static void BM_SendSensorData(State& state, long cbor) {
+#ifdef BENCH_MULTIWIFI
+  Esp32OTA& device = g_device;  // sin CBOR en esta variante
+  (void)cbor;
+#else
+  Esp32OTA& device = cbor ? g_cborDevice : g_device;
+#endif
+  uint32_t before = host::mqttStats().publishes;
+  uint64_t allocs = t_allocs;
+  float t = 21.5f;
+  for (auto _ : state) {
+    device.sendSensorData(t, 48.25f);
+    t += 0.01f;
+  }
+  countAllocs(state, allocs);
+  if (host::mqttStats().publishes - before != state.iterations()) state.SkipWithError("publicación rechazada");
+}
+
+// Solo el armado del mensaje, sin publicarlo: String concatenado (como antes) o JsonWriter
+enum BuildPath { BUILD_STRING, BUILD_WRITER };
+
+static volatile size_t g_sink;
+
+static void BM_BuildSensorMessage(State& state, long path) {
+  String mac = WiFi.macAddress();
+  const char* name = "bench";
+  uint64_t allocs = t_allocs;
+  float t = 21.5f;
+  for (auto _ : state) {
+    if (path == BUILD_STRING) {
+      String payload = "{\"mac\":\"" + mac + "\",\"name\":\"" + name +
+                       "\",\"temperature\":" + String(t, 1) +
+                       ",\"humidity\":" + String(48.25f, 1) + "}";
+      g_sink = payload.length();
+    } else {
+      JsonMessage<192> msg;
+      msg.beginObject()
+         .field("mac", mac.c_str())
+         .field("name", name)
+         .field("temperature", t, 1)
+         .field("humidity", 48.25f, 1)
+         .endObject();
+      g_sink = msg.length();
+    }
+    t += 0.01f;
+  }
+  countAllocs(state, allocs);
+}
+
+static void BM_BuildHeartbeat(State& state, long path) {
+  String mac = WiFi.macAddress();
+  const char* name = "bench";
+  uint64_t allocs = t_allocs;
+  for (auto _ : state) {
+    if (path == BUILD_STRING) {
+      String payload = "{\"mac\":\"" + mac + "\",\"name\":\"" + name +
+                       "\",\"uptime\":" + String(millis()) + "}";
+      g_sink = payload.length();
+    } else {
+      JsonMessage<160> msg;
+      msg.beginObject()
+         .field("mac", mac.c_str())
+         .field("name", name)
+         .field("uptime", millis())
+         .endObject();
+      g_sink = msg.length();
+    }
+  }
+  countAllocs(state, allocs);
+}
+
+// Un lote de samples muestras: record() de cada una y flushTelemetry()
+static void BM_RecordFlushTelemetry(State& state, long samples) {
+  for (auto _ : state) {
+    for (long i = 0; i < samples; i++) g_device.record((i & 1) ? "humidity" : "temperature", 20.0f + i, "C");
+    if (!g_device.flushTelemetry()) {
+      state.SkipWithError("no se pudo publicar el lote");
+      return;
+    }
+  }
+}
+
+#ifndef BENCH_MULTIWIFI
+// Costo de registrar una muestra en un histograma (lo que se agrega a cada loop() y publish)
+static void BM_MetricsObserve(State& state, long) {
+  uint32_t v = 1;
+  for (auto _ : state) {
+    g_device.metrics().observe(METRIC_PUBLISH_US, v);
+    v = v * 1103515245u + 12345u;
+  }
+}
+
+// Armado de la instantánea de esp32/metrics (sin publicarla)
+static void BM_MetricsSnapshot(State& state, long) {
+  for (auto _ : state) {
+    for (int i = 0; i < 64; i++) g_device.metrics().observe(METRIC_LOOP_US, 50 + i * 37);
+    JsonMessage<METRICS_BYTES> msg;
+    msg.beginObject();
+    g_device.metrics().write(msg);
+    msg.endObject();
+    if (!msg.ok()) {
+      state.SkipWithError("la instantánea no entra en METRICS_BYTES");
+      return;
+    }
+  }
+}
+
+static void countJob(void* ctx) { ++*static_cast<uint32_t*>(ctx); }
+
+// Una vuelta de Scheduler::run() por ms simulado con la rueda llena de tareas periódicas
+// (lo que agrega cada loop() aunque no venza nada)
+static void BM_SchedulerRun(State& state, long) {
+  Scheduler jobs;
+  uint32_t fired = 0;
+  for (uint32_t i = 0; i < SCHEDULER_JOBS; i++) jobs.every(0, 100 + i * 997, countJob, &fired);
+  uint32_t now = 0;
+  for (auto _ : state) jobs.run(++now);
+  if (fired == 0 && now > 100) state.SkipWithError("ninguna tarea se ejecutó");
+}
+#endif
+
+// ---------------------------------------------------------------------------
+// mqttCallback: comandos que no llevan a una descarga
+// ---------------------------------------------------------------------------
+enum CallbackCase { CB_OTHER_TARGET, CB_INVALID, CB_COHORT_SKIP, CB_MANIFEST_SKIP };
+
+static void BM_MqttCallback(State& state, long which) {
+  std::string payload;
+  switch (which) {
+    case CB_OTHER_TARGET: payload = "AA:BB:CC:DD:EE:FF|" BENCH_IMAGE_URL; break;
+    case CB_INVALID:      payload = g_mac + "|ftp://no-es-una-url"; break;
+    case CB_COHORT_SKIP:  payload = "all|" BENCH_IMAGE_URL "|pct=0"; break;
+    default:              payload = g_manifestCmd; break;
+  }
+  uint32_t published = host::mqttStats().publishes;
+  for (auto _ : state) {
+    if (!deliver(payload)) {
+      state.SkipWithError("el broker simulado no entregó el mensaje");
+      return;
+    }
+  }
+  // Ninguno de estos comandos puede iniciar una OTA; solo el manifiesto informa "skipped"
+  if (host::restarts() != 0 || (which != CB_MANIFEST_SKIP && host::mqttStats().publishes != published)) {
+    state.SkipWithError("el comando tuvo efectos inesperados");
+  }
+}
+
+// ---------------------------------------------------------------------------
+// OTA de red a flash: segmentos TCP de segment bytes (y profundidad del pipeline en EspOta)
+// ---------------------------------------------------------------------------
+static void BM_OtaStreamToFlash(State& state, long arg) {
+  long segment = arg & 0xFFFFF;
+  long depth = arg >> 20;
+  host::setSegmentSize(segment);
+#ifdef BENCH_MULTIWIFI
+  (void)depth;
+  std::string cmd = g_mac + "|" BENCH_IMAGE_URL;
+#else
+  g_device.setOTAPipeline(OTA_CHUNK_SIZE, (uint8_t)depth);
+#endif
+  for (auto _ : state) {
+    uint32_t restarts = host::restarts();
+#ifdef BENCH_MULTIWIFI
+    deliver(cmd);  // doOTA() bloquea hasta el final, como en el dispositivo
+#else
+    g_device.requestOTA(BENCH_IMAGE_URL);
+    while (g_device.isOTAInProgress()) g_device.loop();
+#endif
+    state.PauseTiming();
+    bool ok = host::restarts() == restarts + 1 && host::bootPartition()[0] != '\0';
+    host::resetBootPartition();
+    if (!ok) {
+      state.SkipWithError("la OTA no terminó con la imagen activada");
+      return;
+    }
+    state.ResumeTiming();
+  }
+  state.SetBytesProcessed(state.iterations() * g_image.size());
+}
+
+#define OTA_ARG(segment, depth) (((long)(depth) << 20) | (segment))
+
+static const Benchmark g_benchmarks[] = {
+  { "BM_SendHeartbeat", BM_SendHeartbeat, 0, "ns" },
+  { "BM_SendSensorData/json", BM_SendSensorData, 0, "ns" },
+#ifndef BENCH_MULTIWIFI
+  { "BM_SendSensorData/cbor", BM_SendSensorData, 1, "ns" },
+#endif
+  { "BM_BuildSensorMessage/string", BM_BuildSensorMessage, BUILD_STRING, "ns" },
+  { "BM_BuildSensorMessage/writer", BM_BuildSensorMessage, BUILD_WRITER, "ns" },
+  { "BM_BuildHeartbeat/string", BM_BuildHeartbeat, BUILD_STRING, "ns" },
+  { "BM_BuildHeartbeat/writer", BM_BuildHeartbeat, BUILD_WRITER, "ns" },
+  { "BM_RecordFlushTelemetry/16", BM_RecordFlushTelemetry, 16, "ns" },
+#ifndef BENCH_MULTIWIFI
+  { "BM_MetricsObserve", BM_MetricsObserve, 0, "ns" },
+  { "BM_MetricsSnapshot", BM_MetricsSnapshot, 0, "ns" },
+  { "BM_SchedulerRun", BM_SchedulerRun, 0, "ns" },
+#endif
+  { "BM_MqttCallback/other_target", BM_MqttCallback, CB_OTHER_TARGET, "ns" },
+  { "BM_MqttCallback/invalid", BM_MqttCallback, CB_INVALID, "ns" },
+  { "BM_MqttCallback/cohort_skip", BM_MqttCallback, CB_COHORT_SKIP, "ns" },
+  { "BM_MqttCallback/manifest_skip", BM_MqttCallback, CB_MANIFEST_SKIP, "ns" },
+#ifdef BENCH_MULTIWIFI
+  { "BM_OtaStreamToFlash/1460", BM_OtaStreamToFlash, OTA_ARG(1460, 1), "ms" },
+  { "BM_OtaStreamToFlash/16384", BM_OtaStreamToFlash, OTA_ARG(16384, 1), "ms" },
+#else
+  { "BM_OtaStreamToFlash/1460/1", BM_OtaStreamToFlash, OTA_ARG(1460, 1), "ms" },
+  { "BM_OtaStreamToFlash/1460/2", BM_OtaStreamToFlash, OTA_ARG(1460, 2), "ms" },
+  { "BM_OtaStreamToFlash/16384/1", BM_OtaStreamToFlash, OTA_ARG(16384, 1), "ms" },
+  { "BM_OtaStreamToFlash/16384/2", BM_OtaStreamToFlash, OTA_ARG(16384, 2), "ms" },
+#endif
+};
+
+// ---------------------------------------------------------------------------
+// Ejecución e informe
+// ---------------------------------------------------------------------------
+static Result run(const Benchmark& bm, double minTime) {
+  uint64_t iterations = 1;
+  for (;;) {
+    State state(iterations);
+    bm.fn(state, bm.arg);
+    double scale = strcmp(bm.unit, "ms") == 0 ? 1e3 : 1e9;
+    bool done = state.error() || state.realSeconds() >= minTime || iterations >= 1000000000ULL;
+    if (done) {
+      Result r;
+      r.name = bm.name;
+      r.iterations = state.iterations();
+      r.realTime = state.realSeconds() * scale / iterations;
+      r.cpuTime = state.cpuSeconds() * scale / iterations;
+      r.unit = bm.unit;
+      r.bytesPerSecond = state.bytes() > 0 && state.realSeconds() > 0 ? state.bytes() / state.realSeconds() : 0;
+      r.counters = state.counters;
+      r.error = state.error();
+      return r;
+    }
+    // Como Google Benchmark: estimar las iteraciones para min_time, con un margen del 40%
+    double perIter = state.realSeconds() / iterations;
+    uint64_t next = perIter > 0 ? (uint64_t)(minTime * 1.4 / perIter) : iterations * 10;
+    iterations = std::max(iterations + 1, std::min(next, iterations * 10));
+  }
+}
+
+static void printJson(const std::vector<Result>& results) {
+  char date[32];
+  time_t now = time(nullptr);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+  printf("{\n  \"context\": {\n");
+  printf("    \"date\": \"%s\",\n", date);
+  printf("    \"executable\": \"esp32ota_bench\",\n");
+  printf("    \"library\": \"%s\",\n", BENCH_LIBRARY);
+  printf("    \"image_bytes\": %zu,\n", g_image.size());
+  printf("    \"library_build_type\": \"release\"\n  },\n");
+  printf("  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    printf("    {\n      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n      \"run_type\": \"iteration\",\n",
+           r.name.c_str(), r.name.c_str());
+    if (r.error) {
+      printf("      \"error_occurred\": true,\n      \"error_message\": \"%s\"\n    }%s\n",
+             r.error, i + 1 < results.size() ? "," : "");
+      continue;
+    }
+    printf("      \"iterations\": %llu,\n", (unsigned long long)r.iterations);
+    printf("      \"real_time\": %.6e,\n      \"cpu_time\": %.6e,\n", r.realTime, r.cpuTime);
+    printf("      \"time_unit\": \"%s\"", r.unit);
+    if (r.bytesPerSecond > 0) printf(",\n      \"bytes_per_second\": %.6e", r.bytesPerSecond);
+    for (const auto& c : r.counters) printf(",\n      \"%s\": %.6e", c.first.c_str(), c.second);
+    printf("\n    }%s\n", i + 1 < results.size() ? "," : "");
+  }
+  printf("  ]\n}\n");
+}
+
+static void printTable(const std::vector<Result>& results) {
+  printf("%-32s %14s %14s %12s %12s\n", "Benchmark", "Time", "CPU", "Iterations", "MB/s");
+  for (const Result& r : results) {
+    if (r.error) {
+      printf("%-32s ERROR: %s\n", r.name.c_str(), r.error);
+      continue;
+    }
+    printf("%-32s %11.3f %-2s %11.3f %-2s %12llu", r.name.c_str(), r.realTime, r.unit, r.cpuTime, r.unit,
+           (unsigned long long)r.iterations);
+    if (r.bytesPerSecond > 0) printf(" %12.1f", r.bytesPerSecond / 1048576.0);
+    else if (!r.counters.empty()) printf(" %12s", "");
+    for (const auto& c : r.counters) printf(" %s=%.1f", c.first.c_str(), c.second);
+    printf("\n");
+  }
+}
+
+int main(int argc, char** argv) {
+  bool json = false;
+  double minTime = 0.5;
+  const char* filter = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0) json = true;
+    else if (strcmp(argv[i], "--verbose") == 0) host::setVerbose(true);
+    else if (strncmp(argv[i], "--filter=", 9) == 0) filter = argv[i] + 9;
+    else if (strncmp(argv[i], "--min-time=", 11) == 0) minTime = atof(argv[i] + 11);
+    else {
+      fprintf(stderr, "Uso: %s [--json] [--filter=<texto>] [--min-time=<s>] [--verbose]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  // La imagen servida es también la que "corre": el manifiesto de esa versión se omite
+  g_image = makeImage(BENCH_IMAGE_SIZE);
+  host::serve(BENCH_IMAGE_URL, g_image.data(), g_image.size(), nullptr, "\"bench-1\"");
+  host::setRunningImage(g_image.data(), g_image.size());
+  host::addAccessPoint(BENCH_SSID, -52, 6);
+  g_mac = WiFi.macAddress().c_str();
+  g_manifestCmd = g_mac + "|manifest|" BENCH_VERSION "|" + std::to_string(g_image.size()) + "|" +
+                  toHex(g_image.data() + g_image.size() - 32, 32) + "|" BENCH_IMAGE_URL;
+
+#ifndef BENCH_MULTIWIFI
+  // El último dispositivo conectado es el que recibe los mensajes de host::mqttDeliver()
+  if (!bringUp(g_cborDevice)) {
+    fprintf(stderr, "El dispositivo CBOR no se conectó al broker simulado\n");
+    return 1;
+  }
+#endif
+  if (!bringUp(g_device)) {
+    fprintf(stderr, "El dispositivo no se conectó al broker simulado\n");
+    return 1;
+  }
+  host::mqttReset();
+
+  std::vector<Result> results;
+  bool failed = false;
+  for (const Benchmark& bm : g_benchmarks) {
+    if (filter && bm.name.find(filter) == std::string::npos) continue;
+    results.push_back(run(bm, minTime));
+    failed |= results.back().error != nullptr;
+  }
+  if (json) printJson(results);
+  else printTable(results);
+  return failed;
+}
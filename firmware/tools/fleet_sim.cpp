@@ -0,0 +1,529 @@
+// Simulador de flota: miles de Esp32OTA (EspOta) en un solo proceso, cada uno con su MAC,
+// contra el broker simulado de host/ o contra un broker real (mosquitto) para cargar la
+// ingesta de servernode (MQTTManager) antes de sumar sitios. Cada placa corre el código
+// del firmware sin cambios: connectMQTT() desde la máquina de conectividad, el heartbeat
+// de la biblioteca, sendSensorData()/record() al ritmo pedido y las OTA "all|" con sus
+// cohortes y ventana, descargando del servidor HTTP en memoria.
+//
+// Compilar (desde la raíz del repositorio; ver CMakeLists.txt):
+//   cmake -S . -B build && cmake --build build --target fleet_sim
+//
+// Uso:
+//   fleet_sim [--devices=N] [--duration=s] [--ramp=s] [--sensor=s] [--record=s] [--heartbeat=s]
+//             [--cbor=%] [--broker=host:puerto] [--auth=usuario:clave]
+//             [--storm-every=s] [--storm-pct=%] [--ota-at=s] [--ota-pct=%] [--ota-win=s]
+//             [--ota-kb=KB] [--verbose]
+//
+// Las placas corren por turnos en el hilo principal, como loop() en cada ESP32. Un cliente
+// observador, en su propio hilo, se suscribe a esp32/# : la latencia de punta a punta va
+// desde el publish() del dispositivo hasta que el observador lo recibe del broker, e incluye
+// la vuelta por las placas. Con --broker, servernode puede publicar su ritmo de ingesta en
+// esp32/server/ingest (MQTT_INGEST_STATS_MS) y el resumen lo agrega.
+//
+// --storm-every corta el WiFi de --storm-pct % de la flota a la vez (reconexión en masa);
+// --ota-at publica "all|<url>|pct=..|win=.." en esp32/update/all, como la API del servidor.
+
+#include "Esp32OTA.h"
+#include "HostSim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mbedtls/sha256.h>
+#include <mbedtls/version.h>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if MBEDTLS_VERSION_NUMBER < 0x03000000
+#define SHA256_ONESHOT mbedtls_sha256_ret
+#else
+#define SHA256_ONESHOT mbedtls_sha256
+#endif
+
+#define FLEET_VERSION    "v-fleet"
+#define FLEET_SSID       "fleet-ap"
+#define FLEET_IMAGE_URL  "http://ota.local/fleet.bin"
+#define FLEET_INGEST_TOPIC "esp32/server/ingest"
+#define FLEET_REPORT_MS  5000
+
+struct Options {
+  unsigned devices = 100;
+  double duration = 30;
+  double ramp = 0;
+  double sensor = 10;
+  double record = 0;
+  double heartbeat = 0;
+  unsigned cborPct = 0;
+  std::string brokerHost;
+  uint16_t brokerPort = 0;
+  std::string user = "fleet";
+  std::string pass = "fleet";
+  double stormEvery = 0;
+  unsigned stormPct = 10;
+  double otaAt = -1;
+  unsigned otaPct = 100;
+  unsigned otaWin = 0;
+  unsigned otaKb = 64;
+};
+
+// ---------------------------------------------------------------------------
+// Mediciones: lo publicado (por el gancho de host/) contra lo que recibe el observador
+// ---------------------------------------------------------------------------
+static double percentile(std::vector<double> v, double q) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(q * v.size()))];
+}
+
+static double jsonNumber(const std::string& json, const char* key) {
+  std::string pattern = std::string("\"") + key + "\":";
+  size_t at = json.find(pattern);
+  return at == std::string::npos ? 0 : strtod(json.c_str() + at + pattern.size(), nullptr);
+}
+
+static bool isCommand(const char* topic) {
+  return strncmp(topic, TOPIC_UPDATE, strlen(TOPIC_UPDATE)) == 0;
+}
+
+class FleetMetrics {
+public:
+  void published(const char* topic, const uint8_t* payload, size_t len) {
+    if (isCommand(topic)) return;
+    std::lock_guard<std::mutex> guard(_lock);
+    _inFlight[key(topic, payload, len)].push_back(micros());
+    _published++;
+    _publishedBytes += len;
+  }
+
+  void received(const char* topic, const uint8_t* payload, size_t len) {
+    if (isCommand(topic)) return;
+    unsigned long now = micros();
+    std::string body((const char*)payload, len);
+    std::lock_guard<std::mutex> guard(_lock);
+    if (strcmp(topic, FLEET_INGEST_TOPIC) == 0) {
+      _server.reports++;
+      _server.windowMs += jsonNumber(body, "windowMs");
+      _server.processed += jsonNumber(body, "processed");
+      _server.errors += jsonNumber(body, "errors");
+      _server.p50Ms = jsonNumber(body, "p50Ms");
+      _server.p99Ms = std::max(_server.p99Ms, jsonNumber(body, "p99Ms"));
+      return;
+    }
+    _received++;
+    auto it = _inFlight.find(key(topic, payload, len));
+    if (it != _inFlight.end()) {
+      _latencyMs.push_back((now - it->second.front()) / 1000.0);
+      it->second.pop_front();
+      if (it->second.empty()) _inFlight.erase(it);
+    }
+    if (strcmp(topic, TOPIC_STATUS) == 0 && body.find("\"status\":\"ota\"") != std::string::npos) {
+      size_t at = body.find("\"result\":\"");
+      if (at != std::string::npos) {
+        at += 10;
+        _otaResults[body.substr(at, body.find('"', at) - at)]++;
+      }
+    }
+  }
+
+  struct Server {
+    unsigned reports = 0;
+    double windowMs = 0;
+    double processed = 0;
+    double errors = 0;
+    double p50Ms = 0;
+    double p99Ms = 0;
+  };
+
+  struct Snapshot {
+    uint64_t published;
+    uint64_t publishedBytes;
+    uint64_t received;
+    size_t unmatched;
+    std::vector<double> latencyMs;
+    std::map<std::string, unsigned> otaResults;
+    Server server;
+  };
+
+  Snapshot snapshot() {
+    std::lock_guard<std::mutex> guard(_lock);
+    Snapshot s;
+    s.published = _published;
+    s.publishedBytes = _publishedBytes;
+    s.received = _received;
+    s.unmatched = 0;
+    for (auto& entry : _inFlight) s.unmatched += entry.second.size();
+    s.latencyMs = _latencyMs;
+    s.otaResults = _otaResults;
+    s.server = _server;
+    return s;
+  }
+
+private:
+  static std::string key(const char* topic, const uint8_t* payload, size_t len) {
+    std::string k(topic);
+    k += '\n';
+    k.append((const char*)payload, len);
+    return k;
+  }
+
+  std::mutex _lock;
+  std::unordered_map<std::string, std::deque<unsigned long>> _inFlight;
+  uint64_t _published = 0;
+  uint64_t _publishedBytes = 0;
+  uint64_t _received = 0;
+  std::vector<double> _latencyMs;
+  std::map<std::string, unsigned> _otaResults;
+  Server _server;
+};
+
+static FleetMetrics g_metrics;
+
+// ---------------------------------------------------------------------------
+// Observador: suscrito a esp32/#, publica el comando OTA cuando se lo piden
+// ---------------------------------------------------------------------------
+struct Observer {
+  const Options* options;
+  std::atomic<bool> ready{ false };
+  std::atomic<bool> failed{ false };
+  std::atomic<bool> stop{ false };
+  std::mutex lock;
+  std::string command;  // comando OTA pendiente de publicar
+};
+
+static void observerMain(Observer* o) {
+  static const uint8_t mac[6] = { 0x02, 0xF1, 0xEE, 0xFF, 0xFF, 0xFF };
+  host::selectDevice(host::createDevice(mac));
+  WiFi.begin(FLEET_SSID, "fleet-pass");
+
+  PubSubClient client;
+  client.setBufferSize(TELEMETRY_BATCH_BYTES + 128);
+  client.setCallback([](char* topic, uint8_t* payload, unsigned int length) {
+    g_metrics.received(topic, payload, length);
+  });
+  const char* user = o->options->user.c_str();
+  const char* pass = o->options->pass.c_str();
+  if (!client.connect("fleet-observer", user, pass, nullptr, 0, false, nullptr) ||
+      !client.subscribe("esp32/#")) {
+    o->failed = true;
+    return;
+  }
+  o->ready = true;
+  while (!o->stop) {
+    std::string command;
+    {
+      std::lock_guard<std::mutex> guard(o->lock);
+      command.swap(o->command);
+    }
+    if (!command.empty()) client.publish(TOPIC_UPDATE_ALL, command.c_str(), false);
+    if (!client.loop()) {
+      client.connect("fleet-observer", user, pass, nullptr, 0, false, nullptr);
+      client.subscribe("esp32/#");
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  client.disconnect();
+}
+
+// ---------------------------------------------------------------------------
+// Placas
+// ---------------------------------------------------------------------------
+static const char* g_ssids[] = { FLEET_SSID };
+static const char* g_passwords[] = { "fleet-pass" };
+
+struct Board {
+  host::Device* device;
+  std::unique_ptr<Esp32OTA> ota;
+  std::string name;
+  TelemetryEncoding encoding;
+  bool started;
+  uint32_t restarts;
+  unsigned long startAt;
+  unsigned long bootAt;     // begin(), hasta CONN_ONLINE
+  unsigned long droppedAt;  // corte de WiFi provocado, hasta CONN_ONLINE
+  bool everOnline;
+  unsigned long nextSensor;
+  unsigned long nextRecord;
+  unsigned long nextHeartbeat;
+  float temperature;
+};
+
+// Como setup() del sketch; también tras cada ESP.restart() (host::reboot())
+static void boot(Board& b, const Options& o) {
+  b.ota.reset(new Esp32OTA(o.brokerHost.empty() ? "broker.local" : o.brokerHost.c_str(),
+                           o.brokerPort ? o.brokerPort : 1883, o.user.c_str(), o.pass.c_str(),
+                           b.name.c_str(), FLEET_VERSION, b.encoding));
+  b.ota->setWiFiNetworks(g_ssids, g_passwords, 1);
+  // Sin tarea de flash: en el host cada placa sería un hilo más
+  b.ota->setOTAPipeline(4096, 1);
+  b.ota->begin();
+  b.bootAt = millis();
+}
+
+static unsigned long jitter(std::mt19937& rng, double seconds) {
+  return seconds > 0 ? rng() % (unsigned long)(seconds * 1000) : 0;
+}
+
+static bool parseOptions(int argc, char** argv, Options& o) {
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    const char* v = strchr(a, '=');
+    std::string name = v ? std::string(a, v - a) : std::string(a);
+    v = v ? v + 1 : "";
+    if (name == "--devices") o.devices = (unsigned)atoi(v);
+    else if (name == "--duration") o.duration = atof(v);
+    else if (name == "--ramp") o.ramp = atof(v);
+    else if (name == "--sensor") o.sensor = atof(v);
+    else if (name == "--record") o.record = atof(v);
+    else if (name == "--heartbeat") o.heartbeat = atof(v);
+    else if (name == "--cbor") o.cborPct = (unsigned)atoi(v);
+    else if (name == "--storm-every") o.stormEvery = atof(v);
+    else if (name == "--storm-pct") o.stormPct = (unsigned)atoi(v);
+    else if (name == "--ota-at") o.otaAt = atof(v);
+    else if (name == "--ota-pct") o.otaPct = (unsigned)atoi(v);
+    else if (name == "--ota-win") o.otaWin = (unsigned)atoi(v);
+    else if (name == "--ota-kb") o.otaKb = (unsigned)atoi(v);
+    else if (name == "--verbose") host::setVerbose(true);
+    else if (name == "--broker") {
+      const char* colon = strrchr(v, ':');
+      o.brokerHost = colon ? std::string(v, colon - v) : std::string(v);
+      o.brokerPort = colon ? (uint16_t)atoi(colon + 1) : 1883;
+    } else if (name == "--auth") {
+      const char* colon = strchr(v, ':');
+      o.user = colon ? std::string(v, colon - v) : std::string(v);
+      o.pass = colon ? std::string(colon + 1) : std::string();
+    } else {
+      return false;
+    }
+  }
+  return o.devices > 0 && o.duration > 0 && o.otaKb >= 1 && o.cborPct <= 100 && o.stormPct <= 100 &&
+         o.otaPct <= 100;
+}
+
+// Imagen con la forma de las de esptool: cabecera 0xE9, hash_appended y el SHA-256 al final
+static std::vector<uint8_t> makeImage(size_t size) {
+  std::vector<uint8_t> image(size);
+  uint32_t x = 2463534242UL;
+  for (size_t i = 0; i < size; i++) {
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    image[i] = (uint8_t)x;
+  }
+  image[0] = 0xE9;
+  image[23] = 1;
+  SHA256_ONESHOT(image.data(), size - 32, image.data() + size - 32, 0);
+  return image;
+}
+
+static void printLatency(const char* label, const std::vector<double>& ms) {
+  printf("%s (ms): p50 %.2f  p90 %.2f  p99 %.2f  p99.9 %.2f  máx %.2f  (%zu muestras)\n", label,
+         percentile(ms, 0.50), percentile(ms, 0.90), percentile(ms, 0.99), percentile(ms, 0.999),
+         percentile(ms, 1.0), ms.size());
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  if (!parseOptions(argc, argv, o)) {
+    fprintf(stderr,
+            "Uso: %s [--devices=N] [--duration=s] [--ramp=s] [--sensor=s] [--record=s] [--heartbeat=s]\n"
+            "       [--cbor=%%] [--broker=host:puerto] [--auth=usuario:clave]\n"
+            "       [--storm-every=s] [--storm-pct=%%] [--ota-at=s] [--ota-pct=%%] [--ota-win=s]\n"
+            "       [--ota-kb=KB] [--verbose]\n", argv[0]);
+    return 2;
+  }
+  if (!o.brokerHost.empty() && !host::setMqttBroker(o.brokerHost.c_str(), o.brokerPort)) {
+    fprintf(stderr, "No se pudo resolver el broker %s\n", o.brokerHost.c_str());
+    return 2;
+  }
+
+  std::vector<uint8_t> image = makeImage((size_t)o.otaKb * 1024);
+  host::serve(FLEET_IMAGE_URL, image.data(), image.size(), nullptr, "\"fleet-1\"");
+  host::addAccessPoint(FLEET_SSID, -60, 6);
+  host::onMqttPublish([](const char* topic, const uint8_t* payload, size_t len) {
+    g_metrics.published(topic, payload, len);
+  });
+
+  Observer observer;
+  observer.options = &o;
+  std::thread observerThread(observerMain, &observer);
+  while (!observer.ready && !observer.failed) delay(1);
+  if (observer.failed) {
+    fprintf(stderr, "El observador no se conectó al broker\n");
+    observerThread.join();
+    return 1;
+  }
+
+  // MAC localmente administrada: 02:F1:EE + número de placa
+  std::mt19937 rng(0xF1EE7u);
+  std::vector<Board> boards(o.devices);
+  unsigned cbor = 0;
+  for (unsigned i = 0; i < o.devices; i++) {
+    Board& b = boards[i];
+    uint8_t mac[6] = { 0x02, 0xF1, 0xEE, (uint8_t)(i >> 16), (uint8_t)(i >> 8), (uint8_t)i };
+    char name[24];
+    snprintf(name, sizeof(name), "fleet-%05u", i);
+    b.device = host::createDevice(mac);
+    b.name = name;
+    b.encoding = i * 100 < o.cborPct * o.devices ? TELEMETRY_CBOR : TELEMETRY_JSON;
+    cbor += b.encoding == TELEMETRY_CBOR;
+    b.started = false;
+    b.restarts = 0;
+    b.startAt = millis() + jitter(rng, o.ramp);
+    b.droppedAt = 0;
+    b.everOnline = false;
+    b.temperature = 18.0f + (float)(rng() % 100) / 10.0f;
+  }
+
+  std::vector<double> bootMs;
+  std::vector<double> reconnectMs;
+  unsigned reboots = 0;
+  unsigned drops = 0;
+  unsigned long start = millis();
+  unsigned long end = start + (unsigned long)(o.duration * 1000);
+  unsigned long nextStorm = o.stormEvery > 0 ? start + (unsigned long)(o.stormEvery * 1000) : 0;
+  bool otaSent = o.otaAt < 0;
+  unsigned long nextReport = start + FLEET_REPORT_MS;
+  FleetMetrics::Snapshot last = g_metrics.snapshot();
+
+  printf("Flota: %u placas EspOta (%u CBOR), %.0f s, broker %s\n", o.devices, cbor, o.duration,
+         o.brokerHost.empty() ? "simulado" : (o.brokerHost + ":" + std::to_string(o.brokerPort)).c_str());
+  while ((long)(millis() - end) < 0) {
+    unsigned long passStart = millis();
+    unsigned online = 0;
+    for (Board& b : boards) {
+      unsigned long now = millis();
+      if (!b.started) {
+        if ((long)(now - b.startAt) < 0) continue;
+        host::selectDevice(b.device);
+        boot(b, o);
+        b.started = true;
+        b.nextSensor = now + jitter(rng, o.sensor);
+        b.nextRecord = now + jitter(rng, o.record);
+        b.nextHeartbeat = now + jitter(rng, o.heartbeat);
+      }
+      host::selectDevice(b.device);
+      b.ota->loop();
+
+      // ESP.restart() tras una OTA: la placa arranca de nuevo con la partición escrita
+      if (host::restarts() != b.restarts) {
+        b.restarts = host::restarts();
+        host::reboot();
+        boot(b, o);
+        b.droppedAt = 0;
+        reboots++;
+        continue;
+      }
+      bool isOnline = b.ota->getConnState() == CONN_ONLINE;
+      if (isOnline) {
+        online++;
+        if (!b.everOnline) {
+          bootMs.push_back((double)(millis() - b.bootAt));
+          b.everOnline = true;
+        }
+        if (b.droppedAt) {
+          reconnectMs.push_back((double)(millis() - b.droppedAt));
+          b.droppedAt = 0;
+        }
+      }
+
+      // Lo que haría el loop() del sketch
+      b.temperature += ((int)(rng() % 21) - 10) / 100.0f;
+      if (o.sensor > 0 && (long)(now - b.nextSensor) >= 0) {
+        b.ota->sendSensorData(b.temperature, 40.0f + (float)(rng() % 200) / 10.0f);
+        b.nextSensor += (unsigned long)(o.sensor * 1000);
+      }
+      if (o.record > 0 && (long)(now - b.nextRecord) >= 0) {
+        b.ota->record("temperature", b.temperature, "C");
+        b.ota->record("humidity", 40.0f + (float)(rng() % 200) / 10.0f, "%");
+        b.nextRecord += (unsigned long)(o.record * 1000);
+      }
+      if (o.heartbeat > 0 && (long)(now - b.nextHeartbeat) >= 0) {
+        b.ota->sendHeartbeat();
+        b.nextHeartbeat += (unsigned long)(o.heartbeat * 1000);
+      }
+    }
+
+    unsigned long now = millis();
+    // Corte de WiFi simultáneo en una parte de la flota (reinicio de un AP, microcorte...)
+    if (nextStorm && (long)(now - nextStorm) >= 0) {
+      unsigned cut = 0;
+      for (Board& b : boards) {
+        if (!b.started || b.droppedAt || rng() % 100 >= o.stormPct) continue;
+        host::selectDevice(b.device);
+        if (WiFi.status() != WL_CONNECTED) continue;
+        host::dropWiFi();
+        b.droppedAt = now;
+        cut++;
+      }
+      drops += cut;
+      printf("  %5.1f s  corte de WiFi en %u placas\n", (now - start) / 1000.0, cut);
+      nextStorm += (unsigned long)(o.stormEvery * 1000);
+    }
+    if (!otaSent && now - start >= (unsigned long)(o.otaAt * 1000)) {
+      std::string command = "all|" FLEET_IMAGE_URL;
+      if (o.otaPct < 100) command += "|pct=" + std::to_string(o.otaPct);
+      if (o.otaWin > 0) command += "|win=" + std::to_string(o.otaWin);
+      {
+        std::lock_guard<std::mutex> guard(observer.lock);
+        observer.command = command;
+      }
+      printf("  %5.1f s  OTA: %s\n", (now - start) / 1000.0, command.c_str());
+      otaSent = true;
+    }
+    if ((long)(now - nextReport) >= 0) {
+      FleetMetrics::Snapshot s = g_metrics.snapshot();
+      printf("  %5.1f s  en línea %u/%u  publicados %.0f/s  recibidos %.0f/s\n", (now - start) / 1000.0,
+             online, o.devices, (s.published - last.published) * 1000.0 / FLEET_REPORT_MS,
+             (s.received - last.received) * 1000.0 / FLEET_REPORT_MS);
+      last = s;
+      nextReport += FLEET_REPORT_MS;
+    }
+    // Como el delay(10) del sketch, pero sin frenar una flota grande
+    if (millis() - passStart < 1) delay(1);
+  }
+
+  // Lo último publicado todavía puede estar en camino al observador
+  delay(500);
+  observer.stop = true;
+  observerThread.join();
+
+  double seconds = (millis() - start) / 1000.0;
+  unsigned online = 0;
+  unsigned everOnline = 0;
+  for (Board& b : boards) {
+    host::selectDevice(b.device);
+    online += b.started && b.ota->getConnState() == CONN_ONLINE;
+    everOnline += b.everOnline;
+  }
+  FleetMetrics::Snapshot s = g_metrics.snapshot();
+  printf("\nEn línea al final: %u/%u (alguna vez: %u)\n", online, o.devices, everOnline);
+  printLatency("Arranque hasta CONN_ONLINE", bootMs);
+  printf("Publicados: %llu mensajes (%.0f/s, %.1f KB/s)  recibidos por el observador: %llu (%.0f/s)  "
+         "sin llegar: %zu\n", (unsigned long long)s.published, s.published / seconds,
+         s.publishedBytes / seconds / 1024.0, (unsigned long long)s.received, s.received / seconds,
+         s.unmatched);
+  printLatency("Latencia de punta a punta", s.latencyMs);
+  if (drops > 0) {
+    printf("Cortes de WiFi: %u, reconectadas: %zu\n", drops, reconnectMs.size());
+    printLatency("Reconexión hasta CONN_ONLINE", reconnectMs);
+  }
+  if (o.otaAt >= 0) {
+    printf("OTA all|: %u reinicios; informes:", reboots);
+    for (auto& r : s.otaResults) printf(" %s=%u", r.first.c_str(), r.second);
+    printf("\n");
+  }
+  if (s.server.reports > 0) {
+    printf("Servidor (%s): %.0f procesados (%.0f/s), %.0f errores, manejo p50 %.1f ms, p99 máx %.1f ms\n",
+           FLEET_INGEST_TOPIC, s.server.processed,
+           s.server.windowMs > 0 ? s.server.processed * 1000.0 / s.server.windowMs : 0.0,
+           s.server.errors, s.server.p50Ms, s.server.p99Ms);
+  }
+  // Con el broker simulado no se pierde nada: si falta algo, es un error del simulador
+  bool lost = o.brokerHost.empty() && s.unmatched > 0;
+  return everOnline != o.devices || lost;
+}
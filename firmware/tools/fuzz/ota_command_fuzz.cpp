@@ -0,0 +1,126 @@
+// Objetivo de fuzzing de parseOtaCommand() (EspOta/OtaCommand.h): el payload de TOPIC_UPDATE
+// llega de la red y se interpreta en el lugar, así que cualquier secuencia de bytes tiene que
+// terminar en un resultado sin leer fuera del buffer y con las vistas dentro del payload.
+//
+// Con libFuzzer (clang):
+//   clang++ -g -O1 -std=c++17 -fsanitize=fuzzer,address,undefined -DESP32OTA_LIBFUZZER
+//       -I../../EspOta ota_command_fuzz.cpp -o ota_command_fuzz
+//   ./ota_command_fuzz corpus/ota_command
+// o con CMake: cmake -DESP32OTA_FUZZ=ON -DCMAKE_CXX_COMPILER=clang++ ...
+//
+// Sin libFuzzer se compila con un main() que vuelve a correr el corpus (archivos o carpetas
+// en la línea de comandos): cada entrada completa y todos sus prefijos, cada uno copiado a
+// un buffer del tamaño justo para que ASan/valgrind vean cualquier lectura de más. Es la
+// prueba ota_command_corpus de ctest. Los casos que encuentre el fuzzer y valga la pena
+// conservar se agregan a corpus/ota_command.
+
+#include "OtaCommand.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* DEVICE_MAC = "24:0A:C4:01:02:FF";
+
+#define FUZZ_CHECK(cond)                                                              \
+  do {                                                                                \
+    if (!(cond)) {                                                                    \
+      fprintf(stderr, "ota_command_fuzz: falla %s (línea %d)\n", #cond, __LINE__); \
+      abort();                                                                        \
+    }                                                                                 \
+  } while (0)
+
+// La vista está vacía o cae entera dentro del payload
+static bool inside(const CmdView& v, const uint8_t* data, size_t size) {
+  if (v.len == 0) return true;
+  const char* begin = (const char*)data;
+  return v.data >= begin && v.len <= size && v.data - begin <= (ptrdiff_t)(size - v.len);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  OtaCommand cmd;
+  OtaParseResult result = parseOtaCommand(data, size, DEVICE_MAC, cmd);
+  FUZZ_CHECK(result == OTA_PARSE_OK || result == OTA_PARSE_OTHER_TARGET || result == OTA_PARSE_INVALID);
+  if (result != OTA_PARSE_OK) return 0;
+
+  FUZZ_CHECK(inside(cmd.target, data, size));
+  FUZZ_CHECK(cmd.target.equals(DEVICE_MAC) || cmd.target.equals("all"));
+  FUZZ_CHECK(inside(cmd.url, data, size) && cmd.url.startsWith("http"));
+  FUZZ_CHECK(cmd.url.find('|') == cmd.url.len);
+  FUZZ_CHECK(inside(cmd.baseVersion, data, size));
+  FUZZ_CHECK(inside(cmd.version, data, size));
+  FUZZ_CHECK(cmd.percent <= 100);
+  FUZZ_CHECK(cmd.signatureLen <= OTA_SIGNATURE_MAX);
+  if (cmd.kind == OTA_CMD_MANIFEST) FUZZ_CHECK(cmd.version.len > 0 && cmd.imageSize > 0);
+  if (cmd.kind != OTA_CMD_DELTA) FUZZ_CHECK(cmd.baseVersion.len == 0);
+  return 0;
+}
+
+#ifndef ESP32OTA_LIBFUZZER
+
+#include <dirent.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+static bool readFile(const std::string& path, std::vector<uint8_t>& out) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  uint8_t buf[4096];
+  size_t n;
+  out.clear();
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+// La entrada y cada prefijo, en un buffer propio del largo exacto
+static void replay(const std::vector<uint8_t>& input) {
+  for (size_t len = 0; len <= input.size(); len++) {
+    uint8_t* copy = (uint8_t*)malloc(len ? len : 1);
+    memcpy(copy, input.data(), len);
+    LLVMFuzzerTestOneInput(len ? copy : nullptr, len);
+    free(copy);
+  }
+}
+
+static int replayPath(const std::string& path, size_t& files) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    fprintf(stderr, "No se encontró %s\n", path.c_str());
+    return 1;
+  }
+  if (S_ISDIR(st.st_mode)) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return 1;
+    int errors = 0;
+    while (struct dirent* e = readdir(dir)) {
+      if (e->d_name[0] == '.') continue;
+      errors += replayPath(path + "/" + e->d_name, files);
+    }
+    closedir(dir);
+    return errors;
+  }
+  std::vector<uint8_t> input;
+  if (!readFile(path, input)) {
+    fprintf(stderr, "No se pudo leer %s\n", path.c_str());
+    return 1;
+  }
+  replay(input);
+  files++;
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Uso: %s <archivo|carpeta>...\n", argv[0]);
+    return 2;
+  }
+  size_t files = 0;
+  int errors = 0;
+  for (int i = 1; i < argc; i++) errors += replayPath(argv[i], files);
+  printf("ota_command_fuzz: %zu entradas del corpus\n", files);
+  return errors || files == 0 ? 1 : 0;
+}
+
+#endif
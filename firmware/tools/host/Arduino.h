@@ -0,0 +1,169 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Arduino mínimo para compilar EspOta en Linux (ver HostSim.h). Solo lo que usa la
+// biblioteca: String sobre std::string, Serial, tiempo, Stream/Client y ESP.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <math.h>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <string>
+
+using std::isnan;
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define PROGMEM
+#define F(x) x
+#define IRAM_ATTR
+
+class String {
+public:
+  String() {}
+  String(const char* c) : _s(c ? c : "") {}
+  String(const std::string& s) : _s(s) {}
+  explicit String(char c) : _s(1, c) {}
+  String(int v) : _s(std::to_string(v)) {}
+  String(unsigned int v) : _s(std::to_string(v)) {}
+  String(long v) : _s(std::to_string(v)) {}
+  String(unsigned long v) : _s(std::to_string(v)) {}
+  String(float v, unsigned int decimals = 2) { setFloat(v, decimals); }
+  String(double v, unsigned int decimals = 2) { setFloat(v, decimals); }
+
+  const char* c_str() const { return _s.c_str(); }
+  unsigned int length() const { return (unsigned int)_s.size(); }
+  bool isEmpty() const { return _s.empty(); }
+  bool reserve(unsigned int n) { _s.reserve(n); return true; }
+  bool concat(const char* c, unsigned int n) { _s.append(c, n); return true; }
+  bool concat(const String& o) { _s += o._s; return true; }
+
+  int indexOf(char c, unsigned int from = 0) const { return pos(_s.find(c, from)); }
+  int indexOf(const char* c, unsigned int from = 0) const { return pos(_s.find(c, from)); }
+  int lastIndexOf(char c) const { return pos(_s.rfind(c)); }
+  String substring(unsigned int from) const { return from > _s.size() ? String() : String(_s.substr(from)); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    return from > _s.size() ? String() : String(_s.substr(from, to - from));
+  }
+  bool startsWith(const char* p) const { return _s.compare(0, strlen(p), p) == 0; }
+  bool startsWith(const String& p) const { return _s.compare(0, p._s.size(), p._s) == 0; }
+  bool endsWith(const char* p) const {
+    size_t n = strlen(p);
+    return n <= _s.size() && _s.compare(_s.size() - n, n, p) == 0;
+  }
+  bool equals(const String& o) const { return _s == o._s; }
+  long toInt() const { return atol(_s.c_str()); }
+  float toFloat() const { return (float)atof(_s.c_str()); }
+  void trim();
+  void toUpperCase();
+  void toLowerCase();
+
+  char operator[](unsigned int i) const { return i < _s.size() ? _s[i] : '\0'; }
+  char charAt(unsigned int i) const { return (*this)[i]; }
+  bool operator==(const String& o) const { return _s == o._s; }
+  bool operator==(const char* o) const { return _s == (o ? o : ""); }
+  bool operator!=(const String& o) const { return _s != o._s; }
+  bool operator!=(const char* o) const { return !(*this == o); }
+  String& operator+=(const String& o) { _s += o._s; return *this; }
+  String& operator+=(const char* o) { _s += (o ? o : ""); return *this; }
+  String& operator+=(char c) { _s += c; return *this; }
+  String& operator+=(int v) { _s += std::to_string(v); return *this; }
+  String& operator+=(unsigned int v) { _s += std::to_string(v); return *this; }
+  String& operator+=(long v) { _s += std::to_string(v); return *this; }
+  String& operator+=(unsigned long v) { _s += std::to_string(v); return *this; }
+
+  friend String operator+(const String& a, const String& b) { return String(a._s + b._s); }
+  friend String operator+(const String& a, const char* b) { return String(a._s + (b ? b : "")); }
+  friend String operator+(const char* a, const String& b) { return String((a ? a : "") + b._s); }
+  friend String operator+(const String& a, char c) { return String(a._s + c); }
+
+private:
+  static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+  void setFloat(double v, unsigned int decimals);
+  std::string _s;
+};
+
+// Serial escribe en stdout solo con host::setVerbose(true): los benchmarks corren en silencio
+class HardwareSerial {
+public:
+  void begin(unsigned long) {}
+  size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return print(String(v)); }
+  size_t print(unsigned int v) { return print(String(v)); }
+  size_t print(long v) { return print(String(v)); }
+  size_t print(unsigned long v) { return print(String(v)); }
+  size_t print(double v, int decimals = 2) { return print(String(v, decimals)); }
+  template <typename T> size_t println(const T& v) { return print(v) + println(); }
+  size_t println() { return print("\n"); }
+  int printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+  size_t write(const uint8_t* data, size_t len);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  int availableForWrite() { return 128; }
+  void flush() {}
+};
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+uint32_t esp_random();
+void configTime(long gmtOffsetSec, int daylightOffsetSec, const char* server1,
+                const char* server2 = nullptr, const char* server3 = nullptr);
+
+// ESP.restart() no reinicia: lo cuenta HostSim (host::restarts())
+class EspClass {
+public:
+  void restart();
+  uint32_t getFreeHeap() { return 200 * 1024; }
+  uint32_t getMinFreeHeap() { return 150 * 1024; }
+  uint32_t getMaxAllocHeap() { return 100 * 1024; }
+};
+extern EspClass ESP;
+
+class Stream {
+public:
+  virtual ~Stream() {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int read(uint8_t* buf, size_t size) {
+    size_t n = 0;
+    int c;
+    while (n < size && (c = read()) >= 0) buf[n++] = (uint8_t)c;
+    return (int)n;
+  }
+  size_t readBytes(uint8_t* buf, size_t size) { return (size_t)read(buf, size); }
+};
+
+class IPAddress;
+
+class Client : public Stream {
+public:
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char* host, uint16_t port) = 0;
+  virtual int connect(IPAddress ip, uint16_t port, int32_t timeout) = 0;
+  virtual int connect(const char* host, uint16_t port, int32_t timeout) = 0;
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t size) = 0;
+  virtual int peek() = 0;
+  virtual void flush() = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() = 0;
+  using Stream::read;
+};
+
+#endif
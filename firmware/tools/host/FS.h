@@ -0,0 +1,58 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include "Arduino.h"
+#include <memory>
+#include <string>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+// Archivo del LittleFS simulado: un archivo real dentro del directorio temporal de la placa.
+// Las copias comparten el mismo descriptor, como los File del core.
+class File {
+public:
+  File() {}
+  explicit File(FILE* fp);
+  size_t write(const uint8_t* buf, size_t size);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t read(uint8_t* buf, size_t size);
+  int read();
+  int available() { return _handle ? (int)(size() - position()) : 0; }
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  void flush();
+  void close() { _handle.reset(); }
+  operator bool() const { return (bool)_handle; }
+
+private:
+  struct Handle;
+  std::shared_ptr<Handle> _handle;
+};
+
+class FS {
+public:
+  File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+  File open(const String& path, const char* mode = FILE_READ, const bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char* path);
+  bool remove(const char* path);
+  bool rename(const char* from, const char* to);
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef HOST_HTTPCLIENT_H
+#define HOST_HTTPCLIENT_H
+
+#include "WiFiClient.h"
+#include <map>
+#include <vector>
+
+#define HTTP_CODE_OK                     200
+#define HTTP_CODE_PARTIAL_CONTENT        206
+#define HTTP_CODE_NOT_FOUND              404
+#define HTTP_CODE_RANGE_NOT_SATISFIABLE  416
+#define HTTPC_ERROR_CONNECTION_REFUSED   (-1)
+#define HTTPC_ERROR_CONNECTION_LOST      (-5)
+
+// Servidor HTTP local en memoria: GET sirve lo publicado con host::serve() (con Range,
+// If-Range, ETag y Content-Encoding); POST responde 200 y guarda el último cuerpo.
+class HTTPClient {
+public:
+  HTTPClient();
+  bool begin(String url);
+  bool begin(WiFiClient& client, String url);
+  void end();
+  void setReuse(bool) {}
+  void setTimeout(uint16_t) {}
+  void setConnectTimeout(int32_t) {}
+  void addHeader(const String& name, const String& value, bool first = false, bool replace = true);
+  void collectHeaders(const char* headerKeys[], const size_t headerKeysCount);
+  String header(const char* name);
+  bool hasHeader(const char* name);
+
+  int GET();
+  int POST(uint8_t* payload, size_t size);
+  int POST(const String& payload) { return POST((uint8_t*)payload.c_str(), payload.length()); }
+  int getSize() { return _size; }
+  WiFiClient* getStreamPtr() { return _client; }
+  WiFiClient& getStream() { return *_client; }
+  String getString();
+  bool connected() { return _client && _client->connected(); }
+
+  static String errorToString(int error);
+
+private:
+  String _url;
+  WiFiClient _own;
+  WiFiClient* _client;
+  std::map<std::string, std::string> _request;
+  std::map<std::string, std::string> _response;
+  int _size;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+// Control del entorno simulado con el que Esp32OTA compila y corre en Linux.
+//
+// Los encabezados de esta carpeta reemplazan a los del core de Arduino-ESP32 y de
+// ESP-IDF que usa la biblioteca (WiFi, HTTPClient, PubSubClient, Update, Preferences,
+// LittleFS, particiones OTA y FreeRTOS). No hay red: el WiFi conecta al instante, el
+// broker MQTT acepta todo (o es uno real, con setMqttBroker()) y el servidor HTTP sirve
+// desde memoria. LittleFS usa archivos reales en un directorio temporal del proceso. El
+// hash y la firma de la OTA usan el mbedtls del sistema (mbedcrypto), así que son los
+// mismos que en el dispositivo; la sesión TLS no cifra (mbedtls/ssl.h) y el inflador
+// tinfl de la ROM es zlib (rom/miniz.h).
+//
+// Se compila con el CMakeLists.txt de la raíz del repositorio (biblioteca esp32ota_host).
+//
+// Un proceso puede simular varias placas (tools/fleet_sim.cpp): cada host::Device tiene
+// su MAC, WiFi, flash, NVS, LittleFS y cliente MQTT; las redes, el servidor HTTP y el
+// broker son comunes. Sin createDevice() todo corre en un dispositivo por defecto.
+
+#include "Arduino.h"
+
+namespace host {
+
+// Muestra la salida de Serial (por defecto, silencio)
+void setVerbose(bool verbose);
+
+struct Device;
+Device* createDevice(const uint8_t mac[6]);
+// Placa sobre la que actúan las llamadas siguientes de este hilo (nullptr: la por defecto).
+// Las tareas de FreeRTOS heredan la de quien las crea.
+void selectDevice(Device* device);
+// Arranque tras ESP.restart(): corre la partición marcada para el arranque y el WiFi queda
+// apagado y sin manejadores de eventos. NVS, LittleFS y la flash se conservan.
+void reboot();
+
+// Ruta en el host de un archivo del LittleFS de esta placa (para revisarlo o dañarlo)
+std::string fsPath(const char* path);
+
+// Redes visibles para scanNetworks(); sin ninguna, begin() conecta a cualquier SSID
+void addAccessPoint(const char* ssid, int32_t rssi, int32_t channel);
+// Corta el WiFi (evento DISCONNECTED): sirve para probar reconexiones
+void dropWiFi();
+// IP fija puesta con WiFi.config() (0: DHCP). Se pierde con reboot().
+uint32_t wifiStaticIp();
+// Apaga una red: deja de aparecer en el escaneo y begin() ya no conecta a ella
+void removeAccessPoint(const char* ssid);
+
+// Imagen grabada en la partición en ejecución (su hash lo devuelve esp_partition_get_sha256)
+void setRunningImage(const uint8_t* image, size_t len);
+// Partición marcada para el próximo arranque (label), o "" si no se cambió
+const char* bootPartition();
+// Vuelve a arrancar desde la partición en ejecución, como si la OTA no hubiera ocurrido
+void resetBootPartition();
+// Llamadas a ESP.restart()
+uint32_t restarts();
+
+// Contenido servido por GET en url. encoding va en Content-Encoding (nullptr: ninguno).
+void serve(const char* url, const void* body, size_t len, const char* encoding = nullptr,
+           const char* etag = nullptr);
+// El próximo GET entrega solo bytes del cuerpo y después cierra la conexión
+void cutNextGet(size_t bytes);
+// Cabecera name (Range, If-Range...) del último GET recibido, o "" si no vino
+std::string lastGetHeader(const char* name);
+// Bytes que entrega cada available() del socket HTTP (tamaño del segmento TCP)
+void setSegmentSize(size_t bytes);
+// Último cuerpo recibido por POST
+const std::string& lastPost();
+
+// El último cliente MQTT conectado desde este dispositivo sigue conectado
+bool mqttConnected();
+// Mensaje MQTT entrante, entregado al callback como lo haría PubSubClient::loop()
+bool mqttDeliver(const char* topic, const void* payload, size_t len);
+// El broker corta la sesión del dispositivo sin DISCONNECT (publica el testamento)
+void dropMqtt();
+// Con refuse, el broker simulado rechaza las conexiones nuevas (CONNECT fallido)
+void refuseMqtt(bool refuse);
+struct MqttStats {
+  uint32_t publishes;
+  uint64_t bytes;
+  std::string lastTopic;
+  std::string lastPayload;
+};
+const MqttStats& mqttStats();
+void mqttReset();
+// Broker real (mosquitto) en lugar del simulado: los clientes que conecten después hablan
+// MQTT por TCP con él. Devuelve false si no se resuelve la dirección.
+bool setMqttBroker(const char* hostname, uint16_t port);
+// Se llama con cada publish() aceptado, justo antes de enviarlo (para medir latencias)
+void onMqttPublish(std::function<void(const char* topic, const uint8_t* payload, size_t len)> hook);
+
+}  // namespace host
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef HOST_LITTLEFS_H
+#define HOST_LITTLEFS_H
+
+#include "FS.h"
+
+namespace fs {
+// Cada placa tiene su directorio dentro de un directorio temporal del proceso (se borra al
+// salir): los archivos sobreviven a host::reboot() y se pueden mirar con host::fsPath().
+class LittleFSFS : public FS {
+public:
+  bool begin(bool /*formatOnFail*/ = false, const char* /*basePath*/ = "/littlefs",
+             uint8_t /*maxOpenFiles*/ = 10, const char* /*partitionLabel*/ = "spiffs") { return true; }
+  void end() {}
+  bool format();
+  size_t totalBytes() { return 1536 * 1024; }
+  size_t usedBytes();
+};
+}  // namespace fs
+
+extern fs::LittleFSFS LittleFS;
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include "Arduino.h"
+#include <string>
+
+// NVS simulado en memoria: sobrevive a ESP.restart() pero no al proceso
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false);
+  void end() { _ns.clear(); }
+  bool clear();
+  bool remove(const char* key);
+  bool isKey(const char* key);
+
+  size_t putUInt(const char* key, uint32_t value);
+  uint32_t getUInt(const char* key, uint32_t defaultValue = 0);
+  size_t putInt(const char* key, int32_t value);
+  int32_t getInt(const char* key, int32_t defaultValue = 0);
+  size_t putUChar(const char* key, uint8_t value);
+  uint8_t getUChar(const char* key, uint8_t defaultValue = 0);
+  size_t putString(const char* key, const char* value);
+  size_t putString(const char* key, const String& value) { return putString(key, value.c_str()); }
+  String getString(const char* key, const String& defaultValue = String());
+  size_t putBytes(const char* key, const void* value, size_t len);
+  size_t getBytes(const char* key, void* buf, size_t maxLen);
+  size_t getBytesLength(const char* key);
+
+private:
+  bool writable() const { return !_ns.empty() && !_readOnly; }
+  std::string _ns;
+  bool _readOnly = false;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef HOST_PUBSUBCLIENT_H
+#define HOST_PUBSUBCLIENT_H
+
+#include "Arduino.h"
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define MQTT_CONNECTION_TIMEOUT (-4)
+#define MQTT_CONNECTION_LOST (-3)
+#define MQTT_CONNECT_FAILED (-2)
+#define MQTT_DISCONNECTED (-1)
+#define MQTT_CONNECTED 0
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+namespace host { struct Device; }
+
+// Sin host::setMqttBroker(), el broker es el simulado: connect() siempre acepta y cada
+// publish() llega a los clientes suscritos en su próximo loop(); host::mqttDeliver()
+// entrega directo al callback. Con setMqttBroker(), habla MQTT 3.1.1 por TCP (QoS 0,
+// como la biblioteca) con un broker real. En los dos casos, cortar el WiFi del dispositivo
+// corta la conexión y el broker publica el testamento.
+class PubSubClient {
+public:
+  PubSubClient();
+  PubSubClient(Client& client);
+  ~PubSubClient();
+  PubSubClient& setServer(const char*, uint16_t) { return *this; }
+  PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+  PubSubClient& setClient(Client&) { return *this; }
+  PubSubClient& setKeepAlive(uint16_t seconds) { _keepAlive = seconds; return *this; }
+  PubSubClient& setSocketTimeout(uint16_t seconds) { _socketTimeout = seconds; return *this; }
+  bool setBufferSize(uint16_t size);
+  uint16_t getBufferSize() { return _bufferSize; }
+
+  bool connect(const char* id, const char* user, const char* pass, const char* willTopic,
+               uint8_t willQos, bool willRetain, const char* willMessage, bool cleanSession = true);
+  void disconnect();
+  bool publish(const char* topic, const char* payload, bool retained = false);
+  bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained = false);
+  bool subscribe(const char* topic, uint8_t qos = 0);
+  bool unsubscribe(const char* topic);
+  bool loop();
+  bool connected();
+  int state() { return _state; }
+
+  // Entrega un mensaje como si llegara del broker (lo usa host::mqttDeliver)
+  bool deliver(const char* topic, const uint8_t* payload, unsigned int length);
+  // Conexión perdida sin DISCONNECT: el broker publica el testamento (host::dropMqtt)
+  void drop(int state);
+
+private:
+  // Broker simulado
+  void route(const char* topic, const uint8_t* payload, unsigned int length);
+  void leaveBroker();
+  // Broker TCP
+  bool connectTcp(const char* id, const char* user, const char* pass, const char* willTopic,
+                  uint8_t willQos, bool willRetain, const char* willMessage, bool cleanSession);
+  bool sendPacket(const std::string& packet);
+  bool readPackets();
+
+  std::function<void(char*, uint8_t*, unsigned int)> _callback;
+  uint16_t _bufferSize;
+  uint8_t* _buffer;
+  bool _connected;
+  int _state;
+  uint16_t _keepAlive;
+  uint16_t _socketTimeout;
+  host::Device* _device;
+
+  std::vector<std::string> _subscriptions;
+  std::deque<std::pair<std::string, std::string>> _inbox;
+  std::string _willTopic;
+  std::string _willMessage;
+
+  int _fd;
+  std::string _rx;
+  unsigned long _lastOut;
+  uint16_t _nextPacketId;
+};
+
+#endif
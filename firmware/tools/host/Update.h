@@ -0,0 +1,35 @@
+#ifndef HOST_UPDATE_H
+#define HOST_UPDATE_H
+
+#include "Arduino.h"
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+#define U_FLASH 0
+
+// Update del core sobre la flash simulada: escribe en la próxima partición OTA y
+// end() la marca para el arranque (falla si la imagen no empieza con 0xE9)
+class UpdateClass {
+public:
+  bool begin(size_t size = UPDATE_SIZE_UNKNOWN, int command = U_FLASH, int ledPin = -1,
+             uint8_t ledOn = 0, const char* label = nullptr);
+  size_t write(uint8_t* data, size_t len);
+  size_t writeStream(Stream& data);
+  bool end(bool evenIfRemaining = false);
+  void abort();
+  bool hasError() { return _error != nullptr; }
+  const char* errorString() { return _error ? _error : "No Error"; }
+  bool isRunning() { return _partition != nullptr; }
+  size_t progress() { return _progress; }
+  size_t size() { return _size; }
+  size_t remaining() { return _size - _progress; }
+  void printError(HardwareSerial& out) { out.println(errorString()); }
+
+private:
+  const struct esp_partition_t* _partition = nullptr;
+  size_t _size = 0;
+  size_t _progress = 0;
+  const char* _error = nullptr;
+};
+extern UpdateClass Update;
+
+#endif
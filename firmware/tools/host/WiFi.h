@@ -0,0 +1,112 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include <memory>
+
+// WiFi simulado: las redes "al alcance" las declara host::addAccessPoint() y begin()
+// conecta al instante (con los eventos CONNECTED y GOT_IP, como el driver real).
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED  (-2)
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_READY = 0,
+  ARDUINO_EVENT_WIFI_SCAN_DONE,
+  ARDUINO_EVENT_WIFI_STA_START,
+  ARDUINO_EVENT_WIFI_STA_STOP,
+  ARDUINO_EVENT_WIFI_STA_CONNECTED,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP,
+  ARDUINO_EVENT_WIFI_STA_LOST_IP,
+  ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef struct { uint8_t reason; } wifi_event_sta_disconnected_t;
+typedef union { wifi_event_sta_disconnected_t wifi_sta_disconnected; } arduino_event_info_t;
+typedef int wifi_event_id_t;
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+typedef std::function<void(arduino_event_id_t event, arduino_event_info_t info)> WiFiEventFuncCb;
+
+class WiFiClass {
+public:
+  String macAddress();
+  uint8_t* macAddress(uint8_t* mac);
+  wl_status_t begin(const char* ssid, const char* passphrase = nullptr, int32_t channel = 0,
+                    const uint8_t* bssid = nullptr, bool connect = true);
+  wl_status_t status();
+  bool disconnect(bool wifioff = false, bool eraseap = false);
+  bool config(IPAddress local, IPAddress gateway, IPAddress subnet,
+              IPAddress dns1 = IPAddress(), IPAddress dns2 = IPAddress());
+  IPAddress localIP();
+  IPAddress gatewayIP();
+  IPAddress subnetMask();
+  IPAddress dnsIP(uint8_t n = 0);
+
+  // El escaneo termina en la misma llamada: el asíncrono queda listo para scanComplete()
+  int16_t scanNetworks(bool async = false, bool showHidden = false, bool passive = false,
+                       uint32_t maxMsPerChan = 300, uint8_t channel = 0);
+  int16_t scanComplete();
+  void scanDelete();
+  String SSID(uint8_t i);
+  String SSID();
+  int32_t RSSI(uint8_t i);
+  int32_t RSSI();
+  uint8_t* BSSID(uint8_t i);
+  uint8_t* BSSID();
+  int32_t channel(uint8_t i);
+  int32_t channel();
+
+  bool mode(wifi_mode_t) { return true; }
+  bool setAutoReconnect(bool) { return true; }
+  bool persistent(bool) { return true; }
+  wifi_event_id_t onEvent(WiFiEventFuncCb cb, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+  void removeEvent(wifi_event_id_t id);
+};
+extern WiFiClass WiFi;
+
+// Socket simulado. Como respuesta HTTP entrega el cuerpo en segmentos de
+// host::setSegmentSize() bytes, uno por cada available(), como llegan los paquetes TCP.
+class WiFiClient : public Client {
+public:
+  WiFiClient();
+  int connect(IPAddress ip, uint16_t port) override { return connect(ip, port, 0); }
+  int connect(const char* host, uint16_t port) override { return connect(host, port, 0); }
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) override;
+  int connect(const char* host, uint16_t port, int32_t timeout) override;
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+  void setTimeout(uint32_t) {}
+
+  // Usado por HTTPClient: el cuerpo a servir desde offset. Al llegar a end (si es menor que
+  // el cuerpo) la conexión se cierra, como un corte a mitad de la descarga.
+  void attach(std::shared_ptr<const std::string> body, size_t offset, size_t end = SIZE_MAX);
+
+private:
+  std::shared_ptr<const std::string> _body;
+  size_t _pos;
+  size_t _end;
+  size_t _segmentLeft;
+  bool _connected;
+};
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef HOST_WIFICLIENT_H
+#define HOST_WIFICLIENT_H
+
+#include "WiFi.h"
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef HOST_WIFICLIENTSECURE_H
+#define HOST_WIFICLIENTSECURE_H
+
+#include "WiFi.h"
+
+// Sin TLS en el host: se comporta como el WiFiClient del que hereda
+class WiFiClientSecure : public WiFiClient {
+public:
+  void setInsecure() {}
+  void setCACert(const char*) {}
+  void setHandshakeTimeout(unsigned long) {}
+};
+
+#endif
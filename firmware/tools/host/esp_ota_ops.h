@@ -0,0 +1,12 @@
+#ifndef HOST_ESP_OTA_OPS_H
+#define HOST_ESP_OTA_OPS_H
+
+#include "esp_partition.h"
+
+const esp_partition_t* esp_ota_get_running_partition(void);
+const esp_partition_t* esp_ota_get_boot_partition(void);
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* startFrom);
+// Rechaza (ESP_ERR_OTA_VALIDATE_FAILED) una partición que no empieza con la cabecera 0xE9
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition);
+
+#endif
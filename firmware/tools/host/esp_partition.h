@@ -0,0 +1,42 @@
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Flash simulada: dos particiones de aplicación (ota_0/ota_1) en memoria, borradas a 0xFF
+
+typedef int esp_err_t;
+#define ESP_OK                     0
+#define ESP_FAIL                   (-1)
+#define ESP_ERR_NO_MEM             0x101
+#define ESP_ERR_INVALID_ARG        0x102
+#define ESP_ERR_INVALID_SIZE       0x104
+#define ESP_ERR_NOT_FOUND          0x105
+#define ESP_ERR_NOT_SUPPORTED      0x106
+#define ESP_ERR_OTA_VALIDATE_FAILED 0x1503
+
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef enum {
+  ESP_PARTITION_SUBTYPE_APP_OTA_0 = 0x10,
+  ESP_PARTITION_SUBTYPE_APP_OTA_1 = 0x11
+} esp_partition_subtype_t;
+
+typedef struct esp_partition_t {
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+  bool encrypted;
+} esp_partition_t;
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t srcOffset, void* dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dstOffset, const void* src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size);
+// El SHA-256 agregado por esptool al final de la imagen, si lo tiene (ver host::setRunningImage)
+esp_err_t esp_partition_get_sha256(const esp_partition_t* partition, uint8_t* sha256);
+
+const char* esp_err_to_name(esp_err_t code);
+
+#endif
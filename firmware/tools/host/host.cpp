@@ -0,0 +1,1747 @@
+// Implementación del entorno simulado de HostSim.h. Todo vive en memoria (menos LittleFS,
+// en un directorio temporal) y cada
+// componente tiene su propio mutex: la tarea de escritura de la OTA y la de red
+// corren en otros hilos, como en el ESP32. Lo que en el ESP32 es propio de cada placa
+// (MAC, WiFi, flash, NVS, LittleFS) está en host::Device; el resto es común.
+
+#include "HostSim.h"
+#include "WiFi.h"
+#include "HTTPClient.h"
+#include "PubSubClient.h"
+#include "Update.h"
+#include "Preferences.h"
+#include "LittleFS.h"
+#include "esp_ota_ops.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "rom/miniz.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Dispositivos simulados
+// ---------------------------------------------------------------------------
+struct AccessPoint {
+  std::string ssid;
+  int32_t rssi;
+  int32_t channel;
+  uint8_t bssid[6];
+};
+
+struct host::Device {
+  explicit Device(const uint8_t* macAddress) { memcpy(mac, macAddress, sizeof(mac)); }
+
+  uint8_t mac[6];
+  uint32_t restarts = 0;
+
+  // Cada partición guarda hasta el último byte tocado: lo demás está borrado (0xFF)
+  std::vector<uint8_t> flash[2];
+  size_t imageLen[2] = { 0, 0 };
+  int running = 0;
+  int boot = 0;
+
+  wl_status_t wifiStatus = WL_DISCONNECTED;
+  uint32_t staticIp = 0;  // WiFi.config(); 0: DHCP
+  AccessPoint wifiCurrent;
+  int16_t scanResult = WIFI_SCAN_FAILED;
+  std::vector<std::pair<wifi_event_id_t, WiFiEventFuncCb>> wifiHandlers;
+  wifi_event_id_t wifiNextHandler = 1;
+
+  std::map<std::string, std::map<std::string, std::string>> nvs;
+  std::string fsDir;  // directorio de su LittleFS (se crea al primer uso)
+  PubSubClient* mqttClient = nullptr;  // el último conectado: destino de host::mqttDeliver()
+};
+
+static const uint8_t g_defaultMac[6] = { 0x24, 0x6F, 0x28, 0xA1, 0xB2, 0xC3 };
+static host::Device g_defaultDevice(g_defaultMac);
+static std::mutex g_devicesLock;
+static std::vector<std::unique_ptr<host::Device>> g_devices;
+// Dispositivo del hilo actual; las tareas lo heredan de quien las crea
+static thread_local host::Device* t_device = &g_defaultDevice;
+
+static host::Device& dev() {
+  return *t_device;
+}
+
+// ---------------------------------------------------------------------------
+// Arduino: String, Serial, tiempo y ESP
+// ---------------------------------------------------------------------------
+void String::trim() {
+  size_t start = _s.find_first_not_of(" \t\r\n");
+  if (start == std::string::npos) {
+    _s.clear();
+    return;
+  }
+  _s = _s.substr(start, _s.find_last_not_of(" \t\r\n") - start + 1);
+}
+
+void String::toUpperCase() {
+  for (char& c : _s) c = (char)toupper((unsigned char)c);
+}
+
+void String::toLowerCase() {
+  for (char& c : _s) c = (char)tolower((unsigned char)c);
+}
+
+void String::setFloat(double v, unsigned int decimals) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+  _s = buf;
+}
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static std::atomic<bool> g_verbose(false);
+static const auto g_start = std::chrono::steady_clock::now();
+
+size_t HardwareSerial::write(const uint8_t* data, size_t len) {
+  if (g_verbose) fwrite(data, 1, len, stdout);
+  return len;
+}
+
+// Se formatea siempre, como en el dispositivo: el costo del log entra en las mediciones
+int HardwareSerial::printf(const char* fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  if (n > 0) write((const uint8_t*)buf, min((size_t)n, sizeof(buf) - 1));
+  return n;
+}
+
+unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - g_start).count();
+}
+
+unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - g_start).count();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+uint32_t esp_random() {
+  static std::mutex lock;
+  static std::mt19937 rng(0xE5B32u);
+  std::lock_guard<std::mutex> guard(lock);
+  return rng();
+}
+
+void configTime(long, int, const char*, const char*, const char*) {}
+
+void EspClass::restart() {
+  dev().restarts++;
+}
+
+// ---------------------------------------------------------------------------
+// Flash y particiones OTA
+// ---------------------------------------------------------------------------
+#define HOST_APP_PARTITION_SIZE 0x180000
+#define HOST_FLASH_SECTOR_SIZE  4096
+
+static esp_partition_t g_partitions[2] = {
+  { ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x010000, HOST_APP_PARTITION_SIZE, "app0", false },
+  { ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x190000, HOST_APP_PARTITION_SIZE, "app1", false },
+};
+static int partitionIndex(const esp_partition_t* p) {
+  if (p == &g_partitions[0]) return 0;
+  if (p == &g_partitions[1]) return 1;
+  return -1;
+}
+
+// Los primeros end bytes de la partición; al ampliarla, lo nuevo queda borrado
+static uint8_t* flashUpTo(int index, size_t end) {
+  std::vector<uint8_t>& flash = dev().flash[index];
+  if (flash.size() < end) flash.resize(end, 0xFF);
+  return flash.data();
+}
+
+static uint8_t flashByte(int index, size_t offset) {
+  const std::vector<uint8_t>& flash = dev().flash[index];
+  return offset < flash.size() ? flash[offset] : 0xFF;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t* partition, size_t srcOffset, void* dst, size_t size) {
+  int i = partitionIndex(partition);
+  if (i < 0 || !dst) return ESP_ERR_INVALID_ARG;
+  if (srcOffset > partition->size || size > partition->size - srcOffset) return ESP_ERR_INVALID_SIZE;
+  const std::vector<uint8_t>& flash = dev().flash[i];
+  size_t stored = srcOffset < flash.size() ? min(size, flash.size() - srcOffset) : 0;
+  if (stored > 0) memcpy(dst, flash.data() + srcOffset, stored);
+  memset((uint8_t*)dst + stored, 0xFF, size - stored);
+  return ESP_OK;
+}
+
+// Como la NOR flash, escribir solo baja bits: sin borrar antes, el dato queda mezclado
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t dstOffset, const void* src, size_t size) {
+  int i = partitionIndex(partition);
+  if (i < 0 || !src) return ESP_ERR_INVALID_ARG;
+  if (dstOffset > partition->size || size > partition->size - dstOffset) return ESP_ERR_INVALID_SIZE;
+  uint8_t* out = flashUpTo(i, dstOffset + size) + dstOffset;
+  const uint8_t* in = (const uint8_t*)src;
+  for (size_t n = 0; n < size; n++) out[n] &= in[n];
+  dev().imageLen[i] = max(dev().imageLen[i], dstOffset + size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size) {
+  int i = partitionIndex(partition);
+  if (i < 0) return ESP_ERR_INVALID_ARG;
+  if (offset % HOST_FLASH_SECTOR_SIZE != 0 || size % HOST_FLASH_SECTOR_SIZE != 0) return ESP_ERR_INVALID_ARG;
+  if (offset > partition->size || size > partition->size - offset) return ESP_ERR_INVALID_SIZE;
+  std::vector<uint8_t>& flash = dev().flash[i];
+  if (offset < flash.size()) memset(flash.data() + offset, 0xFF, min(size, flash.size() - offset));
+  if (offset == 0) dev().imageLen[i] = 0;
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_get_sha256(const esp_partition_t* partition, uint8_t* sha256) {
+  // El largo de la imagen es lo escrito en la partición; se usa el hash que agregó esptool
+  host::Device& d = dev();
+  int i = partitionIndex(partition);
+  if (i != d.running || d.imageLen[i] < 64) return ESP_ERR_NOT_SUPPORTED;
+  if (flashByte(i, 0) != 0xE9 || flashByte(i, 23) != 1) return ESP_ERR_NOT_SUPPORTED;
+  memcpy(sha256, d.flash[i].data() + d.imageLen[i] - 32, 32);
+  return ESP_OK;
+}
+
+const char* esp_err_to_name(esp_err_t code) {
+  switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_OTA_VALIDATE_FAILED: return "ESP_ERR_OTA_VALIDATE_FAILED";
+    default: return "UNKNOWN ERROR";
+  }
+}
+
+const esp_partition_t* esp_ota_get_running_partition(void) {
+  return &g_partitions[dev().running];
+}
+
+const esp_partition_t* esp_ota_get_boot_partition(void) {
+  return &g_partitions[dev().boot];
+}
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* startFrom) {
+  int from = startFrom ? partitionIndex(startFrom) : dev().running;
+  return from < 0 ? nullptr : &g_partitions[1 - from];
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* partition) {
+  int i = partitionIndex(partition);
+  if (i < 0) return ESP_ERR_INVALID_ARG;
+  if (flashByte(i, 0) != 0xE9) return ESP_ERR_OTA_VALIDATE_FAILED;
+  dev().boot = i;
+  return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Update (core de Arduino) sobre la flash simulada
+// ---------------------------------------------------------------------------
+UpdateClass Update;
+
+bool UpdateClass::begin(size_t size, int, int, uint8_t, const char*) {
+  _error = nullptr;
+  _progress = 0;
+  _partition = esp_ota_get_next_update_partition(nullptr);
+  if (size == 0 || size == UPDATE_SIZE_UNKNOWN || size > _partition->size) {
+    _error = "Not Enough Space";
+    _partition = nullptr;
+    return false;
+  }
+  _size = size;
+  return true;
+}
+
+size_t UpdateClass::write(uint8_t* data, size_t len) {
+  if (!_partition || _error) return 0;
+  if (len > _size - _progress) {
+    _error = "Not Enough Space";
+    return 0;
+  }
+  if (_progress == 0 && len > 0 && data[0] != 0xE9) {
+    _error = "Magic byte is wrong, not 0xE9";
+    abort();
+    return 0;
+  }
+  // Se borra cada sector al entrar en él, como el core
+  size_t erasedUpTo = (_progress + HOST_FLASH_SECTOR_SIZE - 1) / HOST_FLASH_SECTOR_SIZE * HOST_FLASH_SECTOR_SIZE;
+  size_t end = _progress + len;
+  if (end > erasedUpTo) {
+    size_t eraseEnd = (end + HOST_FLASH_SECTOR_SIZE - 1) / HOST_FLASH_SECTOR_SIZE * HOST_FLASH_SECTOR_SIZE;
+    if (esp_partition_erase_range(_partition, erasedUpTo, eraseEnd - erasedUpTo) != ESP_OK) {
+      _error = "Flash Erase Failed";
+      return 0;
+    }
+  }
+  if (esp_partition_write(_partition, _progress, data, len) != ESP_OK) {
+    _error = "Flash Write Failed";
+    return 0;
+  }
+  _progress = end;
+  return len;
+}
+
+size_t UpdateClass::writeStream(Stream& data) {
+  uint8_t buf[HOST_FLASH_SECTOR_SIZE];
+  size_t written = 0;
+  while (remaining() > 0) {
+    int n = data.read(buf, min(sizeof(buf), remaining()));
+    if (n <= 0 || write(buf, n) != (size_t)n) break;
+    written += n;
+  }
+  return written;
+}
+
+bool UpdateClass::end(bool evenIfRemaining) {
+  if (!_partition || _error) return false;
+  if (_progress != _size && !evenIfRemaining) {
+    _error = "Premature END";
+    abort();
+    return false;
+  }
+  esp_err_t err = esp_ota_set_boot_partition(_partition);
+  _partition = nullptr;
+  if (err != ESP_OK) {
+    _error = "Could Not Activate The Firmware";
+    return false;
+  }
+  return true;
+}
+
+void UpdateClass::abort() {
+  _partition = nullptr;
+}
+
+// ---------------------------------------------------------------------------
+// WiFi
+// ---------------------------------------------------------------------------
+WiFiClass WiFi;
+
+// Los puntos de acceso son comunes: todos los dispositivos ven las mismas redes
+static std::recursive_mutex g_wifiLock;
+static std::vector<AccessPoint> g_aps;
+
+static void wifiEvent(arduino_event_id_t event) {
+  std::vector<std::pair<wifi_event_id_t, WiFiEventFuncCb>> handlers;
+  {
+    std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+    handlers = dev().wifiHandlers;
+  }
+  arduino_event_info_t info;
+  memset(&info, 0, sizeof(info));
+  for (auto& h : handlers) h.second(event, info);
+}
+
+String WiFiClass::macAddress() {
+  const uint8_t* mac = dev().mac;
+  char buf[18];
+  snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X",
+           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  return String(buf);
+}
+
+uint8_t* WiFiClass::macAddress(uint8_t* mac) {
+  memcpy(mac, dev().mac, sizeof(dev().mac));
+  return mac;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char*, int32_t channel, const uint8_t*, bool) {
+  {
+    std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+    host::Device& d = dev();
+    const AccessPoint* ap = nullptr;
+    for (const AccessPoint& a : g_aps) {
+      if (a.ssid == ssid) ap = &a;
+    }
+    if (!ap && !g_aps.empty()) {
+      d.wifiStatus = WL_NO_SSID_AVAIL;
+      return d.wifiStatus;
+    }
+    if (ap) {
+      d.wifiCurrent = *ap;
+    } else {
+      d.wifiCurrent = AccessPoint{ ssid, -55, channel > 0 ? channel : 6, { 0x02, 0, 0, 0, 0, 1 } };
+    }
+    d.wifiStatus = WL_CONNECTED;
+  }
+  wifiEvent(ARDUINO_EVENT_WIFI_STA_CONNECTED);
+  wifiEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP);
+  return WL_CONNECTED;
+}
+
+wl_status_t WiFiClass::status() {
+  std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+  return dev().wifiStatus;
+}
+
+bool WiFiClass::disconnect(bool, bool) {
+  bool was;
+  {
+    std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+    was = dev().wifiStatus == WL_CONNECTED;
+    dev().wifiStatus = WL_DISCONNECTED;
+  }
+  if (was) wifiEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+  return true;
+}
+
+bool WiFiClass::config(IPAddress local, IPAddress, IPAddress, IPAddress, IPAddress) {
+  std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+  dev().staticIp = (uint32_t)local;
+  return true;
+}
+
+// Con DHCP la concesión es siempre 192.168.1.50
+IPAddress WiFiClass::localIP() {
+  if (status() != WL_CONNECTED) return IPAddress();
+  uint32_t ip = dev().staticIp;
+  return ip ? IPAddress(ip) : IPAddress(192, 168, 1, 50);
+}
+IPAddress WiFiClass::gatewayIP() { return IPAddress(192, 168, 1, 1); }
+IPAddress WiFiClass::subnetMask() { return IPAddress(255, 255, 255, 0); }
+IPAddress WiFiClass::dnsIP(uint8_t) { return IPAddress(192, 168, 1, 1); }
+
+int16_t WiFiClass::scanNetworks(bool async, bool, bool, uint32_t, uint8_t) {
+  std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+  dev().scanResult = (int16_t)g_aps.size();
+  return async ? WIFI_SCAN_RUNNING : dev().scanResult;
+}
+
+int16_t WiFiClass::scanComplete() {
+  std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+  return dev().scanResult;
+}
+
+void WiFiClass::scanDelete() {
+  std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+  dev().scanResult = WIFI_SCAN_FAILED;
+}
+
+static AccessPoint* scanEntry(uint8_t i) {
+  return (dev().scanResult >= 0 && i < g_aps.size()) ? &g_aps[i] : nullptr;
+}
+
+String WiFiClass::SSID(uint8_t i) { AccessPoint* ap = scanEntry(i); return ap ? String(ap->ssid) : String(); }
+int32_t WiFiClass::RSSI(uint8_t i) { AccessPoint* ap = scanEntry(i); return ap ? ap->rssi : 0; }
+uint8_t* WiFiClass::BSSID(uint8_t i) { AccessPoint* ap = scanEntry(i); return ap ? ap->bssid : nullptr; }
+int32_t WiFiClass::channel(uint8_t i) { AccessPoint* ap = scanEntry(i); return ap ? ap->channel : 0; }
+String WiFiClass::SSID() { return status() == WL_CONNECTED ? String(dev().wifiCurrent.ssid) : String(); }
+int32_t WiFiClass::RSSI() { return status() == WL_CONNECTED ? dev().wifiCurrent.rssi : 0; }
+uint8_t* WiFiClass::BSSID() { return status() == WL_CONNECTED ? dev().wifiCurrent.bssid : nullptr; }
+int32_t WiFiClass::channel() { return status() == WL_CONNECTED ? dev().wifiCurrent.channel : 0; }
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventFuncCb cb, arduino_event_id_t event) {
+  std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+  WiFiEventFuncCb filtered = cb;
+  if (event != ARDUINO_EVENT_MAX) {
+    filtered = [cb, event](arduino_event_id_t e, arduino_event_info_t info) {
+      if (e == event) cb(e, info);
+    };
+  }
+  host::Device& d = dev();
+  d.wifiHandlers.push_back(std::make_pair(d.wifiNextHandler, filtered));
+  return d.wifiNextHandler++;
+}
+
+void WiFiClass::removeEvent(wifi_event_id_t id) {
+  std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+  std::vector<std::pair<wifi_event_id_t, WiFiEventFuncCb>>& handlers = dev().wifiHandlers;
+  for (size_t i = 0; i < handlers.size(); i++) {
+    if (handlers[i].first == id) handlers.erase(handlers.begin() + i);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// WiFiClient: socket que entrega el cuerpo HTTP por segmentos
+// ---------------------------------------------------------------------------
+static std::atomic<size_t> g_segmentSize(1460);
+
+WiFiClient::WiFiClient() : _pos(0), _end(0), _segmentLeft(0), _connected(false) {}
+
+int WiFiClient::connect(IPAddress, uint16_t, int32_t) {
+  _connected = WiFi.status() == WL_CONNECTED;
+  return _connected;
+}
+
+int WiFiClient::connect(const char*, uint16_t, int32_t) {
+  _connected = WiFi.status() == WL_CONNECTED;
+  return _connected;
+}
+
+size_t WiFiClient::write(const uint8_t*, size_t size) {
+  return _connected ? size : 0;
+}
+
+int WiFiClient::available() {
+  if (!_body) return 0;
+  size_t left = _end - _pos;
+  if (_segmentLeft == 0) _segmentLeft = min(left, (size_t)g_segmentSize);
+  return (int)_segmentLeft;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+  if (available() == 0) return -1;
+  size_t n = min(size, _segmentLeft);
+  memcpy(buf, _body->data() + _pos, n);
+  _pos += n;
+  _segmentLeft -= n;
+  if (_pos == _end && _end < _body->size()) _connected = false;  // corte (host::cutNextGet)
+  return (int)n;
+}
+
+int WiFiClient::peek() {
+  return available() > 0 ? (uint8_t)(*_body)[_pos] : -1;
+}
+
+void WiFiClient::stop() {
+  _connected = false;
+  _body.reset();
+  _pos = 0;
+  _end = 0;
+  _segmentLeft = 0;
+}
+
+uint8_t WiFiClient::connected() {
+  return _connected && WiFi.status() == WL_CONNECTED;
+}
+
+void WiFiClient::attach(std::shared_ptr<const std::string> body, size_t offset, size_t end) {
+  _body = body;
+  _end = min(end, body ? body->size() : 0);
+  _pos = min(offset, _end);
+  _segmentLeft = 0;
+}
+
+// ---------------------------------------------------------------------------
+// HTTPClient contra el servidor en memoria
+// ---------------------------------------------------------------------------
+struct Served {
+  std::shared_ptr<const std::string> body;
+  std::string encoding;
+  std::string etag;
+};
+
+static std::mutex g_httpLock;
+static std::map<std::string, Served> g_served;
+static std::string g_lastPost;
+static std::map<std::string, std::string> g_lastGet;  // cabeceras del último GET
+static size_t g_cutNextGet = 0;                        // bytes del próximo GET (0: completo)
+
+HTTPClient::HTTPClient() : _client(nullptr), _size(-1) {}
+
+bool HTTPClient::begin(String url) {
+  return begin(_own, url);
+}
+
+bool HTTPClient::begin(WiFiClient& client, String url) {
+  _url = url;
+  _client = &client;
+  _request.clear();
+  _response.clear();
+  _size = -1;
+  return true;
+}
+
+void HTTPClient::end() {
+  // Como con setReuse(true), el socket de un cliente externo queda abierto
+  if (_client == &_own) _own.stop();
+  _request.clear();
+}
+
+void HTTPClient::addHeader(const String& name, const String& value, bool, bool) {
+  _request[name.c_str()] = value.c_str();
+}
+
+void HTTPClient::collectHeaders(const char*[], const size_t) {}
+
+String HTTPClient::header(const char* name) {
+  auto it = _response.find(name);
+  return it == _response.end() ? String() : String(it->second);
+}
+
+bool HTTPClient::hasHeader(const char* name) {
+  return _response.count(name) > 0;
+}
+
+int HTTPClient::GET() {
+  if (!_client || (!_client->connected() && !_client->connect(_url.c_str(), 80))) {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  Served served;
+  size_t cut;
+  {
+    std::lock_guard<std::mutex> guard(g_httpLock);
+    g_lastGet = _request;
+    cut = g_cutNextGet;
+    g_cutNextGet = 0;
+    auto it = g_served.find(_url.c_str());
+    if (it == g_served.end()) {
+      _size = 0;
+      return HTTP_CODE_NOT_FOUND;
+    }
+    served = it->second;
+  }
+  size_t total = served.body->size();
+  if (!served.encoding.empty()) _response["Content-Encoding"] = served.encoding;
+  if (!served.etag.empty()) _response["ETag"] = served.etag;
+
+  // Range: bytes=<inicio>- (con If-Range, solo si el ETag sigue siendo el mismo)
+  auto range = _request.find("Range");
+  auto ifRange = _request.find("If-Range");
+  bool rangeValid = range != _request.end() && range->second.compare(0, 6, "bytes=") == 0 &&
+                    (ifRange == _request.end() || ifRange->second == served.etag);
+  if (rangeValid) {
+    size_t start = strtoul(range->second.c_str() + 6, nullptr, 10);
+    if (start >= total) {
+      _size = 0;
+      return HTTP_CODE_RANGE_NOT_SATISFIABLE;
+    }
+    _response["Content-Range"] = "bytes " + std::to_string(start) + "-" + std::to_string(total - 1) +
+                                 "/" + std::to_string(total);
+    _size = (int)(total - start);
+    _client->attach(served.body, start, cut ? start + cut : SIZE_MAX);
+    return HTTP_CODE_PARTIAL_CONTENT;
+  }
+  _size = (int)total;
+  _client->attach(served.body, 0, cut ? cut : SIZE_MAX);
+  return HTTP_CODE_OK;
+}
+
+int HTTPClient::POST(uint8_t* payload, size_t size) {
+  if (!_client || (!_client->connected() && !_client->connect(_url.c_str(), 80))) {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  std::lock_guard<std::mutex> guard(g_httpLock);
+  g_lastPost.assign((const char*)payload, size);
+  _size = 0;
+  return HTTP_CODE_OK;
+}
+
+String HTTPClient::getString() {
+  String out;
+  uint8_t buf[512];
+  int n;
+  while (_client && (n = _client->read(buf, sizeof(buf))) > 0) out.concat((const char*)buf, n);
+  return out;
+}
+
+String HTTPClient::errorToString(int error) {
+  switch (error) {
+    case HTTPC_ERROR_CONNECTION_REFUSED: return "connection refused";
+    case HTTPC_ERROR_CONNECTION_LOST: return "connection lost";
+    default: return String();
+  }
+}
+
+// ---------------------------------------------------------------------------
+// PubSubClient contra el broker simulado o uno real por TCP
+// ---------------------------------------------------------------------------
+// Las suscripciones exactas van indexadas por tópico (las de los dispositivos); las que
+// tienen comodines se recorren en cada publicación. No se destruye nunca: un Esp32OTA
+// global de otro archivo puede desconectarse después que los estáticos de este.
+static bool isWildcard(const std::string& filter) {
+  return filter.find_first_of("+#") != std::string::npos;
+}
+
+struct MqttBroker {
+  std::mutex lock;
+  host::MqttStats stats;
+  std::function<void(const char*, const uint8_t*, size_t)> hook;
+  std::unordered_map<std::string, std::vector<PubSubClient*>> exact;
+  std::vector<std::pair<std::string, PubSubClient*>> wildcard;
+
+  void add(const std::string& filter, PubSubClient* client) {
+    if (isWildcard(filter)) wildcard.push_back(std::make_pair(filter, client));
+    else exact[filter].push_back(client);
+  }
+
+  void remove(const std::string& filter, PubSubClient* client) {
+    if (isWildcard(filter)) {
+      wildcard.erase(std::remove(wildcard.begin(), wildcard.end(), std::make_pair(filter, client)),
+                     wildcard.end());
+    } else {
+      std::vector<PubSubClient*>& clients = exact[filter];
+      clients.erase(std::remove(clients.begin(), clients.end(), client), clients.end());
+    }
+  }
+};
+
+static MqttBroker& broker() {
+  static MqttBroker* b = new MqttBroker();
+  return *b;
+}
+
+// Broker real (host::setMqttBroker); sin dirección se usa el simulado
+static sockaddr_storage g_brokerAddr;
+static socklen_t g_brokerAddrLen = 0;
+// host::refuseMqtt: el broker simulado rechaza los CONNECT
+static std::atomic<bool> g_mqttRefuse(false);
+
+static bool topicMatches(const std::string& filter, const char* topic) {
+  size_t f = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') return true;
+    if (filter[f] == '+') {
+      while (*topic && *topic != '/') topic++;
+      f++;
+      continue;
+    }
+    if (*topic != filter[f]) return false;
+    topic++;
+    f++;
+  }
+  return *topic == '\0';
+}
+
+// Paquetes MQTT 3.1.1: cabecera fija, largo restante (1 a 4 bytes) y cuerpo
+static void putString(std::string& out, const char* s, size_t len) {
+  out += (char)(len >> 8);
+  out += (char)(len & 0xFF);
+  out.append(s, len);
+}
+
+static void putString(std::string& out, const char* s) {
+  putString(out, s, strlen(s));
+}
+
+static std::string mqttPacket(uint8_t header, const std::string& body) {
+  std::string out(1, (char)header);
+  size_t len = body.size();
+  do {
+    uint8_t b = len % 128;
+    len /= 128;
+    out += (char)(len > 0 ? b | 0x80 : b);
+  } while (len > 0);
+  return out + body;
+}
+
+static bool waitSocket(int fd, short events, int timeoutMs) {
+  pollfd p = { fd, events, 0 };
+  return poll(&p, 1, timeoutMs) == 1 && (p.revents & (events | POLLERR | POLLHUP));
+}
+
+PubSubClient::PubSubClient()
+  : _bufferSize(0), _buffer(nullptr), _connected(false), _state(MQTT_DISCONNECTED),
+    _keepAlive(15), _socketTimeout(15), _device(nullptr), _fd(-1), _lastOut(0), _nextPacketId(1) {
+  setBufferSize(256);
+}
+
+PubSubClient::PubSubClient(Client&) : PubSubClient() {}
+
+// Destruirlo conectado es como apagar la placa: el broker ve caer la conexión
+PubSubClient::~PubSubClient() {
+  if (_connected) drop(MQTT_CONNECTION_LOST);
+  {
+    std::lock_guard<std::mutex> guard(broker().lock);
+    if (_device && _device->mqttClient == this) _device->mqttClient = nullptr;
+  }
+  free(_buffer);
+}
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+  _callback = callback;
+  return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+  if (size == 0) return false;
+  uint8_t* buffer = (uint8_t*)realloc(_buffer, size);
+  if (!buffer) return false;
+  _buffer = buffer;
+  _bufferSize = size;
+  return true;
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass, const char* willTopic,
+                           uint8_t willQos, bool willRetain, const char* willMessage, bool cleanSession) {
+  if (connected()) return true;
+  if (WiFi.status() != WL_CONNECTED) {
+    _state = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  _device = &dev();
+  if (g_brokerAddrLen == 0 && g_mqttRefuse) {
+    _state = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  if (g_brokerAddrLen > 0 &&
+      !connectTcp(id, user, pass, willTopic, willQos, willRetain, willMessage, cleanSession)) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(broker().lock);
+  _willTopic = willTopic ? willTopic : "";
+  _willMessage = willMessage ? willMessage : "";
+  _device->mqttClient = this;
+  _connected = true;
+  _state = MQTT_CONNECTED;
+  return true;
+}
+
+bool PubSubClient::connectTcp(const char* id, const char* user, const char* pass, const char* willTopic,
+                              uint8_t willQos, bool willRetain, const char* willMessage, bool cleanSession) {
+  int timeoutMs = _socketTimeout * 1000;
+  _state = MQTT_CONNECT_FAILED;
+  _fd = socket(g_brokerAddr.ss_family, SOCK_STREAM, 0);
+  if (_fd < 0) return false;
+  int one = 1;
+  setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  fcntl(_fd, F_SETFL, fcntl(_fd, F_GETFL, 0) | O_NONBLOCK);
+  _rx.clear();
+
+  int err = 0;
+  socklen_t errLen = sizeof(err);
+  bool ok = ::connect(_fd, (const sockaddr*)&g_brokerAddr, g_brokerAddrLen) == 0 ||
+            (errno == EINPROGRESS && waitSocket(_fd, POLLOUT, timeoutMs) &&
+             getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &errLen) == 0 && err == 0);
+  if (ok) {
+    std::string body;
+    putString(body, "MQTT");
+    body += (char)4;  // MQTT 3.1.1
+    uint8_t flags = cleanSession ? 0x02 : 0;
+    if (willTopic) flags |= 0x04 | (uint8_t)((willQos & 0x03) << 3) | (willRetain ? 0x20 : 0);
+    if (user) flags |= 0x80;
+    if (pass) flags |= 0x40;
+    body += (char)flags;
+    body += (char)(_keepAlive >> 8);
+    body += (char)(_keepAlive & 0xFF);
+    putString(body, id);
+    if (willTopic) {
+      putString(body, willTopic);
+      putString(body, willMessage ? willMessage : "");
+    }
+    if (user) putString(body, user);
+    if (pass) putString(body, pass);
+    ok = sendPacket(mqttPacket(0x10, body));
+  }
+  // CONNACK: 0x20 0x02 <flags> <código>
+  while (ok && _rx.size() < 4) {
+    char buf[64];
+    ssize_t n = waitSocket(_fd, POLLIN, timeoutMs) ? recv(_fd, buf, sizeof(buf), 0) : -1;
+    if (n <= 0) {
+      _state = MQTT_CONNECTION_TIMEOUT;
+      ok = false;
+    } else {
+      _rx.append(buf, n);
+    }
+  }
+  if (ok && ((uint8_t)_rx[0] != 0x20 || _rx[3] != 0)) {
+    _state = _rx[3];  // rechazo del broker (1 a 5, como MQTT_CONNECT_BAD_PROTOCOL...)
+    ok = false;
+  }
+  if (!ok) {
+    close(_fd);
+    _fd = -1;
+    return false;
+  }
+  _rx.erase(0, 4);
+  return true;
+}
+
+bool PubSubClient::sendPacket(const std::string& packet) {
+  size_t sent = 0;
+  while (_fd >= 0 && sent < packet.size()) {
+    ssize_t n = send(_fd, packet.data() + sent, packet.size() - sent, MSG_NOSIGNAL);
+    if (n > 0) {
+      sent += n;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+               waitSocket(_fd, POLLOUT, _socketTimeout * 1000)) {
+      continue;
+    } else {
+      if (_connected) drop(MQTT_CONNECTION_LOST);
+      return false;
+    }
+  }
+  _lastOut = millis();
+  return _fd >= 0;
+}
+
+bool PubSubClient::readPackets() {
+  char buf[4096];
+  for (;;) {
+    ssize_t n = recv(_fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n > 0) {
+      _rx.append(buf, n);
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) break;
+    drop(MQTT_CONNECTION_LOST);
+    return false;
+  }
+
+  size_t pos = 0;
+  while (pos < _rx.size()) {
+    size_t len = 0;
+    size_t head = pos + 1;
+    int shift = 0;
+    bool complete = false;
+    while (head < _rx.size() && shift <= 21) {
+      uint8_t b = (uint8_t)_rx[head++];
+      len |= (size_t)(b & 0x7F) << shift;
+      shift += 7;
+      if (!(b & 0x80)) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete || _rx.size() - head < len) break;
+
+    uint8_t header = (uint8_t)_rx[pos];
+    const uint8_t* body = (const uint8_t*)_rx.data() + head;
+    pos = head + len;
+    if ((header >> 4) != 3 || len < 2) continue;  // SUBACK, PINGRESP...: nada que hacer
+
+    // PUBLISH: tópico, id de paquete si QoS > 0 y payload
+    uint8_t qos = (header >> 1) & 0x03;
+    size_t topicLen = ((size_t)body[0] << 8) | body[1];
+    size_t offset = 2 + topicLen + (qos > 0 ? 2 : 0);
+    if (offset > len) continue;
+    std::string topic((const char*)body + 2, topicLen);
+    if (qos > 0) {
+      std::string ack;
+      ack += (char)body[2 + topicLen];
+      ack += (char)body[3 + topicLen];
+      if (!sendPacket(mqttPacket(qos == 1 ? 0x40 : 0x50, ack))) return false;
+    }
+    // Si el callback desconecta, _rx ya no es válido
+    std::string payload((const char*)body + offset, len - offset);
+    deliver(topic.c_str(), (const uint8_t*)payload.data(), (unsigned int)payload.size());
+    if (!_connected) return false;
+  }
+  _rx.erase(0, pos);
+  return true;
+}
+
+void PubSubClient::drop(int state) {
+  if (_fd >= 0) {
+    close(_fd);
+    _fd = -1;
+  } else {
+    leaveBroker();
+    if (!_willTopic.empty()) {
+      route(_willTopic.c_str(), (const uint8_t*)_willMessage.data(), (unsigned int)_willMessage.size());
+    }
+  }
+  _rx.clear();
+  _connected = false;
+  _state = state;
+}
+
+void PubSubClient::disconnect() {
+  if (_fd >= 0) {
+    sendPacket(mqttPacket(0xE0, std::string()));
+    close(_fd);
+    _fd = -1;
+  } else {
+    leaveBroker();
+  }
+  _rx.clear();
+  _connected = false;
+  _state = MQTT_DISCONNECTED;
+}
+
+// Sin WiFi no hay TCP: la conexión se da por perdida, como cuando vence el keepalive
+bool PubSubClient::connected() {
+  if (!_connected) return false;
+  bool wifi;
+  {
+    std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+    wifi = _device->wifiStatus == WL_CONNECTED;
+  }
+  if (!wifi) drop(MQTT_CONNECTION_LOST);
+  return wifi;
+}
+
+bool PubSubClient::loop() {
+  if (!connected()) return false;
+  if (_fd >= 0) {
+    if (!readPackets()) return false;
+    if (millis() - _lastOut >= _keepAlive * 1000UL) sendPacket(mqttPacket(0xC0, std::string()));
+    return _connected;
+  }
+  std::deque<std::pair<std::string, std::string>> inbox;
+  {
+    std::lock_guard<std::mutex> guard(broker().lock);
+    inbox.swap(_inbox);
+  }
+  for (auto& msg : inbox) {
+    if (!_connected) break;
+    deliver(msg.first.c_str(), (const uint8_t*)msg.second.data(), (unsigned int)msg.second.size());
+  }
+  return _connected;
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+  return publish(topic, (const uint8_t*)payload, payload ? strlen(payload) : 0, retained);
+}
+
+bool PubSubClient::publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+  // Cabecera fija (hasta 5 bytes) + largo del tópico (2) + tópico + payload, como la biblioteca
+  if (!connected() || 7 + strlen(topic) + length > _bufferSize) return false;
+  MqttBroker& b = broker();
+  if (b.hook) b.hook(topic, payload, length);
+  {
+    std::lock_guard<std::mutex> guard(b.lock);
+    b.stats.publishes++;
+    b.stats.bytes += length;
+    b.stats.lastTopic = topic;
+    b.stats.lastPayload.assign((const char*)payload, length);
+  }
+  if (_fd < 0) {
+    route(topic, payload, length);
+    return true;
+  }
+  std::string body;
+  putString(body, topic);
+  body.append((const char*)payload, length);
+  return sendPacket(mqttPacket(retained ? 0x31 : 0x30, body));
+}
+
+bool PubSubClient::subscribe(const char* topic, uint8_t qos) {
+  if (!connected()) return false;
+  if (_fd >= 0) {
+    std::string body;
+    body += (char)(_nextPacketId >> 8);
+    body += (char)(_nextPacketId & 0xFF);
+    _nextPacketId = _nextPacketId == 0xFFFF ? 1 : _nextPacketId + 1;
+    putString(body, topic);
+    body += (char)qos;
+    return sendPacket(mqttPacket(0x82, body));
+  }
+  std::lock_guard<std::mutex> guard(broker().lock);
+  if (std::find(_subscriptions.begin(), _subscriptions.end(), topic) != _subscriptions.end()) return true;
+  _subscriptions.push_back(topic);
+  broker().add(topic, this);
+  return true;
+}
+
+bool PubSubClient::unsubscribe(const char* topic) {
+  if (!connected()) return false;
+  if (_fd >= 0) {
+    std::string body;
+    body += (char)(_nextPacketId >> 8);
+    body += (char)(_nextPacketId & 0xFF);
+    _nextPacketId = _nextPacketId == 0xFFFF ? 1 : _nextPacketId + 1;
+    putString(body, topic);
+    return sendPacket(mqttPacket(0xA2, body));
+  }
+  std::lock_guard<std::mutex> guard(broker().lock);
+  auto it = std::find(_subscriptions.begin(), _subscriptions.end(), topic);
+  if (it == _subscriptions.end()) return true;
+  _subscriptions.erase(it);
+  broker().remove(topic, this);
+  return true;
+}
+
+// Reparte la publicación a los suscritos (una copia por cliente); la reciben en su loop()
+void PubSubClient::route(const char* topic, const uint8_t* payload, unsigned int length) {
+  MqttBroker& b = broker();
+  std::lock_guard<std::mutex> guard(b.lock);
+  std::vector<PubSubClient*> targets;
+  auto exact = b.exact.find(topic);
+  if (exact != b.exact.end()) targets = exact->second;
+  for (auto& sub : b.wildcard) {
+    if (topicMatches(sub.first, topic) &&
+        std::find(targets.begin(), targets.end(), sub.second) == targets.end()) {
+      targets.push_back(sub.second);
+    }
+  }
+  for (PubSubClient* client : targets) {
+    client->_inbox.emplace_back(topic, std::string((const char*)payload, length));
+  }
+}
+
+// Sesión limpia: al salir del broker se pierden las suscripciones y lo no entregado
+void PubSubClient::leaveBroker() {
+  std::lock_guard<std::mutex> guard(broker().lock);
+  for (const std::string& topic : _subscriptions) broker().remove(topic, this);
+  _subscriptions.clear();
+  _inbox.clear();
+}
+
+// Como PubSubClient::loop(): tópico terminado en '\0' y payload dentro del mismo buffer
+bool PubSubClient::deliver(const char* topic, const uint8_t* payload, unsigned int length) {
+  size_t topicLen = strlen(topic);
+  if (!_connected || !_callback || topicLen + 1 + length > _bufferSize) return false;
+  memcpy(_buffer, topic, topicLen);
+  _buffer[topicLen] = '\0';
+  memcpy(_buffer + topicLen + 1, payload, length);
+  _callback((char*)_buffer, _buffer + topicLen + 1, length);
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Preferences (NVS) y LittleFS en memoria
+// ---------------------------------------------------------------------------
+static std::mutex g_nvsLock;
+
+bool Preferences::begin(const char* name, bool readOnly) {
+  std::lock_guard<std::mutex> guard(g_nvsLock);
+  // Como NVS, un espacio de nombres que no existe no se puede abrir en solo lectura
+  if (readOnly && dev().nvs.find(name) == dev().nvs.end()) return false;
+  dev().nvs[name];
+  _ns = name;
+  _readOnly = readOnly;
+  return true;
+}
+
+bool Preferences::clear() {
+  if (!writable()) return false;
+  std::lock_guard<std::mutex> guard(g_nvsLock);
+  dev().nvs[_ns].clear();
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  if (!writable()) return false;
+  std::lock_guard<std::mutex> guard(g_nvsLock);
+  return dev().nvs[_ns].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+  if (_ns.empty()) return false;
+  std::lock_guard<std::mutex> guard(g_nvsLock);
+  return dev().nvs[_ns].count(key) > 0;
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+  if (!writable() || !key) return 0;
+  std::lock_guard<std::mutex> guard(g_nvsLock);
+  dev().nvs[_ns][key].assign((const char*)value, len);
+  return len;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  if (_ns.empty()) return 0;
+  std::lock_guard<std::mutex> guard(g_nvsLock);
+  auto& ns = dev().nvs[_ns];
+  auto it = ns.find(key);
+  return it == ns.end() ? 0 : it->second.size();
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+  if (_ns.empty()) return 0;
+  std::lock_guard<std::mutex> guard(g_nvsLock);
+  auto& ns = dev().nvs[_ns];
+  auto it = ns.find(key);
+  if (it == ns.end() || it->second.size() > maxLen) return 0;
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+template <typename T>
+static T getScalar(Preferences& prefs, const char* key, T defaultValue) {
+  T value;
+  return prefs.getBytesLength(key) == sizeof(T) && prefs.getBytes(key, &value, sizeof(T)) == sizeof(T)
+             ? value : defaultValue;
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) { return putBytes(key, &value, sizeof(value)); }
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) { return getScalar(*this, key, defaultValue); }
+size_t Preferences::putInt(const char* key, int32_t value) { return putBytes(key, &value, sizeof(value)); }
+int32_t Preferences::getInt(const char* key, int32_t defaultValue) { return getScalar(*this, key, defaultValue); }
+size_t Preferences::putUChar(const char* key, uint8_t value) { return putBytes(key, &value, sizeof(value)); }
+uint8_t Preferences::getUChar(const char* key, uint8_t defaultValue) { return getScalar(*this, key, defaultValue); }
+
+size_t Preferences::putString(const char* key, const char* value) {
+  return putBytes(key, value, strlen(value)) == strlen(value) ? strlen(value) : 0;
+}
+
+String Preferences::getString(const char* key, const String& defaultValue) {
+  if (_ns.empty()) return defaultValue;
+  std::lock_guard<std::mutex> guard(g_nvsLock);
+  auto& ns = dev().nvs[_ns];
+  auto it = ns.find(key);
+  return it == ns.end() ? defaultValue : String(it->second);
+}
+
+fs::LittleFSFS LittleFS;
+
+static std::mutex g_fsLock;
+
+// Directorio temporal común (uno por proceso); cada placa usa un subdirectorio con su MAC
+static const std::filesystem::path& fsRoot() {
+  static std::filesystem::path* root = [] {
+    std::string tmpl = (std::filesystem::temp_directory_path() / "esp32ota-fs-XXXXXX").string();
+    if (!mkdtemp(&tmpl[0])) abort();
+    std::filesystem::path* p = new std::filesystem::path(tmpl);
+    atexit([] {
+      std::error_code ec;
+      std::filesystem::remove_all(fsRoot(), ec);
+    });
+    return p;
+  }();
+  return *root;
+}
+
+static std::filesystem::path fsDeviceDir() {
+  host::Device& d = dev();
+  if (d.fsDir.empty()) {
+    char name[13];
+    snprintf(name, sizeof(name), "%02x%02x%02x%02x%02x%02x",
+             d.mac[0], d.mac[1], d.mac[2], d.mac[3], d.mac[4], d.mac[5]);
+    d.fsDir = (fsRoot() / name).string();
+    std::filesystem::create_directories(d.fsDir);
+  }
+  return d.fsDir;
+}
+
+static std::filesystem::path fsHostPath(const char* path) {
+  while (*path == '/') path++;
+  return fsDeviceDir() / path;
+}
+
+namespace fs {
+
+// fopen exige un fseek entre una lectura y una escritura: se lleva la última operación
+struct File::Handle {
+  explicit Handle(FILE* f) : fp(f), writing(false) {}
+  ~Handle() { fclose(fp); }
+  void mode(bool write) {
+    if (write != writing) fseek(fp, 0, SEEK_CUR);
+    writing = write;
+  }
+  FILE* fp;
+  bool writing;
+};
+
+File::File(FILE* fp) : _handle(fp ? std::make_shared<Handle>(fp) : nullptr) {}
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  if (!_handle) return 0;
+  _handle->mode(true);
+  return fwrite(buf, 1, size, _handle->fp);
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+  if (!_handle) return 0;
+  _handle->mode(false);
+  return fread(buf, 1, size, _handle->fp);
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!_handle) return false;
+  int whence = mode == SeekCur ? SEEK_CUR : mode == SeekEnd ? SEEK_END : SEEK_SET;
+  return fseek(_handle->fp, (long)pos, whence) == 0;
+}
+
+size_t File::position() const {
+  return _handle ? (size_t)ftell(_handle->fp) : 0;
+}
+
+size_t File::size() const {
+  if (!_handle) return 0;
+  fflush(_handle->fp);
+  struct stat st;
+  return fstat(fileno(_handle->fp), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+void File::flush() {
+  if (_handle) fflush(_handle->fp);
+}
+
+// Los modos del core ("r", "w", "a" y sus variantes con "+") son los de fopen
+File FS::open(const char* path, const char* mode, const bool) {
+  std::lock_guard<std::mutex> guard(g_fsLock);
+  std::filesystem::path p = fsHostPath(path);
+  if (mode[0] != 'r') {
+    std::error_code ec;
+    std::filesystem::create_directories(p.parent_path(), ec);
+  }
+  std::string m = std::string(mode[0] == 'r' || mode[0] == 'w' || mode[0] == 'a' ? mode : "r") + "b";
+  return File(fopen(p.c_str(), m.c_str()));
+}
+
+bool FS::exists(const char* path) {
+  std::lock_guard<std::mutex> guard(g_fsLock);
+  std::error_code ec;
+  return std::filesystem::exists(fsHostPath(path), ec);
+}
+
+bool FS::remove(const char* path) {
+  std::lock_guard<std::mutex> guard(g_fsLock);
+  std::error_code ec;
+  return std::filesystem::remove(fsHostPath(path), ec);
+}
+
+bool FS::rename(const char* from, const char* to) {
+  std::lock_guard<std::mutex> guard(g_fsLock);
+  std::error_code ec;
+  std::filesystem::rename(fsHostPath(from), fsHostPath(to), ec);
+  return !ec;
+}
+
+bool LittleFSFS::format() {
+  std::lock_guard<std::mutex> guard(g_fsLock);
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(fsDeviceDir(), ec)) {
+    std::filesystem::remove_all(entry.path(), ec);
+  }
+  return !ec;
+}
+
+size_t LittleFSFS::usedBytes() {
+  std::lock_guard<std::mutex> guard(g_fsLock);
+  size_t used = 0;
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::recursive_directory_iterator(fsDeviceDir(), ec)) {
+    if (entry.is_regular_file(ec)) used += entry.file_size(ec);
+  }
+  return used;
+}
+
+}  // namespace fs
+
+// ---------------------------------------------------------------------------
+// FreeRTOS sobre hilos
+// ---------------------------------------------------------------------------
+struct HostTask {
+  std::mutex lock;
+  std::condition_variable cv;
+  uint32_t notify = 0;
+};
+
+struct HostQueue {
+  std::mutex lock;
+  std::condition_variable notEmpty;
+  std::condition_variable notFull;
+  std::vector<uint8_t> items;
+  size_t itemSize;
+  size_t capacity;
+  size_t head = 0;
+  size_t count = 0;
+};
+
+static HostTask g_mainTask;
+static thread_local HostTask* t_currentTask = &g_mainTask;
+
+// Espera en cv hasta que ready() se cumpla o pasen ticks ms (portMAX_DELAY: sin límite)
+template <typename Pred>
+static bool waitTicks(std::condition_variable& cv, std::unique_lock<std::mutex>& lock,
+                      TickType_t ticks, Pred ready) {
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char*, uint32_t, void* params,
+                                   UBaseType_t, TaskHandle_t* created, BaseType_t) {
+  HostTask* task = new HostTask();
+  if (created) *created = task;
+  host::Device* device = t_device;
+  std::thread([code, params, task, device]() {
+    t_currentTask = task;
+    t_device = device;
+    code(params);
+    // La tarea terminó (vTaskDelete(nullptr)): su handle deja de ser válido, como en FreeRTOS
+    delete task;
+  }).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char* name, uint32_t stackDepth, void* params,
+                       UBaseType_t priority, TaskHandle_t* created) {
+  return xTaskCreatePinnedToCore(code, name, stackDepth, params, priority, created, tskNO_AFFINITY);
+}
+
+// En el host un hilo no se puede matar desde afuera: vTaskDelete(nullptr) marca el final
+// y la función de la tarea retorna justo después (así están escritas las de la biblioteca)
+void vTaskDelete(TaskHandle_t) {}
+
+void vTaskDelay(TickType_t ticks) {
+  delay(ticks);
+}
+
+TickType_t xTaskGetTickCount(void) {
+  return (TickType_t)millis();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  return t_currentTask;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> guard(task->lock);
+  task->notify++;
+  task->cv.notify_one();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait) {
+  HostTask* task = t_currentTask;
+  std::unique_lock<std::mutex> lock(task->lock);
+  waitTicks(task->cv, lock, ticksToWait, [task] { return task->notify > 0; });
+  uint32_t value = task->notify;
+  if (value > 0) task->notify = clearOnExit ? 0 : value - 1;
+  return value;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  if (length == 0) return nullptr;
+  HostQueue* q = new HostQueue();
+  q->itemSize = itemSize;
+  q->capacity = length;
+  q->items.resize((size_t)length * itemSize);
+  return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(q->lock);
+  if (!waitTicks(q->notFull, lock, ticksToWait, [q] { return q->count < q->capacity; })) return pdFALSE;
+  size_t slot = (q->head + q->count) % q->capacity;
+  if (q->itemSize) memcpy(&q->items[slot * q->itemSize], item, q->itemSize);
+  q->count++;
+  q->notEmpty.notify_one();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticksToWait) {
+  std::unique_lock<std::mutex> lock(q->lock);
+  if (!waitTicks(q->notEmpty, lock, ticksToWait, [q] { return q->count > 0; })) return pdFALSE;
+  if (q->itemSize) memcpy(item, &q->items[q->head * q->itemSize], q->itemSize);
+  q->head = (q->head + 1) % q->capacity;
+  q->count--;
+  q->notFull.notify_one();
+  return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+  std::lock_guard<std::mutex> guard(q->lock);
+  return (UBaseType_t)q->count;
+}
+
+void vQueueDelete(QueueHandle_t q) {
+  delete q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+  return xQueueCreate(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticksToWait) {
+  return xQueueReceive(sem, nullptr, ticksToWait);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  return xQueueSend(sem, nullptr, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+  vQueueDelete(sem);
+}
+
+// ---------------------------------------------------------------------------
+// tinfl de la ROM sobre zlib (ver rom/miniz.h)
+// ---------------------------------------------------------------------------
+// zlib pide su memoria al arena del propio descompresor: nada queda fuera del free()
+static voidpf tinflAlloc(voidpf opaque, uInt items, uInt size) {
+  tinfl_decompressor* r = (tinfl_decompressor*)opaque;
+  size_t bytes = ((size_t)items * size + 15) & ~(size_t)15;
+  if (bytes > sizeof(r->arena) - r->arenaUsed) return Z_NULL;
+  void* p = r->arena + r->arenaUsed;
+  r->arenaUsed += bytes;
+  return p;
+}
+
+static void tinflFree(voidpf, voidpf) {}
+
+tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* pIn_buf_next, size_t* pIn_buf_size,
+                              uint8_t* pOut_buf_start, uint8_t* pOut_buf_next, size_t* pOut_buf_size,
+                              const uint32_t decomp_flags) {
+  // Solo deflate crudo, que es lo que usa OtaInflate (el CRC de gzip lo calcula él)
+  if (decomp_flags & (TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_COMPUTE_ADLER32)) return TINFL_STATUS_BAD_PARAM;
+  if (r->state == 0) {
+    // La ventana es el buffer circular completo (potencia de 2), hasta los 32 KB de deflate
+    int bits = 15;
+    if (!(decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)) {
+      size_t size = (size_t)(pOut_buf_next - pOut_buf_start) + *pOut_buf_size;
+      if (size < 256 || (size & (size - 1)) != 0) return TINFL_STATUS_BAD_PARAM;
+      for (bits = 8; bits < 15 && ((size_t)1 << bits) < size; bits++) {}
+    }
+    memset(&r->zs, 0, sizeof(r->zs));
+    r->arenaUsed = 0;
+    r->zs.zalloc = tinflAlloc;
+    r->zs.zfree = tinflFree;
+    r->zs.opaque = r;
+    r->state = inflateInit2(&r->zs, -bits) == Z_OK ? 1 : -1;
+  }
+  if (r->state != 1) {
+    *pIn_buf_size = 0;
+    *pOut_buf_size = 0;
+    return r->state == 2 ? TINFL_STATUS_DONE : TINFL_STATUS_FAILED;
+  }
+
+  r->zs.next_in = (Bytef*)pIn_buf_next;
+  r->zs.avail_in = (uInt)*pIn_buf_size;
+  r->zs.next_out = pOut_buf_next;
+  r->zs.avail_out = (uInt)*pOut_buf_size;
+  int ret = inflate(&r->zs, Z_NO_FLUSH);
+  *pIn_buf_size -= r->zs.avail_in;
+  *pOut_buf_size -= r->zs.avail_out;
+  if (ret == Z_STREAM_END) {
+    r->state = 2;
+    return TINFL_STATUS_DONE;
+  }
+  if (ret != Z_OK && ret != Z_BUF_ERROR) {
+    r->state = -1;
+    return TINFL_STATUS_FAILED;
+  }
+  if (r->zs.avail_out == 0) return TINFL_STATUS_HAS_MORE_OUTPUT;
+  return (decomp_flags & TINFL_FLAG_HAS_MORE_INPUT) ? TINFL_STATUS_NEEDS_MORE_INPUT
+                                                    : TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS;
+}
+
+// ---------------------------------------------------------------------------
+// mbedtls: sesión TLS sin cifrado (ver mbedtls/ssl.h)
+// ---------------------------------------------------------------------------
+void mbedtls_ssl_init(mbedtls_ssl_context*) {}
+void mbedtls_ssl_free(mbedtls_ssl_context*) {}
+void mbedtls_ssl_config_init(mbedtls_ssl_config*) {}
+void mbedtls_ssl_config_free(mbedtls_ssl_config*) {}
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config*, int, int, int) { return 0; }
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config*, int) {}
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config*, int (*)(void*, unsigned char*, size_t), void*) {}
+void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config*, int) {}
+void mbedtls_ssl_conf_max_version(mbedtls_ssl_config*, int, int) {}
+void mbedtls_ssl_conf_max_tls_version(mbedtls_ssl_config*, int) {}
+int mbedtls_ssl_setup(mbedtls_ssl_context*, const mbedtls_ssl_config*) { return 0; }
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context*, const char*) { return 0; }
+void mbedtls_ssl_set_bio(mbedtls_ssl_context*, void*, mbedtls_ssl_send_t*, mbedtls_ssl_recv_t*,
+                         mbedtls_ssl_recv_timeout_t*) {}
+int mbedtls_ssl_set_session(mbedtls_ssl_context*, const mbedtls_ssl_session*) { return 0; }
+int mbedtls_ssl_get_session(const mbedtls_ssl_context*, mbedtls_ssl_session*) { return 0; }
+void mbedtls_ssl_session_init(mbedtls_ssl_session* session) { memset(session, 0, sizeof(*session)); }
+void mbedtls_ssl_session_free(mbedtls_ssl_session*) {}
+
+int mbedtls_ssl_session_save(const mbedtls_ssl_session*, unsigned char*, size_t, size_t* olen) {
+  *olen = 0;
+  return 0;
+}
+
+int mbedtls_ssl_session_load(mbedtls_ssl_session*, const unsigned char*, size_t) { return 0; }
+int mbedtls_ssl_handshake(mbedtls_ssl_context*) { return 0; }
+int mbedtls_ssl_read(mbedtls_ssl_context*, unsigned char*, size_t) { return MBEDTLS_ERR_SSL_WANT_READ; }
+int mbedtls_ssl_write(mbedtls_ssl_context*, const unsigned char*, size_t len) { return (int)len; }
+size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context*) { return 0; }
+int mbedtls_ssl_close_notify(mbedtls_ssl_context*) { return 0; }
+
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context*) {}
+void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context*) {}
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context*, int (*)(void*, unsigned char*, size_t), void*,
+                          const unsigned char*, size_t) { return 0; }
+
+int mbedtls_ctr_drbg_random(void*, unsigned char* output, size_t len) {
+  for (size_t i = 0; i < len; i++) output[i] = (unsigned char)esp_random();
+  return 0;
+}
+
+void mbedtls_entropy_init(mbedtls_entropy_context*) {}
+void mbedtls_entropy_free(mbedtls_entropy_context*) {}
+
+int mbedtls_entropy_func(void*, unsigned char* output, size_t len) {
+  for (size_t i = 0; i < len; i++) output[i] = (unsigned char)esp_random();
+  return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Control del entorno (HostSim.h)
+// ---------------------------------------------------------------------------
+namespace host {
+
+void setVerbose(bool verbose) {
+  g_verbose = verbose;
+}
+
+Device* createDevice(const uint8_t mac[6]) {
+  std::lock_guard<std::mutex> guard(g_devicesLock);
+  g_devices.emplace_back(new Device(mac));
+  return g_devices.back().get();
+}
+
+void selectDevice(Device* device) {
+  t_device = device ? device : &g_defaultDevice;
+}
+
+void reboot() {
+  Device& d = dev();
+  std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+  d.running = d.boot;
+  d.wifiStatus = WL_DISCONNECTED;
+  d.staticIp = 0;
+  d.wifiHandlers.clear();
+  d.scanResult = WIFI_SCAN_FAILED;
+}
+
+std::string fsPath(const char* path) {
+  std::lock_guard<std::mutex> guard(g_fsLock);
+  return fsHostPath(path).string();
+}
+
+void addAccessPoint(const char* ssid, int32_t rssi, int32_t channel) {
+  std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+  AccessPoint ap{ ssid, rssi, channel, { 0x02, 0, 0, 0, 0, (uint8_t)(g_aps.size() + 1) } };
+  g_aps.push_back(ap);
+}
+
+void dropWiFi() {
+  WiFi.disconnect();
+}
+
+uint32_t wifiStaticIp() {
+  std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+  return dev().staticIp;
+}
+
+void removeAccessPoint(const char* ssid) {
+  std::lock_guard<std::recursive_mutex> guard(g_wifiLock);
+  for (auto it = g_aps.begin(); it != g_aps.end();) {
+    it = it->ssid == ssid ? g_aps.erase(it) : it + 1;
+  }
+}
+
+void setRunningImage(const uint8_t* image, size_t len) {
+  Device& d = dev();
+  len = min(len, (size_t)HOST_APP_PARTITION_SIZE);
+  d.flash[d.running].assign(image, image + len);
+  d.imageLen[d.running] = len;
+}
+
+const char* bootPartition() {
+  return dev().boot == dev().running ? "" : g_partitions[dev().boot].label;
+}
+
+void resetBootPartition() {
+  dev().boot = dev().running;
+}
+
+uint32_t restarts() {
+  return dev().restarts;
+}
+
+void serve(const char* url, const void* body, size_t len, const char* encoding, const char* etag) {
+  Served served;
+  served.body = std::make_shared<const std::string>((const char*)body, len);
+  served.encoding = encoding ? encoding : "";
+  served.etag = etag ? etag : "";
+  std::lock_guard<std::mutex> guard(g_httpLock);
+  g_served[url] = served;
+}
+
+void cutNextGet(size_t bytes) {
+  std::lock_guard<std::mutex> guard(g_httpLock);
+  g_cutNextGet = bytes;
+}
+
+std::string lastGetHeader(const char* name) {
+  std::lock_guard<std::mutex> guard(g_httpLock);
+  auto it = g_lastGet.find(name);
+  return it == g_lastGet.end() ? std::string() : it->second;
+}
+
+void setSegmentSize(size_t bytes) {
+  g_segmentSize = max(bytes, (size_t)1);
+}
+
+const std::string& lastPost() {
+  return g_lastPost;
+}
+
+static PubSubClient* deviceClient() {
+  std::lock_guard<std::mutex> guard(broker().lock);
+  return dev().mqttClient;
+}
+
+bool mqttDeliver(const char* topic, const void* payload, size_t len) {
+  PubSubClient* client = deviceClient();
+  return client && client->deliver(topic, (const uint8_t*)payload, (unsigned int)len);
+}
+
+void dropMqtt() {
+  PubSubClient* client = deviceClient();
+  if (client && client->connected()) client->drop(MQTT_CONNECTION_LOST);
+}
+
+void refuseMqtt(bool refuse) {
+  g_mqttRefuse = refuse;
+}
+
+bool mqttConnected() {
+  PubSubClient* client = deviceClient();
+  return client && client->connected();
+}
+
+const MqttStats& mqttStats() {
+  return broker().stats;
+}
+
+void mqttReset() {
+  std::lock_guard<std::mutex> guard(broker().lock);
+  broker().stats = MqttStats();
+}
+
+bool setMqttBroker(const char* hostname, uint16_t port) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* found = nullptr;
+  std::string service = std::to_string(port);
+  if (getaddrinfo(hostname, service.c_str(), &hints, &found) != 0 || !found) return false;
+  memcpy(&g_brokerAddr, found->ai_addr, found->ai_addrlen);
+  g_brokerAddrLen = found->ai_addrlen;
+  freeaddrinfo(found);
+  return true;
+}
+
+void onMqttPublish(std::function<void(const char*, const uint8_t*, size_t)> hook) {
+  broker().hook = hook;
+}
+
+}  // namespace host
@@ -0,0 +1,18 @@
+#ifndef HOST_COMPAT_MBEDTLS_MD_H
+#define HOST_COMPAT_MBEDTLS_MD_H
+
+// mbedtls 2.28 (ver version.h)
+typedef enum {
+  MBEDTLS_MD_NONE = 0,
+  MBEDTLS_MD_MD2,
+  MBEDTLS_MD_MD4,
+  MBEDTLS_MD_MD5,
+  MBEDTLS_MD_SHA1,
+  MBEDTLS_MD_SHA224,
+  MBEDTLS_MD_SHA256,
+  MBEDTLS_MD_SHA384,
+  MBEDTLS_MD_SHA512,
+  MBEDTLS_MD_RIPEMD160
+} mbedtls_md_type_t;
+
+#endif
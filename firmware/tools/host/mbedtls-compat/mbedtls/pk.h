@@ -0,0 +1,33 @@
+#ifndef HOST_COMPAT_MBEDTLS_PK_H
+#define HOST_COMPAT_MBEDTLS_PK_H
+
+// mbedtls 2.28 (ver version.h): el contexto tiene el mismo tamaño que el de la biblioteca
+#include <stddef.h>
+#include "mbedtls/md.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mbedtls_pk_info_t mbedtls_pk_info_t;
+typedef struct {
+  const mbedtls_pk_info_t* pk_info;
+  void* pk_ctx;
+} mbedtls_pk_context;
+
+void mbedtls_pk_init(mbedtls_pk_context* ctx);
+void mbedtls_pk_free(mbedtls_pk_context* ctx);
+int mbedtls_pk_parse_public_key(mbedtls_pk_context* ctx, const unsigned char* key, size_t keylen);
+int mbedtls_pk_parse_key(mbedtls_pk_context* ctx, const unsigned char* key, size_t keylen,
+                         const unsigned char* pwd, size_t pwdlen);
+int mbedtls_pk_sign(mbedtls_pk_context* ctx, mbedtls_md_type_t mdAlg, const unsigned char* hash,
+                    size_t hashLen, unsigned char* sig, size_t* sigLen,
+                    int (*fRng)(void*, unsigned char*, size_t), void* pRng);
+int mbedtls_pk_verify(mbedtls_pk_context* ctx, mbedtls_md_type_t mdAlg, const unsigned char* hash,
+                      size_t hashLen, const unsigned char* sig, size_t sigLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
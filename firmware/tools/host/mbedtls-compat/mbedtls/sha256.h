@@ -0,0 +1,30 @@
+#ifndef HOST_COMPAT_MBEDTLS_SHA256_H
+#define HOST_COMPAT_MBEDTLS_SHA256_H
+
+// mbedtls 2.28 (ver version.h): el contexto tiene el mismo tamaño que el de la biblioteca
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  uint32_t total[2];
+  uint32_t state[8];
+  unsigned char buffer[64];
+  int is224;
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context* ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context* ctx);
+int mbedtls_sha256_starts_ret(mbedtls_sha256_context* ctx, int is224);
+int mbedtls_sha256_update_ret(mbedtls_sha256_context* ctx, const unsigned char* input, size_t len);
+int mbedtls_sha256_finish_ret(mbedtls_sha256_context* ctx, unsigned char output[32]);
+int mbedtls_sha256_ret(const unsigned char* input, size_t len, unsigned char output[32], int is224);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef HOST_COMPAT_MBEDTLS_VERSION_H
+#define HOST_COMPAT_MBEDTLS_VERSION_H
+
+// Declaraciones de mbedtls 2.28 para hosts que tienen la biblioteca (libmbedcrypto.so.7)
+// pero no sus encabezados. El CMakeLists.txt de la raíz solo agrega esta carpeta si no
+// encuentra mbedtls/sha256.h; con libmbedtls-dev instalado se usan los del sistema.
+// Solo lo que usan OtaVerify y las herramientas.
+#define MBEDTLS_VERSION_NUMBER 0x021C0300
+
+#endif
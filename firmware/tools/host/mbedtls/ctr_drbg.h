@@ -0,0 +1,16 @@
+#ifndef HOST_MBEDTLS_CTR_DRBG_H
+#define HOST_MBEDTLS_CTR_DRBG_H
+
+// Generador de la sesión TLS del host (ver mbedtls/ssl.h): no se usa para cifrar nada
+
+#include <stddef.h>
+
+typedef struct { int unused; } mbedtls_ctr_drbg_context;
+
+void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context* ctx);
+void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context* ctx);
+int mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context* ctx, int (*entropy)(void*, unsigned char*, size_t),
+                          void* entropyCtx, const unsigned char* custom, size_t len);
+int mbedtls_ctr_drbg_random(void* ctx, unsigned char* output, size_t len);
+
+#endif
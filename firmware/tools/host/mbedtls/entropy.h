@@ -0,0 +1,14 @@
+#ifndef HOST_MBEDTLS_ENTROPY_H
+#define HOST_MBEDTLS_ENTROPY_H
+
+// Entropía de la sesión TLS del host (ver mbedtls/ssl.h)
+
+#include <stddef.h>
+
+typedef struct { int unused; } mbedtls_entropy_context;
+
+void mbedtls_entropy_init(mbedtls_entropy_context* ctx);
+void mbedtls_entropy_free(mbedtls_entropy_context* ctx);
+int mbedtls_entropy_func(void* ctx, unsigned char* output, size_t len);
+
+#endif
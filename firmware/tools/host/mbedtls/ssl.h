@@ -0,0 +1,68 @@
+#ifndef HOST_MBEDTLS_SSL_H
+#define HOST_MBEDTLS_SSL_H
+
+// Sin TLS en el host (como WiFiClientSecure.h): TlsSessionClient compila contra estas
+// declaraciones y el handshake termina enseguida sin cifrar nada. El MQTT del host no pasa
+// por el socket, así que alcanza con que la sesión "conecte". El hash y la firma de la OTA
+// siguen usando el mbedtls del sistema (mbedcrypto).
+
+#include <stddef.h>
+#include <mbedtls/version.h>
+
+#ifndef MBEDTLS_PRIVATE
+#define MBEDTLS_PRIVATE(member) member
+#endif
+
+#define MBEDTLS_SSL_IS_CLIENT               0
+#define MBEDTLS_SSL_TRANSPORT_STREAM        0
+#define MBEDTLS_SSL_PRESET_DEFAULT          0
+#define MBEDTLS_SSL_VERIFY_NONE             0
+#define MBEDTLS_SSL_SESSION_TICKETS_ENABLED 1
+#define MBEDTLS_SSL_MAJOR_VERSION_3         3
+#define MBEDTLS_SSL_MINOR_VERSION_3         3
+#define MBEDTLS_SSL_VERSION_TLS1_2          0x0303
+
+#define MBEDTLS_ERR_SSL_WANT_READ          (-0x6900)
+#define MBEDTLS_ERR_SSL_WANT_WRITE         (-0x6880)
+#define MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY  (-0x7880)
+#define MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL   (-0x6A00)
+
+typedef struct {
+  unsigned char master[48];
+  size_t id_len;
+  unsigned char id[32];
+} mbedtls_ssl_session;
+typedef struct { int unused; } mbedtls_ssl_config;
+typedef struct { int unused; } mbedtls_ssl_context;
+
+typedef int mbedtls_ssl_send_t(void* ctx, const unsigned char* buf, size_t len);
+typedef int mbedtls_ssl_recv_t(void* ctx, unsigned char* buf, size_t len);
+typedef int mbedtls_ssl_recv_timeout_t(void* ctx, unsigned char* buf, size_t len, unsigned int timeout);
+
+void mbedtls_ssl_init(mbedtls_ssl_context* ssl);
+void mbedtls_ssl_free(mbedtls_ssl_context* ssl);
+void mbedtls_ssl_config_init(mbedtls_ssl_config* conf);
+void mbedtls_ssl_config_free(mbedtls_ssl_config* conf);
+int mbedtls_ssl_config_defaults(mbedtls_ssl_config* conf, int endpoint, int transport, int preset);
+void mbedtls_ssl_conf_authmode(mbedtls_ssl_config* conf, int authmode);
+void mbedtls_ssl_conf_rng(mbedtls_ssl_config* conf, int (*rng)(void*, unsigned char*, size_t), void* ctx);
+void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config* conf, int useTickets);
+void mbedtls_ssl_conf_max_version(mbedtls_ssl_config* conf, int major, int minor);
+void mbedtls_ssl_conf_max_tls_version(mbedtls_ssl_config* conf, int version);
+int mbedtls_ssl_setup(mbedtls_ssl_context* ssl, const mbedtls_ssl_config* conf);
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context* ssl, const char* hostname);
+void mbedtls_ssl_set_bio(mbedtls_ssl_context* ssl, void* ctx, mbedtls_ssl_send_t* send,
+                         mbedtls_ssl_recv_t* recv, mbedtls_ssl_recv_timeout_t* recvTimeout);
+int mbedtls_ssl_set_session(mbedtls_ssl_context* ssl, const mbedtls_ssl_session* session);
+int mbedtls_ssl_get_session(const mbedtls_ssl_context* ssl, mbedtls_ssl_session* session);
+void mbedtls_ssl_session_init(mbedtls_ssl_session* session);
+void mbedtls_ssl_session_free(mbedtls_ssl_session* session);
+int mbedtls_ssl_session_save(const mbedtls_ssl_session* session, unsigned char* buf, size_t len, size_t* olen);
+int mbedtls_ssl_session_load(mbedtls_ssl_session* session, const unsigned char* buf, size_t len);
+int mbedtls_ssl_handshake(mbedtls_ssl_context* ssl);
+int mbedtls_ssl_read(mbedtls_ssl_context* ssl, unsigned char* buf, size_t len);
+int mbedtls_ssl_write(mbedtls_ssl_context* ssl, const unsigned char* buf, size_t len);
+size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context* ssl);
+int mbedtls_ssl_close_notify(mbedtls_ssl_context* ssl);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef HOST_ROM_MINIZ_H
+#define HOST_ROM_MINIZ_H
+
+// Inflador tinfl de la ROM del ESP32 (el que usa OtaInflate para gzip) sobre zlib. Tiene
+// la misma interfaz y los mismos estados que el de la ROM, incluido el buffer de salida
+// circular: su tamaño (inicio + lo que queda) fija la ventana de deflate que se acepta, así
+// que un flujo con distancias más largas que el buffer falla igual que en el dispositivo.
+//
+// Todo el estado de zlib vive dentro de tinfl_decompressor: se libera con un free(), como
+// el de la ROM. Ocupa más (~40 KB contra ~11 KB): no sirve para medir RAM.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+enum {
+  TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+  TINFL_FLAG_HAS_MORE_INPUT = 2,
+  TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+  TINFL_FLAG_COMPUTE_ADLER32 = 8
+};
+
+typedef enum {
+  TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS = -4,
+  TINFL_STATUS_BAD_PARAM = -3,
+  TINFL_STATUS_ADLER32_MISMATCH = -2,
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+// Memoria para inflate_state (~7 KB) y la ventana de 32 KB de zlib
+#define HOST_TINFL_ARENA (48 * 1024)
+
+typedef struct {
+  z_stream zs;
+  int state;  // 0 sin empezar, 1 inflando, 2 terminado, -1 error
+  size_t arenaUsed;
+  alignas(16) uint8_t arena[HOST_TINFL_ARENA];
+} tinfl_decompressor;
+
+#define tinfl_init(r) ((r)->state = 0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* pIn_buf_next, size_t* pIn_buf_size,
+                              uint8_t* pOut_buf_start, uint8_t* pOut_buf_next, size_t* pOut_buf_size,
+                              const uint32_t decomp_flags);
+
+#endif
@@ -0,0 +1,201 @@
+// Generador de parches delta para Esp32OTA (formato descrito en EspOta/OtaDelta.h).
+//
+// Compilar:
+//   g++ -O2 -std=c++17 -I../EspOta ota_delta.cpp ../EspOta/OtaDelta.cpp -o ota_delta
+// o con CMake desde la raíz del repositorio: cmake --build build --target ota_delta
+//
+// Uso:
+//   ota_delta <base.bin> <nuevo.bin> <versión base> <salida.patch>
+//   ota_delta --verify <base.bin> <nuevo.bin> <versión base> <parche>
+//
+// La versión base debe coincidir con la que reporta el dispositivo (_firmwareVersion).
+// El parche puede comprimirse después con gzip -9 o con ota_pack (gzip o heatshrink):
+//   ota_pack --heatshrink nuevo.patch nuevo.patch.hs
+// El ESP32 lo descomprime en streaming antes de aplicarlo.
+//
+// Publicar en esp32/update: <mac|all>|delta|<versión base>|<url del parche>
+
+#include "OtaDelta.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Largo mínimo de coincidencia para emitir COPY (una COPY cuesta 9 bytes)
+static const size_t MIN_MATCH = 16;
+// Largo máximo de una COPY: acota el trabajo por operación en el dispositivo, que rechaza
+// las más largas
+static const size_t MAX_COPY = OTA_DELTA_MAX_COPY;
+// Bytes usados para indexar la imagen base
+static const size_t BLOCK = 8;
+// Candidatos guardados por hash
+static const size_t MAX_CANDIDATES = 8;
+
+static bool readFile(const char* path, std::vector<uint8_t>& out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "No se pudo abrir %s\n", path);
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static void putLE32(std::vector<uint8_t>& out, uint32_t v) {
+  for (int i = 0; i < 4; i++) out.push_back((v >> (8 * i)) & 0xFF);
+}
+
+static uint64_t blockHash(const uint8_t* p) {
+  uint64_t h = 1469598103934665603ULL;
+  for (size_t i = 0; i < BLOCK; i++) h = (h ^ p[i]) * 1099511628211ULL;
+  return h;
+}
+
+static void flushInsert(std::vector<uint8_t>& patch, const std::vector<uint8_t>& pending) {
+  if (pending.empty()) return;
+  patch.push_back(OTA_DELTA_OP_INSERT);
+  putLE32(patch, pending.size());
+  patch.insert(patch.end(), pending.begin(), pending.end());
+}
+
+static std::vector<uint8_t> makePatch(const std::vector<uint8_t>& base,
+                                      const std::vector<uint8_t>& target,
+                                      const std::string& baseVersion) {
+  std::vector<uint8_t> patch = {'E', 'D', 'L', 'T', OTA_DELTA_FORMAT, (uint8_t)baseVersion.size()};
+  patch.insert(patch.end(), baseVersion.begin(), baseVersion.end());
+  putLE32(patch, base.size());
+  putLE32(patch, target.size());
+
+  // Índice de bloques de la base (alineados a 4: el código Xtensa suele estarlo)
+  std::unordered_map<uint64_t, std::vector<uint32_t>> index;
+  for (size_t i = 0; i + BLOCK <= base.size(); i += 4) {
+    auto& c = index[blockHash(&base[i])];
+    if (c.size() < MAX_CANDIDATES) c.push_back(i);
+  }
+
+  std::vector<uint8_t> pending;
+  size_t pos = 0;
+  while (pos < target.size()) {
+    size_t bestLen = 0, bestSrc = 0;
+    if (pos + BLOCK <= target.size()) {
+      auto it = index.find(blockHash(&target[pos]));
+      if (it != index.end()) {
+        for (uint32_t src : it->second) {
+          size_t len = 0;
+          while (len < MAX_COPY && src + len < base.size() && pos + len < target.size() &&
+                 base[src + len] == target[pos + len]) {
+            len++;
+          }
+          if (len > bestLen) {
+            bestLen = len;
+            bestSrc = src;
+          }
+        }
+      }
+    }
+
+    if (bestLen >= MIN_MATCH) {
+      flushInsert(patch, pending);
+      pending.clear();
+      patch.push_back(OTA_DELTA_OP_COPY);
+      putLE32(patch, bestSrc);
+      putLE32(patch, bestLen);
+      pos += bestLen;
+    } else {
+      pending.push_back(target[pos++]);
+    }
+  }
+  flushInsert(patch, pending);
+  patch.push_back(OTA_DELTA_OP_END);
+  return patch;
+}
+
+// Contexto para aplicar el parche en el host con la misma etapa que el ESP32
+struct VerifyCtx {
+  const std::vector<uint8_t>* base;
+  std::vector<uint8_t> out;
+};
+
+static bool verifyReadBase(void* ctx, uint32_t offset, uint8_t* buf, size_t len) {
+  VerifyCtx* v = static_cast<VerifyCtx*>(ctx);
+  if (offset + len > v->base->size()) return false;
+  memcpy(buf, v->base->data() + offset, len);
+  return true;
+}
+
+static bool verifyOutput(void* ctx, const uint8_t* data, size_t len) {
+  VerifyCtx* v = static_cast<VerifyCtx*>(ctx);
+  v->out.insert(v->out.end(), data, data + len);
+  return true;
+}
+
+static bool applyPatch(const std::vector<uint8_t>& base, const std::vector<uint8_t>& patch,
+                       const std::string& baseVersion, std::vector<uint8_t>& out) {
+  VerifyCtx ctx{&base, {}};
+  OtaDelta delta;
+  delta.begin(baseVersion.c_str(), base.size(), verifyReadBase, verifyOutput, &ctx);
+  // Alimentar en bloques pequeños como llega por la red
+  for (size_t i = 0; i < patch.size(); i += 1024) {
+    size_t n = patch.size() - i < 1024 ? patch.size() - i : 1024;
+    if (!delta.write(patch.data() + i, n)) break;
+  }
+  if (!delta.finish()) {
+    fprintf(stderr, "Error al aplicar el parche: %s\n", delta.error());
+    return false;
+  }
+  out.swap(ctx.out);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  bool verify = argc == 6 && strcmp(argv[1], "--verify") == 0;
+  if (argc != 5 && !verify) {
+    fprintf(stderr, "Uso: %s <base.bin> <nuevo.bin> <versión base> <salida.patch>\n", argv[0]);
+    fprintf(stderr, "     %s --verify <base.bin> <nuevo.bin> <versión base> <parche>\n", argv[0]);
+    return 2;
+  }
+  char** a = argv + (verify ? 2 : 1);
+  std::string baseVersion = a[2];
+  if (baseVersion.size() > OTA_DELTA_MAX_VERSION) {
+    fprintf(stderr, "La versión base no puede superar %d caracteres\n", OTA_DELTA_MAX_VERSION);
+    return 2;
+  }
+
+  std::vector<uint8_t> base, target;
+  if (!readFile(a[0], base) || !readFile(a[1], target)) return 1;
+
+  std::vector<uint8_t> patch;
+  if (verify) {
+    if (!readFile(a[3], patch)) return 1;
+  } else {
+    patch = makePatch(base, target, baseVersion);
+  }
+
+  // Siempre se comprueba el ida y vuelta antes de dar el parche por bueno
+  std::vector<uint8_t> rebuilt;
+  if (!applyPatch(base, patch, baseVersion, rebuilt)) return 1;
+  if (rebuilt != target) {
+    fprintf(stderr, "❌ La imagen reconstruida no coincide con %s\n", a[1]);
+    return 1;
+  }
+
+  if (!verify) {
+    FILE* f = fopen(a[3], "wb");
+    if (!f || fwrite(patch.data(), 1, patch.size(), f) != patch.size()) {
+      fprintf(stderr, "No se pudo escribir %s\n", a[3]);
+      if (f) fclose(f);
+      return 1;
+    }
+    fclose(f);
+  }
+
+  printf("✅ Parche %s: %zu bytes (imagen nueva %zu bytes, %.1f%%)\n",
+         verify ? "verificado" : "generado", patch.size(), target.size(),
+         100.0 * patch.size() / target.size());
+  return 0;
+}
@@ -0,0 +1,136 @@
+// Comprime una imagen (o un parche de ota_delta) para la OTA de Esp32OTA, en gzip o en
+// heatshrink con la cabecera que espera EspOta/OtaInflate.h.
+//
+// Compilar (desde la raíz del repositorio; ver CMakeLists.txt):
+//   cmake -S . -B build && cmake --build build --target ota_pack
+//
+// Uso:
+//   ota_pack --gzip [--window=<9..15>] <entrada> <salida>
+//   ota_pack --heatshrink [--window=<4..12>] [--lookahead=<3..window-1>] <entrada> <salida>
+//
+// gzip: --window son los bits de la ventana de deflate (15 por defecto, como gzip -9). Una
+// imagen con menos bits la descomprime cualquier firmware; el ahorro de RAM llega al
+// compilar el firmware con ese OTA_GZ_WINDOW_BITS (ver OtaInflate.h).
+// heatshrink: la ventana (12 por defecto) va en la cabecera y es la RAM que reserva el
+// dispositivo, como mucho 2^OTA_HS_MAX_WINDOW_SZ2.
+//
+// Antes de escribir la salida se descomprime con OtaInflate (el mismo código del firmware)
+// en bloques del tamaño de un segmento TCP y se compara con la entrada.
+//
+// Servir el resultado como cualquier imagen: OtaInflate reconoce el formato por su primer
+// byte o por Content-Encoding (gzip / heatshrink).
+
+#include "OtaInflate.h"
+#include "OtaPack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define PACK_VERIFY_CHUNK 1460
+
+static bool readFile(const char* path, std::vector<uint8_t>& out) {
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "No se pudo abrir %s\n", path);
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static bool collect(void* ctx, const uint8_t* data, size_t len) {
+  std::vector<uint8_t>* out = (std::vector<uint8_t>*)ctx;
+  out->insert(out->end(), data, data + len);
+  return true;
+}
+
+static bool verifyPacked(OTAEncoding enc, const std::vector<uint8_t>& packed, const std::vector<uint8_t>& original) {
+  std::vector<uint8_t> rebuilt;
+  OtaInflate inflate;
+  bool ok = inflate.begin(enc, collect, &rebuilt);
+  for (size_t i = 0; ok && i < packed.size(); i += PACK_VERIFY_CHUNK) {
+    ok = inflate.write(packed.data() + i, min((size_t)PACK_VERIFY_CHUNK, packed.size() - i));
+  }
+  ok = ok && inflate.finish();
+  if (!ok) {
+    fprintf(stderr, "❌ OtaInflate rechazó el resultado: %s\n", inflate.error() ? inflate.error() : "?");
+    return false;
+  }
+  if (rebuilt != original) {
+    fprintf(stderr, "❌ La imagen descomprimida no coincide con la entrada\n");
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  OTAEncoding enc = OTA_ENC_UNKNOWN;
+  int window = -1;
+  int lookahead = 5;
+  const char* files[2];
+  int fileCount = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--gzip") == 0) enc = OTA_ENC_GZIP;
+    else if (strcmp(argv[i], "--heatshrink") == 0) enc = OTA_ENC_HEATSHRINK;
+    else if (strncmp(argv[i], "--window=", 9) == 0) window = atoi(argv[i] + 9);
+    else if (strncmp(argv[i], "--lookahead=", 12) == 0) lookahead = atoi(argv[i] + 12);
+    else if (argv[i][0] != '-' && fileCount < 2) files[fileCount++] = argv[i];
+    else fileCount = 3;
+  }
+  if (enc == OTA_ENC_UNKNOWN || fileCount != 2) {
+    fprintf(stderr, "Uso: %s --gzip [--window=<9..15>] <entrada> <salida>\n", argv[0]);
+    fprintf(stderr, "     %s --heatshrink [--window=<4..%d>] [--lookahead=<3..window-1>] <entrada> <salida>\n",
+            argv[0], OTA_HS_MAX_WINDOW_SZ2);
+    return 2;
+  }
+  if (window < 0) window = enc == OTA_ENC_GZIP ? 15 : OTA_HS_MAX_WINDOW_SZ2;
+  if (enc == OTA_ENC_GZIP && (window < 9 || window > 15)) {
+    fprintf(stderr, "La ventana gzip va de 9 a 15 bits\n");
+    return 2;
+  }
+  if (enc == OTA_ENC_HEATSHRINK &&
+      (window < 4 || window > OTA_HS_MAX_WINDOW_SZ2 || lookahead < 3 || lookahead >= window)) {
+    fprintf(stderr, "heatshrink admite ventana de 4 a %d bits y lookahead de 3 a ventana-1\n",
+            OTA_HS_MAX_WINDOW_SZ2);
+    return 2;
+  }
+
+  std::vector<uint8_t> image;
+  if (!readFile(files[0], image)) return 1;
+  if (image.empty()) {
+    fprintf(stderr, "%s está vacío\n", files[0]);
+    return 1;
+  }
+
+  std::vector<uint8_t> packed;
+  bool ok = enc == OTA_ENC_GZIP ? otaPackGzip(image, window, packed)
+                                : otaPackHeatshrink(image, (uint8_t)window, (uint8_t)lookahead, packed);
+  if (!ok) {
+    fprintf(stderr, "❌ No se pudo comprimir %s\n", files[0]);
+    return 1;
+  }
+  if (!verifyPacked(enc, packed, image)) return 1;
+
+  FILE* f = fopen(files[1], "wb");
+  if (!f || fwrite(packed.data(), 1, packed.size(), f) != packed.size()) {
+    fprintf(stderr, "No se pudo escribir %s\n", files[1]);
+    if (f) fclose(f);
+    return 1;
+  }
+  fclose(f);
+
+  // RAM del descompresor en el ESP32 mientras dura la OTA
+  size_t ram = enc == OTA_ENC_GZIP ? (1u << window) + 11 * 1024 : (1u << window);
+  printf("✅ %s %s: %zu -> %zu bytes (%.1f%%), ~%zu KB de RAM en el ESP32\n",
+         OtaInflate::encodingName(enc), files[1], image.size(), packed.size(),
+         100.0 * packed.size() / image.size(), (ram + 1023) / 1024);
+  if (enc == OTA_ENC_GZIP && window < 15) {
+    printf("   Ese consumo requiere compilar el firmware con OTA_GZ_WINDOW_BITS=%d\n", window);
+  }
+  return 0;
+}
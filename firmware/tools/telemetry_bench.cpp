@@ -0,0 +1,95 @@
+// Compara tamaño y tiempo de codificación de la telemetría de sensor: JSON vs CBOR.
+// Usa los mismos escritores que el firmware (EspOta/JsonWriter.h y EspOta/CborWriter.h).
+//
+// Compilar:
+//   g++ -O2 -std=c++17 -I../EspOta telemetry_bench.cpp -o telemetry_bench
+// o con CMake desde la raíz del repositorio: cmake --build build --target telemetry_bench
+//
+// Uso:
+//   telemetry_bench [iteraciones]
+//
+// Los tiempos son del host: sirven para comparar ambos formatos entre sí, no como
+// valor absoluto en el ESP32. El tamaño sí es exactamente el que viaja por MQTT.
+
+#define CBOR_KEY_MAC         0
+#define CBOR_KEY_TEMPERATURE 1
+#define CBOR_KEY_HUMIDITY    2
+
+#include "CborWriter.h"
+#include "JsonWriter.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* MAC_TEXT = "24:0A:C4:01:02:FF";
+static const uint8_t MAC_BYTES[6] = {0x24, 0x0A, 0xC4, 0x01, 0x02, 0xFF};
+static const char* DEVICE_NAME = "ESP32-Lab-01";
+
+// Overhead fijo de un PUBLISH MQTT 3.1.1 con QoS 0: cabecera (2) + largo del tópico (2) + tópico
+static size_t mqttOverhead(const char* topic) {
+  return 2 + 2 + strlen(topic);
+}
+
+static size_t encodeJson(float t, float h, const char** out) {
+  static JsonMessage<192> msg;
+  msg.clear();
+  msg.beginObject()
+     .field("mac", MAC_TEXT)
+     .field("name", DEVICE_NAME)
+     .field("temperature", t, 1)
+     .field("humidity", h, 1)
+     .endObject();
+  *out = msg.c_str();
+  return msg.length();
+}
+
+static size_t encodeCbor(float t, float h) {
+  static CborMessage<32> frame;
+  frame.clear();
+  frame.map(3).uint(CBOR_KEY_MAC).bytes(MAC_BYTES, sizeof(MAC_BYTES));
+  frame.uint(CBOR_KEY_TEMPERATURE).float32(t);
+  frame.uint(CBOR_KEY_HUMIDITY).float32(h);
+  return frame.length();
+}
+
+// Devuelve ns por mensaje; acumula los largos para que el compilador no elimine el trabajo
+template <typename F>
+static double timeIt(long iterations, F encode, size_t& sink) {
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; i++) {
+    float t = 20.0f + (i % 100) * 0.1f;
+    float h = 40.0f + (i % 300) * 0.1f;
+    sink += encode(t, h);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+  long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+  if (iterations <= 0) {
+    fprintf(stderr, "Uso: %s [iteraciones]\n", argv[0]);
+    return 2;
+  }
+
+  const char* sample;
+  size_t jsonLen = encodeJson(25.3f, 61.8f, &sample);
+  size_t cborLen = encodeCbor(25.3f, 61.8f);
+  size_t jsonWire = jsonLen + mqttOverhead("esp32/sensor");
+  size_t cborWire = cborLen + mqttOverhead("esp32/sensor/cbor");
+  printf("Ejemplo JSON: %s\n\n", sample);
+
+  size_t sink = 0;
+  const char* ignored;
+  double jsonNs = timeIt(iterations, [&](float t, float h) { return encodeJson(t, h, &ignored); }, sink);
+  double cborNs = timeIt(iterations, [](float t, float h) { return encodeCbor(t, h); }, sink);
+
+  printf("%-6s %10s %14s %12s\n", "", "payload", "PUBLISH MQTT", "ns/mensaje");
+  printf("%-6s %8zu B %12zu B %12.1f\n", "JSON", jsonLen, jsonWire, jsonNs);
+  printf("%-6s %8zu B %12zu B %12.1f\n", "CBOR", cborLen, cborWire, cborNs);
+  printf("\nCBOR ocupa %.0f%% del payload JSON (%.0f%% del PUBLISH)\n",
+         100.0 * cborLen / jsonLen, 100.0 * cborWire / jsonWire);
+  return sink == 0;  // nunca 0: solo evita que se optimice el bucle
+}
@@ -0,0 +1,269 @@
+// EspOta/ConnectivityFsm alimentada con guiones de eventos: primero la máquina sola (un hilo
+// hace de tarea de eventos de WiFi y postea, el de la prueba consume con poll()/apply()), y
+// después dentro de Esp32OTA contra HostSim, cortando el WiFi y el broker para ver la espera
+// entre intentos y la reconexión. EspOta se compila con WIFI_RETRY_DELAY y MQTT_RETRY_DELAY
+// cortos (biblioteca esp32ota_fast_retry).
+
+#include "ConnectivityFsm.h"
+#include "Esp32OTA.h"
+#include "HostSim.h"
+
+#include <functional>
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+#define TEST_TIMEOUT_MS 10000
+
+struct Transition {
+  ConnState from;
+  ConnState to;
+  unsigned long at;
+};
+
+bool operator==(const Transition& a, const Transition& b) {
+  return a.from == b.from && a.to == b.to;
+}
+
+std::ostream& operator<<(std::ostream& os, const Transition& t) {
+  return os << ConnectivityFsm::name(t.from) << "->" << ConnectivityFsm::name(t.to) << "@" << t.at;
+}
+
+// Paso del guion: en el instante at llega ev y la máquina queda en expect
+struct Step {
+  unsigned long at;
+  ConnEvent ev;
+  ConnState expect;
+};
+
+class ConnectivityFsmTest : public ::testing::Test {
+protected:
+  void SetUp() override { fsm.setListener(record, &seen); }
+
+  static void record(ConnState from, ConnState to, void* ctx) {
+    static_cast<std::vector<Transition>*>(ctx)->push_back(Transition{ from, to, 0 });
+  }
+
+  // Cada evento pasa por la cola, como los que postea el callback de WiFi
+  void play(const std::vector<Step>& script) {
+    for (const Step& s : script) {
+      ASSERT_TRUE(fsm.post(s.ev));
+      ConnEvent ev;
+      ASSERT_TRUE(fsm.poll(ev));
+      EXPECT_EQ(s.expect, fsm.apply(ev, s.at))
+          << "evento " << (int)s.ev << " en t=" << s.at;
+    }
+  }
+
+  ConnectivityFsm fsm;
+  std::vector<Transition> seen;
+};
+
+// Sesión completa: intento fallido, espera, unión, broker que rechaza, caída del broker y del WiFi
+TEST_F(ConnectivityFsmTest, WalksScriptedSession) {
+  play({
+    { 0,     CONN_EV_JOIN_STARTED,   CONN_ASSOCIATING },
+    { 40,    CONN_EV_DISCONNECTED,   CONN_ASSOCIATING },  // WiFi.begin() de otra candidata
+    { 10000, CONN_EV_JOIN_FAILED,    CONN_DISCONNECTED },
+    { 25000, CONN_EV_JOIN_STARTED,   CONN_ASSOCIATING },
+    { 25300, CONN_EV_GOT_IP,         CONN_IP },
+    { 25300, CONN_EV_MQTT_STARTED,   CONN_MQTT_CONNECTING },
+    { 25800, CONN_EV_MQTT_FAILED,    CONN_IP },
+    { 55800, CONN_EV_MQTT_STARTED,   CONN_MQTT_CONNECTING },
+    { 56000, CONN_EV_MQTT_CONNECTED, CONN_ONLINE },
+    { 60000, CONN_EV_GOT_IP,         CONN_ONLINE },       // renovación DHCP
+    { 70000, CONN_EV_MQTT_LOST,      CONN_IP },
+    { 70000, CONN_EV_MQTT_STARTED,   CONN_MQTT_CONNECTING },
+    { 70200, CONN_EV_MQTT_CONNECTED, CONN_ONLINE },
+    { 80000, CONN_EV_DISCONNECTED,   CONN_DISCONNECTED },
+    { 80001, CONN_EV_LOST_IP,        CONN_DISCONNECTED },
+    { 80001, CONN_EV_MQTT_LOST,      CONN_DISCONNECTED },
+  });
+
+  EXPECT_EQ(80000u, fsm.since());
+  std::vector<Transition> expected = {
+    { CONN_DISCONNECTED, CONN_ASSOCIATING, 0 },   { CONN_ASSOCIATING, CONN_DISCONNECTED, 0 },
+    { CONN_DISCONNECTED, CONN_ASSOCIATING, 0 },   { CONN_ASSOCIATING, CONN_IP, 0 },
+    { CONN_IP, CONN_MQTT_CONNECTING, 0 },         { CONN_MQTT_CONNECTING, CONN_IP, 0 },
+    { CONN_IP, CONN_MQTT_CONNECTING, 0 },         { CONN_MQTT_CONNECTING, CONN_ONLINE, 0 },
+    { CONN_ONLINE, CONN_IP, 0 },                  { CONN_IP, CONN_MQTT_CONNECTING, 0 },
+    { CONN_MQTT_CONNECTING, CONN_ONLINE, 0 },     { CONN_ONLINE, CONN_DISCONNECTED, 0 },
+  };
+  EXPECT_EQ(expected, seen);
+}
+
+// Perder la IP tira todo abajo desde cualquier estado con red
+TEST_F(ConnectivityFsmTest, LostIpFromEveryState) {
+  for (ConnState s : { CONN_ASSOCIATING, CONN_IP, CONN_MQTT_CONNECTING, CONN_ONLINE }) {
+    EXPECT_EQ(CONN_DISCONNECTED, ConnectivityFsm::transition(s, CONN_EV_LOST_IP)) << ConnectivityFsm::name(s);
+  }
+  EXPECT_EQ(CONN_DISCONNECTED, ConnectivityFsm::transition(CONN_DISCONNECTED, CONN_EV_LOST_IP));
+  EXPECT_EQ(CONN_DISCONNECTED, ConnectivityFsm::transition(CONN_DISCONNECTED, CONN_EV_MQTT_CONNECTED));
+  EXPECT_EQ(CONN_IP, ConnectivityFsm::transition(CONN_DISCONNECTED, CONN_EV_GOT_IP));  // IP sin intento propio
+}
+
+// La cola es fija: lo que no entra se descarta y se cuenta, sin bloquear al callback
+TEST_F(ConnectivityFsmTest, DropsWhenQueueIsFull) {
+  for (int i = 0; i < CONN_EVENT_QUEUE - 1; i++) ASSERT_TRUE(fsm.post(CONN_EV_DISCONNECTED));
+  EXPECT_FALSE(fsm.post(CONN_EV_GOT_IP));
+  EXPECT_EQ(1u, fsm.dropped());
+
+  ConnEvent ev;
+  int drained = 0;
+  while (fsm.poll(ev)) {
+    EXPECT_EQ(CONN_EV_DISCONNECTED, ev);
+    drained++;
+  }
+  EXPECT_EQ(CONN_EVENT_QUEUE - 1, drained);
+  EXPECT_TRUE(fsm.post(CONN_EV_GOT_IP));
+}
+
+// Otro hilo postea un guion largo de caídas y reconexiones; loop() los ve completos y en orden
+TEST_F(ConnectivityFsmTest, EventsFromWiFiTaskArriveInOrder) {
+  static const ConnEvent cycle[] = {
+    CONN_EV_GOT_IP, CONN_EV_DISCONNECTED, CONN_EV_DISCONNECTED, CONN_EV_GOT_IP, CONN_EV_LOST_IP,
+  };
+  const size_t total = 20000;
+  std::thread wifiTask([&] {
+    for (size_t i = 0; i < total; i++) {
+      while (!fsm.post(cycle[i % 5])) std::this_thread::yield();
+    }
+  });
+
+  size_t received = 0;
+  size_t outOfOrder = 0;
+  ConnEvent ev;
+  while (received < total) {
+    if (!fsm.poll(ev)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (ev != cycle[received % 5]) outOfOrder++;
+    fsm.apply(ev, received);
+    received++;
+  }
+  wifiTask.join();
+
+  EXPECT_EQ(0u, outOfOrder);
+  EXPECT_EQ(CONN_DISCONNECTED, fsm.state());
+  EXPECT_EQ(total / 5 * 4, seen.size());  // por vuelta: ->IP, ->DISC, ->IP, ->DISC
+}
+
+// Esp32OTA en una placa de HostSim: el guion ahora lo escriben el AP y el broker simulados
+class ConnectivityBackoffTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    static uint8_t next = 1;
+    uint8_t mac[6] = { 0x24, 0x6F, 0x28, 0x0C, 0x00, next++ };
+    host::selectDevice(host::createDevice(mac));
+    host::addAccessPoint(kSsids[0], -55, 6);
+    static const bool other = (host::addAccessPoint("fsm-vecino", -40, 1), true);
+    (void)other;
+    changes().clear();
+    ota.reset(new Esp32OTA("broker.local", 8883, "user", "pass", "fsm", "v-fsm"));
+    ota->setWiFiNetworks(kSsids, kPasswords, 1);
+    ota->setConnectivityCallback(onChange);
+  }
+
+  void TearDown() override {
+    host::refuseMqtt(false);
+    host::removeAccessPoint(kSsids[0]);
+    host::reboot();
+    ota.reset();
+    host::selectDevice(nullptr);
+  }
+
+  static std::vector<Transition>& changes() {
+    static std::vector<Transition> c;
+    return c;
+  }
+
+  static void onChange(ConnState from, ConnState to) { changes().push_back(Transition{ from, to, millis() }); }
+
+  bool runUntil(std::function<bool()> done) {
+    unsigned long start = millis();
+    while (!done()) {
+      if (millis() - start > TEST_TIMEOUT_MS) return false;
+      ota->loop();
+      delay(1);
+    }
+    return true;
+  }
+
+  // Cuántas veces se entró a to desde la marca mark
+  size_t entered(ConnState to, size_t mark = 0) const {
+    size_t n = 0;
+    for (size_t i = mark; i < changes().size(); i++) n += changes()[i].to == to;
+    return n;
+  }
+
+  // Instante de la n-ésima (desde 0) entrada a to a partir de mark
+  unsigned long enteredAt(ConnState to, size_t n, size_t mark = 0) const {
+    for (size_t i = mark; i < changes().size(); i++) {
+      if (changes()[i].to == to && n-- == 0) return changes()[i].at;
+    }
+    return 0;
+  }
+
+  static const char* kSsids[];
+  static const char* kPasswords[];
+  std::unique_ptr<Esp32OTA> ota;
+};
+
+const char* ConnectivityBackoffTest::kSsids[] = { "fsm-ap" };
+const char* ConnectivityBackoffTest::kPasswords[] = { "fsm-pass" };
+
+// Sin la red, cada intento fallido espera WIFI_RETRY_DELAY; al volver la red se reconecta sola
+TEST_F(ConnectivityBackoffTest, WiFiRetriesWithBackoffAndReconnects) {
+  ota->begin();
+  ASSERT_TRUE(runUntil([&] { return ota->getConnState() == CONN_ONLINE; }));
+
+  size_t mark = changes().size();
+  host::removeAccessPoint(kSsids[0]);
+  host::dropWiFi();
+  // Intento directo y escaneo sin candidatas: falla; se espera a dos intentos más
+  ASSERT_TRUE(runUntil([&] { return entered(CONN_ASSOCIATING, mark) >= 3; }));
+  EXPECT_EQ(CONN_DISCONNECTED, changes()[mark].to);
+  for (size_t n = 1; n < 3; n++) {
+    unsigned long failedAt = enteredAt(CONN_DISCONNECTED, n, mark);
+    EXPECT_GE(enteredAt(CONN_ASSOCIATING, n, mark) - failedAt, (unsigned long)WIFI_RETRY_DELAY - 5)
+        << "intento " << n;
+  }
+  EXPECT_EQ(0u, entered(CONN_IP, mark));
+
+  host::addAccessPoint(kSsids[0], -55, 6);
+  ASSERT_TRUE(runUntil([&] { return ota->getConnState() == CONN_ONLINE; }));
+  EXPECT_EQ(CONN_IP, changes()[changes().size() - 3].to);
+  EXPECT_EQ(CONN_MQTT_CONNECTING, changes()[changes().size() - 2].to);
+  EXPECT_TRUE(host::mqttConnected());
+}
+
+// El broker corta: reintento inmediato; si rechaza, los siguientes cada MQTT_RETRY_DELAY
+// sin soltar el WiFi
+TEST_F(ConnectivityBackoffTest, MqttRetriesWithBackoffAndReconnects) {
+  ota->begin();
+  ASSERT_TRUE(runUntil([&] { return ota->getConnState() == CONN_ONLINE; }));
+
+  size_t mark = changes().size();
+  unsigned long droppedAt = millis();
+  host::refuseMqtt(true);
+  host::dropMqtt();
+  ASSERT_TRUE(runUntil([&] { return entered(CONN_MQTT_CONNECTING, mark) >= 3; }));
+  ASSERT_EQ(CONN_IP, changes()[mark].to);
+  EXPECT_EQ(CONN_ONLINE, changes()[mark].from);
+  EXPECT_LT(enteredAt(CONN_MQTT_CONNECTING, 0, mark) - droppedAt, (unsigned long)MQTT_RETRY_DELAY);
+  for (size_t n = 1; n < 3; n++) {
+    EXPECT_GE(enteredAt(CONN_MQTT_CONNECTING, n, mark) - enteredAt(CONN_MQTT_CONNECTING, n - 1, mark),
+              (unsigned long)MQTT_RETRY_DELAY - 5)
+        << "intento " << n;
+  }
+  EXPECT_EQ(0u, entered(CONN_DISCONNECTED, mark));
+
+  host::refuseMqtt(false);
+  ASSERT_TRUE(runUntil([&] { return ota->getConnState() == CONN_ONLINE; }));
+  EXPECT_TRUE(host::mqttConnected());
+}
+
+}  // namespace
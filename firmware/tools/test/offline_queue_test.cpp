@@ -0,0 +1,167 @@
+// EspOta/OfflineQueue sobre el LittleFS del host (archivos reales en un directorio temporal):
+// orden, descarte de la más vieja con la cola llena, reinicio con host::reboot() y el
+// reenvío por lotes de sendWeatherData cuando vuelve la red.
+
+#include "Esp32OTA.h"
+#include "HostSim.h"
+
+#include <gtest/gtest.h>
+#include <math.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+namespace {
+
+#define TEST_PATH       "/weather.q"
+#define TEST_URL        "http://meteo.local/api/weather"
+#define TEST_TIMEOUT_MS 10000
+
+QueuedReading reading(uint32_t n) {
+  QueuedReading r = {};
+  r.temperature = 20.0f + n;
+  r.humidity = 50.0f + n;
+  r.capturedMs = n;
+  r.bootId = 7;
+  return r;
+}
+
+size_t hostFileSize(const char* path) {
+  struct stat st;
+  return stat(host::fsPath(path).c_str(), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+class OfflineQueueTest : public ::testing::Test {
+protected:
+  // Cada prueba corre en su propia placa: el LittleFS empieza vacío
+  void SetUp() override {
+    static uint8_t next = 1;
+    uint8_t mac[6] = { 0x24, 0x6F, 0x28, 0x0F, 0x00, next++ };
+    host::selectDevice(host::createDevice(mac));
+  }
+
+  void TearDown() override { host::selectDevice(nullptr); }
+
+  // Lectura i de la cola, o una con temperatura NaN si no está
+  float temperatureAt(OfflineQueue& q, uint32_t i) {
+    QueuedReading r;
+    return q.peek(i, r) ? r.temperature : NAN;
+  }
+};
+
+TEST_F(OfflineQueueTest, KeepsOrderAndPops) {
+  OfflineQueue q;
+  ASSERT_TRUE(q.begin(LittleFS, TEST_PATH, 8));
+  for (uint32_t n = 0; n < 5; n++) ASSERT_TRUE(q.push(reading(n)));
+
+  EXPECT_EQ(5u, q.size());
+  EXPECT_FLOAT_EQ(20.0f, temperatureAt(q, 0));
+  EXPECT_FLOAT_EQ(24.0f, temperatureAt(q, 4));
+  ASSERT_TRUE(q.pop(2));
+  EXPECT_EQ(3u, q.size());
+  EXPECT_FLOAT_EQ(22.0f, temperatureAt(q, 0));
+  ASSERT_TRUE(q.pop(10));
+  EXPECT_TRUE(q.empty());
+}
+
+// Llena, la nueva reemplaza a la más vieja; el archivo no crece (ranuras reservadas)
+TEST_F(OfflineQueueTest, EvictsOldestWhenFull) {
+  OfflineQueue q;
+  ASSERT_TRUE(q.begin(LittleFS, TEST_PATH, 4));
+  size_t fileSize = hostFileSize(TEST_PATH);
+  EXPECT_GE(fileSize, 4 * sizeof(QueuedReading));
+
+  for (uint32_t n = 0; n < 7; n++) ASSERT_TRUE(q.push(reading(n)));
+  EXPECT_EQ(4u, q.size());
+  EXPECT_EQ(3u, q.evicted());
+  for (uint32_t i = 0; i < 4; i++) EXPECT_FLOAT_EQ(23.0f + i, temperatureAt(q, i));
+  EXPECT_EQ(fileSize, hostFileSize(TEST_PATH));
+}
+
+// Tras el reinicio la cola se reabre con lo pendiente, también después de dar la vuelta
+TEST_F(OfflineQueueTest, SurvivesReboot) {
+  {
+    OfflineQueue q;
+    ASSERT_TRUE(q.begin(LittleFS, TEST_PATH, 4));
+    for (uint32_t n = 0; n < 6; n++) ASSERT_TRUE(q.push(reading(n)));
+    ASSERT_TRUE(q.pop(1));
+  }
+  host::reboot();
+
+  OfflineQueue q;
+  ASSERT_TRUE(q.begin(LittleFS, TEST_PATH, 4));
+  ASSERT_EQ(3u, q.size());
+  EXPECT_EQ(0u, q.evicted());
+  for (uint32_t i = 0; i < 3; i++) EXPECT_FLOAT_EQ(23.0f + i, temperatureAt(q, i));
+  QueuedReading r;
+  ASSERT_TRUE(q.peek(2, r));
+  EXPECT_EQ(7u, r.bootId);
+  EXPECT_EQ(5u, r.capturedMs);
+}
+
+// Un archivo truncado o de otra capacidad no se interpreta: se crea de nuevo vacío
+TEST_F(OfflineQueueTest, RecreatesDamagedFile) {
+  {
+    OfflineQueue q;
+    ASSERT_TRUE(q.begin(LittleFS, TEST_PATH, 4));
+    ASSERT_TRUE(q.push(reading(1)));
+  }
+  ASSERT_EQ(0, truncate(host::fsPath(TEST_PATH).c_str(), 30));
+
+  OfflineQueue q;
+  ASSERT_TRUE(q.begin(LittleFS, TEST_PATH, 4));
+  EXPECT_TRUE(q.empty());
+  ASSERT_TRUE(q.push(reading(2)));
+  q.end();
+  ASSERT_TRUE(q.begin(LittleFS, TEST_PATH, 8));
+  EXPECT_TRUE(q.empty());
+}
+
+// sendWeatherData sin red guarda en flash; tras el reinicio, con red, se reenvía todo en
+// POST de hasta OFFLINE_DRAIN_BATCH lecturas y en el orden en que se tomaron
+TEST_F(OfflineQueueTest, ReplaysWeatherDataAfterReboot) {
+  static const char* offlineSsids[] = { "offline-ap" };
+  static const char* onlineSsids[] = { "offline-queue-ap" };
+  static const char* passwords[] = { "pass" };
+  static const bool apReady = (host::addAccessPoint(onlineSsids[0], -60, 11), true);
+  (void)apReady;
+  const uint32_t readings = OFFLINE_DRAIN_BATCH + 3;
+
+  {
+    // La red configurada no está: todo va a la cola
+    Esp32OTA ota("broker.local", 8883, "user", "pass", "offline", "v-offline");
+    ota.setWiFiNetworks(offlineSsids, passwords, 1);
+    ota.begin();
+    for (uint32_t n = 0; n < readings; n++) ota.sendWeatherData(10.0f + n, 40.0f, TEST_URL);
+    EXPECT_EQ(readings, ota.pendingWeatherData());
+    host::reboot();
+  }
+
+  Esp32OTA ota("broker.local", 8883, "user", "pass", "offline", "v-offline");
+  ota.setWiFiNetworks(onlineSsids, passwords, 1);
+  ota.setWeatherEndpoint(TEST_URL);
+  ota.begin();
+  EXPECT_EQ(readings, ota.pendingWeatherData());
+
+  std::vector<std::string> posts;
+  unsigned long start = millis();
+  while (ota.pendingWeatherData() > 0 && millis() - start < TEST_TIMEOUT_MS) {
+    ota.loop();
+    if (posts.empty() || host::lastPost() != posts.back()) {
+      if (!host::lastPost().empty()) posts.push_back(host::lastPost());
+    }
+    delay(1);
+  }
+  host::reboot();
+
+  ASSERT_EQ(0u, ota.pendingWeatherData());
+  ASSERT_EQ(2u, posts.size());
+  EXPECT_NE(std::string::npos, posts[0].find("\"readings\":[{\"temperature\":10.0,"));
+  EXPECT_NE(std::string::npos, posts[1].find("\"readings\":[{\"temperature\":" +
+                                             std::to_string(10 + OFFLINE_DRAIN_BATCH) + ".0,"));
+  size_t entries = 0;
+  for (size_t pos = 0; (pos = posts[1].find("\"temperature\"", pos)) != std::string::npos; pos++) entries++;
+  EXPECT_EQ(3u, entries);
+}
+
+}  // namespace
@@ -0,0 +1,118 @@
+// EspOta/OtaDelta: parches armados a mano sobre una imagen base en memoria, con foco en el
+// tope de OTA_DELTA_MAX_COPY que también respeta tools/ota_delta.
+
+#include "OtaDelta.h"
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Target {
+  std::vector<uint8_t> base;
+  std::vector<uint8_t> out;
+};
+
+bool readBase(void* ctx, uint32_t offset, uint8_t* buf, size_t len) {
+  Target* t = (Target*)ctx;
+  if (offset + len > t->base.size()) return false;
+  memcpy(buf, t->base.data() + offset, len);
+  return true;
+}
+
+bool collect(void* ctx, const uint8_t* data, size_t len) {
+  Target* t = (Target*)ctx;
+  t->out.insert(t->out.end(), data, data + len);
+  return true;
+}
+
+void putLE32(std::vector<uint8_t>& v, uint32_t x) {
+  for (int i = 0; i < 4; i++) v.push_back((uint8_t)(x >> (8 * i)));
+}
+
+std::vector<uint8_t> header(const char* version, uint32_t baseSize, uint32_t newSize) {
+  std::string magic = std::string("EDLT") + (char)OTA_DELTA_FORMAT + (char)strlen(version) + version;
+  std::vector<uint8_t> p(magic.begin(), magic.end());
+  putLE32(p, baseSize);
+  putLE32(p, newSize);
+  return p;
+}
+
+void copy(std::vector<uint8_t>& p, uint32_t offset, uint32_t len) {
+  p.push_back(OTA_DELTA_OP_COPY);
+  putLE32(p, offset);
+  putLE32(p, len);
+}
+
+void insert(std::vector<uint8_t>& p, const std::string& bytes) {
+  p.push_back(OTA_DELTA_OP_INSERT);
+  putLE32(p, (uint32_t)bytes.size());
+  p.insert(p.end(), bytes.begin(), bytes.end());
+}
+
+class OtaDeltaTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    for (size_t i = 0; i < 3 * OTA_DELTA_MAX_COPY; i++) target.base.push_back((uint8_t)(i * 7));
+  }
+
+  bool apply(const std::vector<uint8_t>& patch, size_t chunk) {
+    delta.begin("1.0.0", (uint32_t)target.base.size(), readBase, collect, &target);
+    for (size_t i = 0; i < patch.size(); i += chunk) {
+      if (!delta.write(patch.data() + i, std::min(chunk, patch.size() - i))) return false;
+    }
+    return delta.finish();
+  }
+
+  Target target;
+  OtaDelta delta;
+};
+
+TEST_F(OtaDeltaTest, RebuildsFromCopiesAndInserts) {
+  std::vector<uint8_t> patch = header("1.0.0", (uint32_t)target.base.size(), OTA_DELTA_MAX_COPY + 100 + 5);
+  copy(patch, 100, OTA_DELTA_MAX_COPY);
+  insert(patch, "hola!");
+  copy(patch, 0, 100);
+  patch.push_back(OTA_DELTA_OP_END);
+
+  for (size_t chunk : { (size_t)1, (size_t)5, (size_t)4096 }) {
+    target.out.clear();
+    ASSERT_TRUE(apply(patch, chunk)) << delta.error();
+    std::vector<uint8_t> expected(target.base.begin() + 100, target.base.begin() + 100 + OTA_DELTA_MAX_COPY);
+    expected.insert(expected.end(), { 'h', 'o', 'l', 'a', '!' });
+    expected.insert(expected.end(), target.base.begin(), target.base.begin() + 100);
+    EXPECT_EQ(expected, target.out);
+  }
+}
+
+TEST_F(OtaDeltaTest, RejectsCopyLongerThanFormatLimit) {
+  std::vector<uint8_t> patch = header("1.0.0", (uint32_t)target.base.size(), OTA_DELTA_MAX_COPY + 1);
+  copy(patch, 0, OTA_DELTA_MAX_COPY + 1);
+  patch.push_back(OTA_DELTA_OP_END);
+
+  EXPECT_FALSE(apply(patch, 64));
+  EXPECT_STREQ("COPY más larga que el máximo del formato", delta.error());
+  EXPECT_TRUE(target.out.empty());  // falla antes de leer la base
+}
+
+TEST_F(OtaDeltaTest, RejectsCopyOutsideBase) {
+  std::vector<uint8_t> patch = header("1.0.0", (uint32_t)target.base.size(), 16);
+  copy(patch, (uint32_t)target.base.size() - 8, 16);
+  patch.push_back(OTA_DELTA_OP_END);
+
+  EXPECT_FALSE(apply(patch, 64));
+  EXPECT_STREQ("COPY fuera de la imagen base", delta.error());
+}
+
+TEST_F(OtaDeltaTest, RejectsPatchForOtherBase) {
+  std::vector<uint8_t> patch = header("0.9.0", (uint32_t)target.base.size(), 5);
+  insert(patch, "hola!");
+  patch.push_back(OTA_DELTA_OP_END);
+
+  EXPECT_FALSE(apply(patch, 64));
+  EXPECT_STREQ("el parche fue generado para otra versión base", delta.error());
+}
+
+}  // namespace
@@ -0,0 +1,267 @@
+// Ida y vuelta de EspOta/OtaInflate: imágenes planas, gzip y heatshrink generadas con
+// tools/OtaPack.h (lo mismo que ota_pack) y entregadas en bloques de tamaños impares, como
+// llegan de la red. Se compila dos veces: con la ventana gzip por defecto y con
+// OTA_GZ_WINDOW_BITS=12, donde una imagen comprimida con ventana mayor tiene que fallar.
+
+#include "OtaInflate.h"
+#include "OtaPack.h"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Imagen con la forma de un firmware: cabecera 0xE9, tramos de ruido, texto repetido, ceros
+// y copias de tramos anteriores a más de 4 KB (como funciones duplicadas)
+std::vector<uint8_t> makeImage(size_t size, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<uint8_t> image = { 0xE9, 0x05, 0x02, 0x20 };
+  static const char text[] = "Esp32OTA: descarga en curso, reintentando conexion MQTT... ";
+  while (image.size() < size) {
+    size_t len = 64 + rng() % 2048;
+    switch (rng() % 4) {
+      case 0:
+        for (size_t i = 0; i < len; i++) image.push_back((uint8_t)rng());
+        break;
+      case 1:
+        for (size_t i = 0; i < len; i++) image.push_back((uint8_t)text[i % (sizeof(text) - 1)]);
+        break;
+      case 2:
+        image.insert(image.end(), len / 4, 0);
+        break;
+      default:
+        if (image.size() > 12000) {
+          size_t from = image.size() - 5000 - rng() % 7000;
+          for (size_t i = 0; i < len; i++) image.push_back(image[from + i]);
+        }
+        break;
+    }
+  }
+  image.resize(size);
+  return image;
+}
+
+bool collect(void* ctx, const uint8_t* data, size_t len) {
+  std::vector<uint8_t>* out = (std::vector<uint8_t>*)ctx;
+  out->insert(out->end(), data, data + len);
+  return true;
+}
+
+struct Decoded {
+  bool ok;
+  std::string error;
+  std::vector<uint8_t> out;
+};
+
+// Entrega packed en bloques de los tamaños de chunks, en ciclo
+Decoded decode(OTAEncoding enc, const std::vector<uint8_t>& packed, const std::vector<size_t>& chunks) {
+  Decoded d;
+  OtaInflate inflate;
+  d.ok = inflate.begin(enc, collect, &d.out);
+  size_t pos = 0;
+  for (size_t n = 0; d.ok && pos < packed.size(); n++) {
+    size_t len = std::min(chunks[n % chunks.size()], packed.size() - pos);
+    d.ok = inflate.write(packed.data() + pos, len);
+    pos += len;
+  }
+  d.ok = d.ok && inflate.finish();
+  if (inflate.error()) d.error = inflate.error();
+  return d;
+}
+
+std::vector<uint8_t> gzipOf(const std::vector<uint8_t>& image, int windowBits, const char* name = nullptr) {
+  std::vector<uint8_t> out;
+  EXPECT_TRUE(otaPackGzip(image, windowBits, out, name));
+  return out;
+}
+
+std::vector<uint8_t> heatshrinkOf(const std::vector<uint8_t>& image, uint8_t window, uint8_t lookahead) {
+  std::vector<uint8_t> out;
+  EXPECT_TRUE(otaPackHeatshrink(image, window, lookahead, out));
+  return out;
+}
+
+struct Format {
+  const char* name;
+  OTAEncoding enc;
+  int window;     // bits de ventana (gzip o heatshrink)
+  int lookahead;  // solo heatshrink
+};
+
+struct Chunking {
+  const char* name;
+  std::vector<size_t> sizes;
+};
+
+void PrintTo(const Format& format, std::ostream* os) { *os << format.name; }
+void PrintTo(const Chunking& chunking, std::ostream* os) { *os << chunking.name; }
+
+const Format kFormats[] = {
+  { "plain", OTA_ENC_NONE, 0, 0 },
+  { "gzip9", OTA_ENC_GZIP, 9, 0 },
+  { "gzip12", OTA_ENC_GZIP, 12, 0 },
+  { "gzip15", OTA_ENC_GZIP, 15, 0 },
+  { "hs4_3", OTA_ENC_HEATSHRINK, 4, 3 },
+  { "hs8_4", OTA_ENC_HEATSHRINK, 8, 4 },
+  { "hs12_5", OTA_ENC_HEATSHRINK, 12, 5 },
+};
+
+const Chunking kChunkings[] = {
+  { "1", { 1 } },
+  { "7", { 7 } },
+  { "333", { 333 } },
+  { "1460", { 1460 } },
+  { "mixed", { 3, 1021, 17, 65536, 2, 4097 } },
+};
+
+class InflateRoundTrip : public ::testing::TestWithParam<std::tuple<Format, Chunking>> {};
+
+TEST_P(InflateRoundTrip, RebuildsImage) {
+  const Format& format = std::get<0>(GetParam());
+  const Chunking& chunking = std::get<1>(GetParam());
+  if (format.enc == OTA_ENC_GZIP && format.window > OTA_GZ_WINDOW_BITS) {
+    GTEST_SKIP() << "ventana mayor que OTA_GZ_WINDOW_BITS";
+  }
+  std::vector<uint8_t> image = makeImage(96 * 1024 + 17, 1);
+  std::vector<uint8_t> packed;
+  if (format.enc == OTA_ENC_NONE) packed = image;
+  else if (format.enc == OTA_ENC_GZIP) packed = gzipOf(image, format.window);
+  else packed = heatshrinkOf(image, (uint8_t)format.window, (uint8_t)format.lookahead);
+  if (format.enc != OTA_ENC_NONE && format.window >= 8) {  // con 16 bytes de ventana no hay ganancia
+    EXPECT_LT(packed.size(), image.size());
+  }
+
+  ASSERT_EQ(format.enc, OtaInflate::detect("", packed[0]));
+  Decoded d = decode(format.enc, packed, chunking.sizes);
+  ASSERT_TRUE(d.ok) << d.error;
+  EXPECT_EQ(image, d.out);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Formats, InflateRoundTrip,
+    ::testing::Combine(::testing::ValuesIn(kFormats), ::testing::ValuesIn(kChunkings)),
+    [](const ::testing::TestParamInfo<InflateRoundTrip::ParamType>& info) {
+      return std::string(std::get<0>(info.param).name) + "_" + std::get<1>(info.param).name;
+    });
+
+TEST(OtaInflate, DetectsByContentEncodingFirst) {
+  EXPECT_EQ(OTA_ENC_GZIP, OtaInflate::detect("gzip", 0xE9));
+  EXPECT_EQ(OTA_ENC_GZIP, OtaInflate::detect("x-gzip", 0xE9));
+  EXPECT_EQ(OTA_ENC_HEATSHRINK, OtaInflate::detect("heatshrink", 0xE9));
+  EXPECT_EQ(OTA_ENC_NONE, OtaInflate::detect("", 'E'));  // parche delta
+  EXPECT_EQ(OTA_ENC_UNKNOWN, OtaInflate::detect("", 0x00));
+}
+
+TEST(OtaInflate, GzipParsesAllOptionalHeaderFields) {
+  std::vector<uint8_t> image = makeImage(20000, 2);
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  ASSERT_EQ(Z_OK, deflateInit2(&zs, 9, Z_DEFLATED, 16 + 12, 9, Z_DEFAULT_STRATEGY));
+  static Bytef extra[] = { 'A', 'P', 4, 0, 1, 2, 3, 4 };
+  static Bytef name[] = "firmware.bin";
+  static Bytef comment[] = "build 1.2.3";
+  gz_header header;
+  memset(&header, 0, sizeof(header));
+  header.extra = extra;
+  header.extra_len = sizeof(extra);
+  header.name = name;
+  header.comment = comment;
+  header.hcrc = 1;
+  ASSERT_EQ(Z_OK, deflateSetHeader(&zs, &header));
+  std::vector<uint8_t> packed(deflateBound(&zs, image.size()) + 128);
+  zs.next_in = image.data();
+  zs.avail_in = image.size();
+  zs.next_out = packed.data();
+  zs.avail_out = packed.size();
+  ASSERT_EQ(Z_STREAM_END, deflate(&zs, Z_FINISH));
+  packed.resize(zs.total_out);
+  deflateEnd(&zs);
+
+  Decoded d = decode(OTA_ENC_GZIP, packed, { 1 });
+  ASSERT_TRUE(d.ok) << d.error;
+  EXPECT_EQ(image, d.out);
+}
+
+TEST(OtaInflate, GzipRejectsBadCrc) {
+  std::vector<uint8_t> packed = gzipOf(makeImage(30000, 3), 12);
+  packed[packed.size() - 8] ^= 0x01;  // primer byte del CRC32
+  Decoded d = decode(OTA_ENC_GZIP, packed, { 1460 });
+  EXPECT_FALSE(d.ok);
+  EXPECT_EQ("CRC32 de gzip no coincide", d.error);
+}
+
+TEST(OtaInflate, GzipRejectsTruncatedStream) {
+  std::vector<uint8_t> packed = gzipOf(makeImage(30000, 4), 12);
+  packed.resize(packed.size() - 5);
+  Decoded d = decode(OTA_ENC_GZIP, packed, { 333 });
+  EXPECT_FALSE(d.ok);
+  EXPECT_EQ("flujo gzip truncado", d.error);
+}
+
+TEST(OtaInflate, GzipRejectsTrailingData) {
+  std::vector<uint8_t> packed = gzipOf(makeImage(30000, 5), 12);
+  packed.push_back(0);
+  Decoded d = decode(OTA_ENC_GZIP, packed, { 7 });
+  EXPECT_FALSE(d.ok);
+  EXPECT_EQ("datos extra tras el trailer gzip", d.error);
+}
+
+TEST(OtaInflate, GzipRejectsCorruptDeflate) {
+  std::vector<uint8_t> packed = gzipOf(makeImage(30000, 6), 12);
+  for (size_t i = 20; i < 60; i++) packed[i] = 0xFF;
+  Decoded d = decode(OTA_ENC_GZIP, packed, { 1460 });
+  EXPECT_FALSE(d.ok);
+}
+
+#if OTA_GZ_WINDOW_BITS < 15
+// Con la ventana recortada, una imagen con referencias más lejanas no puede terminar bien
+TEST(OtaInflate, GzipRejectsWindowLargerThanConfigured) {
+  std::vector<uint8_t> image = makeImage(96 * 1024, 7);
+  Decoded d = decode(OTA_ENC_GZIP, gzipOf(image, 15), { 1460 });
+  EXPECT_FALSE(d.ok);
+  EXPECT_NE(image, d.out);
+}
+#endif
+
+TEST(OtaInflate, HeatshrinkRejectsTruncatedStream) {
+  std::vector<uint8_t> packed = heatshrinkOf(makeImage(30000, 8), 10, 4);
+  packed.resize(packed.size() - 10);
+  Decoded d = decode(OTA_ENC_HEATSHRINK, packed, { 333 });
+  EXPECT_FALSE(d.ok);
+  EXPECT_EQ("imagen heatshrink truncada", d.error);
+}
+
+TEST(OtaInflate, HeatshrinkRejectsTruncatedHeader) {
+  std::vector<uint8_t> packed = { 'H', 'S', 10, 4 };
+  Decoded d = decode(OTA_ENC_HEATSHRINK, packed, { 1 });
+  EXPECT_FALSE(d.ok);
+  EXPECT_EQ("cabecera heatshrink incompleta", d.error);
+}
+
+TEST(OtaInflate, HeatshrinkRejectsWindowAboveLimit) {
+  std::vector<uint8_t> image = makeImage(30000, 9);
+  std::vector<uint8_t> packed = heatshrinkOf(image, OTA_HS_MAX_WINDOW_SZ2 + 1, 5);
+  Decoded d = decode(OTA_ENC_HEATSHRINK, packed, { 1460 });
+  EXPECT_FALSE(d.ok);
+  EXPECT_EQ("parámetros heatshrink no soportados", d.error);
+}
+
+TEST(OtaInflate, HeatshrinkRejectsTrailingData) {
+  std::vector<uint8_t> packed = heatshrinkOf(makeImage(30000, 10), 10, 4);
+  packed.push_back(0);
+  Decoded d = decode(OTA_ENC_HEATSHRINK, packed, { 7 });
+  EXPECT_FALSE(d.ok);
+  EXPECT_EQ("datos extra tras la imagen heatshrink", d.error);
+}
+
+TEST(OtaInflate, HeatshrinkStopsAtAnnouncedSize) {
+  std::vector<uint8_t> packed = heatshrinkOf(makeImage(30000, 11), 10, 4);
+  packed[5] = 0x50;  // anuncia 0x5030 bytes en lugar de 30000 (0x7530)
+  Decoded d = decode(OTA_ENC_HEATSHRINK, packed, { 1460 });
+  EXPECT_FALSE(d.ok);
+  EXPECT_LE(d.out.size(), 0x5030u);
+}
+
+}  // namespace
@@ -0,0 +1,105 @@
+// EspOta/Rollout: la cohorte sale solo de la MAC (misma MAC, misma cohorte) y una flota de
+// MACs consecutivas, como las de un lote de placas, se reparte parejo entre las 100 cohortes.
+
+#include "Rollout.h"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+namespace {
+
+#define FLEET_SIZE 20000
+
+// MAC n de un lote: OUI de Espressif y los tres bytes bajos consecutivos
+void fleetMac(uint32_t n, uint8_t mac[6]) {
+  const uint8_t base[6] = { 0x24, 0x0A, 0xC4, 0x10, 0x00, 0x00 };
+  uint32_t low = ((uint32_t)base[3] << 16) + n;
+  for (int i = 0; i < 3; i++) mac[i] = base[i];
+  mac[3] = (uint8_t)(low >> 16);
+  mac[4] = (uint8_t)(low >> 8);
+  mac[5] = (uint8_t)low;
+}
+
+// Chi-cuadrado de las cuentas por cohorte contra una distribución uniforme
+double chiSquare(const std::vector<uint32_t>& counts, uint32_t total) {
+  double expected = (double)total / counts.size();
+  double chi = 0;
+  for (uint32_t c : counts) chi += (c - expected) * (c - expected) / expected;
+  return chi;
+}
+
+TEST(RolloutTest, SameMacSameCohort) {
+  std::mt19937 rng(42);
+  for (uint32_t n = 0; n < 1000; n++) {
+    uint8_t mac[6];
+    fleetMac(n * 37, mac);
+    uint8_t cohort = rolloutCohort(mac);
+    ASSERT_LT(cohort, 100);
+    // Ni el porcentaje, ni la ventana ni el azar del dispositivo cambian la cohorte
+    for (int i = 0; i < 4; i++) {
+      RolloutPlan plan = planRollout(mac, (uint8_t)(rng() % 101), rng() % 3600, rng());
+      ASSERT_EQ(cohort, plan.cohort) << "MAC " << n;
+    }
+  }
+
+  // Valores fijos: si la cohorte cambiara entre versiones del firmware, un despliegue a
+  // medias tomaría otros equipos después de actualizar
+  const uint8_t mac[6] = { 0x24, 0x0A, 0xC4, 0x01, 0x02, 0xFF };
+  const uint8_t zero[6] = { 0, 0, 0, 0, 0, 0 };
+  EXPECT_EQ(99, rolloutCohort(mac));
+  EXPECT_EQ(48, rolloutCohort(zero));
+}
+
+TEST(RolloutTest, ConsecutiveMacsSpreadEvenly) {
+  std::vector<uint32_t> counts(100, 0);
+  uint32_t neighbours = 0;  // MACs vecinas en la misma cohorte o la siguiente
+  uint8_t prev = 0;
+  for (uint32_t n = 0; n < FLEET_SIZE; n++) {
+    uint8_t mac[6];
+    fleetMac(n, mac);
+    uint8_t cohort = rolloutCohort(mac);
+    counts[cohort]++;
+    if (n > 0 && (cohort == prev || cohort == (prev + 1) % 100)) neighbours++;
+    prev = cohort;
+  }
+
+  // 99 grados de libertad: el percentil 99,9 es ~148
+  EXPECT_LT(chiSquare(counts, FLEET_SIZE), 148.0);
+  for (int c = 0; c < 100; c++) {
+    EXPECT_GT(counts[c], FLEET_SIZE / 100 * 7 / 10) << "cohorte " << c;
+    EXPECT_LT(counts[c], FLEET_SIZE / 100 * 13 / 10) << "cohorte " << c;
+  }
+  EXPECT_LT(neighbours, FLEET_SIZE * 4 / 100);  // ~2 % si no hay correlación
+}
+
+// Cada porcentaje toma esa fracción de la flota, y al subirlo se suman equipos sin sacar ninguno
+TEST(RolloutTest, PercentSelectsGrowingSubset) {
+  for (uint8_t pct : { 0, 1, 10, 50, 100 }) {
+    uint32_t selected = 0;
+    for (uint32_t n = 0; n < FLEET_SIZE; n++) {
+      uint8_t mac[6];
+      fleetMac(n, mac);
+      bool apply = planRollout(mac, pct, 0, 0).apply;
+      selected += apply;
+      if (pct < 100) {
+        ASSERT_TRUE(!apply || planRollout(mac, (uint8_t)(pct + 1), 0, 0).apply);
+      }
+    }
+    EXPECT_NEAR((double)pct / 100, (double)selected / FLEET_SIZE, 0.01) << "pct=" << (int)pct;
+  }
+}
+
+TEST(RolloutTest, DelayStaysInsideWindow) {
+  uint8_t mac[6];
+  fleetMac(0, mac);
+  EXPECT_EQ(0u, planRollout(mac, 100, 0, 0xFFFFFFFFUL).delayMs);
+  EXPECT_EQ(0u, planRollout(mac, 100, 600, 0).delayMs);
+  EXPECT_EQ(299999u, planRollout(mac, 100, 600, 0x7FFFFFFFUL).delayMs);
+  EXPECT_LT(planRollout(mac, 100, 600, 0xFFFFFFFFUL).delayMs, 600000u);
+  EXPECT_LT(planRollout(mac, 100, 10 * ROLLOUT_MAX_WINDOW, 0xFFFFFFFFUL).delayMs,
+            (uint32_t)ROLLOUT_MAX_WINDOW * 1000);
+  EXPECT_EQ(0u, planRollout(mac, 0, 600, 0xFFFFFFFFUL).delayMs);  // fuera de la cohorte no espera
+}
+
+}  // namespace
@@ -0,0 +1,154 @@
+// EspOta/SpscRing: un hilo productor y uno consumidor con mensajes de largo variable, en un
+// buffer chico para que la marca de salto al principio aparezca miles de veces. El largo y el
+// contenido de cada mensaje salen de su número de secuencia, así el consumidor verifica el
+// orden y los bytes sin que el mensaje los lleve.
+
+#include "SpscRing.h"
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Largo del mensaje seq entre 0 y max (xorshift del número de secuencia)
+size_t lengthOf(uint32_t seq, size_t max) {
+  uint32_t x = seq * 2654435761UL + 1;
+  x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+  return x % (max + 1);
+}
+
+uint8_t byteOf(uint32_t seq, size_t i) {
+  return (uint8_t)(seq * 31 + i * 7 + (seq >> 8));
+}
+
+class SpscRingTest : public ::testing::Test {
+protected:
+  void start(size_t capacity) {
+    storage.assign(capacity / 4, 0);
+    ASSERT_TRUE(ring.begin((uint8_t*)storage.data(), capacity));
+  }
+
+  bool pushSeq(uint32_t seq, size_t len) {
+    std::vector<uint8_t> msg(len);
+    for (size_t i = 0; i < len; i++) msg[i] = byteOf(seq, i);
+    return ring.push(msg.data(), len);
+  }
+
+  // Saca un mensaje y lo compara con el esperado para seq
+  bool popSeq(uint32_t seq, size_t expectedLen) {
+    size_t len;
+    const uint8_t* p = ring.peek(len);
+    if (!p || len != expectedLen) return false;
+    for (size_t i = 0; i < len; i++) {
+      if (p[i] != byteOf(seq, i)) return false;
+    }
+    ring.release();
+    return true;
+  }
+
+  std::vector<uint32_t> storage;  // alineado a 4
+  SpscRing ring;
+};
+
+TEST_F(SpscRingTest, RejectsBadBuffers) {
+  uint32_t buf[16];
+  EXPECT_FALSE(ring.begin(nullptr, 64));
+  EXPECT_FALSE(ring.begin((uint8_t*)buf, 8));
+  EXPECT_FALSE(ring.begin((uint8_t*)buf, 48));
+  EXPECT_TRUE(ring.begin((uint8_t*)buf, 64));
+  EXPECT_EQ(28u, ring.maxMessage());
+  EXPECT_EQ(nullptr, ring.reserve(29));
+  EXPECT_EQ(1u, ring.dropped());
+}
+
+// Un mensaje que no entra antes del final deja la marca de salto y sigue desde el principio
+TEST_F(SpscRingTest, WrapsWithSkipMarker) {
+  start(64);
+  ASSERT_TRUE(pushSeq(0, 20));  // 24 bytes
+  ASSERT_TRUE(pushSeq(1, 20));  // 48
+  ASSERT_TRUE(popSeq(0, 20));
+  ASSERT_TRUE(pushSeq(2, 20));  // no entra en los 16 finales: salto + 24 desde 0
+  EXPECT_EQ(64u, ring.used());   // 24 + 16 del salto + 24
+  EXPECT_FALSE(pushSeq(3, 20));  // lleno hasta el mensaje 1
+  EXPECT_EQ(1u, ring.dropped());
+  ASSERT_TRUE(popSeq(1, 20));
+  ASSERT_TRUE(popSeq(2, 20));  // salta la marca
+  EXPECT_TRUE(ring.empty());
+  EXPECT_EQ(64u, ring.highWater());
+}
+
+// tryReserve() con la cola llena no cuenta descarte: el productor reintenta cuando hay lugar
+TEST_F(SpscRingTest, TryReserveDoesNotCountDrops) {
+  start(64);
+  ASSERT_TRUE(pushSeq(0, 28));
+  ASSERT_TRUE(pushSeq(1, 28));
+  EXPECT_EQ(nullptr, ring.tryReserve(4));
+  EXPECT_EQ(0u, ring.dropped());
+  ASSERT_TRUE(popSeq(0, 28));
+  uint8_t* p = ring.tryReserve(4);
+  ASSERT_NE(nullptr, p);
+  memcpy(p, "abcd", 4);
+  ring.commit(4);
+  ASSERT_TRUE(popSeq(1, 28));
+  size_t len = 0;
+  const uint8_t* q = ring.peek(len);
+  ASSERT_NE(nullptr, q);
+  ASSERT_EQ(4u, len);
+  EXPECT_EQ(0, memcmp(q, "abcd", 4));
+  EXPECT_EQ(0u, ring.dropped());
+}
+
+// commit() con menos bytes que los reservados publica solo esos
+TEST_F(SpscRingTest, CommitsShorterThanReserved) {
+  start(64);
+  uint8_t* p = ring.reserve(28);
+  ASSERT_NE(nullptr, p);
+  for (size_t i = 0; i < 5; i++) p[i] = byteOf(9, i);
+  ring.commit(5);
+  EXPECT_EQ(12u, ring.used());
+  ASSERT_TRUE(popSeq(9, 5));
+  EXPECT_TRUE(ring.empty());
+}
+
+TEST_F(SpscRingTest, TwoThreadsKeepOrderAcrossWraps) {
+  start(256);
+  const uint32_t total = 200000;
+  const size_t maxLen = ring.maxMessage();
+
+  std::thread producer([&] {
+    for (uint32_t seq = 0; seq < total; seq++) {
+      size_t len = lengthOf(seq, maxLen);
+      // A veces se reserva de más y se publica menos, como cuando se serializa en el lugar
+      size_t extra = seq % 3 == 0 ? std::min((size_t)8, maxLen - len) : 0;
+      uint8_t* p;
+      while (!(p = ring.reserve(len + extra))) std::this_thread::yield();
+      for (size_t i = 0; i < len; i++) p[i] = byteOf(seq, i);
+      ring.commit(len);
+    }
+  });
+
+  uint32_t seq = 0;
+  uint32_t bad = 0;
+  uint32_t firstBad = 0;
+  while (seq < total) {
+    size_t len;
+    const uint8_t* p = ring.peek(len);
+    if (!p) {
+      std::this_thread::yield();
+      continue;
+    }
+    bool ok = len == lengthOf(seq, maxLen);
+    for (size_t i = 0; ok && i < len; i++) ok = p[i] == byteOf(seq, i);
+    if (!ok && bad++ == 0) firstBad = seq;
+    ring.release();
+    seq++;
+  }
+  producer.join();
+
+  EXPECT_EQ(0u, bad) << "primer mensaje distinto: " << firstBad;
+  EXPECT_TRUE(ring.empty());
+  EXPECT_LE(ring.highWater(), ring.capacity());
+}
+
+}  // namespace
@@ -0,0 +1,100 @@
+// EspOta/WiFiFastConnect contra HostSim: la IP de RTC se reutiliza como fija solo en la
+// primera unión tras un reinicio y solo si la dio DHCP; al perder el enlace se vuelve a DHCP
+// y una IP reutilizada no se guarda como concesión nueva. host::wifiStaticIp() muestra lo
+// que quedó en WiFi.config().
+
+#include "Esp32OTA.h"
+#include "HostSim.h"
+
+#include <functional>
+#include <gtest/gtest.h>
+#include <memory>
+
+namespace {
+
+#define TEST_TIMEOUT_MS 10000
+
+const char* g_ssids[] = { "fast-ap" };
+const char* g_passwords[] = { "fast-pass" };
+
+class WiFiFastConnectTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    static uint8_t next = 1;
+    uint8_t mac[6] = { 0x24, 0x6F, 0x28, 0x0D, 0x00, next++ };
+    host::selectDevice(host::createDevice(mac));
+    static const bool apReady = (host::addAccessPoint(g_ssids[0], -50, 11), true);
+    (void)apReady;
+    dhcpLease = (uint32_t)IPAddress(192, 168, 1, 50);
+  }
+
+  void TearDown() override {
+    host::reboot();
+    ota.reset();
+    host::selectDevice(nullptr);
+  }
+
+  // Arranque limpio de la biblioteca tras host::reboot(); espera a tener IP
+  bool boot() {
+    if (ota) {
+      host::reboot();
+      ota.reset();
+    }
+    ota.reset(new Esp32OTA("broker.local", 8883, "user", "pass", "fast", "v-fast"));
+    ota->setWiFiNetworks(g_ssids, g_passwords, 1);
+    ota->begin();
+    return online();
+  }
+
+  bool online() {
+    unsigned long start = millis();
+    while (ota->getConnState() < CONN_IP || WiFi.status() != WL_CONNECTED) {
+      if (millis() - start > TEST_TIMEOUT_MS) return false;
+      ota->loop();
+      delay(1);
+    }
+    return true;
+  }
+
+  // Unión con DHCP en este arranque: la concesión queda en RTC
+  bool freshLease() {
+    host::dropWiFi();
+    return online() && host::wifiStaticIp() == 0;
+  }
+
+  std::unique_ptr<Esp32OTA> ota;
+  uint32_t dhcpLease;
+};
+
+TEST_F(WiFiFastConnectTest, ReusesDhcpLeaseOnceAfterReset) {
+  ASSERT_TRUE(boot());
+  ASSERT_TRUE(freshLease());
+
+  ASSERT_TRUE(boot());
+  EXPECT_TRUE(ota->getWiFiStats().lastWasFast);
+  EXPECT_EQ(dhcpLease, host::wifiStaticIp());
+
+  // La IP reutilizada no se guardó como concesión: el arranque siguiente pide DHCP
+  ASSERT_TRUE(boot());
+  EXPECT_TRUE(ota->getWiFiStats().lastWasFast);
+  EXPECT_EQ(0u, host::wifiStaticIp());
+}
+
+TEST_F(WiFiFastConnectTest, DisconnectGoesBackToDhcp) {
+  ASSERT_TRUE(boot());
+  ASSERT_TRUE(freshLease());
+  ASSERT_TRUE(boot());
+  ASSERT_EQ(dhcpLease, host::wifiStaticIp());
+
+  // En el mismo arranque la concesión no se vuelve a ofrecer
+  host::dropWiFi();
+  ASSERT_TRUE(online());
+  EXPECT_EQ(0u, host::wifiStaticIp());
+  EXPECT_TRUE(ota->getWiFiStats().lastWasFast);
+
+  // Esa unión sí fue con DHCP: el próximo reinicio puede reutilizarla
+  ASSERT_TRUE(boot());
+  EXPECT_EQ(dhcpLease, host::wifiStaticIp());
+}
+
+}  // namespace
@@ -0,0 +1,122 @@
+// EspOta/WiFiRanking: escaneos sintéticos contra una lista configurada, sin radio ni Arduino.
+
+#include "WiFiRanking.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Scan {
+  const char* ssid;
+  int32_t rssi;
+  uint8_t last;   // último byte del BSSID
+  int32_t channel;
+};
+
+class WiFiRankingTest : public ::testing::Test {
+protected:
+  void configure(const char* ssid, uint16_t attempts = 0, uint16_t successes = 0) {
+    WiFiNetStats stats = { attempts, successes };
+    ASSERT_TRUE(ranker.addNetwork(ssid, stats));
+  }
+
+  void scan(const std::vector<Scan>& results) {
+    for (const Scan& r : results) {
+      uint8_t bssid[6] = { 0x24, 0x6F, 0x28, 0xAA, 0x00, r.last };
+      ranker.addScanResult(r.ssid, r.rssi, bssid, r.channel);
+    }
+  }
+
+  // Índices configurados en el orden en que se intentarían
+  std::vector<size_t> order() {
+    count = ranker.rank(out, WIFI_MAX_NETWORKS);
+    std::vector<size_t> v;
+    for (size_t i = 0; i < count; i++) v.push_back(out[i].index);
+    return v;
+  }
+
+  WiFiRanker ranker;
+  WiFiCandidate out[WIFI_MAX_NETWORKS];
+  size_t count = 0;
+};
+
+TEST_F(WiFiRankingTest, OnlyReachableNetworksByRssi) {
+  configure("casa");
+  configure("oficina");
+  configure("taller");
+  scan({ { "vecino", -30, 1, 1 }, { "taller", -55, 2, 6 }, { "casa", -70, 3, 11 } });
+
+  EXPECT_EQ((std::vector<size_t>{ 2, 0 }), order());
+  EXPECT_EQ(-55, out[0].rssi);
+  EXPECT_EQ(6, out[0].channel);
+  EXPECT_EQ(2, out[0].bssid[5]);
+}
+
+// Con varios AP del mismo SSID se une al más fuerte, con su BSSID y canal
+TEST_F(WiFiRankingTest, KeepsStrongestAccessPoint) {
+  configure("casa");
+  scan({ { "casa", -80, 1, 1 }, { "casa", -50, 2, 6 }, { "casa", -65, 3, 11 } });
+
+  ASSERT_EQ((std::vector<size_t>{ 0 }), order());
+  EXPECT_EQ(-50, out[0].rssi);
+  EXPECT_EQ(2, out[0].bssid[5]);
+  EXPECT_EQ(6, out[0].channel);
+}
+
+// El historial compensa hasta WIFI_RANK_HISTORY_WEIGHT dBm de señal, no más
+TEST_F(WiFiRankingTest, HistoryOutweighsSmallRssiGap) {
+  configure("fuerte-que-falla", 40, 0);
+  configure("debil-que-conecta", 40, 40);
+  configure("lejana-que-conecta", 40, 40);
+  scan({ { "fuerte-que-falla", -50, 1, 1 },
+         { "debil-que-conecta", -50 - (WIFI_RANK_HISTORY_WEIGHT - 5), 2, 6 },
+         { "lejana-que-conecta", -50 - (WIFI_RANK_HISTORY_WEIGHT + 5), 3, 11 } });
+
+  EXPECT_EQ((std::vector<size_t>{ 1, 0, 2 }), order());
+}
+
+// A igual puntaje gana el orden de configuración, sin importar el orden del escaneo
+TEST_F(WiFiRankingTest, TiesKeepConfiguredPriority) {
+  configure("primera");
+  configure("segunda");
+  configure("tercera");
+  scan({ { "tercera", -60, 3, 1 }, { "segunda", -60, 2, 1 }, { "primera", -60, 1, 1 } });
+
+  EXPECT_EQ((std::vector<size_t>{ 0, 1, 2 }), order());
+}
+
+TEST_F(WiFiRankingTest, EmptyScanAndCapacity) {
+  configure("casa");
+  EXPECT_TRUE(order().empty());
+
+  WiFiRanker full;
+  WiFiNetStats none = { 0, 0 };
+  std::vector<std::string> names;
+  for (size_t i = 0; i <= WIFI_MAX_NETWORKS; i++) names.push_back("red-" + std::to_string(i));
+  for (size_t i = 0; i < WIFI_MAX_NETWORKS; i++) EXPECT_TRUE(full.addNetwork(names[i].c_str(), none));
+  EXPECT_FALSE(full.addNetwork(names[WIFI_MAX_NETWORKS].c_str(), none));
+  EXPECT_FALSE(full.addNetwork(nullptr, none));
+}
+
+TEST_F(WiFiRankingTest, ScoreUsesSmoothedSuccessRate) {
+  WiFiNetStats fresh = { 0, 0 };
+  WiFiNetStats perfect = { 98, 98 };
+  EXPECT_EQ(-6000 + WIFI_RANK_HISTORY_WEIGHT * 50, WiFiRanker::score(-60, fresh));
+  EXPECT_EQ(-6000 + WIFI_RANK_HISTORY_WEIGHT * 99, WiFiRanker::score(-60, perfect));
+}
+
+// Pasados los 1000 intentos el historial se reduce a la mitad y conserva la tasa
+TEST_F(WiFiRankingTest, RecordHalvesLongHistory) {
+  WiFiNetStats stats = { 0, 0 };
+  for (int i = 0; i < 1000; i++) WiFiRanker::record(stats, i % 4 != 0);
+  EXPECT_EQ(1000, stats.attempts);
+  EXPECT_EQ(750, stats.successes);
+
+  WiFiRanker::record(stats, false);
+  EXPECT_EQ(501, stats.attempts);
+  EXPECT_EQ(375, stats.successes);
+}
+
+}  // namespace
@@ -4,18 +4,38 @@ import { prisma } from "@/lib/prisma";
 // Endpoint para recibir datos de los ESP32
 export async function POST(request) {
   try {
-    const data = await request.json();
+    const data = (await request.json()) ?? {};
     // const { mac, name, temperature, humidity, lat, lon } = data
-    const { mac, name, temperature, humidity } = data;
+    const { mac, name, temperature, humidity, age } = data;
+
+    // Una lectura suelta, o varias en "readings" (cola offline del ESP32).
+    // "age" son los ms transcurridos desde la lectura hasta el envío.
+    const readings = Array.isArray(data.readings)
+      ? data.readings
+      : [{ temperature, humidity, age }];
 
     // Validar datos requeridos
-    if (!mac || temperature === undefined || humidity === undefined) {
+    if (
+      !mac ||
+      readings.length === 0 ||
+      readings.some(
+        (r) => !r || typeof r !== "object" || r.temperature === undefined || r.humidity === undefined
+      )
+    ) {
       return NextResponse.json(
         { error: "Faltan datos requeridos (mac, temperature, humidity)" },
         { status: 400 }
       );
     }
 
+    // temperature y humidity deben ser números (Prisma rechazaría el lote entero)
+    if (readings.some((r) => !Number.isFinite(r.temperature) || !Number.isFinite(r.humidity))) {
+      return NextResponse.json(
+        { error: "temperature y humidity deben ser numéricos" },
+        { status: 400 }
+      );
+    }
+
     // Buscar o crear estación
     let station = await prisma.station.findUnique({ where: { mac } });
 
@@ -43,13 +63,15 @@ export async function POST(request) {
       });
     }
 
-    // Crear nueva lectura
-    await prisma.reading.create({
-      data: {
+    // Crear las lecturas (fechadas según su antigüedad si viene informada)
+    const receivedAt = Date.now();
+    await prisma.reading.createMany({
+      data: readings.map((r) => ({
         stationId: station.id,
-        temperature,
-        humidity,
-      },
+        temperature: r.temperature,
+        humidity: r.humidity,
+        ...(Number.isFinite(r.age) && r.age >= 0 && { timestamp: new Date(receivedAt - r.age) }),
+      })),
     });
 
     return NextResponse.json(
@@ -0,0 +1,128 @@
+// Decodificador CBOR (RFC 8949) mínimo para las tramas binarias de los ESP32.
+// Soporta enteros, bytes, texto, arrays, mapas, simples y floats de 16/32/64 bits;
+// no admite largos indefinidos ni etiquetas (el firmware no los genera).
+
+// Claves enteras de la trama de esp32/sensor/cbor (ver firmware/EspOta/Esp32OTA.h)
+const SENSOR_KEYS = {
+  MAC: 0,
+  TEMPERATURE: 1,
+  HUMIDITY: 2,
+};
+
+function decode(buffer) {
+  const buf = Buffer.isBuffer(buffer) ? buffer : Buffer.from(buffer);
+  let pos = 0;
+
+  const need = (n) => {
+    if (pos + n > buf.length) throw new Error('CBOR: trama truncada');
+  };
+
+  const readArg = (info) => {
+    if (info < 24) return info;
+    if (info === 24) { need(1); return buf.readUInt8(pos++); }
+    if (info === 25) { need(2); const v = buf.readUInt16BE(pos); pos += 2; return v; }
+    if (info === 26) { need(4); const v = buf.readUInt32BE(pos); pos += 4; return v; }
+    if (info === 27) {
+      need(8);
+      const v = buf.readBigUInt64BE(pos);
+      pos += 8;
+      if (v > BigInt(Number.MAX_SAFE_INTEGER)) throw new Error('CBOR: entero fuera de rango');
+      return Number(v);
+    }
+    throw new Error(`CBOR: largo no soportado (${info})`);
+  };
+
+  const readHalf = () => {
+    need(2);
+    const h = buf.readUInt16BE(pos);
+    pos += 2;
+    const exp = (h >> 10) & 0x1f;
+    const mant = h & 0x3ff;
+    const sign = h & 0x8000 ? -1 : 1;
+    if (exp === 0) return sign * mant * 2 ** -24;
+    if (exp === 31) return mant ? NaN : sign * Infinity;
+    return sign * (1 + mant / 1024) * 2 ** (exp - 15);
+  };
+
+  const readItem = () => {
+    need(1);
+    const initial = buf.readUInt8(pos++);
+    const major = initial >> 5;
+    const info = initial & 0x1f;
+
+    switch (major) {
+      case 0:
+        return readArg(info);
+      case 1:
+        return -1 - readArg(info);
+      case 2: {
+        const len = readArg(info);
+        need(len);
+        const bytes = buf.subarray(pos, pos + len);
+        pos += len;
+        return bytes;
+      }
+      case 3: {
+        const len = readArg(info);
+        need(len);
+        const text = buf.toString('utf8', pos, pos + len);
+        pos += len;
+        return text;
+      }
+      case 4: {
+        const len = readArg(info);
+        const items = [];
+        for (let i = 0; i < len; i++) items.push(readItem());
+        return items;
+      }
+      case 5: {
+        const len = readArg(info);
+        const map = new Map();
+        for (let i = 0; i < len; i++) {
+          const key = readItem();
+          map.set(key, readItem());
+        }
+        return map;
+      }
+      case 7:
+        if (info === 20) return false;
+        if (info === 21) return true;
+        if (info === 22 || info === 23) return null;
+        if (info === 25) return readHalf();
+        if (info === 26) { need(4); const v = buf.readFloatBE(pos); pos += 4; return v; }
+        if (info === 27) { need(8); const v = buf.readDoubleBE(pos); pos += 8; return v; }
+        throw new Error(`CBOR: simple no soportado (${info})`);
+      default:
+        throw new Error(`CBOR: tipo mayor no soportado (${major})`);
+    }
+  };
+
+  const value = readItem();
+  if (pos !== buf.length) throw new Error('CBOR: datos extra tras la trama');
+  return value;
+}
+
+// Redondea a 1 decimal, igual que la versión JSON del firmware (NaN -> null)
+function round1(value) {
+  return Number.isFinite(value) ? Math.round(value * 10) / 10 : null;
+}
+
+// Convierte una trama de esp32/sensor/cbor al mismo objeto que llega por esp32/sensor
+function decodeSensorFrame(buffer) {
+  const map = decode(buffer);
+  if (!(map instanceof Map)) throw new Error('CBOR: la trama de sensor no es un mapa');
+
+  const macBytes = map.get(SENSOR_KEYS.MAC);
+  if (!Buffer.isBuffer(macBytes) || macBytes.length !== 6) {
+    throw new Error('CBOR: MAC inválida en la trama de sensor');
+  }
+  const mac = Array.from(macBytes, (b) => b.toString(16).padStart(2, '0').toUpperCase()).join(':');
+
+  return {
+    mac,
+    temperature: round1(map.get(SENSOR_KEYS.TEMPERATURE)),
+    humidity: round1(map.get(SENSOR_KEYS.HUMIDITY)),
+  };
+}
+
+module.exports = { decode, decodeSensorFrame, SENSOR_KEYS };
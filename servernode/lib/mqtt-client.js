@@ -1,12 +1,42 @@
+const crypto = require('crypto');
 const mqtt = require('mqtt');
 const { prisma } = require('./prisma');
 const { emitDeviceUpdate, emitLogUpdate } = require('./socket-server');
+const { decodeSensorFrame } = require('./cbor');
+
+// Tópicos de comandos OTA (los mismos que firmware/EspOta/Esp32OTA.h)
+const UPDATE_TOPIC_LEGACY = 'esp32/update';
+const UPDATE_TOPIC_PREFIX = 'esp32/update/';
+const UPDATE_TOPIC_GROUP = 'esp32/update/group/';
+const UPDATE_TOPIC_ALL = 'esp32/update/all';
+// Valores del enum LogLevel (prisma/schema.prisma)
+const LOG_LEVELS = new Set(['DEBUG', 'INFO', 'WARNING', 'ERROR']);
+// Ritmo de ingesta para pruebas de carga (firmware/tools/fleet_sim.cpp)
+const INGEST_STATS_TOPIC = 'esp32/server/ingest';
+
+function newIngestWindow() {
+  return { received: 0, processed: 0, errors: 0, handleMs: [] };
+}
+
+// Entero de 32 bits de una instantánea de métricas, o null si no viene o no es válido
+function metricInt(value) {
+  return Number.isInteger(value) && Math.abs(value) <= 0x7fffffff ? value : null;
+}
+
+function percentile(sorted, q) {
+  if (sorted.length === 0) return 0;
+  const value = sorted[Math.min(sorted.length - 1, Math.floor(q * sorted.length))];
+  return Math.round(value * 100) / 100;
+}
 
 class MQTTManager {
   constructor() {
     this.client = null;
     this.reconnectAttempts = 0;
     this.maxReconnectAttempts = 10;
+    this.ingest = newIngestWindow();
+    this.ingestInFlight = 0;
+    this.ingestTimer = null;
   }
 
   // Función auxiliar para obtener la fecha actual en UTC
@@ -29,6 +59,7 @@ class MQTTManager {
         console.log('MQTT: Connected to broker');
         this.reconnectAttempts = 0;
         this.subscribeToTopics();
+        this.startIngestStats();
       });
 
       this.client.on('message', this.handleMessage.bind(this));
@@ -59,7 +90,9 @@ class MQTTManager {
       'esp32/heartbeat',
       'esp32/debug',
       'esp32/measurements',
-      'esp32/sensor'
+      'esp32/sensor',
+      'esp32/sensor/cbor',
+      'esp32/metrics'
     ];
     topics.forEach(topic => {
       this.client.subscribe(topic, (err) => {
@@ -72,29 +105,81 @@ class MQTTManager {
     });
   }
 
+  // Con MQTT_INGEST_STATS_MS > 0 se publica cada ese intervalo, en esp32/server/ingest, lo
+  // que se procesó en la ventana y cuánto tardó cada mensaje (de la llegada a la base)
+  startIngestStats() {
+    const intervalMs = parseInt(process.env.MQTT_INGEST_STATS_MS || '0', 10);
+    if (!(intervalMs > 0) || this.ingestTimer) return;
+    let windowStart = Date.now();
+    this.ingestTimer = setInterval(() => {
+      const now = Date.now();
+      const { received, processed, errors, handleMs } = this.ingest;
+      const sorted = handleMs.sort((a, b) => a - b);
+      const stats = {
+        windowMs: now - windowStart,
+        received,
+        processed,
+        errors,
+        inFlight: this.ingestInFlight,
+        p50Ms: percentile(sorted, 0.5),
+        p99Ms: percentile(sorted, 0.99),
+      };
+      this.ingest = newIngestWindow();
+      windowStart = now;
+      if (this.client && this.client.connected) {
+        this.client.publish(INGEST_STATS_TOPIC, JSON.stringify(stats), { qos: 0 });
+      }
+    }, intervalMs);
+  }
+
   async handleMessage(topic, message) {
+    const ingest = this.ingest;
+    const startedAt = process.hrtime.bigint();
+    ingest.received++;
+    this.ingestInFlight++;
     try {
-      const payload = JSON.parse(message.toString());
-      console.log(`MQTT: Received message on ${topic}:`, payload);
-      switch (topic) {
-        case 'esp32/status':
-          await this.handleStatusMessage(payload);
-          break;
-        case 'esp32/heartbeat':
-          await this.handleHeartbeatMessage(payload);
-          break;
-        case 'esp32/debug':
-          await this.handleDebugMessage(payload);
-          break;
-        case 'esp32/measurements':
-          await this.handleMeasurementMessage(payload);
-          break;
-        case 'esp32/sensor':
-          await this.handleSensorMessage(payload);
-          break;
-      }
+      await this.dispatchMessage(topic, message);
+      ingest.processed++;
     } catch (error) {
+      ingest.errors++;
       console.error(`MQTT: Error processing message from ${topic}:`, error);
+    } finally {
+      this.ingestInFlight--;
+      ingest.handleMs.push(Number(process.hrtime.bigint() - startedAt) / 1e6);
+    }
+  }
+
+  async dispatchMessage(topic, message) {
+    // Tópicos binarios: se decodifican antes de intentar parsear JSON
+    if (topic === 'esp32/sensor/cbor') {
+      const payload = decodeSensorFrame(message);
+      console.log(`MQTT: Received message on ${topic} (${message.length} bytes CBOR):`, payload);
+      await this.handleSensorMessage(payload);
+      return;
+    }
+
+    const payload = JSON.parse(message.toString());
+    console.log(`MQTT: Received message on ${topic}:`, payload);
+    switch (topic) {
+      case 'esp32/status':
+        if (payload.status === 'ota') await this.handleOtaReport(payload);
+        else await this.handleStatusMessage(payload);
+        break;
+      case 'esp32/heartbeat':
+        await this.handleHeartbeatMessage(payload);
+        break;
+      case 'esp32/debug':
+        await this.handleDebugMessage(payload);
+        break;
+      case 'esp32/measurements':
+        await this.handleMeasurementMessage(payload);
+        break;
+      case 'esp32/sensor':
+        await this.handleSensorMessage(payload);
+        break;
+      case 'esp32/metrics':
+        await this.handleMetricsMessage(payload);
+        break;
     }
   }
 
@@ -147,6 +232,24 @@ class MQTTManager {
     emitDeviceUpdate(device);
   }
 
+  // Resultado de una OTA: "skipped" (ya corría esa imagen), "updated" o "failed"
+  async handleOtaReport(payload) {
+    const { mac, result, version, target, reason } = payload;
+    const device = await prisma.device.findUnique({ where: { mac } });
+    if (!device) return;
+    const detail = [target && `target ${target}`, `running ${version}`, reason].filter(Boolean).join(', ');
+    await prisma.debugLog.create({
+      data: {
+        deviceId: device.id,
+        level: result === 'failed' ? 'ERROR' : 'INFO',
+        message: `OTA ${result} (${detail})`,
+      },
+    });
+    if (version && version !== device.version) {
+      emitDeviceUpdate(await prisma.device.update({ where: { mac }, data: { version } }));
+    }
+  }
+
   async handleHeartbeatMessage(payload) {
     const { mac, name } = payload;
     const now = this.getCurrentTime();
@@ -173,10 +276,13 @@ class MQTTManager {
     emitDeviceUpdate(device);
   }
 
+  // Una línea ({ mac, level, message }) o un lote del firmware ({ mac, entries: [...] }),
+  // donde cada entrada trae "age": ms desde que se registró hasta el envío
   async handleDebugMessage(payload) {
-    const { mac, level, message } = payload;
+    const { mac, level, message, entries } = payload;
     const device = await prisma.device.findUnique({ where: { mac } });
-    if (device) {
+    if (!device) return;
+    if (!Array.isArray(entries)) {
       await prisma.debugLog.create({
         data: {
           deviceId: device.id,
@@ -184,42 +290,183 @@ class MQTTManager {
           message,
         },
       });
+      return;
     }
+    const receivedAt = this.getCurrentTime().getTime();
+    const data = entries
+      .filter((entry) => entry && typeof entry.message === 'string')
+      .map((entry) => {
+        const log = {
+          deviceId: device.id,
+          level: LOG_LEVELS.has(entry.level) ? entry.level : 'INFO',
+          message: entry.message,
+        };
+        if (Number.isFinite(entry.age) && entry.age >= 0) {
+          log.timestamp = new Date(receivedAt - entry.age);
+        }
+        return log;
+      });
+    if (data.length > 0) await prisma.debugLog.createMany({ data });
   }
 
   async handleMeasurementMessage(payload) {
     const { mac, measurements } = payload;
     const device = await prisma.device.findUnique({ where: { mac } });
-    if (device && measurements) {
-      for (const measurement of measurements) {
-        await prisma.measurement.create({
-          data: {
+    if (device && Array.isArray(measurements) && measurements.length > 0) {
+      // Los lotes del firmware traen "age": ms transcurridos desde la lectura hasta el envío
+      const receivedAt = this.getCurrentTime().getTime();
+      await prisma.measurement.createMany({
+        data: measurements.map((measurement) => {
+          const data = {
             deviceId: device.id,
             type: measurement.type,
             value: measurement.value,
             unit: measurement.unit || null,
-          },
-        });
-      }
+          };
+          if (Number.isFinite(measurement.age) && measurement.age >= 0) {
+            data.timestamp = new Date(receivedAt - measurement.age);
+          }
+          return data;
+        }),
+      });
     }
   }
 
+  // Instantánea de métricas internas (firmware/EspOta/Metrics.h). Los valores que se consultan
+  // seguido van en columnas; la instantánea completa (cubetas incluidas) queda en snapshot.
+  async handleMetricsMessage(payload) {
+    const { mac, uptime, windowMs, counters = {}, gauges = {}, histograms = {} } = payload;
+    const device = await prisma.device.findUnique({ where: { mac } });
+    if (!device) return;
+    const loop = histograms.loopUs || {};
+    const pub = histograms.publishUs || {};
+    await prisma.deviceMetrics.create({
+      data: {
+        deviceId: device.id,
+        uptimeMs: BigInt(Number.isSafeInteger(uptime) && uptime >= 0 ? uptime : 0),
+        windowMs: metricInt(windowMs) ?? 0,
+        freeHeap: metricInt(gauges.freeHeap),
+        minFreeHeap: metricInt(gauges.minFreeHeap),
+        maxAllocHeap: metricInt(gauges.maxAllocHeap),
+        loopP50Us: metricInt(loop.p50),
+        loopP99Us: metricInt(loop.p99),
+        loopMaxUs: metricInt(loop.max),
+        publishP99Us: metricInt(pub.p99),
+        mqttLost: metricInt(counters.mqttLost),
+        wifiLost: metricInt(counters.wifiLost),
+        snapshot: { counters, gauges, histograms },
+      },
+    });
+  }
+
   calculateHealth(payload) {
     if (payload.battery && payload.battery < 20) return 'CRITICAL';
     if (payload.temperature && payload.temperature > 80) return 'WARNING';
     return 'HEALTHY';
   }
 
-  async publishOTAUpdate(deviceMac, firmwareUrl, version) {
+  // Comando OTA para un dispositivo (por MAC). Viaja solo por su tópico, así el resto de
+  // la flota no lo recibe. Con { legacy: true } se repite en el tópico compartido para
+  // equipos con firmware anterior (lo reciben todos, pero solo actúa el de esa MAC).
+  // Con { manifest } (ver firmwareManifest) el equipo solo descarga si no corre ya esa imagen.
+  async publishOTAUpdate(deviceMac, firmwareUrl, { legacy = false, manifest } = {}) {
+    if (!deviceMac) return this.publishBroadcastOTAUpdate(firmwareUrl, { legacy, manifest });
+    this.checkLegacyManifest(legacy, manifest);
+    const mac = deviceMac.toUpperCase();
+    const command = this.otaCommand(mac, firmwareUrl, manifest);
+    await this.publishCommand(`${UPDATE_TOPIC_PREFIX}${mac}`, command);
+    if (legacy) await this.publishCommand(UPDATE_TOPIC_LEGACY, command);
+  }
+
+  // Comando OTA para los dispositivos que se suscribieron al grupo (addUpdateGroup en el firmware).
+  // percent/windowSec: despliegue escalonado (ver rolloutOptions)
+  async publishGroupOTAUpdate(group, firmwareUrl, { percent, windowSec, manifest } = {}) {
+    if (!group || /[+#/]/.test(group)) {
+      throw new Error(`Invalid update group: ${group}`);
+    }
+    const command = this.otaCommand('all', firmwareUrl, manifest) + this.rolloutOptions(percent, windowSec);
+    await this.publishCommand(`${UPDATE_TOPIC_GROUP}${group}`, command);
+  }
+
+  // Comando OTA para toda la flota
+  async publishBroadcastOTAUpdate(firmwareUrl, { legacy = false, percent, windowSec, manifest } = {}) {
+    const options = this.rolloutOptions(percent, windowSec);
+    // El firmware anterior tomaría las opciones como parte de la URL
+    if (legacy && options) {
+      throw new Error('Rollout options are not understood on the legacy update topic');
+    }
+    this.checkLegacyManifest(legacy, manifest);
+    const command = this.otaCommand('all', firmwareUrl, manifest) + options;
+    await this.publishCommand(UPDATE_TOPIC_ALL, command);
+    if (legacy) await this.publishCommand(UPDATE_TOPIC_LEGACY, command);
+  }
+
+  // "<destino>|<URL>" o, con manifiesto, "<destino>|manifest|<versión>|<tamaño>|<sha256>|<URL>"
+  otaCommand(target, firmwareUrl, manifest) {
+    if (!manifest) return `${target}|${firmwareUrl}`;
+    const { version, size, sha256 } = manifest;
+    if (!version || /\|/.test(version)) throw new Error(`Invalid manifest version: ${version}`);
+    if (!Number.isInteger(size) || size <= 0 || size > 999999999) {
+      throw new Error(`Invalid manifest size: ${size}`);
+    }
+    if (!/^[0-9a-fA-F]{64}$/.test(sha256 || '')) throw new Error(`Invalid manifest sha256: ${sha256}`);
+    const { signature } = manifest;
+    if (signature && !/^([0-9a-fA-F]{2}){1,104}$/.test(signature)) {
+      throw new Error(`Invalid manifest signature: ${signature}`);
+    }
+    const sig = signature ? `|sig=${signature.toLowerCase()}` : '';
+    return `${target}|manifest|${version}|${size}|${sha256.toLowerCase()}|${firmwareUrl}${sig}`;
+  }
+
+  // El firmware anterior intentaría descargar "manifest|..." como si fuera la URL
+  checkLegacyManifest(legacy, manifest) {
+    if (legacy && manifest) {
+      throw new Error('Manifest commands are not understood on the legacy update topic');
+    }
+  }
+
+  // Manifiesto de una imagen .bin: el hash es el que el dispositivo obtiene de su partición
+  // (esp_partition_get_sha256). Si esptool le agregó el SHA-256 (byte 23 de la cabecera en 1),
+  // son sus últimos 32 bytes; si no, el del archivo completo.
+  // Con signingKey (clave privada EC o RSA, la pareja de setOTASigningKey en el firmware) se
+  // firma ese mismo hash; el dispositivo lo verifica antes de cambiar de partición.
+  firmwareManifest(image, version, { signingKey } = {}) {
+    const hashAppended = image.length > 32 && image[0] === 0xe9 && image[23] === 1;
+    const hashed = hashAppended ? image.subarray(0, image.length - 32) : image;
+    const sha256 = crypto.createHash('sha256').update(hashed).digest('hex');
+    if (hashAppended && sha256 !== image.subarray(image.length - 32).toString('hex')) {
+      throw new Error('Firmware image is corrupt: appended SHA-256 does not match');
+    }
+    const manifest = { version, size: image.length, sha256 };
+    if (signingKey) manifest.signature = crypto.sign('sha256', hashed, signingKey).toString('hex');
+    return manifest;
+  }
+
+  // Opciones de despliegue escalonado de los comandos "all": solo actualiza el percent% de
+  // la flota (cohortes fijas por MAC, así subir el porcentaje mantiene a los anteriores) y
+  // cada equipo empieza en un momento al azar dentro de windowSec segundos
+  rolloutOptions(percent, windowSec) {
+    let options = '';
+    if (percent !== undefined && percent !== null) {
+      if (!Number.isInteger(percent) || percent < 0 || percent > 100) {
+        throw new Error(`Invalid rollout percent: ${percent}`);
+      }
+      if (percent < 100) options += `|pct=${percent}`;
+    }
+    if (windowSec !== undefined && windowSec !== null) {
+      if (!Number.isInteger(windowSec) || windowSec < 0) {
+        throw new Error(`Invalid rollout window: ${windowSec}`);
+      }
+      if (windowSec > 0) options += `|win=${windowSec}`;
+    }
+    return options;
+  }
+
+  // Sin retain: un comando retenido se repetiría en cada reconexión del dispositivo
+  publishCommand(topic, message) {
     if (!this.client) {
-      throw new Error('MQTT client not connected');
+      return Promise.reject(new Error('MQTT client not connected'));
     }
-    const topic = deviceMac ? `esp32/ota/${deviceMac}` : 'esp32/ota/all';
-    const message = JSON.stringify({
-      url: firmwareUrl,
-      version,
-      timestamp: new Date().toISOString(),
-    });
     return new Promise((resolve, reject) => {
       this.client.publish(topic, message, { qos: 1 }, (error) => {
         if (error) {
@@ -233,6 +480,10 @@ class MQTTManager {
   }
 
   disconnect() {
+    if (this.ingestTimer) {
+      clearInterval(this.ingestTimer);
+      this.ingestTimer = null;
+    }
     if (this.client) {
       this.client.end();
       this.client = null;
@@ -0,0 +1,26 @@
+-- CreateTable
+CREATE TABLE "device_metrics" (
+    "id" TEXT NOT NULL,
+    "deviceId" TEXT NOT NULL,
+    "uptimeMs" BIGINT NOT NULL,
+    "windowMs" INTEGER NOT NULL,
+    "freeHeap" INTEGER,
+    "minFreeHeap" INTEGER,
+    "maxAllocHeap" INTEGER,
+    "loopP50Us" INTEGER,
+    "loopP99Us" INTEGER,
+    "loopMaxUs" INTEGER,
+    "publishP99Us" INTEGER,
+    "mqttLost" INTEGER,
+    "wifiLost" INTEGER,
+    "snapshot" JSONB NOT NULL,
+    "timestamp" TIMESTAMP(3) NOT NULL DEFAULT (CURRENT_TIMESTAMP AT TIME ZONE 'America/Argentina/Buenos_Aires'),
+
+    CONSTRAINT "device_metrics_pkey" PRIMARY KEY ("id")
+);
+
+-- CreateIndex
+CREATE INDEX "device_metrics_deviceId_timestamp_idx" ON "device_metrics"("deviceId", "timestamp");
+
+-- AddForeignKey
+ALTER TABLE "device_metrics" ADD CONSTRAINT "device_metrics_deviceId_fkey" FOREIGN KEY ("deviceId") REFERENCES "devices"("id") ON DELETE CASCADE ON UPDATE CASCADE;